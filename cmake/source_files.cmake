@@ -10,7 +10,8 @@ SET(LCB_UTILS_SRC
     src/hashtable.c
     src/list.c
     src/logging.c
-    src/ringbuffer.c)
+    src/ringbuffer.c
+    src/timerwheel.c)
 
 # lcbio
 FILE(GLOB LCB_IO_SRC src/lcbio/*.c)
@@ -54,6 +55,7 @@ SET(LCB_CORE_CXXSRC
     src/bucketconfig/bc_cccp.cc
     src/bucketconfig/bc_http.cc
     src/bucketconfig/bc_file.cc
+    src/bucketconfig/bc_shm.cc
     src/bucketconfig/bc_static.cc
     src/bucketconfig/confmon.cc
     src/collections.cc
@@ -62,6 +62,7 @@ extern "C" {
     } cbsasl_secret_t;
 
     typedef struct cbsasl_conn_st cbsasl_conn_t;
+    typedef struct cbsasl_scram_cache_st cbsasl_scram_cache_t;
 
     typedef struct {
         void *context;
@@ -95,6 +96,7 @@ extern "C" {
         unsigned char *saltedpassword; // for SCRAM-SHA authentication
         unsigned int saltedpasslen; // length of the salted password field
         char *auth_message; // for SCRAM-SHA authentication
+        cbsasl_scram_cache_t *scram_cache; // optional, not owned
     };
 
     struct cbsasl_server_conn_t {
@@ -247,6 +249,34 @@ extern "C" {
                                       const char **clientout,
                                       unsigned int *clientoutlen);
 
+    /**
+     * Creates a cache for SCRAM-SHA salted passwords.
+     *
+     * Deriving the salted password runs PBKDF2 with the iteration count
+     * requested by the server, which is by far the most expensive part of
+     * the SCRAM exchange. Connections sharing a cache only run it once for
+     * each combination of mechanism, user, password, salt and iteration
+     * count. The cache is not thread safe.
+     *
+     * @return the new cache, or NULL if out of memory
+     */
+    CBSASL_PUBLIC_API
+    cbsasl_scram_cache_t *cbsasl_scram_cache_new(void);
+
+    /**
+     * Wipes and frees the cache. Connections using it must have been
+     * disposed already.
+     */
+    CBSASL_PUBLIC_API
+    void cbsasl_scram_cache_free(cbsasl_scram_cache_t *cache);
+
+    /**
+     * Makes the client connection use the given cache. Must be called
+     * before cbsasl_client_step()
+     */
+    CBSASL_PUBLIC_API
+    cbsasl_error_t cbsasl_client_set_scram_cache(cbsasl_conn_t *conn, cbsasl_scram_cache_t *cache);
+
 #ifdef __cplusplus
 }
 #endif
@@ -276,14 +276,20 @@ cbsasl_error_t cbsasl_client_step(cbsasl_conn_t *conn, const char *serverin, uns
                     return SASL_BADPARAM;
                 }
                 // ok, now we can compute the client proof
-                ret = generate_salted_password(conn->c.client.auth_mech, pass, salt, saltlen, itcount, saltedpassword,
-                                               &saltedpasslen);
-                if (ret != SASL_OK) {
-                    return ret;
+                if (!scram_cache_get(conn->c.client.scram_cache, conn->c.client.auth_mech, usernm, usernmlen, pass,
+                                     salt, saltlen, itcount, saltedpassword, &saltedpasslen)) {
+                    ret = generate_salted_password(conn->c.client.auth_mech, pass, salt, saltlen, itcount,
+                                                   saltedpassword, &saltedpasslen);
+                    if (ret != SASL_OK) {
+                        return ret;
+                    }
+                    scram_cache_put(conn->c.client.scram_cache, conn->c.client.auth_mech, usernm, usernmlen, pass,
+                                    salt, saltlen, itcount, saltedpassword, saltedpasslen);
                 }
                 // save salted password for later use
                 conn->c.client.saltedpassword = calloc(saltedpasslen, 1);
                 if (conn->c.client.saltedpassword == NULL) {
+                    cbsasl_secure_zero(saltedpassword, sizeof(saltedpassword));
                     return SASL_NOMEM;
                 }
                 memcpy(conn->c.client.saltedpassword, saltedpassword, saltedpasslen);
@@ -322,6 +328,7 @@ cbsasl_error_t cbsasl_client_step(cbsasl_conn_t *conn, const char *serverin, uns
                     strlen(conn->c.client.client_first_message_bare), serverin, serverinlen, conn->c.client.userdata,
                     strlen(FINAL_HEADER) + noncelen, &(conn->c.client.auth_message),
                     conn->c.client.userdata + strlen(FINAL_HEADER) + noncelen + strlen(PROOF_ATTR), prooflen + 1);
+                cbsasl_secure_zero(saltedpassword, sizeof(saltedpassword));
                 if (ret != SASL_OK) {
                     return ret;
                 }
@@ -395,3 +402,13 @@ cbsasl_error_t cbsasl_client_check(cbsasl_conn_t *conn, const char *serverin, un
 
     return SASL_OK;
 }
+
+CBSASL_PUBLIC_API
+cbsasl_error_t cbsasl_client_set_scram_cache(cbsasl_conn_t *conn, cbsasl_scram_cache_t *cache)
+{
+    if (conn->client == 0) {
+        return SASL_BADPARAM;
+    }
+    conn->c.client.scram_cache = cache;
+    return SASL_OK;
+}
@@ -26,7 +26,10 @@ void cbsasl_dispose(cbsasl_conn_t **conn)
             free((*conn)->c.client.userdata);
             free((*conn)->c.client.nonce);
             free((*conn)->c.client.client_first_message_bare);
-            free((*conn)->c.client.saltedpassword);
+            if ((*conn)->c.client.saltedpassword) {
+                cbsasl_secure_zero((*conn)->c.client.saltedpassword, (*conn)->c.client.saltedpasslen);
+                free((*conn)->c.client.saltedpassword);
+            }
             free((*conn)->c.client.auth_message);
         } else {
             free((*conn)->c.server.username);
@@ -39,6 +42,14 @@ void cbsasl_dispose(cbsasl_conn_t **conn)
     }
 }
 
+void cbsasl_secure_zero(void *buf, size_t len)
+{
+    volatile unsigned char *p = (volatile unsigned char *)buf;
+    while (len--) {
+        *p++ = 0;
+    }
+}
+
 static const char *hexchar = "0123456789abcdef";
 void cbsasl_hex_encode(char *dest, const char *src, size_t srclen)
 {
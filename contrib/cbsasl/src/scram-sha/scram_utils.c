@@ -16,12 +16,14 @@
 
 #include "scram_utils.h"
 #include "config.h"
+#include "util.h"
 #include <time.h>
 #include <ctype.h>
 
 #include "strcodecs/strcodecs.h"
 
 #ifndef LCB_NO_SSL
+#include <openssl/crypto.h>
 #include <openssl/rand.h>
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
@@ -335,6 +337,171 @@ static cbsasl_error_t HMAC_digest(cbsasl_auth_mechanism_t auth_mech, const unsig
 }
 #endif
 
+#define SCRAM_CACHE_SIZE 8
+
+/**
+ * A cached salted password. The password itself is not kept: instead the
+ * entry holds HMAC(SaltedPassword, password), which is enough to notice that
+ * the password for the user has changed.
+ */
+typedef struct {
+    cbsasl_auth_mechanism_t auth_mech;
+    unsigned int itcount;
+    char *salt;
+    unsigned int saltlen;
+    char *usernm;
+    unsigned int usernmlen;
+    unsigned char saltedpassword[CBSASL_SHA512_DIGEST_SIZE];
+    unsigned int saltedpasslen;
+    unsigned char passtag[CBSASL_SHA512_DIGEST_SIZE];
+    unsigned int passtaglen;
+} scram_cache_entry;
+
+struct cbsasl_scram_cache_st {
+    scram_cache_entry entries[SCRAM_CACHE_SIZE];
+    unsigned int next; // next slot to (re)use
+};
+
+static void scram_cache_clear_entry(scram_cache_entry *entry)
+{
+    free(entry->salt);
+    free(entry->usernm);
+    cbsasl_secure_zero(entry, sizeof(*entry));
+}
+
+CBSASL_PUBLIC_API
+cbsasl_scram_cache_t *cbsasl_scram_cache_new(void)
+{
+    return calloc(1, sizeof(cbsasl_scram_cache_t));
+}
+
+CBSASL_PUBLIC_API
+void cbsasl_scram_cache_free(cbsasl_scram_cache_t *cache)
+{
+    unsigned int i;
+    if (cache == NULL) {
+        return;
+    }
+    for (i = 0; i < SCRAM_CACHE_SIZE; ++i) {
+        scram_cache_clear_entry(cache->entries + i);
+    }
+    free(cache);
+}
+
+#ifndef LCB_NO_SSL
+/**
+ * Returns the matching entry, or NULL. The password tag is only verified
+ * once every other part of the key matches.
+ */
+static scram_cache_entry *scram_cache_find(cbsasl_scram_cache_t *cache, cbsasl_auth_mechanism_t auth_mech,
+                                           const char *usernm, unsigned int usernmlen, const char *salt,
+                                           unsigned int saltlen, unsigned int itcount)
+{
+    unsigned int i;
+    for (i = 0; i < SCRAM_CACHE_SIZE; ++i) {
+        scram_cache_entry *entry = cache->entries + i;
+        if (entry->saltedpasslen && entry->auth_mech == auth_mech && entry->itcount == itcount &&
+            entry->saltlen == saltlen && entry->usernmlen == usernmlen && memcmp(entry->salt, salt, saltlen) == 0 &&
+            memcmp(entry->usernm, usernm, usernmlen) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+#endif
+
+int scram_cache_get(cbsasl_scram_cache_t *cache, cbsasl_auth_mechanism_t auth_mech, const char *usernm,
+                    unsigned int usernmlen, const cbsasl_secret_t *passwd, const char *salt, unsigned int saltlen,
+                    unsigned int itcount, unsigned char *outbuffer, unsigned int *outlength)
+{
+#ifndef LCB_NO_SSL
+    scram_cache_entry *entry;
+    unsigned char passtag[EVP_MAX_MD_SIZE];
+    unsigned int passtaglen = 0;
+
+    if (cache == NULL) {
+        return 0;
+    }
+    entry = scram_cache_find(cache, auth_mech, usernm, usernmlen, salt, saltlen, itcount);
+    if (entry == NULL) {
+        return 0;
+    }
+    if (HMAC_digest(auth_mech, entry->saltedpassword, entry->saltedpasslen, passwd->data, passwd->len, passtag,
+                    &passtaglen) != SASL_OK) {
+        return 0;
+    }
+    if (passtaglen != entry->passtaglen || CRYPTO_memcmp(passtag, entry->passtag, passtaglen) != 0) {
+        // same user, but the password has changed
+        scram_cache_clear_entry(entry);
+        return 0;
+    }
+    memcpy(outbuffer, entry->saltedpassword, entry->saltedpasslen);
+    *outlength = entry->saltedpasslen;
+    return 1;
+#else
+    (void)cache;
+    (void)auth_mech;
+    (void)usernm;
+    (void)usernmlen;
+    (void)passwd;
+    (void)salt;
+    (void)saltlen;
+    (void)itcount;
+    (void)outbuffer;
+    (void)outlength;
+    return 0;
+#endif
+}
+
+void scram_cache_put(cbsasl_scram_cache_t *cache, cbsasl_auth_mechanism_t auth_mech, const char *usernm,
+                     unsigned int usernmlen, const cbsasl_secret_t *passwd, const char *salt, unsigned int saltlen,
+                     unsigned int itcount, const unsigned char *saltedpassword, unsigned int saltedpasslen)
+{
+#ifndef LCB_NO_SSL
+    scram_cache_entry *entry;
+
+    if (cache == NULL || saltedpasslen > sizeof(entry->saltedpassword)) {
+        return;
+    }
+    entry = scram_cache_find(cache, auth_mech, usernm, usernmlen, salt, saltlen, itcount);
+    if (entry == NULL) {
+        entry = cache->entries + cache->next;
+        cache->next = (cache->next + 1) % SCRAM_CACHE_SIZE;
+    }
+    scram_cache_clear_entry(entry);
+
+    entry->salt = malloc(saltlen);
+    entry->usernm = malloc(usernmlen ? usernmlen : 1);
+    if (entry->salt == NULL || entry->usernm == NULL) {
+        scram_cache_clear_entry(entry);
+        return;
+    }
+    memcpy(entry->salt, salt, saltlen);
+    entry->saltlen = saltlen;
+    memcpy(entry->usernm, usernm, usernmlen);
+    entry->usernmlen = usernmlen;
+    memcpy(entry->saltedpassword, saltedpassword, saltedpasslen);
+    entry->saltedpasslen = saltedpasslen;
+    entry->auth_mech = auth_mech;
+    entry->itcount = itcount;
+    if (HMAC_digest(auth_mech, saltedpassword, saltedpasslen, passwd->data, passwd->len, entry->passtag,
+                    &entry->passtaglen) != SASL_OK) {
+        scram_cache_clear_entry(entry);
+    }
+#else
+    (void)cache;
+    (void)auth_mech;
+    (void)usernm;
+    (void)usernmlen;
+    (void)passwd;
+    (void)salt;
+    (void)saltlen;
+    (void)itcount;
+    (void)saltedpassword;
+    (void)saltedpasslen;
+#endif
+}
+
 /**
  * Computes the client proof. It is computed as:
  *
@@ -64,6 +64,23 @@ cbsasl_error_t generate_salted_password(cbsasl_auth_mechanism_t auth_mech, const
                                         const char *salt, unsigned int saltlen, unsigned int itcount,
                                         unsigned char *outbuffer, unsigned int *outlength);
 
+/**
+ * Looks up the salted password in the cache. Returns 1 and fills 'outbuffer'
+ * (which must hold CBSASL_SHA512_DIGEST_SIZE bytes) on hit, 0 on miss or if
+ * 'cache' is NULL.
+ */
+int scram_cache_get(cbsasl_scram_cache_t *cache, cbsasl_auth_mechanism_t auth_mech, const char *usernm,
+                    unsigned int usernmlen, const cbsasl_secret_t *passwd, const char *salt, unsigned int saltlen,
+                    unsigned int itcount, unsigned char *outbuffer, unsigned int *outlength);
+
+/**
+ * Stores the salted password in the cache, evicting the oldest entry if it
+ * is full. Does nothing if 'cache' is NULL.
+ */
+void scram_cache_put(cbsasl_scram_cache_t *cache, cbsasl_auth_mechanism_t auth_mech, const char *usernm,
+                     unsigned int usernmlen, const cbsasl_secret_t *passwd, const char *salt, unsigned int saltlen,
+                     unsigned int itcount, const unsigned char *saltedpassword, unsigned int saltedpasslen);
+
 /**
  * Computes the client proof. It is computed as:
  *
@@ -27,5 +27,8 @@ int cbsasl_secure_compare(const char *a, size_t alen, const char *b, size_t blen
 
 cbsasl_error_t cbsasl_secure_random(char *dest, size_t len);
 
+/* Zero out len bytes of buf in a way the compiler won't optimize away */
+void cbsasl_secure_zero(void *buf, size_t len);
+
 
 #endif /*  CBSASL_UTIL_H_ */
@@ -1287,11 +1287,288 @@ typedef enum {
  */
 #define LCB_CNTL_ALLOW_STATIC_CONFIG 0x60
 
+/**
+ * Write the configuration cache file (see @ref LCB_CNTL_CONFIGCACHE) as a
+ * compact binary snapshot instead of JSON. This avoids JSON parsing when
+ * the cache is loaded. Cache files in either format are always accepted
+ * when reading.
+ *
+ * Use `config_cache_binary` in the connection string
+ *
+ * @cntl_arg_both{int* (as boolean)}
+ * @volatile
+ */
+#define LCB_CNTL_CONFIGCACHE_BINARY 0x61
+
+/**
+ * @brief Name of the shared memory segment used for the cross-process
+ * configuration cache.
+ *
+ * Processes on the same host which set the same segment name share a single
+ * copy of the cluster map. One process owns the segment: it retrieves the
+ * configuration from the cluster and publishes every new revision into the
+ * segment. The other processes only read from the segment and pick up new
+ * revisions without contacting the cluster themselves. If the owner goes away,
+ * another process takes ownership and resumes fetching via the regular
+ * providers.
+ *
+ * If the name is NULL or empty, it is derived from the bucket name.
+ *
+ * Use `config_shm` in the connection string
+ *
+ * @note Only supported on POSIX platforms, and only for couchbase buckets
+ * @cntl_arg_get_and_set{char**, char*}
+ * @volatile
+ */
+#define LCB_CNTL_CONFIG_SHM 0x62
+
+/**
+ * @brief Connect to all data nodes when a configuration is applied
+ *
+ * By default a connection to a data node is only established once the first
+ * operation for that node is scheduled, so the first operations to each node
+ * also pay for connecting, authenticating and negotiating the session. When
+ * this setting is enabled, every time a new configuration is applied all data
+ * nodes which are not yet connected are connected to in parallel, and
+ * lcb_wait() does not return until each of these connections has either been
+ * fully negotiated or has failed.
+ *
+ * Calling lcb_wait() after lcb_connect() therefore waits for the whole
+ * instance to be ready, rather than only for the bootstrap.
+ *
+ * Use `kv_preconnect` in the connection string
+ *
+ * @cntl_arg_both{int* (as boolean)}
+ * @volatile
+ */
+#define LCB_CNTL_KV_PRECONNECT 0x63
+
+/**
+ * @brief Negotiate new KV connections in a single round trip
+ *
+ * Normally HELLO, SASL_LIST_MECHS, SASL_AUTH, GET_ERROR_MAP and SELECT_BUCKET
+ * are sent one after another, each waiting for the previous reply. When this
+ * setting is enabled and the SASL mechanism is already known (either forced via
+ * @ref LCB_CNTL_FORCE_SASL_MECH, or remembered from a previous connection to
+ * the same node), HELLO and SASL_AUTH are written at once. GET_ERROR_MAP and
+ * (for single-step mechanisms) SELECT_BUCKET follow as soon as the HELLO reply
+ * shows the server supports them, without waiting for the authentication. If
+ * any of the pipelined requests fails, negotiation starts over with the
+ * regular sequence on the same connection.
+ *
+ * PLAIN is only pipelined over TLS connections.
+ *
+ * Use `pipeline_negotiation` in the connection string
+ *
+ * @cntl_arg_both{int* (as boolean)}
+ * @volatile
+ */
+#define LCB_CNTL_PIPELINE_NEGOTIATION 0x64
+
+/**
+ * @brief Busy poll timeout for new sockets
+ *
+ * When non-zero, blocking reads on the socket busy poll the receive queue of
+ * the network device for up to this many microseconds before sleeping
+ * (`SO_BUSY_POLL` on Linux). This trades CPU time for lower latency.
+ * Setting a value above `net.core.busy_poll` may require `CAP_NET_ADMIN`.
+ * Ignored on platforms which do not support it.
+ *
+ * Use `tcp_busy_poll` in the connection string
+ *
+ * @cntl_arg_both{lcb_U32* (microseconds)}
+ * @volatile
+ */
+#define LCB_CNTL_TCP_BUSY_POLL 0x65
+
+/**
+ * @brief Size of the socket receive buffer
+ *
+ * Sets `SO_RCVBUF` on new sockets before they are connected, so that the
+ * TCP window scaling is negotiated accordingly. 0 keeps the system default.
+ *
+ * Use `tcp_rcvbuf` in the connection string
+ *
+ * @cntl_arg_both{lcb_U32* (bytes)}
+ * @volatile
+ */
+#define LCB_CNTL_TCP_RCVBUF 0x66
+
+/**
+ * @brief Size of the socket send buffer
+ *
+ * Sets `SO_SNDBUF` on new sockets before they are connected. 0 keeps the
+ * system default.
+ *
+ * Use `tcp_sndbuf` in the connection string
+ *
+ * @cntl_arg_both{lcb_U32* (bytes)}
+ * @volatile
+ */
+#define LCB_CNTL_TCP_SNDBUF 0x67
+
+/**
+ * @brief Disable delayed acknowledgements on new connections
+ *
+ * Sets `TCP_QUICKACK` once the connection is established. Note that Linux may
+ * fall back to delayed acknowledgements later on, so this mostly helps the
+ * first exchanges of the connection (i.e. the negotiation).
+ *
+ * Use `tcp_quickack` in the connection string
+ *
+ * @cntl_arg_both{int* (as boolean)}
+ * @volatile
+ */
+#define LCB_CNTL_TCP_QUICKACK 0x68
+
+/**
+ * @brief Time for which transmitted data may remain unacknowledged
+ *
+ * When non-zero, the connection is closed by the kernel if data written to it
+ * is not acknowledged by the peer within this interval (`TCP_USER_TIMEOUT`).
+ * This detects dead peers sooner than retransmission timeouts or keepalive.
+ *
+ * Use `tcp_user_timeout` in the connection string
+ *
+ * @cntl_arg_both{lcb_U32* (microseconds, rounded up to milliseconds)}
+ * @volatile
+ */
+#define LCB_CNTL_TCP_USER_TIMEOUT 0x69
+
+/**
+ * @brief Type of service of new connections
+ *
+ * Sets `IP_TOS` (or `IPV6_TCLASS` for IPv6 connections) on new sockets, e.g.
+ * to mark the traffic with a DSCP class. 0 keeps the system default.
+ *
+ * Use `ip_tos` in the connection string
+ *
+ * @cntl_arg_both{int* (0-255)}
+ * @volatile
+ */
+#define LCB_CNTL_IP_TOS 0x6a
+
+/**
+ * @brief Number of KV connections to each node
+ *
+ * Operations for a node are spread over this many connections. Each vBucket
+ * sticks to one connection while it has operations in flight, which keeps
+ * them in order; otherwise the connection with the fewest bytes pending is
+ * picked. This only applies to nodes added by configurations received after
+ * the setting was changed. With @ref LCB_CNTL_METRICS, each additional
+ * connection is reported separately, as `host:port#N`.
+ *
+ * Use `kv_pool_size` in the connection string
+ *
+ * @cntl_arg_both{lcb_U32* (1-16)}
+ * @volatile
+ */
+#define LCB_CNTL_KV_POOL_SIZE 0x6b
+
+/**
+ * Minimum number of idle pooled HTTP sockets to keep for each node once it
+ * has been used. Sockets are opened in the background to replace the ones
+ * taken by requests, so that query requests do not have to wait for a new
+ * connection. This is capped by @ref LCB_CNTL_HTTP_POOLSIZE. The default
+ * is 0.
+ *
+ * Use `http_pool_min_idle` in the connection string
+ *
+ * @cntl_arg_both{lcb_SIZE*}
+ * @volatile
+ */
+#define LCB_CNTL_HTTP_POOL_MIN_IDLE 0x6c
+
+/**
+ * @brief Maximum age of cached TLS sessions
+ *
+ * The TLS session (TLS 1.2 ticket or TLS 1.3 pre-shared key) received from
+ * each endpoint is kept and offered when connecting to the same endpoint
+ * again, which saves a full handshake. Sessions older than this are not
+ * offered anymore, regardless of the lifetime announced by the server.
+ * 0 disables the session cache. The default is 300 seconds.
+ *
+ * Use `ssl_session_lifetime` in the connection string
+ *
+ * @cntl_arg_both{lcb_U32* (microseconds)}
+ * @volatile
+ */
+#define LCB_CNTL_SSL_SESSION_LIFETIME 0x6d
+
+/**
+ * @brief Offload TLS record processing to the kernel
+ *
+ * When enabled, OpenSSL is asked to hand the negotiated keys over to the
+ * kernel (kTLS) once the handshake is complete. Data is then encrypted and
+ * decrypted by the kernel, and written and read directly by the socket
+ * routines of the I/O plugin without being copied through OpenSSL.
+ *
+ * This requires Linux, an OpenSSL 3 library built with kTLS support, the
+ * `tls` kernel module and an event-based I/O plugin. Whenever the kernel or
+ * the negotiated cipher does not support it, the connection transparently
+ * keeps using OpenSSL for the direction(s) which could not be offloaded.
+ *
+ * Use `ssl_ktls` in the connection string
+ *
+ * @cntl_arg_both{int* (as boolean)}
+ * @volatile
+ */
+#define LCB_CNTL_SSL_KTLS 0x6e
+
+/**
+ * @brief Compress large values in background threads
+ *
+ * Values of at least this many bytes are not compressed by the thread
+ * scheduling them, but by a pool of worker threads, so that snappy does not
+ * stall the event loop and the other operations of the instance. Such a
+ * store (and the operations scheduled after it to the same connection) is
+ * sent once the compression completes, so their relative order is kept.
+ *
+ * The value is copied before lcb_store() returns. A value of 0 (the
+ * default) compresses every value inline.
+ *
+ * Use `compression_async_min_size` in the connection string
+ *
+ * @cntl_arg_both{lcb_U32*}
+ * @volatile
+ */
+#define LCB_CNTL_COMPRESSION_ASYNC_MIN_SIZE 0x6f
+
+/**
+ * @brief Number of threads compressing values in the background
+ *
+ * See @ref LCB_CNTL_COMPRESSION_ASYNC_MIN_SIZE. The threads are started when
+ * the first value is handed to them, later changes have no effect.
+ *
+ * Use `compression_async_threads` in the connection string
+ *
+ * @cntl_arg_both{lcb_U32*}
+ * @volatile
+ */
+#define LCB_CNTL_COMPRESSION_ASYNC_THREADS 0x70
+
+/**
+ * @brief Pass the progress of TLS handshakes to a custom logger
+ *
+ * Each state transition and alert of the TLS handshakes is logged at the
+ * DEBUG level. OpenSSL reports these through a callback which is only
+ * installed on new connections when the messages would be logged. This is
+ * the case for the console logger at the DEBUG level or lower. The level of
+ * a custom logger (see @ref LCB_CNTL_LOGGER) cannot be queried, so it only
+ * receives them when this is enabled.
+ *
+ * Use `ssl_log_handshake` in the connection string
+ *
+ * @cntl_arg_both{int* (as boolean)}
+ * @volatile
+ */
+#define LCB_CNTL_SSL_LOG_HANDSHAKE 0x71
+
 /**
  * This is not a command, but rather an indicator of the last item.
  * @internal
  */
-#define LCB_CNTL__MAX 0x61
+#define LCB_CNTL__MAX 0x72
 /**@}*/
 
 #ifdef __cplusplus
@@ -346,6 +346,27 @@ typedef int (*lcb_ioE_chkclosed_fn)(lcb_io_opt_t iops, lcb_socket_t sock, int fl
 /** Enable/Disable TCP Keepalive */
 #define LCB_IO_CNTL_TCP_KEEPALIVE 2
 
+/** Busy poll the device queue for up to this many microseconds when reading (int, Linux `SO_BUSY_POLL`) */
+#define LCB_IO_CNTL_SO_BUSY_POLL 3
+
+/** Size of the kernel receive buffer in bytes (int, `SO_RCVBUF`) */
+#define LCB_IO_CNTL_SO_RCVBUF 4
+
+/** Size of the kernel send buffer in bytes (int, `SO_SNDBUF`) */
+#define LCB_IO_CNTL_SO_SNDBUF 5
+
+/** Send ACKs immediately rather than delaying them (int, Linux `TCP_QUICKACK`) */
+#define LCB_IO_CNTL_TCP_QUICKACK 6
+
+/** Milliseconds transmitted data may remain unacknowledged before the connection is dropped (int, `TCP_USER_TIMEOUT`) */
+#define LCB_IO_CNTL_TCP_USER_TIMEOUT 7
+
+/** Type of service, or traffic class for IPv6 (int, `IP_TOS`/`IPV6_TCLASS`) */
+#define LCB_IO_CNTL_IP_TOS 8
+
+/** CPU which processes the incoming packets of the socket, only for LCB_IO_CNTL_GET (int, `SO_INCOMING_CPU`) */
+#define LCB_IO_CNTL_SO_INCOMING_CPU 9
+
 /**
  * @brief Execute a specificied operation on a socket.
  * @param iops The iops
@@ -904,7 +925,11 @@ typedef enum {
     LCB_IO_OPS_LIBEV = 0x04,
     LCB_IO_OPS_SELECT = 0x05,
     LCB_IO_OPS_WINIOCP = 0x06,
-    LCB_IO_OPS_LIBUV = 0x07
+    LCB_IO_OPS_LIBUV = 0x07,
+    /** Built-in epoll(7) loop, Linux only. See lcb_create_epoll_io_opts() */
+    LCB_IO_OPS_EPOLL = 0x08,
+    /** Built-in io_uring(7) completion loop, Linux only. See lcb_create_uring_io_opts() */
+    LCB_IO_OPS_URING = 0x09
 } lcb_io_ops_type_t;
 
 /** @brief IO Creation for builtin plugins */
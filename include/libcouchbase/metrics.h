@@ -62,6 +62,18 @@ typedef struct lcb_SERVERMETRICS_st {
 
     /** Number of NOT_MY_VBUCKET replies received */
     lcb_SIZE packets_nmv;
+
+    /** Number of values which were run through the compressor */
+    lcb_SIZE compress_attempted;
+
+    /**
+     * Number of values eligible for compression which were sent as-is because
+     * sampling predicted they would not compress well enough
+     */
+    lcb_SIZE compress_skipped;
+
+    /** Number of values sent compressed. Subset of compress_attempted */
+    lcb_SIZE compress_succeeded;
 } lcb_SERVERMETRICS;
 
 typedef struct lcb_METRICS_st {
@@ -70,6 +82,13 @@ typedef struct lcb_METRICS_st {
 
     /** Number of times a packet entered the retry queue */
     lcb_SIZE packets_retried;
+
+    /**
+     * Number of configurations received via CCCP (including NOT_MY_VBUCKET
+     * replies) which were discarded without parsing, because their revision
+     * was not newer than the current one
+     */
+    lcb_SIZE configs_skipped;
 } lcb_METRICS;
 
 #ifdef __cplusplus
@@ -284,11 +284,11 @@ cntl_getset_impl(lcb_io_opt_t io, lcb_socket_t sock, int mode, int oslevel,
     #ifndef _WIN32
     socklen_t dummy = optsize;
     #else
-    char dummy = optsize;
+    int dummy = optsize;
     #endif
 
     if (mode == LCB_IO_CNTL_GET) {
-        rv = getsockopt(sock, oslevel, osopt, &dummy, (socklen_t *)optval);
+        rv = getsockopt(sock, oslevel, osopt, (char *)optval, &dummy);
     } else {
         rv = setsockopt(sock, oslevel, osopt, (const char *)optval, (socklen_t)optsize);
     }
@@ -306,6 +306,21 @@ cntl_getset_impl(lcb_io_opt_t io, lcb_socket_t sock, int mode, int oslevel,
     }
 }
 
+static int
+cntl_tos_impl(lcb_io_opt_t io, lcb_socket_t sock, int mode, void *arg)
+{
+    #ifdef IPV6_TCLASS
+    struct sockaddr_storage ss;
+    socklen_t sslen = sizeof(ss);
+    if (getsockname(sock, (struct sockaddr *)&ss, &sslen) == 0 && ss.ss_family == AF_INET6) {
+        return cntl_getset_impl(io,
+            sock, mode, IPPROTO_IPV6, IPV6_TCLASS, sizeof(int), arg);
+    }
+    #endif
+    return cntl_getset_impl(io,
+        sock, mode, IPPROTO_IP, IP_TOS, sizeof(int), arg);
+}
+
 static int
 cntl_impl(lcb_io_opt_t io, lcb_socket_t sock, int mode, int option, void *arg)
 {
@@ -316,6 +331,38 @@ cntl_impl(lcb_io_opt_t io, lcb_socket_t sock, int mode, int option, void *arg)
     case LCB_IO_CNTL_TCP_KEEPALIVE:
         return cntl_getset_impl(io,
             sock, mode, SOL_SOCKET, SO_KEEPALIVE, sizeof(int), arg);
+    case LCB_IO_CNTL_SO_RCVBUF:
+        return cntl_getset_impl(io,
+            sock, mode, SOL_SOCKET, SO_RCVBUF, sizeof(int), arg);
+    case LCB_IO_CNTL_SO_SNDBUF:
+        return cntl_getset_impl(io,
+            sock, mode, SOL_SOCKET, SO_SNDBUF, sizeof(int), arg);
+    case LCB_IO_CNTL_IP_TOS:
+        return cntl_tos_impl(io, sock, mode, arg);
+    #ifdef SO_BUSY_POLL
+    case LCB_IO_CNTL_SO_BUSY_POLL:
+        return cntl_getset_impl(io,
+            sock, mode, SOL_SOCKET, SO_BUSY_POLL, sizeof(int), arg);
+    #endif
+    #ifdef TCP_QUICKACK
+    case LCB_IO_CNTL_TCP_QUICKACK:
+        return cntl_getset_impl(io,
+            sock, mode, IPPROTO_TCP, TCP_QUICKACK, sizeof(int), arg);
+    #endif
+    #ifdef TCP_USER_TIMEOUT
+    case LCB_IO_CNTL_TCP_USER_TIMEOUT:
+        return cntl_getset_impl(io,
+            sock, mode, IPPROTO_TCP, TCP_USER_TIMEOUT, sizeof(int), arg);
+    #endif
+    #ifdef SO_INCOMING_CPU
+    case LCB_IO_CNTL_SO_INCOMING_CPU:
+        if (mode == LCB_IO_CNTL_GET) {
+            return cntl_getset_impl(io,
+                sock, mode, SOL_SOCKET, SO_INCOMING_CPU, sizeof(int), arg);
+        }
+        LCB_IOPS_ERRNO(io) = EINVAL;
+        return -1;
+    #endif
     default:
         LCB_IOPS_ERRNO(io) = ENOTSUP;
         return -1;
@@ -166,6 +166,7 @@ typedef struct lcbvb_CONFIG_st {
     int *randbuf;               /* Used for random server selection */
     uint64_t caps;              /**< Bucket capabilities */
     uint64_t ccaps;             /**< Cluster capabilities */
+    int64_t revepoch;           /* revision epoch from the config (0 if not present) */
 } lcbvb_CONFIG;
 
 #define LCBVB_BUCKET_NAME(cfg) (cfg)->bname
@@ -228,6 +229,23 @@ int lcbvb_load_json(lcbvb_CONFIG *vbc, const char *data);
 LIBCOUCHBASE_API
 int lcbvb_load_json_ex(lcbvb_CONFIG *vbc, const char *data, const char *source, char **network);
 
+/**
+ * @volatile
+ * @brief Extract the revision of a raw JSON configuration without parsing it
+ *
+ * This scans the top-level object of `data` for the `rev` and `revEpoch`
+ * fields. Nothing is allocated, and nested objects are skipped over, so this
+ * may be used to decide whether a configuration is worth loading at all.
+ *
+ * @param data the JSON configuration (need not be NUL-terminated)
+ * @param ndata the length of `data`
+ * @param[out] epoch set to the value of `revEpoch`, or 0 if not present
+ * @param[out] rev set to the value of `rev`, or -1 if not present
+ * @return nonzero if `rev` was found
+ */
+LIBCOUCHBASE_API
+int lcbvb_peek_revision(const char *data, size_t ndata, int64_t *epoch, int64_t *rev);
+
 /**@brief Serialize the current config as a JSON string.
  * @volatile
  * Serialize the current configuration as a JSON string. The string returned is
@@ -236,6 +254,40 @@ int lcbvb_load_json_ex(lcbvb_CONFIG *vbc, const char *data, const char *source,
 LIBCOUCHBASE_API
 char *lcbvb_save_json(lcbvb_CONFIG *vbc);
 
+/**@brief Serialize the current config as a compact binary snapshot.
+ * @volatile
+ * The snapshot is versioned and checksummed, and does not contain any pointers,
+ * so it may be loaded back (see lcbvb_load_binary()) directly from a file or a
+ * mapped memory region without JSON parsing.
+ * @param vbc the configuration
+ * @param[out] nbuf will contain the size of the returned buffer
+ * @return a buffer which should be freed using the free() function, or NULL
+ * on allocation failure.
+ */
+LIBCOUCHBASE_API
+char *lcbvb_save_binary(lcbvb_CONFIG *vbc, size_t *nbuf);
+
+/**
+ * @volatile
+ * @brief Check whether the buffer looks like a snapshot produced by
+ * lcbvb_save_binary()
+ * @return nonzero if the buffer starts with the binary snapshot header
+ */
+LIBCOUCHBASE_API
+int lcbvb_is_binary(const void *data, size_t ndata);
+
+/**
+ * @volatile
+ * @brief Load a snapshot produced by lcbvb_save_binary() into a configuration object
+ * @param vbc Object to populate (created by lcbvb_create())
+ * @param data the snapshot
+ * @param ndata size of the snapshot
+ * @return 0 on success, nonzero on failure (e.g. version or checksum mismatch).
+ * The reason may be retrieved with lcbvb_get_error()
+ */
+LIBCOUCHBASE_API
+int lcbvb_load_binary(lcbvb_CONFIG *vbc, const void *data, size_t ndata);
+
 /**
  * @committed
  * @brief Return a string indicating why parsing the configuration failed
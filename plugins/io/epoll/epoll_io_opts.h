@@ -0,0 +1,59 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef LIBCOUCHBASE_EPOLL_IO_OPTS_H
+#define LIBCOUCHBASE_EPOLL_IO_OPTS_H 1
+
+#include <libcouchbase/couchbase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Default number of events harvested by a single epoll_wait() call */
+#define LCB_EPOLL_DEFAULT_BATCH 256
+
+/**
+ * Options for lcb_create_epoll_io_opts(). Pass a pointer to this structure
+ * as the `cookie` of lcb_IOCREATEOPTS_BUILTIN, or as the last argument to
+ * lcb_create_epoll_io_opts(). NULL selects the defaults.
+ */
+typedef struct {
+    /**
+     * Maximum number of events returned by each epoll_wait() call. Bigger
+     * batches save system calls when many sockets are active at once.
+     * The `LCB_EPOLL_BATCH` environment variable overrides this value.
+     */
+    unsigned batch_size;
+} lcb_EPOLL_OPTIONS;
+
+/**
+ * Create an instance of an event handler that utilizes Linux epoll(7)
+ * for event notification.
+ *
+ * @param version must be 0
+ * @param io where the new I/O table is stored
+ * @param arg optional pointer to lcb_EPOLL_OPTIONS
+ * @return status of the operation
+ */
+LIBCOUCHBASE_API
+lcb_STATUS lcb_create_epoll_io_opts(int version, lcb_io_opt_t *io, void *arg);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,481 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * Event-model plugin built directly on epoll(7).
+ *
+ * Sockets are registered edge-triggered. Since an edge is only reported
+ * once, an event which was delivered is "disarmed", and the next watch()
+ * call re-arms it with EPOLL_CTL_MOD (which re-evaluates readiness). This
+ * way the library does not have to drain the socket to EAGAIN, while
+ * watch() calls which do not follow a delivery or a cancel() cost no system
+ * call.
+ *
+ * epoll has one registration per descriptor, while the library may create
+ * several events for the same socket. The registration belongs to the event
+ * which last added or modified it; only that event removes it when freed.
+ *
+ * Timers are kept in the shared timing wheel (see timerwheel.h).
+ */
+
+#define LCB_IOPS_V12_NO_DEPRECATE
+
+#include "internal.h"
+#include "timerwheel.h"
+#include "epoll_io_opts.h"
+#include <libcouchbase/plugins/io/bsdio-inl.c>
+#include <sys/epoll.h>
+
+typedef struct ep_EVENT ep_EVENT;
+struct ep_EVENT {
+    lcb_list_t list;
+    lcb_socket_t sock;
+    /** socket whose epoll registration points to this event, or INVALID_SOCKET */
+    lcb_socket_t regsock;
+    short flags;
+    /** flags the registration was armed with */
+    short armflags;
+    /** registration will report the next readiness change */
+    int armed;
+    void *cb_data;
+    lcb_ioE_callback handler;
+};
+
+typedef struct {
+    lcb_TWENTRY entry;
+    void *cb_data;
+    lcb_ioE_callback handler;
+} ep_TIMER;
+
+typedef struct {
+    int epfd;
+    lcb_list_t events;
+    /** number of events with non-zero flags */
+    unsigned nactive;
+
+    lcb_TIMERWHEEL timers;
+
+    struct epoll_event *batch;
+    unsigned batch_size;
+    /** number of entries of 'batch' being dispatched */
+    int nbatch;
+
+    int event_loop;
+} ep_LOOP;
+
+/**
+ * Remove the event's registration from the epoll set, if it still owns it.
+ * Errors are ignored: the socket may be closed already
+ */
+static void ep_unregister(ep_LOOP *io, ep_EVENT *ev)
+{
+    if (ev->regsock != INVALID_SOCKET) {
+        struct epoll_event dummy = {0};
+        epoll_ctl(io->epfd, EPOLL_CTL_DEL, ev->regsock, &dummy);
+        ev->regsock = INVALID_SOCKET;
+    }
+    ev->armed = 0;
+}
+
+/**
+ * Called once the registration of @p sock points to @p ev. Several events
+ * may be created for the same socket (e.g. the pool's idle watcher and the
+ * connection's context), but epoll keeps a single registration per
+ * descriptor: any other event which believed to own it must neither skip
+ * re-arming it nor remove it when freed.
+ */
+static void ep_claim_registration(ep_LOOP *io, ep_EVENT *ev, lcb_socket_t sock)
+{
+    lcb_list_t *ll;
+    LCB_LIST_FOR(ll, &io->events)
+    {
+        ep_EVENT *other = LCB_LIST_ITEM(ll, ep_EVENT, list);
+        if (other != ev && other->regsock == sock) {
+            other->regsock = INVALID_SOCKET;
+            other->armed = 0;
+        }
+    }
+    ev->regsock = sock;
+}
+
+static void *ep_event_new(lcb_io_opt_t iops)
+{
+    ep_LOOP *io = iops->v.v3.cookie;
+    ep_EVENT *ret = calloc(1, sizeof(ep_EVENT));
+    if (ret != NULL) {
+        ret->sock = INVALID_SOCKET;
+        ret->regsock = INVALID_SOCKET;
+        lcb_list_append(&io->events, &ret->list);
+    }
+    return ret;
+}
+
+static int ep_event_update(lcb_io_opt_t iops, lcb_socket_t sock, void *event, short flags, void *cb_data,
+                           lcb_ioE_callback handler)
+{
+    ep_LOOP *io = iops->v.v3.cookie;
+    ep_EVENT *ev = event;
+    struct epoll_event epev;
+    int op;
+
+    if (ev->flags == 0 && flags != 0) {
+        io->nactive++;
+    } else if (ev->flags != 0 && flags == 0) {
+        io->nactive--;
+    }
+    ev->handler = handler;
+    ev->cb_data = cb_data;
+    ev->flags = flags;
+
+    if (ev->regsock != sock) {
+        ep_unregister(io, ev);
+    }
+    ev->sock = sock;
+    if (flags == 0 || (ev->armed && ev->armflags == flags)) {
+        /* Nothing changed: the registration will still report the next edge */
+        return 0;
+    }
+
+    memset(&epev, 0, sizeof(epev));
+    epev.events = EPOLLET;
+    if (flags & LCB_READ_EVENT) {
+        epev.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (flags & LCB_WRITE_EVENT) {
+        epev.events |= EPOLLOUT;
+    }
+    epev.data.ptr = ev;
+
+    op = ev->regsock == INVALID_SOCKET ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(io->epfd, op, sock, &epev) != 0) {
+        if (op == EPOLL_CTL_MOD && errno == ENOENT) {
+            /* closed and reopened under the same descriptor */
+            op = EPOLL_CTL_ADD;
+        } else if (op == EPOLL_CTL_ADD && errno == EEXIST) {
+            /* registered by another event for the same socket */
+            op = EPOLL_CTL_MOD;
+        } else {
+            iops->v.v3.error = errno;
+            return -1;
+        }
+        if (epoll_ctl(io->epfd, op, sock, &epev) != 0) {
+            iops->v.v3.error = errno;
+            return -1;
+        }
+        ep_claim_registration(io, ev, sock);
+    } else if (op == EPOLL_CTL_ADD) {
+        ep_claim_registration(io, ev, sock);
+    }
+    ev->armflags = flags;
+    ev->armed = 1;
+    return 0;
+}
+
+static void ep_event_cancel(lcb_io_opt_t iops, lcb_socket_t sock, void *event)
+{
+    ep_LOOP *io = iops->v.v3.cookie;
+    ep_EVENT *ev = event;
+    if (ev->flags != 0) {
+        io->nactive--;
+    }
+    ev->flags = 0;
+    ev->cb_data = NULL;
+    ev->handler = NULL;
+    /* Keep the registration: a disarmed edge-triggered entry costs nothing
+     * and the socket will most likely be watched again. Events for it are
+     * dropped in run_loop() while flags are 0. An edge may be dropped that
+     * way, and another event may take over the registration meanwhile, so
+     * the next watch() must re-arm it */
+    ev->armed = 0;
+    (void)sock;
+}
+
+static void ep_event_free(lcb_io_opt_t iops, void *event)
+{
+    ep_LOOP *io = iops->v.v3.cookie;
+    ep_EVENT *ev = event;
+    int ii;
+
+    if (ev->flags != 0) {
+        io->nactive--;
+    }
+    ep_unregister(io, ev);
+    /* The event may still be in the batch currently being dispatched */
+    for (ii = 0; ii < io->nbatch; ii++) {
+        if (io->batch[ii].data.ptr == ev) {
+            io->batch[ii].data.ptr = NULL;
+        }
+    }
+    lcb_list_delete(&ev->list);
+    free(ev);
+}
+
+static void *ep_timer_new(lcb_io_opt_t iops)
+{
+    ep_TIMER *ret = calloc(1, sizeof(ep_TIMER));
+    if (ret != NULL) {
+        lcb_timerwheel_entry_init(&ret->entry);
+    }
+    (void)iops;
+    return ret;
+}
+
+static void ep_timer_cancel(lcb_io_opt_t iops, void *timer)
+{
+    ep_LOOP *io = iops->v.v3.cookie;
+    ep_TIMER *tm = timer;
+    lcb_timerwheel_cancel(&io->timers, &tm->entry);
+}
+
+static void ep_timer_free(lcb_io_opt_t iops, void *timer)
+{
+    ep_timer_cancel(iops, timer);
+    free(timer);
+}
+
+static int ep_timer_schedule(lcb_io_opt_t iops, void *timer, lcb_U32 usec, void *cb_data, lcb_ioE_callback handler)
+{
+    ep_LOOP *io = iops->v.v3.cookie;
+    ep_TIMER *tm = timer;
+
+    tm->cb_data = cb_data;
+    tm->handler = handler;
+    lcb_timerwheel_schedule(&io->timers, &tm->entry, gethrtime(), usec);
+    return 0;
+}
+
+static void ep_stop_loop(struct lcb_io_opt_st *iops)
+{
+    ep_LOOP *io = iops->v.v3.cookie;
+    io->event_loop = 0;
+}
+
+static void run_expired_timers(ep_LOOP *io, hrtime_t now)
+{
+    lcb_list_t expired, *ll;
+
+    lcb_list_init(&expired);
+    lcb_timerwheel_expire(&io->timers, now, &expired);
+    /* a handler may cancel (and so unlink) any of the remaining entries */
+    while ((ll = lcb_list_shift(&expired)) != NULL) {
+        ep_TIMER *tm = LCB_LIST_ITEM(ll, ep_TIMER, entry.list);
+        tm->entry.active = 0;
+        tm->handler(-1, 0, tm->cb_data);
+    }
+}
+
+/** Milliseconds until the next timer expires (rounded up), or -1 without timers */
+static int get_next_timeout(ep_LOOP *io, hrtime_t now)
+{
+    hrtime_t delta;
+    if (!lcb_timerwheel_next(&io->timers, now, &delta)) {
+        return -1;
+    }
+    delta = (delta + 999999) / 1000000;
+    if (delta > 0x7fffffff) {
+        return 0x7fffffff;
+    }
+    return (int)delta;
+}
+
+static void run_loop(lcb_io_opt_t iops, int is_tick)
+{
+    ep_LOOP *io = iops->v.v3.cookie;
+    io->event_loop = !is_tick;
+    do {
+        int ii, ret, tmo;
+        int has_timers;
+
+        tmo = get_next_timeout(io, gethrtime());
+        has_timers = tmo != -1;
+        if (!has_timers && is_tick) {
+            /* do not wait forever on tick */
+            tmo = 100;
+        }
+
+        if (io->nactive == 0 && !has_timers) {
+            io->event_loop = 0;
+            return;
+        }
+
+        ret = epoll_wait(io->epfd, io->batch, (int)io->batch_size, tmo);
+        if (ret == -1) {
+            if (errno != EINTR) {
+                /* the loop cannot make progress, let the caller see why */
+                iops->v.v3.error = errno;
+                io->event_loop = 0;
+                return;
+            }
+            ret = 0;
+        }
+
+        /** Always invoke the pending timers */
+        if (has_timers) {
+            run_expired_timers(io, gethrtime());
+        }
+
+        io->nbatch = ret;
+        for (ii = 0; ii < io->nbatch; ii++) {
+            ep_EVENT *ev = io->batch[ii].data.ptr;
+            uint32_t revents = io->batch[ii].events;
+            short eflags = 0;
+
+            if (ev == NULL) {
+                continue; /* freed by an earlier callback */
+            }
+            ev->armed = 0;
+            if (ev->flags == 0) {
+                continue;
+            }
+            if (revents & (EPOLLERR | EPOLLHUP)) {
+                /* Let the pending I/O operation itself fetch the error */
+                eflags = LCB_RW_EVENT;
+            } else {
+                if (revents & (EPOLLIN | EPOLLRDHUP)) {
+                    eflags |= LCB_READ_EVENT;
+                }
+                if (revents & EPOLLOUT) {
+                    eflags |= LCB_WRITE_EVENT;
+                }
+            }
+            eflags &= ev->flags;
+            if (eflags != 0) {
+                ev->handler(ev->sock, eflags, ev->cb_data);
+            }
+        }
+        io->nbatch = 0;
+    } while (io->event_loop);
+}
+
+static void ep_run_loop(struct lcb_io_opt_st *iops)
+{
+    run_loop(iops, 0);
+}
+
+static void ep_tick_loop(struct lcb_io_opt_st *iops)
+{
+    run_loop(iops, 1);
+}
+
+static void ep_destroy_iops(struct lcb_io_opt_st *iops)
+{
+    ep_LOOP *io = iops->v.v3.cookie;
+    lcb_list_t *nn, *ii, timers;
+
+    LCB_LIST_SAFE_FOR(ii, nn, &io->events)
+    {
+        ep_event_free(iops, LCB_LIST_ITEM(ii, ep_EVENT, list));
+    }
+    lcb_assert(LCB_LIST_IS_EMPTY(&io->events));
+    lcb_list_init(&timers);
+    lcb_timerwheel_drain(&io->timers, &timers);
+    LCB_LIST_SAFE_FOR(ii, nn, &timers)
+    {
+        free(LCB_LIST_ITEM(ii, ep_TIMER, entry.list));
+    }
+    close(io->epfd);
+    free(io->batch);
+    free(io);
+    free(iops);
+}
+
+static void procs2_ep_callback(int version, lcb_loop_procs *loop_procs, lcb_timer_procs *timer_procs,
+                               lcb_bsd_procs *bsd_procs, lcb_ev_procs *ev_procs,
+                               lcb_completion_procs *completion_procs, lcb_iomodel_t *iomodel)
+{
+    ev_procs->create = ep_event_new;
+    ev_procs->destroy = ep_event_free;
+    ev_procs->watch = ep_event_update;
+    ev_procs->cancel = ep_event_cancel;
+
+    timer_procs->create = ep_timer_new;
+    timer_procs->destroy = ep_timer_free;
+    timer_procs->schedule = ep_timer_schedule;
+    timer_procs->cancel = ep_timer_cancel;
+
+    loop_procs->start = ep_run_loop;
+    loop_procs->stop = ep_stop_loop;
+    loop_procs->tick = ep_tick_loop;
+
+    *iomodel = LCB_IOMODEL_EVENT;
+    wire_lcb_bsd_impl2(bsd_procs, version);
+    (void)completion_procs;
+}
+
+LIBCOUCHBASE_API
+lcb_STATUS lcb_create_epoll_io_opts(int version, lcb_io_opt_t *io, void *arg)
+{
+    lcb_io_opt_t ret;
+    ep_LOOP *cookie;
+    const lcb_EPOLL_OPTIONS *options = arg;
+    unsigned batch_size = LCB_EPOLL_DEFAULT_BATCH;
+    char envbuf[32];
+
+    if (version != 0) {
+        return LCB_ERR_PLUGIN_VERSION_MISMATCH;
+    }
+    if (options && options->batch_size) {
+        batch_size = options->batch_size;
+    }
+    if (lcb_getenv_nonempty("LCB_EPOLL_BATCH", envbuf, sizeof(envbuf))) {
+        unsigned val = (unsigned)strtoul(envbuf, NULL, 10);
+        if (val) {
+            batch_size = val;
+        }
+    }
+
+    ret = calloc(1, sizeof(*ret));
+    cookie = calloc(1, sizeof(*cookie));
+    if (ret == NULL || cookie == NULL) {
+        free(ret);
+        free(cookie);
+        return LCB_ERR_NO_MEMORY;
+    }
+    cookie->batch = calloc(batch_size, sizeof(*cookie->batch));
+    if (cookie->batch == NULL) {
+        free(ret);
+        free(cookie);
+        return LCB_ERR_NO_MEMORY;
+    }
+    cookie->batch_size = batch_size;
+    cookie->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (cookie->epfd == -1) {
+        free(cookie->batch);
+        free(ret);
+        free(cookie);
+        return LCB_ERR_SDK_INTERNAL;
+    }
+    lcb_list_init(&cookie->events);
+    lcb_timerwheel_init(&cookie->timers, gethrtime());
+
+    /* setup io iops! */
+    ret->version = 3;
+    ret->dlhandle = NULL;
+    ret->destructor = ep_destroy_iops;
+
+    /* consider that struct isn't allocated by the library,
+     * `need_cleanup' flag might be set in lcb_create() */
+    ret->v.v3.need_cleanup = 0;
+    ret->v.v3.get_procs = procs2_ep_callback;
+    ret->v.v3.cookie = cookie;
+
+    /* For backwards compatibility */
+    wire_lcb_bsd_impl(ret);
+
+    *io = ret;
+    return LCB_SUCCESS;
+}
@@ -19,6 +19,7 @@
 
 #include "internal.h"
 #include "select_io_opts.h"
+#include "timerwheel.h"
 #include <libcouchbase/plugins/io/bsdio-inl.c>
 
 #if defined(_WIN32) && !defined(usleep)
@@ -38,32 +39,17 @@ struct sel_EVENT {
 
 typedef struct sel_TIMER sel_TIMER;
 struct sel_TIMER {
-    lcb_list_t list;
-    int active;
-    hrtime_t exptime;
+    lcb_TWENTRY entry;
     void *cb_data;
     lcb_ioE_callback handler;
 };
 
 typedef struct {
     sel_EVENT events;
-    lcb_list_t timers;
+    lcb_TIMERWHEEL timers;
     int event_loop;
 } sel_LOOP;
 
-static int timer_cmp_asc(lcb_list_t *a, lcb_list_t *b)
-{
-    sel_TIMER *ta = LCB_LIST_ITEM(a, sel_TIMER, list);
-    sel_TIMER *tb = LCB_LIST_ITEM(b, sel_TIMER, list);
-    if (ta->exptime > tb->exptime) {
-        return 1;
-    } else if (ta->exptime < tb->exptime) {
-        return -1;
-    } else {
-        return 0;
-    }
-}
-
 static void *sel_event_new(lcb_io_opt_t iops)
 {
     sel_LOOP *io = iops->v.v2.cookie;
@@ -107,18 +93,18 @@ static void sel_event_cancel(lcb_io_opt_t iops, lcb_socket_t sock, void *event)
 static void *sel_timer_new(lcb_io_opt_t iops)
 {
     sel_TIMER *ret = calloc(1, sizeof(sel_TIMER));
+    if (ret != NULL) {
+        lcb_timerwheel_entry_init(&ret->entry);
+    }
     (void)iops;
     return ret;
 }
 
 static void sel_timer_cancel(lcb_io_opt_t iops, void *timer)
 {
+    sel_LOOP *cookie = iops->v.v2.cookie;
     sel_TIMER *tm = timer;
-    if (tm->active) {
-        tm->active = 0;
-        lcb_list_delete(&tm->list);
-    }
-    (void)iops;
+    lcb_timerwheel_cancel(&cookie->timers, &tm->entry);
 }
 
 static void sel_timer_free(lcb_io_opt_t iops, void *timer)
@@ -132,14 +118,9 @@ static int sel_timer_schedule(lcb_io_opt_t iops, void *timer, lcb_U32 usec, void
 {
     sel_TIMER *tm = timer;
     sel_LOOP *cookie = iops->v.v2.cookie;
-    lcb_assert(!tm->active);
-    tm->exptime = gethrtime() + (usec * (hrtime_t)1000);
     tm->cb_data = cb_data;
     tm->handler = handler;
-    tm->active = 1;
-    lcb_list_add_sorted(&cookie->timers, &tm->list, timer_cmp_asc);
-
-    (void)iops;
+    lcb_timerwheel_schedule(&cookie->timers, &tm->entry, gethrtime(), usec);
     return 0;
 }
 
@@ -149,41 +130,30 @@ static void sel_stop_loop(struct lcb_io_opt_st *iops)
     io->event_loop = 0;
 }
 
-static sel_TIMER *pop_next_timer(sel_LOOP *cookie, hrtime_t now)
+static void run_expired_timers(sel_LOOP *cookie, hrtime_t now)
 {
-    sel_TIMER *ret;
-
-    if (LCB_LIST_IS_EMPTY(&cookie->timers)) {
-        return NULL;
-    }
-
-    ret = LCB_LIST_ITEM(cookie->timers.next, sel_TIMER, list);
-    if (ret->exptime > now) {
-        return NULL;
+    lcb_list_t expired, *ll;
+
+    lcb_list_init(&expired);
+    lcb_timerwheel_expire(&cookie->timers, now, &expired);
+    /* a handler may cancel (and so unlink) any of the remaining entries */
+    while ((ll = lcb_list_shift(&expired)) != NULL) {
+        sel_TIMER *tm = LCB_LIST_ITEM(ll, sel_TIMER, entry.list);
+        tm->entry.active = 0;
+        tm->handler(-1, 0, tm->cb_data);
     }
-    lcb_list_shift(&cookie->timers);
-    ret->active = 0;
-    return ret;
 }
 
 static int get_next_timeout(sel_LOOP *cookie, struct timeval *tmo, hrtime_t now)
 {
-    sel_TIMER *first;
     hrtime_t delta;
 
-    if (LCB_LIST_IS_EMPTY(&cookie->timers)) {
+    if (!lcb_timerwheel_next(&cookie->timers, now, &delta)) {
         tmo->tv_sec = 0;
         tmo->tv_usec = 0;
         return 0;
     }
 
-    first = LCB_LIST_ITEM(cookie->timers.next, sel_TIMER, list);
-    if (now < first->exptime) {
-        delta = first->exptime - now;
-    } else {
-        delta = 0;
-    }
-
     if (delta) {
         delta /= 1000;
         tmo->tv_sec = (long)(delta / 1000000);
@@ -267,12 +237,7 @@ static void run_loop(sel_LOOP *io, int is_tick)
 
         /** Always invoke the pending timers */
         if (has_timers) {
-            sel_TIMER *tm;
-            now = gethrtime();
-
-            while ((tm = pop_next_timer(io, now))) {
-                tm->handler(-1, 0, tm->cb_data);
-            }
+            run_expired_timers(io, gethrtime());
         }
 
         /* To be completely safe, we need to copy active events
@@ -306,7 +271,10 @@ static void run_loop(sel_LOOP *io, int is_tick)
             ev = active;
             while (ev) {
                 sel_EVENT *p = ev->next;
-                ev->handler(ev->sock, ev->eflags, ev->cb_data);
+                /* skip events cancelled by an earlier callback */
+                if (ev->flags != 0) {
+                    ev->handler(ev->sock, ev->eflags, ev->cb_data);
+                }
                 ev = p;
             }
         }
@@ -325,7 +293,7 @@ static void sel_tick_loop(struct lcb_io_opt_st *iops)
 static void sel_destroy_iops(struct lcb_io_opt_st *iops)
 {
     sel_LOOP *io = iops->v.v2.cookie;
-    lcb_list_t *nn, *ii;
+    lcb_list_t *nn, *ii, timers;
     sel_EVENT *ev;
     sel_TIMER *tm;
 
@@ -339,12 +307,13 @@ static void sel_destroy_iops(struct lcb_io_opt_st *iops)
         sel_event_free(iops, ev);
     }
     lcb_assert(LCB_LIST_IS_EMPTY(&io->events.list));
-    LCB_LIST_SAFE_FOR(ii, nn, &io->timers)
+    lcb_list_init(&timers);
+    lcb_timerwheel_drain(&io->timers, &timers);
+    LCB_LIST_SAFE_FOR(ii, nn, &timers)
     {
-        tm = LCB_LIST_ITEM(ii, sel_TIMER, list);
-        sel_timer_free(iops, tm);
+        tm = LCB_LIST_ITEM(ii, sel_TIMER, entry.list);
+        free(tm);
     }
-    lcb_assert(LCB_LIST_IS_EMPTY(&io->timers));
     free(io);
     free(iops);
 }
@@ -414,7 +383,7 @@ lcb_STATUS lcb_create_select_io_opts(int version, lcb_io_opt_t *io, void *arg)
         return LCB_ERR_NO_MEMORY;
     }
     lcb_list_init(&cookie->events.list);
-    lcb_list_init(&cookie->timers);
+    lcb_timerwheel_init(&cookie->timers, gethrtime());
 
     /* setup io iops! */
     ret->version = 3;
@@ -0,0 +1,855 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * Completion-model plugin built directly on io_uring(7).
+ *
+ * lcbio hands read2() the free segments of the read buffer and write2() the
+ * pending output, which map onto IORING_OP_RECVMSG and IORING_OP_SENDMSG
+ * without copying. Operations are only queued in the submission ring; the
+ * whole batch is submitted by the io_uring_enter() call which also waits for
+ * completions, so a loop iteration costs a single system call no matter how
+ * many sockets are active.
+ *
+ * The ring is driven through the raw system calls, so liburing is not
+ * needed. Sockets are left blocking: the kernel arms its own poll handler
+ * when an operation cannot complete immediately.
+ *
+ * Timers are kept in the shared timing wheel (see timerwheel.h), and the
+ * wait timeout is passed with IORING_ENTER_EXT_ARG.
+ */
+
+#define LCB_IOPS_V12_NO_DEPRECATE
+
+#include "internal.h"
+#include "timerwheel.h"
+#include "uring_io_opts.h"
+#include "plugins/io/epoll/epoll_io_opts.h"
+#include <linux/io_uring.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define ur_load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define ur_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+enum { UR_OP_CONNECT, UR_OP_READ, UR_OP_WRITE };
+
+typedef struct {
+    lcb_sockdata_t base;
+    lcb_list_t list;
+    /** operations submitted for this socket */
+    lcb_list_t pending;
+    unsigned npending;
+    int domain;
+} ur_SOCKET;
+
+typedef struct {
+    lcb_list_t list;
+    ur_SOCKET *sock;
+    int type;
+    union {
+        lcb_io_connect_cb conn;
+        lcb_ioC_read2_callback read;
+        lcb_ioC_write2_callback write;
+    } cb;
+    void *arg;
+    struct msghdr msg;
+    struct sockaddr_storage addr;
+    unsigned niov;
+    struct iovec iov[1];
+} ur_REQ;
+
+typedef struct {
+    lcb_TWENTRY entry;
+    void *cb_data;
+    lcb_ioE_callback handler;
+} ur_TIMER;
+
+typedef struct {
+    int fd;
+    void *ring;
+    size_t ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *sq_khead;
+    unsigned *sq_ktail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    /** local tail, published to the kernel on submit */
+    unsigned sq_tail;
+
+    unsigned *cq_khead;
+    unsigned *cq_ktail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /** operations submitted and not yet completed */
+    unsigned ninflight;
+    lcb_list_t sockets;
+
+    lcb_TIMERWHEEL timers;
+
+    int event_loop;
+} ur_LOOP;
+
+static int ur_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ur_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int ur_register(int fd, unsigned opcode, void *arg, unsigned nargs)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+}
+
+/**
+ * Check that the ring provides everything this plugin relies on. Each of
+ * the features implies a kernel recent enough for the opcodes, but those
+ * may still be disabled, so they are probed as well.
+ */
+static int ur_probe(ur_LOOP *io, const struct io_uring_params *params)
+{
+    static const unsigned required_features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    static const unsigned char required_ops[] = {IORING_OP_CONNECT, IORING_OP_RECVMSG, IORING_OP_SENDMSG,
+                                                 IORING_OP_ASYNC_CANCEL};
+    struct io_uring_probe *probe;
+    size_t ii;
+    int rv = 0;
+
+    if ((params->features & required_features) != required_features) {
+        return -1;
+    }
+    probe = calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op));
+    if (probe == NULL) {
+        return -1;
+    }
+    if (ur_register(io->fd, IORING_REGISTER_PROBE, probe, 256) != 0) {
+        rv = -1;
+    }
+    for (ii = 0; rv == 0 && ii < sizeof(required_ops); ii++) {
+        if (required_ops[ii] > probe->last_op || (probe->ops[required_ops[ii]].flags & IO_URING_OP_SUPPORTED) == 0) {
+            rv = -1;
+        }
+    }
+    free(probe);
+    return rv;
+}
+
+static void ur_unmap(ur_LOOP *io)
+{
+    if (io->sqes != NULL) {
+        munmap(io->sqes, io->sqes_size);
+        io->sqes = NULL;
+    }
+    if (io->ring != NULL) {
+        munmap(io->ring, io->ring_size);
+        io->ring = NULL;
+    }
+    if (io->fd != -1) {
+        close(io->fd);
+        io->fd = -1;
+    }
+}
+
+static int ur_init(ur_LOOP *io, unsigned entries)
+{
+    struct io_uring_params params;
+    size_t sq_size, cq_size;
+    char *ring;
+
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+#ifdef IORING_SETUP_COOP_TASKRUN
+    /* the loop always enters the kernel to reap completions, no need to be interrupted */
+    params.flags |= IORING_SETUP_COOP_TASKRUN;
+#endif
+    io->fd = ur_setup(entries, &params);
+    if (io->fd == -1 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CLAMP;
+        io->fd = ur_setup(entries, &params);
+    }
+    if (io->fd == -1) {
+        return -1;
+    }
+    if (ur_probe(io, &params) != 0) {
+        ur_unmap(io);
+        return -1;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    io->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ring = mmap(NULL, io->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->fd, IORING_OFF_SQ_RING);
+    if (ring == MAP_FAILED) {
+        ur_unmap(io);
+        return -1;
+    }
+    io->ring = ring;
+    io->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    io->sqes = mmap(NULL, io->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->fd, IORING_OFF_SQES);
+    if (io->sqes == MAP_FAILED) {
+        io->sqes = NULL;
+        ur_unmap(io);
+        return -1;
+    }
+
+    io->sq_khead = (unsigned *)(ring + params.sq_off.head);
+    io->sq_ktail = (unsigned *)(ring + params.sq_off.tail);
+    io->sq_array = (unsigned *)(ring + params.sq_off.array);
+    io->sq_mask = *(unsigned *)(ring + params.sq_off.ring_mask);
+    io->sq_entries = *(unsigned *)(ring + params.sq_off.ring_entries);
+    io->sq_tail = *io->sq_ktail;
+
+    io->cq_khead = (unsigned *)(ring + params.cq_off.head);
+    io->cq_ktail = (unsigned *)(ring + params.cq_off.tail);
+    io->cq_mask = *(unsigned *)(ring + params.cq_off.ring_mask);
+    io->cqes = (struct io_uring_cqe *)(ring + params.cq_off.cqes);
+    return 0;
+}
+
+/**
+ * Hand queued entries to the kernel and optionally wait for completions.
+ * @return 0 on success, or the errno of io_uring_enter()
+ */
+static int ur_submit(ur_LOOP *io, unsigned wait_nr, struct io_uring_getevents_arg *arg)
+{
+    unsigned flags = 0, to_submit;
+
+    ur_store_release(io->sq_ktail, io->sq_tail);
+    to_submit = io->sq_tail - ur_load_acquire(io->sq_khead);
+    if (wait_nr || arg) {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    } else if (to_submit == 0) {
+        return 0;
+    }
+    if (ur_enter(io->fd, to_submit, wait_nr, flags, arg, arg ? sizeof(*arg) : 0) == -1) {
+        return errno;
+    }
+    return 0;
+}
+
+static struct io_uring_sqe *ur_get_sqe(ur_LOOP *io)
+{
+    struct io_uring_sqe *sqe;
+    unsigned idx;
+
+    if (io->sq_tail - ur_load_acquire(io->sq_khead) >= io->sq_entries) {
+        /* ring full: flush what has been queued so far */
+        ur_submit(io, 0, NULL);
+        if (io->sq_tail - ur_load_acquire(io->sq_khead) >= io->sq_entries) {
+            return NULL;
+        }
+    }
+    idx = io->sq_tail & io->sq_mask;
+    sqe = &io->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    io->sq_array[idx] = idx;
+    io->sq_tail++;
+    return sqe;
+}
+
+/** Queue the operation described by the request. Returns nonzero if the ring is exhausted */
+static int ur_queue_req(ur_LOOP *io, ur_REQ *req)
+{
+    struct io_uring_sqe *sqe = ur_get_sqe(io);
+    if (sqe == NULL) {
+        return -1;
+    }
+    sqe->fd = req->sock->base.socket;
+    sqe->user_data = (lcb_U64)(uintptr_t)req;
+    switch (req->type) {
+        case UR_OP_CONNECT:
+            sqe->opcode = IORING_OP_CONNECT;
+            sqe->addr = (lcb_U64)(uintptr_t)&req->addr;
+            sqe->off = req->msg.msg_namelen;
+            break;
+        case UR_OP_READ:
+            sqe->opcode = IORING_OP_RECVMSG;
+            sqe->addr = (lcb_U64)(uintptr_t)&req->msg;
+            sqe->len = 1;
+            break;
+        case UR_OP_WRITE:
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->addr = (lcb_U64)(uintptr_t)&req->msg;
+            sqe->len = 1;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            break;
+    }
+    io->ninflight++;
+    return 0;
+}
+
+static ur_REQ *ur_req_new(ur_SOCKET *sock, int type, lcb_IOV *iov, lcb_SIZE niov, void *arg)
+{
+    ur_REQ *req;
+    lcb_SIZE ii;
+
+    req = calloc(1, sizeof(*req) + (niov ? niov - 1 : 0) * sizeof(struct iovec));
+    if (req == NULL) {
+        return NULL;
+    }
+    req->sock = sock;
+    req->type = type;
+    req->arg = arg;
+    for (ii = 0; ii < niov; ii++) {
+        req->iov[ii].iov_base = iov[ii].iov_base;
+        req->iov[ii].iov_len = iov[ii].iov_len;
+    }
+    req->niov = (unsigned)niov;
+    req->msg.msg_iov = req->iov;
+    req->msg.msg_iovlen = niov;
+    return req;
+}
+
+static int ur_start_req(lcb_io_opt_t iops, ur_REQ *req)
+{
+    if (ur_queue_req(iops->v.v3.cookie, req) != 0) {
+        iops->v.v3.error = EAGAIN;
+        free(req);
+        return -1;
+    }
+    lcb_list_append(&req->sock->pending, &req->list);
+    req->sock->npending++;
+    return 0;
+}
+
+static void ur_maybe_free_socket(ur_SOCKET *sock)
+{
+    if (!sock->base.closed || sock->npending) {
+        return;
+    }
+    close(sock->base.socket);
+    lcb_list_delete(&sock->list);
+    free(sock);
+}
+
+static lcb_sockdata_t *ur_socket(lcb_io_opt_t iops, int domain, int type, int protocol)
+{
+    ur_LOOP *io = iops->v.v3.cookie;
+    ur_SOCKET *sock = calloc(1, sizeof(*sock));
+
+    if (sock == NULL) {
+        iops->v.v3.error = ENOMEM;
+        return NULL;
+    }
+    sock->base.socket = socket(domain, type | SOCK_CLOEXEC, protocol);
+    if (sock->base.socket == INVALID_SOCKET) {
+        iops->v.v3.error = errno;
+        free(sock);
+        return NULL;
+    }
+    sock->base.parent = iops;
+    sock->domain = domain;
+    lcb_list_init(&sock->pending);
+    lcb_list_append(&io->sockets, &sock->list);
+    return &sock->base;
+}
+
+static int ur_connect(lcb_io_opt_t iops, lcb_sockdata_t *sd, const struct sockaddr *dst, unsigned int naddr,
+                      lcb_io_connect_cb callback)
+{
+    ur_REQ *req;
+
+    if (naddr > sizeof(req->addr)) {
+        iops->v.v3.error = EINVAL;
+        return -1;
+    }
+    req = ur_req_new((ur_SOCKET *)sd, UR_OP_CONNECT, NULL, 0, NULL);
+    if (req == NULL) {
+        iops->v.v3.error = ENOMEM;
+        return -1;
+    }
+    memcpy(&req->addr, dst, naddr);
+    req->msg.msg_namelen = naddr;
+    req->cb.conn = callback;
+    return ur_start_req(iops, req);
+}
+
+static int ur_read2(lcb_io_opt_t iops, lcb_sockdata_t *sd, lcb_IOV *iov, lcb_SIZE niov, void *uarg,
+                    lcb_ioC_read2_callback callback)
+{
+    ur_REQ *req = ur_req_new((ur_SOCKET *)sd, UR_OP_READ, iov, niov, uarg);
+    if (req == NULL) {
+        iops->v.v3.error = ENOMEM;
+        return -1;
+    }
+    req->cb.read = callback;
+    return ur_start_req(iops, req);
+}
+
+static int ur_write2(lcb_io_opt_t iops, lcb_sockdata_t *sd, lcb_IOV *iov, lcb_SIZE niov, void *uarg,
+                     lcb_ioC_write2_callback callback)
+{
+    ur_REQ *req = ur_req_new((ur_SOCKET *)sd, UR_OP_WRITE, iov, niov, uarg);
+    if (req == NULL) {
+        iops->v.v3.error = ENOMEM;
+        return -1;
+    }
+    req->cb.write = callback;
+    return ur_start_req(iops, req);
+}
+
+static unsigned int ur_close(lcb_io_opt_t iops, lcb_sockdata_t *sd)
+{
+    ur_LOOP *io = iops->v.v3.cookie;
+    ur_SOCKET *sock = (ur_SOCKET *)sd;
+    lcb_list_t *ii;
+
+    sd->closed = 1;
+    /* Pending operations complete with -ECANCELED and their callbacks are
+     * still invoked. The socket is released after the last one */
+    LCB_LIST_FOR(ii, &sock->pending)
+    {
+        struct io_uring_sqe *sqe = ur_get_sqe(io);
+        if (sqe == NULL) {
+            shutdown(sd->socket, SHUT_RDWR);
+            break;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = (lcb_U64)(uintptr_t)LCB_LIST_ITEM(ii, ur_REQ, list);
+        sqe->user_data = 0;
+    }
+    ur_maybe_free_socket(sock);
+    return 0;
+}
+
+static int ur_nameinfo(lcb_io_opt_t iops, lcb_sockdata_t *sd, struct lcb_nameinfo_st *ni)
+{
+    socklen_t lenp;
+
+    lenp = sizeof(struct sockaddr_storage);
+    if (getsockname(sd->socket, ni->local.name, &lenp) != 0) {
+        iops->v.v3.error = errno;
+        return -1;
+    }
+    *ni->local.len = (int)lenp;
+    lenp = sizeof(struct sockaddr_storage);
+    if (getpeername(sd->socket, ni->remote.name, &lenp) != 0) {
+        iops->v.v3.error = errno;
+        return -1;
+    }
+    *ni->remote.len = (int)lenp;
+    return 0;
+}
+
+static int ur_is_closed(lcb_io_opt_t iops, lcb_sockdata_t *sd, int flags)
+{
+    char buf = 0;
+    ssize_t rv;
+
+    (void)iops;
+    do {
+        /* the socket is blocking, so the probe must not wait */
+        rv = recv(sd->socket, &buf, 1, MSG_PEEK | MSG_DONTWAIT);
+    } while (rv == -1 && errno == EINTR);
+
+    if (rv == 1) {
+        if (flags & LCB_IO_SOCKCHECK_PEND_IS_ERROR) {
+            return LCB_IO_SOCKCHECK_STATUS_CLOSED;
+        }
+        return LCB_IO_SOCKCHECK_STATUS_OK;
+    }
+    if (rv == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return LCB_IO_SOCKCHECK_STATUS_OK;
+    }
+    return LCB_IO_SOCKCHECK_STATUS_CLOSED;
+}
+
+static int ur_cntl(lcb_io_opt_t iops, lcb_sockdata_t *sd, int mode, int option, void *arg)
+{
+    int level, optname, rv;
+    socklen_t dummy = sizeof(int);
+
+    switch (option) {
+        case LCB_IO_CNTL_TCP_NODELAY:
+            level = IPPROTO_TCP;
+            optname = TCP_NODELAY;
+            break;
+        case LCB_IO_CNTL_TCP_KEEPALIVE:
+            level = SOL_SOCKET;
+            optname = SO_KEEPALIVE;
+            break;
+        case LCB_IO_CNTL_SO_BUSY_POLL:
+            level = SOL_SOCKET;
+            optname = SO_BUSY_POLL;
+            break;
+        case LCB_IO_CNTL_SO_RCVBUF:
+            level = SOL_SOCKET;
+            optname = SO_RCVBUF;
+            break;
+        case LCB_IO_CNTL_SO_SNDBUF:
+            level = SOL_SOCKET;
+            optname = SO_SNDBUF;
+            break;
+        case LCB_IO_CNTL_TCP_QUICKACK:
+            level = IPPROTO_TCP;
+            optname = TCP_QUICKACK;
+            break;
+        case LCB_IO_CNTL_TCP_USER_TIMEOUT:
+            level = IPPROTO_TCP;
+            optname = TCP_USER_TIMEOUT;
+            break;
+        case LCB_IO_CNTL_IP_TOS:
+            if (((ur_SOCKET *)sd)->domain == AF_INET6) {
+                level = IPPROTO_IPV6;
+                optname = IPV6_TCLASS;
+            } else {
+                level = IPPROTO_IP;
+                optname = IP_TOS;
+            }
+            break;
+        case LCB_IO_CNTL_SO_INCOMING_CPU:
+            if (mode != LCB_IO_CNTL_GET) {
+                iops->v.v3.error = EINVAL;
+                return -1;
+            }
+            level = SOL_SOCKET;
+            optname = SO_INCOMING_CPU;
+            break;
+        default:
+            iops->v.v3.error = ENOTSUP;
+            return -1;
+    }
+    if (mode == LCB_IO_CNTL_GET) {
+        rv = getsockopt(sd->socket, level, optname, arg, &dummy);
+    } else {
+        rv = setsockopt(sd->socket, level, optname, arg, dummy);
+    }
+    if (rv != 0) {
+        iops->v.v3.error = errno;
+    }
+    return rv;
+}
+
+/** Skip the bytes which were already sent. Returns the number of bytes left */
+static size_t ur_advance_iov(ur_REQ *req, size_t nw)
+{
+    size_t left = 0;
+    unsigned ii;
+
+    while (req->msg.msg_iovlen && nw >= req->msg.msg_iov->iov_len) {
+        nw -= req->msg.msg_iov->iov_len;
+        req->msg.msg_iov++;
+        req->msg.msg_iovlen--;
+    }
+    if (req->msg.msg_iovlen) {
+        req->msg.msg_iov->iov_base = (char *)req->msg.msg_iov->iov_base + nw;
+        req->msg.msg_iov->iov_len -= nw;
+    }
+    for (ii = 0; ii < req->msg.msg_iovlen; ii++) {
+        left += req->msg.msg_iov[ii].iov_len;
+    }
+    return left;
+}
+
+static void ur_complete(ur_LOOP *io, ur_REQ *req, int res)
+{
+    ur_SOCKET *sock = req->sock;
+    lcb_io_opt_t iops = sock->base.parent;
+
+    io->ninflight--;
+    if (!sock->base.closed) {
+        int retry = res == -EINTR || res == -EAGAIN;
+        if (req->type == UR_OP_WRITE && res > 0) {
+            /* partial write: send the remainder */
+            retry = ur_advance_iov(req, (size_t)res) != 0;
+        }
+        if (retry && ur_queue_req(io, req) == 0) {
+            return;
+        }
+        if (req->type == UR_OP_WRITE && res >= 0 && req->msg.msg_iovlen) {
+            res = res == 0 ? -EPIPE : -EAGAIN;
+        }
+    }
+
+    /* still counted in npending, so that the socket survives if the
+     * callback closes it */
+    lcb_list_delete(&req->list);
+    if (res < 0) {
+        iops->v.v3.error = -res;
+    }
+    switch (req->type) {
+        case UR_OP_CONNECT:
+            req->cb.conn(&sock->base, res < 0 ? -1 : 0);
+            break;
+        case UR_OP_READ:
+            req->cb.read(&sock->base, res < 0 ? -1 : res, req->arg);
+            break;
+        case UR_OP_WRITE:
+            req->cb.write(&sock->base, res < 0 ? -1 : 0, req->arg);
+            break;
+    }
+    free(req);
+    sock->npending--;
+    ur_maybe_free_socket(sock);
+}
+
+static void ur_reap(ur_LOOP *io)
+{
+    unsigned head = *io->cq_khead;
+    unsigned tail = ur_load_acquire(io->cq_ktail);
+
+    /* only the completions present now are dispatched, callbacks queue new
+     * operations which are submitted by the next loop iteration */
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &io->cqes[head & io->cq_mask];
+        ur_REQ *req = (ur_REQ *)(uintptr_t)cqe->user_data;
+        int res = cqe->res;
+
+        ur_store_release(io->cq_khead, ++head);
+        if (req != NULL) {
+            ur_complete(io, req, res);
+        }
+    }
+}
+
+static void *ur_timer_new(lcb_io_opt_t iops)
+{
+    ur_TIMER *ret = calloc(1, sizeof(ur_TIMER));
+    if (ret != NULL) {
+        lcb_timerwheel_entry_init(&ret->entry);
+    }
+    (void)iops;
+    return ret;
+}
+
+static void ur_timer_cancel(lcb_io_opt_t iops, void *timer)
+{
+    ur_LOOP *io = iops->v.v3.cookie;
+    ur_TIMER *tm = timer;
+    lcb_timerwheel_cancel(&io->timers, &tm->entry);
+}
+
+static void ur_timer_free(lcb_io_opt_t iops, void *timer)
+{
+    ur_timer_cancel(iops, timer);
+    free(timer);
+}
+
+static int ur_timer_schedule(lcb_io_opt_t iops, void *timer, lcb_U32 usec, void *cb_data, lcb_ioE_callback handler)
+{
+    ur_LOOP *io = iops->v.v3.cookie;
+    ur_TIMER *tm = timer;
+
+    tm->cb_data = cb_data;
+    tm->handler = handler;
+    lcb_timerwheel_schedule(&io->timers, &tm->entry, gethrtime(), usec);
+    return 0;
+}
+
+static void ur_stop_loop(struct lcb_io_opt_st *iops)
+{
+    ur_LOOP *io = iops->v.v3.cookie;
+    io->event_loop = 0;
+}
+
+static void run_expired_timers(ur_LOOP *io, hrtime_t now)
+{
+    lcb_list_t expired, *ll;
+
+    lcb_list_init(&expired);
+    lcb_timerwheel_expire(&io->timers, now, &expired);
+    /* a handler may cancel (and so unlink) any of the remaining entries */
+    while ((ll = lcb_list_shift(&expired)) != NULL) {
+        ur_TIMER *tm = LCB_LIST_ITEM(ll, ur_TIMER, entry.list);
+        tm->entry.active = 0;
+        tm->handler(-1, 0, tm->cb_data);
+    }
+}
+
+static void run_loop(lcb_io_opt_t iops, int is_tick)
+{
+    ur_LOOP *io = iops->v.v3.cookie;
+    io->event_loop = !is_tick;
+    do {
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+        hrtime_t delta;
+        unsigned wait_nr = 1;
+        int rv, has_timers;
+
+        has_timers = lcb_timerwheel_next(&io->timers, gethrtime(), &delta);
+        if (io->ninflight == 0 && !has_timers) {
+            /* flush cancellations of closed sockets */
+            ur_submit(io, 0, NULL);
+            io->event_loop = 0;
+            return;
+        }
+
+        memset(&arg, 0, sizeof(arg));
+        if (has_timers) {
+            if (delta == 0) {
+                wait_nr = 0;
+            }
+            ts.tv_sec = (long long)(delta / 1000000000);
+            ts.tv_nsec = (long long)(delta % 1000000000);
+            arg.ts = (lcb_U64)(uintptr_t)&ts;
+        } else if (is_tick) {
+            /* do not wait forever on tick */
+            ts.tv_sec = 0;
+            ts.tv_nsec = 100000000;
+            arg.ts = (lcb_U64)(uintptr_t)&ts;
+        }
+
+        rv = ur_submit(io, wait_nr, &arg);
+        if (rv != 0 && rv != ETIME && rv != EINTR && rv != EBUSY) {
+            /* the loop cannot make progress, let the caller see why */
+            iops->v.v3.error = rv;
+            io->event_loop = 0;
+            return;
+        }
+
+        /** Always invoke the pending timers */
+        if (has_timers) {
+            run_expired_timers(io, gethrtime());
+        }
+
+        ur_reap(io);
+    } while (io->event_loop);
+}
+
+static void ur_run_loop(struct lcb_io_opt_st *iops)
+{
+    run_loop(iops, 0);
+}
+
+static void ur_tick_loop(struct lcb_io_opt_st *iops)
+{
+    run_loop(iops, 1);
+}
+
+static void ur_destroy_iops(struct lcb_io_opt_st *iops)
+{
+    ur_LOOP *io = iops->v.v3.cookie;
+    lcb_list_t *nn, *ii, timers;
+
+    /* closing the ring cancels whatever is still in flight */
+    ur_unmap(io);
+    LCB_LIST_SAFE_FOR(ii, nn, &io->sockets)
+    {
+        ur_SOCKET *sock = LCB_LIST_ITEM(ii, ur_SOCKET, list);
+        lcb_list_t *jj, *kk;
+        LCB_LIST_SAFE_FOR(jj, kk, &sock->pending)
+        {
+            free(LCB_LIST_ITEM(jj, ur_REQ, list));
+        }
+        close(sock->base.socket);
+        free(sock);
+    }
+    lcb_list_init(&timers);
+    lcb_timerwheel_drain(&io->timers, &timers);
+    LCB_LIST_SAFE_FOR(ii, nn, &timers)
+    {
+        free(LCB_LIST_ITEM(ii, ur_TIMER, entry.list));
+    }
+    free(io);
+    free(iops);
+}
+
+static void procs2_ur_callback(int version, lcb_loop_procs *loop_procs, lcb_timer_procs *timer_procs,
+                               lcb_bsd_procs *bsd_procs, lcb_ev_procs *ev_procs,
+                               lcb_completion_procs *completion_procs, lcb_iomodel_t *iomodel)
+{
+    completion_procs->socket = ur_socket;
+    completion_procs->close = ur_close;
+    completion_procs->connect = ur_connect;
+    completion_procs->read2 = ur_read2;
+    completion_procs->write2 = ur_write2;
+    completion_procs->nameinfo = ur_nameinfo;
+    completion_procs->is_closed = ur_is_closed;
+    completion_procs->cntl = ur_cntl;
+
+    timer_procs->create = ur_timer_new;
+    timer_procs->destroy = ur_timer_free;
+    timer_procs->schedule = ur_timer_schedule;
+    timer_procs->cancel = ur_timer_cancel;
+
+    loop_procs->start = ur_run_loop;
+    loop_procs->stop = ur_stop_loop;
+    loop_procs->tick = ur_tick_loop;
+
+    *iomodel = LCB_IOMODEL_COMPLETION;
+    (void)version;
+    (void)bsd_procs;
+    (void)ev_procs;
+}
+
+LIBCOUCHBASE_API
+lcb_STATUS lcb_create_uring_io_opts(int version, lcb_io_opt_t *io, void *arg)
+{
+    lcb_io_opt_t ret;
+    ur_LOOP *cookie;
+    const lcb_URING_OPTIONS *options = arg;
+    unsigned entries = LCB_URING_DEFAULT_ENTRIES;
+    char envbuf[32];
+
+    if (version != 0) {
+        return LCB_ERR_PLUGIN_VERSION_MISMATCH;
+    }
+    if (options && options->entries) {
+        entries = options->entries;
+    }
+    if (lcb_getenv_nonempty("LCB_URING_ENTRIES", envbuf, sizeof(envbuf))) {
+        unsigned val = (unsigned)strtoul(envbuf, NULL, 10);
+        if (val) {
+            entries = val;
+        }
+    }
+
+    cookie = calloc(1, sizeof(*cookie));
+    if (cookie == NULL) {
+        return LCB_ERR_NO_MEMORY;
+    }
+    cookie->fd = -1;
+    if (ur_init(cookie, entries) != 0) {
+        /* io_uring is missing or incomplete in this kernel */
+        free(cookie);
+        return lcb_create_epoll_io_opts(0, io, NULL);
+    }
+    ret = calloc(1, sizeof(*ret));
+    if (ret == NULL) {
+        ur_unmap(cookie);
+        free(cookie);
+        return LCB_ERR_NO_MEMORY;
+    }
+    lcb_list_init(&cookie->sockets);
+    lcb_timerwheel_init(&cookie->timers, gethrtime());
+
+    /* setup io iops! */
+    ret->version = 3;
+    ret->dlhandle = NULL;
+    ret->destructor = ur_destroy_iops;
+
+    /* consider that struct isn't allocated by the library,
+     * `need_cleanup' flag might be set in lcb_create() */
+    ret->v.v3.need_cleanup = 0;
+    ret->v.v3.get_procs = procs2_ur_callback;
+    ret->v.v3.cookie = cookie;
+
+    *io = ret;
+    return LCB_SUCCESS;
+}
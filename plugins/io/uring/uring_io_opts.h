@@ -0,0 +1,64 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef LIBCOUCHBASE_URING_IO_OPTS_H
+#define LIBCOUCHBASE_URING_IO_OPTS_H 1
+
+#include <libcouchbase/couchbase.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Default number of submission queue entries of the ring */
+#define LCB_URING_DEFAULT_ENTRIES 256
+
+/**
+ * Options for lcb_create_uring_io_opts(). Pass a pointer to this structure
+ * as the `cookie` of lcb_IOCREATEOPTS_BUILTIN, or as the last argument to
+ * lcb_create_uring_io_opts(). NULL selects the defaults.
+ */
+typedef struct {
+    /**
+     * Number of submission queue entries. Every connection keeps at most
+     * one read and one write in flight, so this bounds how many operations
+     * are handed to the kernel with a single system call.
+     * The `LCB_URING_ENTRIES` environment variable overrides this value.
+     */
+    unsigned entries;
+} lcb_URING_OPTIONS;
+
+/**
+ * Create an instance of a completion-model I/O handler built on Linux
+ * io_uring(7).
+ *
+ * The kernel is probed first. When io_uring is unavailable (too old, or
+ * blocked by a seccomp policy), an epoll-based handler is returned instead,
+ * see lcb_create_epoll_io_opts().
+ *
+ * @param version must be 0
+ * @param io where the new I/O table is stored
+ * @param arg optional pointer to lcb_URING_OPTIONS
+ * @return status of the operation
+ */
+LIBCOUCHBASE_API
+lcb_STATUS lcb_create_uring_io_opts(int version, lcb_io_opt_t *io, void *arg);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -57,7 +57,8 @@ struct CccpProvider : public Provider {
     {
         mcio_error(LCB_ERR_TIMEOUT);
     }
-    lcb_STATUS update(const char *host, const char *data);
+    lcb_STATUS update(const char *host, const char *data, size_t ndata);
+    bool is_stale(const char *data, size_t ndata);
     void request_config();
     void on_io_read();
 
@@ -183,26 +184,60 @@ lcb_STATUS CccpProvider::mcio_error(lcb_STATUS err)
 }
 
 /** Update the configuration from a server. */
-lcb_STATUS lcb::clconfig::cccp_update(Provider *provider, const char *host, const char *data)
+lcb_STATUS lcb::clconfig::cccp_update(Provider *provider, const char *host, const char *data, size_t ndata)
 {
-    return static_cast< CccpProvider * >(provider)->update(host, data);
+    return static_cast< CccpProvider * >(provider)->update(host, data, ndata);
 }
 
-lcb_STATUS CccpProvider::update(const char *host, const char *data)
+/**
+ * Check the revision of a raw configuration against the current one. Nodes
+ * send the whole map with every NOT_MY_VBUCKET reply, and during a rebalance
+ * most of these carry a revision we already have.
+ */
+bool CccpProvider::is_stale(const char *data, size_t ndata)
+{
+    ConfigInfo *current = parent->get_config();
+    int64_t epoch, rev;
+
+    if (!current || !current->vbc->bname || current->vbc->revid < 0) {
+        return false;
+    }
+    if (!lcbvb_peek_revision(data, ndata, &epoch, &rev)) {
+        return false;
+    }
+    if (epoch > current->vbc->revepoch || (epoch == current->vbc->revepoch && rev > current->vbc->revid)) {
+        return false;
+    }
+
+    lcb_log(LOGARGS(this, TRACE), LOGFMT "Skipping config rev=%lld epoch=%lld (current rev=%d epoch=%lld)", LOGID(this),
+            (long long)rev, (long long)epoch, current->vbc->revid, (long long)current->vbc->revepoch);
+    if (settings().metrics) {
+        settings().metrics->configs_skipped++;
+    }
+    return true;
+}
+
+lcb_STATUS CccpProvider::update(const char *host, const char *data, size_t ndata)
 {
     lcbvb_CONFIG *vbc;
     int rv;
     ConfigInfo *new_config;
-    vbc = lcbvb_create();
 
+    if (is_stale(data, ndata)) {
+        parent->provider_got_config(this, parent->get_config());
+        return LCB_SUCCESS;
+    }
+
+    vbc = lcbvb_create();
     if (!vbc) {
         return LCB_ERR_NO_MEMORY;
     }
-    rv = lcbvb_load_json_ex(vbc, data, host, &LCBT_SETTING(this->parent, network));
+    std::string json(data, ndata);
+    rv = lcbvb_load_json_ex(vbc, json.c_str(), host, &LCBT_SETTING(this->parent, network));
 
     if (rv) {
         lcb_log(LOGARGS(this, ERROR), LOGFMT "Failed to parse config", LOGID(this));
-        lcb_log_badconfig(LOGARGS(this, ERROR), vbc, data);
+        lcb_log_badconfig(LOGARGS(this, ERROR), vbc, json.c_str());
         lcbvb_destroy(vbc);
         return LCB_ERR_PROTOCOL_ERROR;
     }
@@ -252,8 +287,7 @@ void lcb::clconfig::cccp_update(const void *cookie_, lcb_STATUS err, const void
     }
 
     if (err == LCB_SUCCESS) {
-        std::string ss(reinterpret_cast< const char * >(bytes), nbytes);
-        err = cccp->update(origin->host, ss.c_str());
+        err = cccp->update(origin->host, reinterpret_cast< const char * >(bytes), nbytes);
     }
 
     if (err != LCB_SUCCESS && was_active) {
@@ -404,7 +438,7 @@ void CccpProvider::on_io_read()
     resp.release(ioctx);
     stop_current_request(true);
 
-    lcb_STATUS err = update(hoststr.c_str(), jsonstr.c_str());
+    lcb_STATUS err = update(hoststr.c_str(), jsonstr.c_str(), jsonstr.size());
 
     if (err == LCB_SUCCESS) {
         timer.cancel();
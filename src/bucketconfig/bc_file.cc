@@ -97,14 +97,6 @@ FileProvider::Status FileProvider::load_cache()
     ifs.read(&buf[0], fsize);
     buf.push_back(0); // NUL termination
 
-    char *end = std::strstr(&buf[0], CONFIG_CACHE_MAGIC);
-    if (end == NULL) {
-        lcb_log(LOGARGS(this, ERROR), LOGFMT "Couldn't find magic", LOGID(this));
-        maybe_remove_file();
-        return CACHE_ERROR;
-    }
-    *end = '\0'; // Stop parsing at MAGIC
-
     lcbvb_CONFIG *vbc = lcbvb_create();
     if (vbc == NULL) {
         return CACHE_ERROR;
@@ -112,11 +104,28 @@ FileProvider::Status FileProvider::load_cache()
 
     Status status = CACHE_ERROR;
 
-    if (lcbvb_load_json(vbc, &buf[0]) != 0) {
-        lcb_log(LOGARGS(this, ERROR), LOGFMT "Couldn't parse configuration", LOGID(this));
-        lcb_log_badconfig(LOGARGS(this, ERROR), vbc, &buf[0]);
-        maybe_remove_file();
-        goto GT_DONE;
+    if (lcbvb_is_binary(&buf[0], fsize)) {
+        if (lcbvb_load_binary(vbc, &buf[0], fsize) != 0) {
+            lcb_log(LOGARGS(this, ERROR), LOGFMT "Couldn't load binary configuration: %s", LOGID(this),
+                    lcbvb_get_error(vbc));
+            maybe_remove_file();
+            goto GT_DONE;
+        }
+    } else {
+        char *end = std::strstr(&buf[0], CONFIG_CACHE_MAGIC);
+        if (end == NULL) {
+            lcb_log(LOGARGS(this, ERROR), LOGFMT "Couldn't find magic", LOGID(this));
+            maybe_remove_file();
+            goto GT_DONE;
+        }
+        *end = '\0'; // Stop parsing at MAGIC
+
+        if (lcbvb_load_json(vbc, &buf[0]) != 0) {
+            lcb_log(LOGARGS(this, ERROR), LOGFMT "Couldn't parse configuration", LOGID(this));
+            lcb_log_badconfig(LOGARGS(this, ERROR), vbc, &buf[0]);
+            maybe_remove_file();
+            goto GT_DONE;
+        }
     }
 
     if (lcbvb_get_distmode(vbc) != LCBVB_DIST_VBUCKET) {
@@ -129,7 +138,7 @@ FileProvider::Status FileProvider::load_cache()
         goto GT_DONE;
     }
 
-    if (strcmp(vbc->bname, settings().bucket) != 0) {
+    if (vbc->bname == NULL || strcmp(vbc->bname, settings().bucket) != 0) {
         lcb_log(LOGARGS(this, ERROR), LOGFMT "Bucket name in file is different from the one requested", LOGID(this));
         goto GT_DONE;
     }
@@ -157,8 +166,20 @@ void FileProvider::write_cache(lcbvb_CONFIG *cfg)
         return;
     }
 
-    std::ofstream ofs(filename.c_str(), std::ios::trunc);
+    std::ofstream ofs(filename.c_str(), std::ios::trunc | std::ios::binary);
     if (ofs.good()) {
+        if (settings().config_cache_binary) {
+            size_t nbin = 0;
+            char *bin = lcbvb_save_binary(cfg, &nbin);
+            if (bin != NULL) {
+                lcb_log(LOGARGS(this, INFO), LOGFMT "Writing binary configuration to file", LOGID(this));
+                ofs.write(bin, nbin);
+                free(bin);
+                return;
+            }
+            lcb_log(LOGARGS(this, WARN), LOGFMT "Couldn't serialize binary configuration. Falling back to JSON",
+                    LOGID(this));
+        }
         lcb_log(LOGARGS(this, INFO), LOGFMT "Writing configuration to file", LOGID(this));
         char *json = lcbvb_save_json(cfg);
         ofs << json;
@@ -0,0 +1,431 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * Cross-process configuration cache.
+ *
+ * Processes sharing a host (e.g. a pre-forked worker fleet) attach to a
+ * named POSIX shared memory segment. A single process owns the segment: it
+ * fetches configurations from the cluster as usual and publishes each new
+ * one as a binary snapshot (see lcbvb_save_binary()). All other processes
+ * never write the payload; they poll the segment and pick up new revisions
+ * without contacting the cluster.
+ *
+ * The payload is protected by a sequence lock: the owner makes the sequence
+ * odd before writing and even again afterwards, and readers retry until they
+ * observe the same even sequence before and after copying the payload.
+ *
+ * Ownership is an exclusive flock() on the segment, held for as long as the
+ * owner stays attached. The kernel drops the lock when the owning process
+ * exits, so this is not affected by PID reuse or PID namespaces. If the owner
+ * goes away, the next reader to obtain the lock takes ownership and falls
+ * through to the next provider (normally CCCP) to fetch the configuration
+ * itself.
+ */
+
+#include "internal.h"
+#include "bc_shm.h"
+#include <lcbio/lcbio.h>
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define SHM_BARRIER() __sync_synchronize()
+#define SHM_SEQ_INCR(p) __sync_fetch_and_add(p, 1)
+#else
+#define SHM_BARRIER() MemoryBarrier()
+#define SHM_SEQ_INCR(p) InterlockedIncrement((volatile LONG *)(p))
+#endif
+
+#define LOGARGS(pb, lvl) static_cast< Provider * >(pb)->parent->settings, "bc_shm", LCB_LOG_##lvl, __FILE__, __LINE__
+#define LOGFMT "(shm=%s) "
+#define LOGID(sp) sp->name.c_str()
+
+/* Size of the payload area. Sparse until touched, so it is cheap to be generous */
+#define SHM_PAYLOAD_SIZE (1024 * 1024)
+/* How often non-owning processes check the segment for a new revision */
+#define SHM_POLL_INTERVAL LCB_MS2US(100)
+/* How many times a reader retries when it races with the owner */
+#define SHM_READ_RETRIES 64
+
+using namespace lcb::clconfig;
+
+#ifndef _WIN32
+bool ShmProvider::attach()
+{
+    int sfd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    if (sfd == -1) {
+        last_errno = errno;
+        lcb_log(LOGARGS(this, ERROR), LOGFMT "Couldn't open segment: %s", LOGID(this), strerror(last_errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(sfd, &st) != 0) {
+        last_errno = errno;
+        close(sfd);
+        return false;
+    }
+
+    size_t len = st.st_size;
+    if (len == 0) {
+        /* Concurrent creators all truncate to the same size, so this is safe */
+        len = sizeof(ShmHeader) + SHM_PAYLOAD_SIZE;
+        if (ftruncate(sfd, len) != 0) {
+            last_errno = errno;
+            lcb_log(LOGARGS(this, ERROR), LOGFMT "Couldn't size segment: %s", LOGID(this), strerror(last_errno));
+            close(sfd);
+            return false;
+        }
+    } else if (len < sizeof(ShmHeader)) {
+        lcb_log(LOGARGS(this, ERROR), LOGFMT "Segment is too small (%lu bytes)", LOGID(this), (unsigned long)len);
+        close(sfd);
+        return false;
+    }
+
+    void *addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, sfd, 0);
+    if (addr == MAP_FAILED) {
+        last_errno = errno;
+        lcb_log(LOGARGS(this, ERROR), LOGFMT "Couldn't map segment: %s", LOGID(this), strerror(last_errno));
+        close(sfd);
+        return false;
+    }
+
+    header = static_cast< ShmHeader * >(addr);
+    maplen = len;
+    fd = sfd;
+    lcb_log(LOGARGS(this, INFO), LOGFMT "Attached to segment (%lu bytes)", LOGID(this), (unsigned long)len);
+    return true;
+}
+
+void ShmProvider::detach()
+{
+    if (header == NULL) {
+        return;
+    }
+    munmap(header, maplen);
+    /* Closing the descriptor releases the lock, letting the next process
+     * take over right away */
+    close(fd);
+    header = NULL;
+    maplen = 0;
+    fd = -1;
+    owner = false;
+}
+
+bool ShmProvider::is_owner() const
+{
+    return header != NULL && owner;
+}
+
+bool ShmProvider::try_acquire()
+{
+    if (owner) {
+        return true;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        if (errno != EWOULDBLOCK) {
+            last_errno = errno;
+        }
+        return false;
+    }
+    owner = true;
+    int32_t pid = header->owner;
+    header->owner = (int32_t)getpid();
+    if (header->seq & 1) {
+        /* Previous owner died in the middle of publishing */
+        SHM_SEQ_INCR(&header->seq);
+    }
+    lcb_log(LOGARGS(this, INFO), LOGFMT "Took ownership of segment (previous owner: %d)", LOGID(this), (int)pid);
+    return true;
+}
+#else
+bool ShmProvider::attach()
+{
+    lcb_log(LOGARGS(this, ERROR), LOGFMT "Shared memory configuration cache is not supported on this platform",
+            LOGID(this));
+    return false;
+}
+
+void ShmProvider::detach() {}
+
+bool ShmProvider::is_owner() const
+{
+    return false;
+}
+
+bool ShmProvider::try_acquire()
+{
+    return false;
+}
+#endif
+
+ShmProvider::Status ShmProvider::load_snapshot()
+{
+    if (header == NULL) {
+        return SHM_ERROR;
+    }
+
+    std::vector< char > buf;
+    uint32_t seq = 0;
+    bool consistent = false;
+
+    for (size_t ii = 0; ii < SHM_READ_RETRIES && !consistent; ii++) {
+        seq = header->seq;
+        SHM_BARRIER();
+        if (seq & 1) {
+            continue;
+        }
+        if (seq == last_seq && config != NULL) {
+            return NO_CHANGES;
+        }
+        if (memcmp(header->magic, SHM_MAGIC, sizeof(header->magic)) != 0 || header->version != SHM_VERSION) {
+            return SHM_ERROR;
+        }
+        uint32_t length = header->length;
+        if (length == 0 || length > maplen - sizeof(ShmHeader)) {
+            return SHM_ERROR;
+        }
+        buf.resize(length);
+        memcpy(&buf[0], header + 1, length);
+        SHM_BARRIER();
+        consistent = header->seq == seq;
+    }
+
+    if (!consistent) {
+        lcb_log(LOGARGS(this, DEBUG), LOGFMT "Couldn't read a consistent snapshot", LOGID(this));
+        return SHM_ERROR;
+    }
+
+    lcbvb_CONFIG *vbc = lcbvb_create();
+    if (vbc == NULL) {
+        return SHM_ERROR;
+    }
+
+    Status status = SHM_ERROR;
+    if (lcbvb_load_binary(vbc, &buf[0], buf.size()) != 0) {
+        lcb_log(LOGARGS(this, ERROR), LOGFMT "Couldn't load snapshot: %s", LOGID(this), lcbvb_get_error(vbc));
+        goto GT_DONE;
+    }
+
+    if (settings().bucket == NULL || vbc->bname == NULL || strcmp(vbc->bname, settings().bucket) != 0) {
+        lcb_log(LOGARGS(this, ERROR), LOGFMT "Bucket name in segment is different from the one requested",
+                LOGID(this));
+        goto GT_DONE;
+    }
+
+    if (config) {
+        config->decref();
+    }
+    config = ConfigInfo::create(vbc, CLCONFIG_SHM);
+    last_seq = seq;
+    status = UPDATED;
+    vbc = NULL;
+
+GT_DONE:
+    if (vbc != NULL) {
+        lcbvb_destroy(vbc);
+    }
+    return status;
+}
+
+void ShmProvider::publish(lcbvb_CONFIG *cfg)
+{
+    size_t nbin = 0;
+    char *bin = lcbvb_save_binary(cfg, &nbin);
+    if (bin == NULL) {
+        lcb_log(LOGARGS(this, WARN), LOGFMT "Couldn't serialize configuration", LOGID(this));
+        return;
+    }
+    if (nbin > maplen - sizeof(ShmHeader)) {
+        lcb_log(LOGARGS(this, WARN), LOGFMT "Snapshot (%lu bytes) does not fit into segment", LOGID(this),
+                (unsigned long)nbin);
+        free(bin);
+        return;
+    }
+
+    SHM_SEQ_INCR(&header->seq);
+    SHM_BARRIER();
+    memcpy(header->magic, SHM_MAGIC, sizeof(header->magic));
+    header->version = SHM_VERSION;
+    header->capacity = maplen - sizeof(ShmHeader);
+    memcpy(header + 1, bin, nbin);
+    header->length = nbin;
+    header->revid = cfg->revid;
+    SHM_BARRIER();
+    SHM_SEQ_INCR(&header->seq);
+
+    free(bin);
+    lcb_log(LOGARGS(this, DEBUG), LOGFMT "Published configuration rev=%d (%lu bytes)", LOGID(this), cfg->revid,
+            (unsigned long)nbin);
+}
+
+ConfigInfo *ShmProvider::get_cached()
+{
+    return header == NULL ? NULL : config;
+}
+
+void ShmProvider::reload_segment()
+{
+    if (header == NULL) {
+        parent->provider_failed(this, LCB_ERR_GENERIC);
+        return;
+    }
+
+    if (try_acquire()) {
+        /* We are the publisher. Let the network providers fetch the config */
+        lcb_log(LOGARGS(this, TRACE), LOGFMT "Owner of segment. Deferring to next provider", LOGID(this));
+        poll_timer.cancel();
+        parent->provider_failed(this, LCB_SUCCESS);
+        return;
+    }
+
+    Status status = load_snapshot();
+    if (status == SHM_ERROR) {
+        /* Nothing published yet */
+        parent->provider_failed(this, LCB_ERR_GENERIC);
+        return;
+    }
+    if (!poll_timer.is_armed()) {
+        poll_timer.rearm(SHM_POLL_INTERVAL);
+    }
+    /* The owner is alive, so whatever is in the segment is the freshest
+     * configuration available, even if it has not changed. */
+    parent->provider_got_config(this, config);
+}
+
+void ShmProvider::poll_segment()
+{
+    if (header == NULL || is_owner()) {
+        return;
+    }
+    if (try_acquire()) {
+        lcb_log(LOGARGS(this, INFO), LOGFMT "Previous owner of segment is gone. Requesting new configuration",
+                LOGID(this));
+        parent->start();
+        return;
+    }
+    if (load_snapshot() == UPDATED) {
+        parent->provider_got_config(this, config);
+    }
+    poll_timer.rearm(SHM_POLL_INTERVAL);
+}
+
+lcb_STATUS ShmProvider::refresh()
+{
+    if (!timer.is_armed()) {
+        timer.signal();
+    }
+    return LCB_SUCCESS;
+}
+
+ShmProvider::~ShmProvider()
+{
+    timer.release();
+    poll_timer.release();
+    detach();
+    if (config) {
+        config->decref();
+    }
+}
+
+void ShmProvider::clconfig_lsn(EventType event, ConfigInfo *info)
+{
+    if (event != CLCONFIG_EVENT_GOT_NEW_CONFIG) {
+        return;
+    }
+    if (!enabled || header == NULL) {
+        return;
+    }
+
+    Method origin = info->get_origin();
+    if (origin == CLCONFIG_PHONY || origin == CLCONFIG_FILE || origin == CLCONFIG_SHM) {
+        lcb_log(LOGARGS(this, TRACE), LOGFMT "Not publishing configuration originating from PHONY, FILE or SHM",
+                LOGID(this));
+        return;
+    }
+    if (lcbvb_get_distmode(info->vbc) != LCBVB_DIST_VBUCKET) {
+        return;
+    }
+    if (!try_acquire()) {
+        return;
+    }
+    poll_timer.cancel();
+    publish(info->vbc);
+}
+
+void ShmProvider::dump(FILE *fp) const
+{
+    fprintf(fp, "## BEGIN SHM PROVIDER DUMP ##\n");
+    fprintf(fp, "NAME: %s\n", name.c_str());
+    if (header != NULL) {
+        fprintf(fp, "OWNER: %d%s\n", (int)header->owner, is_owner() ? " (self)" : "");
+        fprintf(fp, "SEQUENCE: %u\n", (unsigned)header->seq);
+        fprintf(fp, "REVISION: %d\n", (int)header->revid);
+    }
+    fprintf(fp, "LAST SYSTEM ERRNO: %d\n", last_errno);
+    fprintf(fp, "## END SHM PROVIDER DUMP ##\n");
+}
+
+ShmProvider::ShmProvider(Confmon *parent_)
+    : Provider(parent_, CLCONFIG_SHM), header(NULL), maplen(0), fd(-1), owner(false), config(NULL), last_seq(0),
+      last_errno(0),
+      timer(parent_->iot, this), poll_timer(parent_->iot, this)
+{
+    parent->add_listener(this);
+}
+
+bool lcb::clconfig::shm_set_name(Provider *p, const char *n)
+{
+    ShmProvider *provider = static_cast< ShmProvider * >(p);
+    provider->detach();
+
+    if (n != NULL && *n != '\0') {
+        provider->name = n;
+    } else if (p->parent->settings->bucket != NULL) {
+        provider->name = std::string("lcb-config-") + p->parent->settings->bucket;
+    } else {
+        return false;
+    }
+    if (provider->name[0] != '/') {
+        provider->name.insert(0, "/");
+    }
+
+    if (!provider->attach()) {
+        return false;
+    }
+    provider->enabled = 1;
+    return true;
+}
+
+const char *lcb::clconfig::shm_get_name(Provider *p)
+{
+    ShmProvider *provider = static_cast< ShmProvider * >(p);
+    if (provider->header == NULL) {
+        return NULL;
+    }
+    return provider->name.c_str();
+}
+
+Provider *lcb::clconfig::new_shm_provider(Confmon *mon)
+{
+    return new ShmProvider(mon);
+}
@@ -0,0 +1,89 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/**
+ * Cross-process configuration cache. See bc_shm.cc for an overview.
+ */
+#ifndef LCB_CLPROVIDER_SHM_H
+#define LCB_CLPROVIDER_SHM_H
+
+#include "config.h"
+#include "clconfig.h"
+#include <lcbio/timer-ng.h>
+#include <lcbio/timer-cxx.h>
+#include <string>
+
+#define SHM_MAGIC "LCBSHMC1"
+#define SHM_VERSION 1
+
+namespace lcb
+{
+namespace clconfig
+{
+/** Layout of the start of the segment. The snapshot payload follows it */
+struct ShmHeader {
+    char magic[8];
+    uint32_t version;
+    /** Size of the payload area following this header */
+    uint32_t capacity;
+    /** Sequence lock. Odd while the owner is writing */
+    volatile uint32_t seq;
+    /** PID of the last process to take ownership. Informational only; the
+     * owner is whoever holds the lock on the segment */
+    volatile int32_t owner;
+    /** Length of the current snapshot, 0 if nothing has been published */
+    volatile uint32_t length;
+    /** Revision of the current snapshot */
+    volatile int32_t revid;
+};
+
+struct ShmProvider : Provider, Listener {
+    ShmProvider(Confmon *confmon);
+    ~ShmProvider();
+
+    enum Status { SHM_ERROR, NO_CHANGES, UPDATED };
+    bool attach();
+    void detach();
+    bool is_owner() const;
+    bool try_acquire();
+    Status load_snapshot();
+    void publish(lcbvb_CONFIG *vbc);
+    void reload_segment();
+    void poll_segment();
+
+    /* Overrides */
+    ConfigInfo *get_cached();
+    lcb_STATUS refresh();
+    void dump(FILE *) const;
+    void clconfig_lsn(EventType, ConfigInfo *);
+
+    std::string name;
+    ShmHeader *header;
+    size_t maplen;
+    /** Descriptor of the segment, kept open to hold the owner lock */
+    int fd;
+    bool owner;
+    ConfigInfo *config;
+    uint32_t last_seq;
+    int last_errno;
+    lcb::io::Timer< ShmProvider, &ShmProvider::reload_segment > timer;
+    lcb::io::Timer< ShmProvider, &ShmProvider::poll_segment > poll_timer;
+};
+
+} // namespace clconfig
+} // namespace lcb
+#endif /* LCB_CLPROVIDER_SHM_H */
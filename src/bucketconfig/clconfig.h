@@ -99,6 +99,8 @@ namespace clconfig
 enum Method {
     /** File-based "configcache" provider. Implemented in bc_file.c */
     CLCONFIG_FILE,
+    /** Cross-process shared memory configuration cache. Implemented in bc_shm.cc */
+    CLCONFIG_SHM,
     /** New-style config-over-memcached provider. Implemented in bc_cccp.c */
     CLCONFIG_CCCP,
     /** Old-style streaming HTTP provider. Implemented in bc_http.c */
@@ -512,6 +514,7 @@ struct Provider {
 
 Provider *new_cccp_provider(Confmon *);
 Provider *new_file_provider(Confmon *);
+Provider *new_shm_provider(Confmon *);
 Provider *new_http_provider(Confmon *);
 Provider *new_mcraw_provider(Confmon *);
 Provider *new_cladmin_provider(Confmon *);
@@ -642,6 +645,29 @@ const char *file_get_filename(Provider *p);
 void file_set_readonly(Provider *p, bool val);
 /**@}*/
 
+/**
+ * @name Shared Memory Provider-specific APIs
+ * @{
+ */
+
+/**
+ * Attaches the provider to the named shared memory segment, creating it if
+ * necessary. This also enables the provider.
+ * @param p The provider of type CLCONFIG_SHM
+ * @param name the segment name (if NULL or empty, a name is derived from
+ * the bucket)
+ * @return true on success, false on failure.
+ */
+bool shm_set_name(Provider *p, const char *name);
+
+/**
+ * Retrieve the name of the shared memory segment
+ * @param p The provider of type CLCONFIG_SHM
+ * @return the segment name, or NULL if the provider is not attached
+ */
+const char *shm_get_name(Provider *p);
+/**@}*/
+
 /**
  * @name HTTP Provider-specific APIs
  * @{
@@ -692,10 +718,11 @@ static inline const lcb_host_t *http_get_host(Confmon *c)
  * @param provider The CCCP provider
  * @param host The hostname (without the port) on which the packet was received
  * @param data The configuration JSON blob
+ * @param ndata Size of the blob
  * @return LCB_SUCCESS, or an error code if the configuration could not be
  * set
  */
-lcb_STATUS cccp_update(Provider *provider, const char *host, const char *data);
+lcb_STATUS cccp_update(Provider *provider, const char *host, const char *data, size_t ndata);
 
 /**
  * @brief Notify the CCCP provider about a configuration received from a
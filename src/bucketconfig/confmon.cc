@@ -57,6 +57,9 @@ const char *provider_string(Method type)
     if (type == CLCONFIG_FILE) {
         return "FILE";
     }
+    if (type == CLCONFIG_SHM) {
+        return "SHM";
+    }
     if (type == CLCONFIG_MCRAW) {
         return "MCRAW";
     }
@@ -75,6 +78,7 @@ Confmon::Confmon(lcb_settings *settings_, lcbio_pTABLE iot_, lcb_INSTANCE *insta
     lcb_settings_ref(settings);
 
     all_providers[CLCONFIG_FILE] = new_file_provider(this);
+    all_providers[CLCONFIG_SHM] = new_shm_provider(this);
     all_providers[CLCONFIG_CCCP] = new_cccp_provider(this);
     all_providers[CLCONFIG_HTTP] = new_http_provider(this);
     all_providers[CLCONFIG_MCRAW] = new_mcraw_provider(this);
@@ -354,6 +358,10 @@ int ConfigInfo::compare(const ConfigInfo &other)
     if (vbc->bname == NULL && other.vbc->bname != NULL) {
         return -1; /* we want to upgrade config after opening bucket */
     }
+    /** A new epoch supersedes any revision of the previous one */
+    if (vbc->revepoch != other.vbc->revepoch) {
+        return vbc->revepoch < other.vbc->revepoch ? -1 : 1;
+    }
     /** Then check if both have revisions */
     int rev_a, rev_b;
     rev_a = lcbvb_get_revision(this->vbc);
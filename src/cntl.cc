@@ -101,6 +101,8 @@ static lcb_uint32_t *get_timeout_field(lcb_INSTANCE *instance, int cmd)
         return &settings->tracer_threshold[LCBTRACE_THRESHOLD_SEARCH];
     case LCB_CNTL_TRACING_THRESHOLD_ANALYTICS: return &settings->tracer_threshold[LCBTRACE_THRESHOLD_ANALYTICS];
     case LCB_CNTL_PERSISTENCE_TIMEOUT_FLOOR: return &settings->persistence_timeout_floor;
+    case LCB_CNTL_TCP_USER_TIMEOUT: return &settings->tcp_user_timeout;
+    case LCB_CNTL_SSL_SESSION_LIFETIME: return &settings->ssl_session_lifetime;
     default: return NULL;
     }
 }
@@ -175,6 +177,9 @@ HANDLER(http_poolsz_handler) {
 HANDLER(http_pooltmo_handler) {
     RETURN_GET_SET(uint32_t, instance->http_sockpool->get_options().tmoidle)
 }
+HANDLER(http_pool_minidle_handler) {
+    RETURN_GET_SET(lcb_SIZE, instance->http_sockpool->get_options().minidle)
+}
 HANDLER(http_refresh_config_handler) {
     RETURN_GET_SET(int, LCBT_SETTING(instance, refresh_on_hterr))
 }
@@ -433,6 +438,23 @@ HANDLER(config_cache_handler) {
     }
 }
 
+HANDLER(config_shm_handler) {
+    using namespace lcb::clconfig;
+    Provider *provider;
+
+    (void)cmd;
+    provider = instance->confmon->get_provider(lcb::clconfig::CLCONFIG_SHM);
+    if (mode == LCB_CNTL_SET) {
+        if (shm_set_name(provider, reinterpret_cast<const char*>(arg))) {
+            return LCB_SUCCESS;
+        }
+        return LCB_ERR_INVALID_ARGUMENT;
+    } else {
+        *(const char **)arg = shm_get_name(provider);
+        return LCB_SUCCESS;
+    }
+}
+
 HANDLER(retrymode_handler) {
     lcb_U32 *val = reinterpret_cast<lcb_U32*>(arg);
     lcb_U32 rmode = LCB_RETRYOPT_GETMODE(*val);
@@ -665,6 +687,17 @@ HANDLER(comp_min_ratio_handler) {
     RETURN_GET_SET(float, LCBT_SETTING(instance, compress_min_ratio))
 }
 
+HANDLER(comp_async_min_size_handler) {
+    RETURN_GET_SET(lcb_U32, LCBT_SETTING(instance, compress_async_min_size))
+}
+
+HANDLER(comp_async_threads_handler) {
+    if (mode == LCB_CNTL_SET && *reinterpret_cast<lcb_U32*>(arg) == 0) {
+        return LCB_ERR_CONTROL_INVALID_ARGUMENT;
+    }
+    RETURN_GET_SET(lcb_U32, LCBT_SETTING(instance, compress_async_threads))
+}
+
 HANDLER(network_handler) {
     if (mode == LCB_CNTL_SET) {
         const char *val = reinterpret_cast<const char*>(arg);
@@ -684,6 +717,62 @@ HANDLER(durable_write_handler) {
     RETURN_GET_SET(int, LCBT_SETTING(instance, enable_durable_write));
 }
 
+HANDLER(config_cache_binary_handler) {
+    RETURN_GET_SET(int, LCBT_SETTING(instance, config_cache_binary));
+}
+
+HANDLER(kv_preconnect_handler) {
+    RETURN_GET_SET(int, LCBT_SETTING(instance, kv_preconnect));
+}
+
+HANDLER(pipeline_negotiation_handler) {
+    RETURN_GET_SET(int, LCBT_SETTING(instance, pipeline_negotiation));
+}
+
+HANDLER(tcp_busy_poll_handler) {
+    RETURN_GET_SET(lcb_U32, LCBT_SETTING(instance, tcp_busy_poll));
+}
+
+HANDLER(tcp_rcvbuf_handler) {
+    RETURN_GET_SET(lcb_U32, LCBT_SETTING(instance, tcp_rcvbuf));
+}
+
+HANDLER(tcp_sndbuf_handler) {
+    RETURN_GET_SET(lcb_U32, LCBT_SETTING(instance, tcp_sndbuf));
+}
+
+HANDLER(tcp_quickack_handler) {
+    RETURN_GET_SET(int, LCBT_SETTING(instance, tcp_quickack));
+}
+
+HANDLER(ip_tos_handler) {
+    if (mode == LCB_CNTL_SET) {
+        int val = *reinterpret_cast<int*>(arg);
+        if (val < 0 || val > 255) {
+            return LCB_ERR_CONTROL_INVALID_ARGUMENT;
+        }
+    }
+    RETURN_GET_SET(int, LCBT_SETTING(instance, ip_tos))
+}
+
+HANDLER(kv_pool_size_handler) {
+    if (mode == LCB_CNTL_SET) {
+        lcb_U32 val = *reinterpret_cast<lcb_U32*>(arg);
+        if (val < 1 || val > 16) {
+            return LCB_ERR_CONTROL_INVALID_ARGUMENT;
+        }
+    }
+    RETURN_GET_SET(lcb_U32, LCBT_SETTING(instance, kv_pool_size))
+}
+
+HANDLER(ssl_ktls_handler) {
+    RETURN_GET_SET(int, LCBT_SETTING(instance, ssl_ktls));
+}
+
+HANDLER(ssl_log_handshake_handler) {
+    RETURN_GET_SET(int, LCBT_SETTING(instance, ssl_log_handshake));
+}
+
 /* clang-format off */
 static ctl_handler handlers[] = {
     timeout_common,                       /* LCB_CNTL_OP_TIMEOUT */
@@ -783,6 +872,23 @@ static ctl_handler handlers[] = {
     durable_write_handler,                /* LCB_CNTL_ENABLE_DURABLE_WRITE */
     timeout_common,                       /* LCB_CNTL_PERSISTENCE_TIMEOUT_FLOOR */
     allow_static_config_handler,          /* LCB_CNTL_ALLOW_STATIC_CONFIG */
+    config_cache_binary_handler,          /* LCB_CNTL_CONFIGCACHE_BINARY */
+    config_shm_handler,                   /* LCB_CNTL_CONFIG_SHM */
+    kv_preconnect_handler,                /* LCB_CNTL_KV_PRECONNECT */
+    pipeline_negotiation_handler,         /* LCB_CNTL_PIPELINE_NEGOTIATION */
+    tcp_busy_poll_handler,                /* LCB_CNTL_TCP_BUSY_POLL */
+    tcp_rcvbuf_handler,                   /* LCB_CNTL_TCP_RCVBUF */
+    tcp_sndbuf_handler,                   /* LCB_CNTL_TCP_SNDBUF */
+    tcp_quickack_handler,                 /* LCB_CNTL_TCP_QUICKACK */
+    timeout_common,                       /* LCB_CNTL_TCP_USER_TIMEOUT */
+    ip_tos_handler,                       /* LCB_CNTL_IP_TOS */
+    kv_pool_size_handler,                 /* LCB_CNTL_KV_POOL_SIZE */
+    http_pool_minidle_handler,            /* LCB_CNTL_HTTP_POOL_MIN_IDLE */
+    timeout_common,                       /* LCB_CNTL_SSL_SESSION_LIFETIME */
+    ssl_ktls_handler,                     /* LCB_CNTL_SSL_KTLS */
+    comp_async_min_size_handler,          /* LCB_CNTL_COMPRESSION_ASYNC_MIN_SIZE */
+    comp_async_threads_handler,           /* LCB_CNTL_COMPRESSION_ASYNC_THREADS */
+    ssl_log_handshake_handler,            /* LCB_CNTL_SSL_LOG_HANDSHAKE */
     NULL
 };
 /* clang-format on */
@@ -989,6 +1095,23 @@ static cntl_OPCODESTRS stropcode_map[] = {
     {"enable_durable_write", LCB_CNTL_ENABLE_DURABLE_WRITE, convert_intbool},
     {"persistence_timeout_floor", LCB_CNTL_PERSISTENCE_TIMEOUT_FLOOR, convert_timevalue},
     {"allow_static_config", LCB_CNTL_ALLOW_STATIC_CONFIG, convert_intbool},
+    {"config_cache_binary", LCB_CNTL_CONFIGCACHE_BINARY, convert_intbool},
+    {"config_shm", LCB_CNTL_CONFIG_SHM, convert_passthru},
+    {"kv_preconnect", LCB_CNTL_KV_PRECONNECT, convert_intbool},
+    {"pipeline_negotiation", LCB_CNTL_PIPELINE_NEGOTIATION, convert_intbool},
+    {"tcp_busy_poll", LCB_CNTL_TCP_BUSY_POLL, convert_u32},
+    {"tcp_rcvbuf", LCB_CNTL_TCP_RCVBUF, convert_u32},
+    {"tcp_sndbuf", LCB_CNTL_TCP_SNDBUF, convert_u32},
+    {"tcp_quickack", LCB_CNTL_TCP_QUICKACK, convert_intbool},
+    {"tcp_user_timeout", LCB_CNTL_TCP_USER_TIMEOUT, convert_timevalue},
+    {"ip_tos", LCB_CNTL_IP_TOS, convert_int},
+    {"kv_pool_size", LCB_CNTL_KV_POOL_SIZE, convert_u32},
+    {"http_pool_min_idle", LCB_CNTL_HTTP_POOL_MIN_IDLE, convert_SIZE},
+    {"ssl_session_lifetime", LCB_CNTL_SSL_SESSION_LIFETIME, convert_timevalue},
+    {"ssl_ktls", LCB_CNTL_SSL_KTLS, convert_intbool},
+    {"compression_async_min_size", LCB_CNTL_COMPRESSION_ASYNC_MIN_SIZE, convert_u32},
+    {"compression_async_threads", LCB_CNTL_COMPRESSION_ASYNC_THREADS, convert_u32},
+    {"ssl_log_handshake", LCB_CNTL_SSL_LOG_HANDSHAKE, convert_intbool},
     {NULL, -1}};
 
 #define CNTL_NUM_HANDLERS (sizeof(handlers) / sizeof(handlers[0]))
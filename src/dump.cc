@@ -64,9 +64,12 @@ lcb_dump(lcb_INSTANCE *instance, FILE *fp, lcb_U32 flags)
     }
 
     fprintf(fp, "=== BEGIN PIPELINE DUMP ===\n");
-    for (ii = 0; ii < instance->cmdq.npipelines; ii++) {
+    for (ii = 0; ii < instance->cmdq.nlanes; ii++) {
         lcb::Server *server = static_cast<lcb::Server*>(instance->cmdq.pipelines[ii]);
-        fprintf(fp, "** [%u] SERVER %s:%s\n", ii, server->curhost->host, server->curhost->port);
+        fprintf(fp, "** [%u] SERVER %s:%s\n", server->get_index(), server->curhost->host, server->curhost->port);
+        if (ii >= instance->cmdq.npipelines || server->nlanes > 1) {
+            fprintf(fp, "** == LANE %u, %lu BYTES PENDING\n", ii, (unsigned long)server->nbytes_pending);
+        }
         if (server->connctx) {
             fprintf(fp, "** == BEGIN SOCKET INFO\n");
             lcbio_ctx_dump(server->connctx, fp);
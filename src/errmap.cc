@@ -121,7 +121,7 @@ ErrorMap::ParseStatus ErrorMap::parse(const char *s, size_t n, std::string &errm
         return PARSE_ERROR;
     }
 
-    if (revJson.asUInt() <= revision) {
+    if (verJson.asUInt() < version || (verJson.asUInt() == version && revJson.asUInt() <= revision)) {
         return NOT_UPDATED;
     }
 
@@ -131,6 +131,8 @@ ErrorMap::ParseStatus ErrorMap::parse(const char *s, size_t n, std::string &errm
         return PARSE_ERROR;
     }
 
+    // The current map is only replaced once the new one parsed successfully
+    MapType newerrors;
     Json::Value::const_iterator ii = errsJson.begin();
     for (; ii != errsJson.end(); ++ii) {
         // Key is the version in hex
@@ -174,9 +176,12 @@ ErrorMap::ParseStatus ErrorMap::parse(const char *s, size_t n, std::string &errm
                 return PARSE_ERROR;
             }
         }
-        errors.insert(MapType::value_type(ec, error));
+        newerrors.insert(MapType::value_type(ec, error));
     }
 
+    errors.swap(newerrors);
+    version = verJson.asUInt();
+    revision = revJson.asUInt();
     return UPDATED;
 }
 
@@ -394,6 +394,9 @@ void invoke_callback(const mc_PACKET *pkt, mc_PIPELINE *pipeline, T *resp,
  * @param[out] freeptr pointer to free. This should be initialized to `NULL`.
  * If temporary dynamic storage is required this will be set to the allocated
  * pointer upon return. Otherwise it will be set to NULL. In any case it must
+ * be passed to release_decompressed() once the value is not used anymore.
+ *
+ * Values are inflated into the scratch buffer of the instance when possible.
  */
 static void
 maybe_decompress(lcb_INSTANCE *o,
@@ -411,7 +414,7 @@ maybe_decompress(lcb_INSTANCE *o,
     if (respkt->datatype() & PROTOCOL_BINARY_DATATYPE_COMPRESSED) {
         if (LCBT_SETTING(o, compressopts) & LCB_COMPRESS_IN) {
             /* if we inflate, we don't set the flag */
-            mcreq_inflate_value(
+            mcreq_inflate_value_scratch(&o->inflatebuf,
                 respkt->value(), respkt->vallen(),
                 &rescmd->value, &rescmd->nvalue, freeptr);
 
@@ -423,6 +426,12 @@ maybe_decompress(lcb_INSTANCE *o,
     rescmd->datatype = dtype;
 }
 
+static void release_decompressed(lcb_INSTANCE *o, const lcb_RESPGET *rescmd, void *freeptr)
+{
+    mcreq_inflatebuf_release(&o->inflatebuf, rescmd->value);
+    free(freeptr);
+}
+
 static void
 H_get(mc_PIPELINE *pipeline, mc_PACKET *request, MemcachedResponse* response,
       lcb_STATUS immerr)
@@ -451,7 +460,7 @@ H_get(mc_PIPELINE *pipeline, mc_PACKET *request, MemcachedResponse* response,
     LCBTRACE_KV_FINISH(pipeline, request, resp, response);
     TRACE_GET_END(o, request, response, &resp);
     invoke_callback(request, o, &resp, LCB_CALLBACK_GET);
-    free(freeptr);
+    release_decompressed(o, &resp, freeptr);
 }
 
 static void H_exists(mc_PIPELINE *pipeline, mc_PACKET *request, MemcachedResponse *response, lcb_STATUS immerr)
@@ -508,7 +517,7 @@ H_getreplica(mc_PIPELINE *pipeline, mc_PACKET *request,
 
     maybe_decompress(instance, response, &resp, &freeptr);
     rd->procs->handler(pipeline, request, resp.ctx.rc, &resp);
-    free(freeptr);
+    release_decompressed(instance, &resp, freeptr);
 }
 
 static int lcb_sdresult_next(const lcb_RESPSUBDOC *resp, lcb_SDENTRY *ent, size_t *iter);
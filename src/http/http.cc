@@ -348,6 +348,10 @@ void Request::finish(lcb_STATUS error)
     /* Cancel the timeout */
     lcbio_timer_disarm(timer);
 
+    /* Stop any I/O. This also drops the reference held by a request body which
+     * has not yet been written (see on_connected()) */
+    close_io();
+
     /* Remove the initial refcount=1 (set from lcb_http3). Typically this will
      * also free the request (though this is dependent on pending I/O operations) */
     decref();
@@ -114,6 +114,11 @@ int Request::handle_parse_chunked(const char *buf, unsigned nbuf)
     return parse_state;
 }
 
+static void release_body(void *arg)
+{
+    reinterpret_cast< Request * >(arg)->decref();
+}
+
 static void io_read(lcbio_CTX *ctx, unsigned nr)
 {
     Request *req = reinterpret_cast< Request * >(lcbio_ctx_data(ctx));
@@ -245,7 +250,13 @@ static void on_connected(lcbio_SOCKET *sock, void *arg, lcb_STATUS err, lcbio_OS
     req->ioctx->subsys = "mgmt/capi";
     lcbio_ctx_put(req->ioctx, &req->preamble[0], req->preamble.size());
     if (!req->body.empty()) {
-        lcbio_ctx_put(req->ioctx, &req->body[0], req->body.size());
+        /* The body is written straight from the request, which must stay
+         * alive until the context no longer references it */
+        lcb_IOV iov;
+        iov.iov_base = const_cast< char * >(&req->body[0]);
+        iov.iov_len = req->body.size();
+        req->incref();
+        lcbio_ctx_put_iov(req->ioctx, &iov, 1, release_body, req);
     }
     lcbio_ctx_rwant(req->ioctx, 1);
     lcbio_ctx_schedule(req->ioctx);
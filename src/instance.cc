@@ -633,6 +633,16 @@ void lcb_destroy(lcb_INSTANCE *instance)
         pendq->clear();
     }
 
+    if (instance->cmdq.cpool) {
+        mcreq_compresspool_reap(instance->cmdq.cpool, NULL, 1);
+    }
+    if (instance->compress_event) {
+        instance->iotable->E_event_cancel(mcreq_compresspool_fd(instance->cmdq.cpool), instance->compress_event);
+        instance->iotable->E_event_destroy(instance->compress_event);
+        instance->compress_event = NULL;
+    }
+    DESTROY(lcbio_timer_destroy, compress_timer);
+
     for (size_t ii = 0; ii < LCBT_NSERVERS(instance); ++ii) {
         instance->get_server(ii)->close();
     }
@@ -654,7 +664,7 @@ void lcb_destroy(lcb_INSTANCE *instance)
 
     if (instance->cmdq.pipelines) {
         unsigned ii;
-        for (ii = 0; ii < instance->cmdq.npipelines; ii++) {
+        for (ii = 0; ii < instance->cmdq.nlanes; ii++) {
             lcb::Server *server = static_cast<lcb::Server*>(instance->cmdq.pipelines[ii]);
             if (server) {
                 server->instance = NULL;
@@ -690,6 +700,7 @@ void lcb_destroy(lcb_INSTANCE *instance)
         delete instance->scratch;
         instance->scratch = NULL;
     }
+    mcreq_inflatebuf_cleanup(&instance->inflatebuf);
 
     for (std::map< std::string, lcbcrypto_PROVIDER * >::iterator ii = instance->crypto->begin();
          ii != instance->crypto->end(); ++ii) {
@@ -779,6 +790,8 @@ LCB_INTERNAL_API
 void lcb_run_loop(lcb_INSTANCE *instance)
 {
     IOT_START(instance->iotable);
+    instance->memd_sockpool->loop_stopped();
+    instance->http_sockpool->loop_stopped();
 }
 
 LCB_INTERNAL_API
@@ -40,6 +40,7 @@
 #include <strcodecs/strcodecs.h>
 #include "mcserver/mcserver.h"
 #include "mc/mcreq.h"
+#include "mc/compress.h"
 #include "settings.h"
 #include "contrib/genhash/genhash.h"
 
@@ -125,10 +126,13 @@ struct lcb_st {
     lcbio_pTABLE iotable;             /**< IO Routine table */
     lcb_RETRYQ *retryq;               /**< Retry queue for failed operations */
     lcb_pSCRATCHBUF scratch;          /**< Generic buffer space */
+    mc_INFLATEBUF inflatebuf;         /**< Inflated values of responses */
     struct lcb_GUESSVB_st *vbguess;   /**< Heuristic masters for vbuckets */
     lcb_N1QLCACHE *n1ql_cache;
     lcb_MUTATION_TOKEN *dcpinfo; /**< Mapping of known vbucket to {uuid,seqno} info */
     lcbio_pTIMER dtor_timer;     /**< Asynchronous destruction timer */
+    lcbio_pTIMER compress_timer; /**< Polls cmdq.cpool if compress_event cannot be used */
+    void *compress_event;        /**< Watches cmdq.cpool for values compressed in the background */
     lcb_BTYPE btype;             /**< Type of the bucket */
     lcb_COLLCACHE *collcache;    /**< Collection cache */
 
@@ -151,6 +155,11 @@ struct lcb_st {
     {
         return static_cast< lcb::Server * >(cmdq.pipelines[index]);
     }
+    /** Get a pipeline by its position in the command queue, including the lanes of every server */
+    lcb::Server *get_lane(size_t index) const
+    {
+        return static_cast< lcb::Server * >(cmdq.pipelines[index]);
+    }
     lcb::Server *find_server(const lcb_host_t &host) const;
     lcb_STATUS request_config(const void *cookie, lcb::Server *server);
     lcb_STATUS select_bucket(const void *cookie, lcb::Server *server);
@@ -199,6 +208,7 @@ struct lcb_st {
 
 #define LCBT_VBCONFIG(instance) (instance)->cmdq.config
 #define LCBT_NSERVERS(instance) (instance)->cmdq.npipelines
+#define LCBT_NLANES(instance) (instance)->cmdq.nlanes
 #define LCBT_NDATASERVERS(instance) LCBVB_NDATASERVERS(LCBT_VBCONFIG(instance))
 #define LCBT_NREPLICAS(instance) LCBVB_NREPLICAS(LCBT_VBCONFIG(instance))
 #define LCBT_GET_SERVER(instance, ix) (instance)->cmdq.pipelines[ix]
@@ -19,6 +19,12 @@
 
 #include "internal.h"
 #include "plugins/io/select/select_io_opts.h"
+#ifdef HAVE_EPOLL
+#include "plugins/io/epoll/epoll_io_opts.h"
+#endif
+#ifdef HAVE_IO_URING
+#include "plugins/io/uring/uring_io_opts.h"
+#endif
 #include <libcouchbase/plugins/io/bsdio-inl.c>
 
 #ifdef LCB_EMBED_PLUGIN_LIBEVENT
@@ -90,6 +96,13 @@ typedef struct {
 static plugin_info builtin_plugins[] = {BUILTIN_CORE("select", LCB_IO_OPS_SELECT, lcb_create_select_io_opts),
                                         BUILTIN_CORE("winsock", LCB_IO_OPS_WINSOCK, lcb_create_select_io_opts),
 
+#ifdef HAVE_EPOLL
+                                        BUILTIN_CORE("epoll", LCB_IO_OPS_EPOLL, lcb_create_epoll_io_opts),
+#endif
+#ifdef HAVE_IO_URING
+                                        BUILTIN_CORE("uring", LCB_IO_OPS_URING, lcb_create_uring_io_opts),
+#endif
+
 #ifdef _WIN32
                                         BUILTIN_CORE("iocp", LCB_IO_OPS_WINIOCP, lcb_iocp_new_iops),
 #endif
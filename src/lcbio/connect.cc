@@ -101,13 +101,39 @@ void Connstart::unwatch()
     }
 }
 
-static void try_enable_sockopt(lcbio_SOCKET *sock, int cntl)
+static void try_enable_sockopt(lcbio_SOCKET *sock, int cntl, int value = 1)
 {
-    lcb_STATUS rv = lcbio_enable_sockopt(sock, cntl);
+    lcb_STATUS rv = lcbio_set_sockopt(sock, cntl, value);
     if (rv == LCB_SUCCESS) {
-        lcb_log(LOGARGS(sock, DEBUG), CSLOGFMT "Successfully set %s", CSLOGID(sock), lcbio_strsockopt(cntl));
+        lcb_log(LOGARGS(sock, DEBUG), CSLOGFMT "Successfully set %s=%d", CSLOGID(sock), lcbio_strsockopt(cntl),
+                value);
     } else {
-        lcb_log(LOGARGS(sock, INFO), CSLOGFMT "Couldn't set %s", CSLOGID(sock), lcbio_strsockopt(cntl));
+        lcb_log(LOGARGS(sock, INFO), CSLOGFMT "Couldn't set %s=%d", CSLOGID(sock), lcbio_strsockopt(cntl), value);
+    }
+}
+
+/**
+ * Options which must be in place before the connection is initiated: buffer
+ * sizes determine the window scale advertised in the SYN.
+ */
+static void apply_presockopts(lcbio_SOCKET *sock)
+{
+    const lcb_settings *settings = sock->settings;
+    if (settings->tcp_rcvbuf) {
+        try_enable_sockopt(sock, LCB_IO_CNTL_SO_RCVBUF, (int)settings->tcp_rcvbuf);
+    }
+    if (settings->tcp_sndbuf) {
+        try_enable_sockopt(sock, LCB_IO_CNTL_SO_SNDBUF, (int)settings->tcp_sndbuf);
+    }
+    if (settings->tcp_busy_poll) {
+        try_enable_sockopt(sock, LCB_IO_CNTL_SO_BUSY_POLL, (int)settings->tcp_busy_poll);
+    }
+    if (settings->tcp_user_timeout) {
+        /* the option is in milliseconds */
+        try_enable_sockopt(sock, LCB_IO_CNTL_TCP_USER_TIMEOUT, (int)((settings->tcp_user_timeout + 999) / 1000));
+    }
+    if (settings->ip_tos) {
+        try_enable_sockopt(sock, LCB_IO_CNTL_IP_TOS, settings->ip_tos);
     }
 }
 
@@ -160,6 +186,9 @@ void Connstart::handler()
             if (sock->settings->tcp_keepalive) {
                 try_enable_sockopt(sock, LCB_IO_CNTL_TCP_KEEPALIVE);
             }
+            if (sock->settings->tcp_quickack) {
+                try_enable_sockopt(sock, LCB_IO_CNTL_TCP_QUICKACK);
+            }
         } else {
             lcb_log(LOGARGS_T(ERR), CSLOGFMT "Failed to establish connection: %s, os errno=%u", CSLOGID_T(),
                     lcb_strerror_short(err), syserr);
@@ -250,6 +279,7 @@ bool Connstart::ensure_sock()
             sock->u.fd = lcbio_E_ai2sock(io, &ai, &errtmp);
             if (sock->u.fd != INVALID_SOCKET) {
                 lcb_log(LOGARGS_T(DEBUG), CSLOGFMT "Created new socket with FD=%d", CSLOGID_T(), sock->u.fd);
+                apply_presockopts(sock);
                 return true;
             }
         }
@@ -263,6 +293,7 @@ bool Connstart::ensure_sock()
             if (sock->u.sd) {
                 sock->u.sd->lcbconn = const_cast< lcbio_SOCKET * >(sock);
                 sock->u.sd->parent = IOT_ARG(io);
+                apply_presockopts(sock);
                 return true;
             }
         }
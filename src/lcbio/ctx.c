@@ -36,6 +36,11 @@
 
 #include "rw-inl.h"
 
+/** Maximum number of output buffers kept for reuse by a context */
+#define OUTFREE_MAX 4
+/** Output buffers with more capacity than this are not kept in the freelist */
+#define OUTFREE_MAXSIZE 65536
+
 typedef enum { ES_ACTIVE = 0, ES_DETACHED } easy_state;
 
 static void err_handler(void *cookie)
@@ -96,13 +101,62 @@ lcbio_CTX *lcbio_ctx_new(lcbio_SOCKET *sock, void *data, const lcbio_CTXPROCS *p
     return ctx;
 }
 
+static void destroy_output(lcbio__EASYRB *erb)
+{
+    lcbio__erb_release(erb);
+    ringbuffer_destruct(&erb->rb);
+    free(erb);
+}
+
+/** Obtain a new output buffer, preferring one from the freelist */
+static lcbio__EASYRB *new_output(lcbio_CTX *ctx)
+{
+    lcbio__EASYRB *erb = ctx->outfree;
+
+    if (erb) {
+        ctx->outfree = erb->next;
+        ctx->noutfree--;
+        ctx->nout_reuse++;
+        erb->next = NULL;
+    } else if ((erb = calloc(1, sizeof(*erb))) != NULL) {
+        erb->parent = ctx;
+        ctx->nout_alloc++;
+    } else {
+        return NULL;
+    }
+    ctx->output = erb;
+    return erb;
+}
+
+/** Return a written output buffer to the freelist, retaining its capacity */
+static void recycle_output(lcbio_CTX *ctx, lcbio__EASYRB *erb)
+{
+    lcbio__erb_release(erb);
+    if (ctx->noutfree >= OUTFREE_MAX) {
+        destroy_output(erb);
+        return;
+    }
+    if (erb->rb.size > OUTFREE_MAXSIZE) {
+        ringbuffer_destruct(&erb->rb);
+    } else {
+        ringbuffer_reset(&erb->rb);
+    }
+    erb->next = ctx->outfree;
+    ctx->outfree = erb;
+    ctx->noutfree++;
+}
+
 static void free_ctx(lcbio_CTX *ctx)
 {
     rdb_cleanup(&ctx->ior);
     lcbio_unref(ctx->sock);
     if (ctx->output) {
-        ringbuffer_destruct(&ctx->output->rb);
-        free(ctx->output);
+        destroy_output(ctx->output);
+    }
+    while (ctx->outfree) {
+        lcbio__EASYRB *erb = ctx->outfree;
+        ctx->outfree = erb->next;
+        destroy_output(erb);
     }
     if (ctx->procs.cb_flush_ready) {
         /* dtor */
@@ -145,7 +199,7 @@ void lcbio_ctx_close_ex(lcbio_CTX *ctx, lcbio_CTXCLOSE_cb cb, void *arg, lcbio_C
                        ctx->err == LCB_SUCCESS && /* no socket errors */
                        ctx->rdwant == 0 &&        /* no expected input */
                        ctx->wwant == 0 &&         /* no expected output */
-                       (ctx->output == NULL || ctx->output->rb.nbytes == 0);
+                       (ctx->output == NULL || LCBIO_EASYRB_NBYTES(ctx->output) == 0);
         cb(ctx->sock, reusable, arg);
     }
 
@@ -155,9 +209,9 @@ void lcbio_ctx_close_ex(lcbio_CTX *ctx, lcbio_CTXCLOSE_cb cb, void *arg, lcbio_C
     }
 
     if (ctx->output) {
-        ringbuffer_destruct(&ctx->output->rb);
-        free(ctx->output);
+        lcbio__EASYRB *erb = ctx->output;
         ctx->output = NULL;
+        destroy_output(erb);
     }
 
     ctx->fd = INVALID_SOCKET;
@@ -185,20 +239,9 @@ void lcbio_ctx_put(lcbio_CTX *ctx, const void *buf, unsigned nbuf)
 {
     lcbio__EASYRB *erb = ctx->output;
 
-    if (!erb) {
-        ctx->output = erb = calloc(1, sizeof(*ctx->output));
-
-        if (!erb) {
-            lcbio_ctx_senderr(ctx, LCB_ERR_NO_MEMORY);
-            return;
-        }
-
-        erb->parent = ctx;
-
-        if (!ringbuffer_initialize(&erb->rb, nbuf)) {
-            lcbio_ctx_senderr(ctx, LCB_ERR_NO_MEMORY);
-            return;
-        }
+    if (!erb && (erb = new_output(ctx)) == NULL) {
+        lcbio_ctx_senderr(ctx, LCB_ERR_NO_MEMORY);
+        return;
     }
 
     if (!ringbuffer_ensure_capacity(&erb->rb, nbuf)) {
@@ -209,6 +252,49 @@ void lcbio_ctx_put(lcbio_CTX *ctx, const void *buf, unsigned nbuf)
     ringbuffer_write(&erb->rb, buf, nbuf);
 }
 
+void lcbio_ctx_put_iov(lcbio_CTX *ctx, const lcb_IOV *iov, unsigned niov, lcbio_CTXRELEASE_cb release, void *arg)
+{
+    lcbio__EASYRB *erb = ctx->output;
+    lcbio__OUTREF *last = NULL;
+    unsigned ii;
+
+    if (!erb && (erb = new_output(ctx)) == NULL) {
+        lcbio_ctx_senderr(ctx, LCB_ERR_NO_MEMORY);
+        release(arg);
+        return;
+    }
+
+    for (ii = 0; ii < niov; ii++) {
+        lcbio__OUTREF *ref;
+        if (!iov[ii].iov_len) {
+            continue;
+        }
+        if (!(ref = calloc(1, sizeof(*ref)))) {
+            lcbio_ctx_senderr(ctx, LCB_ERR_NO_MEMORY);
+            break;
+        }
+        ref->offset = (unsigned)erb->rb.nbytes;
+        ref->buf = (const char *)iov[ii].iov_base;
+        ref->nbuf = (unsigned)iov[ii].iov_len;
+        if (erb->reftail) {
+            erb->reftail->next = ref;
+        } else {
+            erb->refhead = ref;
+        }
+        erb->reftail = ref;
+        erb->nrefs++;
+        erb->nrefbytes += ref->nbuf;
+        last = ref;
+    }
+
+    if (last) {
+        last->release = release;
+        last->arg = arg;
+    } else {
+        release(arg);
+    }
+}
+
 void lcbio_ctx_rwant(lcbio_CTX *ctx, unsigned n)
 {
     ctx->rdwant = n;
@@ -299,7 +385,7 @@ static void E_handler(lcb_socket_t sock, short which, void *arg)
                 return;
             }
         } else if (ctx->output) {
-            status = lcbio_E_rb_write(ctx, &ctx->output->rb);
+            status = lcbio_E_erb_write(ctx, ctx->output);
             /** Metrics are logged by E_rb_write */
             if (!LCBIO_IS_OK(status)) {
                 send_io_error(ctx, status);
@@ -326,15 +412,16 @@ static void Cw_handler(lcb_sockdata_t *sd, int status, void *arg)
     (void)sd;
 
     ctx->npending--;
-    CTX_INCR_METRIC(ctx, bytes_sent, erb->rb.nbytes);
+    CTX_INCR_METRIC(ctx, bytes_sent, LCBIO_EASYRB_NBYTES(erb));
+    lcbio__erb_release(erb);
 
     if (!ctx->output) {
         ctx->output = erb;
+        ctx->nout_reuse++;
         ringbuffer_reset(&erb->rb);
 
     } else {
-        ringbuffer_destruct(&erb->rb);
-        free(erb);
+        recycle_output(ctx, erb);
     }
 
     if (ctx->state == ES_ACTIVE && status) {
@@ -407,29 +494,37 @@ static void C_schedule(lcbio_CTX *ctx)
     lcb_sockdata_t *sd = CTX_SD(ctx);
     int rv;
 
-    if (ctx->output && ctx->output->rb.nbytes) {
-        /** Schedule a write */
-        lcb_IOV iov[2] = {0};
-        unsigned niov;
+    if (ctx->output && LCBIO_EASYRB_NBYTES(ctx->output)) {
+        /** Schedule a write. Each referenced buffer may split the ringbuffer
+         * data around it, so the whole output fits in 3 * nrefs + 2 IOVs */
+        lcb_IOV iovbuf[RWINL_IOVSIZE];
+        lcb_IOV *iov = iovbuf;
+        unsigned niov, maxiov = ctx->output->nrefs * 3 + 2;
 
-        ringbuffer_get_iov(&ctx->output->rb, RINGBUFFER_READ, iov);
-        niov = iov[1].iov_len ? 2 : 1;
+        if (maxiov > RWINL_IOVSIZE && (iov = malloc(sizeof(*iov) * maxiov)) == NULL) {
+            lcbio_ctx_senderr(ctx, LCB_ERR_NO_MEMORY);
+            return;
+        }
+        niov = lcbio__erb_get_iov(ctx->output, iov, maxiov);
+#ifdef LCB_DUMP_PACKETS
+        {
+            char *b64 = NULL;
+            int nb64 = 0;
+            lcb_base64_encode_iov((lcb_IOV *)iov, niov, LCBIO_EASYRB_NBYTES(ctx->output), &b64, &nb64);
+            lcb_log(LOGARGS(ctx, TRACE), CTX_LOGFMT "pkt,snd: size=%d, %.*s", CTX_LOGID(ctx), nb64, nb64, b64);
+            free(b64);
+        }
+#endif
         rv = IOT_V1(io).write2(IOT_ARG(io), sd, iov, niov, ctx->output, Cw_handler);
+        if (iov != iovbuf) {
+            free(iov);
+        }
         if (rv) {
             send_io_error(ctx, LCBIO_IOERR);
             return;
         } else {
             ctx->output = NULL;
             ctx->npending++;
-#ifdef LCB_DUMP_PACKETS
-            {
-                char *b64 = NULL;
-                int nb64 = 0;
-                lcb_base64_encode_iov((lcb_IOV *)iov, niov, iov[0].iov_len + iov[1].iov_len, &b64, &nb64);
-                lcb_log(LOGARGS(ctx, TRACE), CTX_LOGFMT "pkt,snd: size=%d, %.*s", CTX_LOGID(ctx), nb64, nb64, b64);
-                free(b64);
-            }
-#endif
         }
     }
 
@@ -466,7 +561,7 @@ static void E_schedule(lcbio_CTX *ctx)
     if (ctx->rdwant) {
         which |= LCB_READ_EVENT;
     }
-    if (ctx->wwant || (ctx->output && ctx->output->rb.nbytes)) {
+    if (ctx->wwant || (ctx->output && LCBIO_EASYRB_NBYTES(ctx->output))) {
         which |= LCB_WRITE_EVENT;
     }
 
@@ -609,6 +704,8 @@ void lcbio_ctx_dump(lcbio_CTX *ctx, FILE *fp)
     fprintf(fp, "  WantWrite=%d\n", ctx->wwant);
     fprintf(fp, "  Entered=%d\n", ctx->entered);
     fprintf(fp, "  Active=%d\n", ctx->state == ES_ACTIVE);
+    fprintf(fp, "  Output Buffers: Allocated=%u, Reused=%u, Free=%u\n", ctx->nout_alloc, ctx->nout_reuse,
+            ctx->noutfree);
     fprintf(fp, "  SOCKET=%p\n", (void *)ctx->sock);
     fprintf(fp, "    Model=%s\n", ctx->io->model == LCB_IOMODEL_EVENT ? "Event" : "Completion");
     if (IOT_IS_EVENT(ctx->io)) {
@@ -77,8 +77,9 @@ extern "C" {
  * # Writing
  *
  * Writing can be done through a simple lcbio_ctx_put() which simply copies data
- * to an output buffer, or can be done through more efficient but complex means -
- * see the lcbio_ctx_wwant() function.
+ * to an output buffer, through lcbio_ctx_put_iov() which references buffers
+ * owned by the caller until they are written, or through more efficient but
+ * complex means - see the lcbio_ctx_wwant() function.
  *
  * # Scheduling
  *
@@ -114,15 +115,43 @@ typedef struct {
     void (*cb_flush_done)(lcbio_pCTX, unsigned requested, unsigned nflushed);
 } lcbio_CTXPROCS;
 
+/**
+ * Callback invoked once the buffers passed to lcbio_ctx_put_iov() are no
+ * longer referenced by the context.
+ * @param arg the argument passed to lcbio_ctx_put_iov()
+ */
+typedef void (*lcbio_CTXRELEASE_cb)(void *arg);
+
+/**
+ * Caller-owned output buffer queued by lcbio_ctx_put_iov().
+ * @private
+ */
+typedef struct lcbio__OUTREF {
+    struct lcbio__OUTREF *next;
+    unsigned offset; /**< bytes in the ringbuffer which precede this buffer */
+    const char *buf;
+    unsigned nbuf;
+    lcbio_CTXRELEASE_cb release; /**< set on the last buffer of each call */
+    void *arg;
+} lcbio__OUTREF;
+
 /**
  * Container buffer handle containing a backref to the original context.
  * @private
  */
-typedef struct {
+typedef struct lcbio__EASYRB {
     ringbuffer_t rb;
     lcbio_pCTX parent;
+    struct lcbio__EASYRB *next; /**< next buffer in the context's freelist */
+    lcbio__OUTREF *refhead;
+    lcbio__OUTREF *reftail;
+    unsigned nrefs;     /**< number of referenced buffers */
+    unsigned nrefbytes; /**< bytes remaining in referenced buffers */
 } lcbio__EASYRB;
 
+/** @private Total number of bytes pending in an output buffer */
+#define LCBIO_EASYRB_NBYTES(erb) ((erb)->rb.nbytes + (erb)->nrefbytes)
+
 /**
  * @brief Context for socket I/O
  *
@@ -131,24 +160,28 @@ typedef struct {
  * application data with the socket.
  */
 typedef struct lcbio_CTX {
-    lcbio_SOCKET *sock;    /**< Socket resource */
-    lcbio_pTABLE io;       /**< Cached IO table */
-    void *data;            /**< Associative pointer */
-    void *event;           /**< event pointer for E-model I/O */
-    lcb_sockdata_t *sd;    /**< cached SD for C-model I/O */
-    lcbio__EASYRB *output; /**< for lcbio_ctx_put() */
-    lcb_socket_t fd;       /**< cached FD for E-model I/O */
-    char evactive;         /**< watcher is active for E-model I/O */
-    char wwant;            /**< flag for lcbio_ctx_put_ex */
-    char state;            /**< internal state */
-    char entered;          /**< inside event handler */
-    unsigned npending;     /**< reference count on pending I/O */
-    unsigned rdwant;       /**< number of remaining bytes to read */
-    lcb_STATUS err;        /**< pending error */
-    rdb_IOROPE ior;        /**< for reads */
-    lcbio_pASYNC as_err;   /**< async error handler */
-    lcbio_CTXPROCS procs;  /**< callbacks */
-    const char *subsys;    /**< Informational description of connection */
+    lcbio_SOCKET *sock;     /**< Socket resource */
+    lcbio_pTABLE io;        /**< Cached IO table */
+    void *data;             /**< Associative pointer */
+    void *event;            /**< event pointer for E-model I/O */
+    lcb_sockdata_t *sd;     /**< cached SD for C-model I/O */
+    lcbio__EASYRB *output;  /**< for lcbio_ctx_put() */
+    lcbio__EASYRB *outfree; /**< output buffers released by completed writes */
+    unsigned noutfree;      /**< number of buffers in #outfree */
+    unsigned nout_alloc;    /**< number of output buffers allocated */
+    unsigned nout_reuse;    /**< number of times an output buffer was reused */
+    lcb_socket_t fd;        /**< cached FD for E-model I/O */
+    char evactive;          /**< watcher is active for E-model I/O */
+    char wwant;             /**< flag for lcbio_ctx_put_ex */
+    char state;             /**< internal state */
+    char entered;           /**< inside event handler */
+    unsigned npending;      /**< reference count on pending I/O */
+    unsigned rdwant;        /**< number of remaining bytes to read */
+    lcb_STATUS err;         /**< pending error */
+    rdb_IOROPE ior;         /**< for reads */
+    lcbio_pASYNC as_err;    /**< async error handler */
+    lcbio_CTXPROCS procs;   /**< callbacks */
+    const char *subsys;     /**< Informational description of connection */
 } lcbio_CTX;
 
 /**@name Creating and Closing
@@ -245,6 +278,29 @@ void lcbio_ctx_schedule(lcbio_CTX *ctx);
  */
 void lcbio_ctx_put(lcbio_CTX *ctx, const void *buf, unsigned nbuf);
 
+/**
+ * @brief Add caller-owned buffers to the write queue without copying them.
+ *
+ * This behaves like calling lcbio_ctx_put() for each element of `iov` in
+ * turn (the data is written in order with any other data added to the
+ * context), except that the buffers are referenced rather than copied.
+ * The buffers must remain valid and unmodified until `release` is invoked,
+ * which happens once all of them have been written to the network, or
+ * when they are discarded because the context was closed. For completion
+ * based I/O this may be after lcbio_ctx_close() has returned.
+ *
+ * `release` is always invoked exactly once; if there is no data to write
+ * it is invoked before this function returns. It may be invoked from within
+ * the I/O handlers and therefore must not call back into the context.
+ *
+ * @param ctx
+ * @param iov the buffers to write. The array itself is not retained
+ * @param niov the number of elements in `iov`
+ * @param release callback invoked when the buffers are no longer needed
+ * @param arg argument passed to `release`
+ */
+void lcbio_ctx_put_iov(lcbio_CTX *ctx, const lcb_IOV *iov, unsigned niov, lcbio_CTXRELEASE_cb release, void *arg);
+
 /**
  * Invoke the lcbio_CTXPROCS#cb_flush_ready()
  * callback when a flush may be invoked. Note that the
@@ -265,19 +265,18 @@ int lcbio_is_netclosed(lcbio_SOCKET *sock, int flags)
     }
 }
 
-lcb_STATUS lcbio_enable_sockopt(lcbio_SOCKET *s, int cntl)
+static lcb_STATUS sockopt_common(lcbio_SOCKET *s, int mode, int cntl, int *value)
 {
     lcbio_pTABLE iot = s->io;
     int rv;
-    int value = 1;
 
     if (!iot->has_cntl()) {
         return LCB_ERR_UNSUPPORTED_OPERATION;
     }
     if (iot->is_E()) {
-        rv = iot->E_cntl(s->u.fd, LCB_IO_CNTL_SET, cntl, &value);
+        rv = iot->E_cntl(s->u.fd, mode, cntl, value);
     } else {
-        rv = iot->C_cntl(s->u.sd, LCB_IO_CNTL_SET, cntl, &value);
+        rv = iot->C_cntl(s->u.sd, mode, cntl, value);
     }
     if (rv != 0) {
         return lcbio_mklcberr(IOT_ERRNO(iot), s->settings);
@@ -286,6 +285,21 @@ lcb_STATUS lcbio_enable_sockopt(lcbio_SOCKET *s, int cntl)
     }
 }
 
+lcb_STATUS lcbio_enable_sockopt(lcbio_SOCKET *s, int cntl)
+{
+    return lcbio_set_sockopt(s, cntl, 1);
+}
+
+lcb_STATUS lcbio_set_sockopt(lcbio_SOCKET *s, int cntl, int value)
+{
+    return sockopt_common(s, LCB_IO_CNTL_SET, cntl, &value);
+}
+
+lcb_STATUS lcbio_get_sockopt(lcbio_SOCKET *s, int cntl, int *value)
+{
+    return sockopt_common(s, LCB_IO_CNTL_GET, cntl, value);
+}
+
 const char *lcbio_strsockopt(int cntl)
 {
     switch (cntl) {
@@ -293,6 +307,20 @@ const char *lcbio_strsockopt(int cntl)
             return "TCP_KEEPALIVE";
         case LCB_IO_CNTL_TCP_NODELAY:
             return "TCP_NODELAY";
+        case LCB_IO_CNTL_SO_BUSY_POLL:
+            return "SO_BUSY_POLL";
+        case LCB_IO_CNTL_SO_RCVBUF:
+            return "SO_RCVBUF";
+        case LCB_IO_CNTL_SO_SNDBUF:
+            return "SO_SNDBUF";
+        case LCB_IO_CNTL_TCP_QUICKACK:
+            return "TCP_QUICKACK";
+        case LCB_IO_CNTL_TCP_USER_TIMEOUT:
+            return "TCP_USER_TIMEOUT";
+        case LCB_IO_CNTL_IP_TOS:
+            return "IP_TOS";
+        case LCB_IO_CNTL_SO_INCOMING_CPU:
+            return "SO_INCOMING_CPU";
         default:
             return "FIXME: Unknown option";
     }
@@ -329,7 +357,15 @@ lcb_STATUS lcbio_ssl_get_error(lcbio_SOCKET *)
 {
     return LCB_SUCCESS;
 }
+int lcbio_ssl_ktls(lcbio_SOCKET *)
+{
+    return 0;
+}
 void lcbio_ssl_global_init(void) {}
+void lcbio_ssl_session_stats(lcbio_pSSLCTX, lcbio_SSLSESSIONSTATS *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
 lcb_STATUS lcbio_sslify_if_needed(lcbio_SOCKET *, lcb_settings *)
 {
     return LCB_SUCCESS;
@@ -93,6 +93,24 @@ int lcbio_is_netclosed(lcbio_SOCKET *sock, int flags);
  */
 lcb_STATUS lcbio_enable_sockopt(lcbio_SOCKET *sock, int cntl);
 
+/**
+ * Set an integer option on a socket
+ * @param sock The socket
+ * @param cntl The option (LCB_IO_CNTL_xxx)
+ * @param value The value of the option
+ * @return
+ */
+lcb_STATUS lcbio_set_sockopt(lcbio_SOCKET *sock, int cntl, int value);
+
+/**
+ * Read the current value of an integer option of a socket
+ * @param sock The socket
+ * @param cntl The option (LCB_IO_CNTL_xxx)
+ * @param[out] value The value of the option
+ * @return
+ */
+lcb_STATUS lcbio_get_sockopt(lcbio_SOCKET *sock, int cntl, int *value);
+
 const char *lcbio_strsockopt(int cntl);
 
 void lcbio__load_socknames(lcbio_SOCKET *sock);
@@ -31,9 +31,13 @@ namespace io
 {
 
 struct PoolHost {
-    inline PoolHost(Pool *, const std::string &);
+    inline PoolHost(Pool *, const lcb_host_t &);
     inline void connection_available();
     inline void start_new_connection(uint32_t timeout);
+    inline void maybe_prewarm();
+    inline unsigned min_idle() const;
+    inline void settle_idle();
+    inline void destroy_events();
 
     void ref()
     {
@@ -49,6 +53,7 @@ struct PoolHost {
 
     ~PoolHost()
     {
+        destroy_events();
         if (parent) {
             parent->unref();
             parent = NULL;
@@ -77,11 +82,22 @@ struct PoolHost {
     lcb_clist_t ll_idle;    /* idle connections */
     lcb_clist_t ll_pending; /* pending cinfo */
     lcb_clist_t requests;   /* pending requests */
-    const std::string key;  /* host:port */
+    lcb_host_t host;
+    std::string key; /* host:port, for logging */
     Pool *parent;
     lcb::io::Timer< PoolHost, &PoolHost::connection_available > async;
+    lcb::io::Timer< PoolHost, &PoolHost::settle_idle > settle;
+    /* cancelled idle events, destroyed by `settle` once the loop is no longer
+     * dispatching them */
+    std::vector< std::pair< lcbio_pTABLE, void * > > dead_events;
     unsigned n_total; /* number of total connections */
     unsigned refcount;
+    uint32_t tmoconnect; /* connection timeout of the last request */
+
+    /* counters */
+    lcb_U64 n_hits;    /* requests served by an idle connection */
+    lcb_U64 n_misses;  /* requests which had to wait for a connection */
+    lcb_U64 n_evicted; /* idle connections closed by the peer */
 };
 } // namespace io
 } // namespace lcb
@@ -98,12 +114,22 @@ struct PoolConnInfo : lcbio_PROTOCTX, CinfoNode {
     inline ~PoolConnInfo();
     inline void on_idle_timeout();
     inline void on_connected(lcbio_SOCKET *sock, lcb_STATUS err);
+    inline void on_idle_event();
+    inline void set_idle();
+    inline void watch_idle();
+    inline void unwatch_idle();
 
     void set_leased()
     {
         lcb_assert(state == IDLE);
         state = LEASED;
         idle_timer.cancel();
+        /* The leasing context creates its own event for the socket. Some
+         * plugins cache registration state per event, so don't leave a
+         * cancelled one behind for the same descriptor. This may run from a
+         * callback while the idle event is ready as well, so it is only
+         * destroyed after the current loop iteration */
+        unwatch_idle();
     }
 
     static PoolConnInfo *from_llnode(lcb_list_t *node)
@@ -121,6 +147,14 @@ struct PoolConnInfo : lcbio_PROTOCTX, CinfoNode {
     lcbio_SOCKET *sock;
     lcbio_pCONNSTART cs;
     lcb::io::Timer< PoolConnInfo, &PoolConnInfo::on_idle_timeout > idle_timer;
+    /* watches the idle socket for a hangup (event model only). Only exists
+     * while the connection is idle */
+    void *event;
+    lcbio_pTABLE evio;
+    lcb_socket_t evfd; /* `sock` may already be cleared when unwatching */
+    /* the event loop ran since the socket became idle, and did not stop
+     * since, so the watcher would have noticed a hangup */
+    bool settled;
 
     enum State { PENDING, IDLE, LEASED };
     State state;
@@ -141,6 +175,12 @@ struct PoolRequest : ReqNode, ConnectionRequest {
     {
     }
 
+    /** Get a request from the cache of the pool, or allocate a new one */
+    static inline PoolRequest *create(PoolHost *host, lcbio_CONNDONE_cb cb, void *cbarg);
+
+    /** Return the request to the cache of the pool once it is finished */
+    inline void release();
+
     virtual ~PoolRequest() {}
     virtual void cancel();
     inline void invoke();
@@ -199,6 +239,7 @@ static const char *get_hehost(const PoolHost *h)
 PoolConnInfo::~PoolConnInfo()
 {
     idle_timer.release();
+    unwatch_idle();
     parent->n_total--;
     if (state == IDLE) {
         lcb_clist_delete(&parent->ll_idle, this);
@@ -219,12 +260,60 @@ PoolConnInfo::~PoolConnInfo()
 static void cinfo_protoctx_dtor(lcbio_PROTOCTX *ctx)
 {
     PoolConnInfo *info = reinterpret_cast< PoolConnInfo * >(ctx);
+    info->unwatch_idle();
     info->sock = NULL;
     delete info;
 }
 
 Pool::Pool(lcb_settings *settings_, lcbio_pTABLE io_) : settings(settings_), io(io_), refcount(1) {}
 
+Pool::~Pool()
+{
+    for (size_t ii = 0; ii < reqcache.size(); ii++) {
+        delete reqcache[ii];
+    }
+}
+
+/** Maximum number of finished requests kept by a pool for reuse */
+#define MAX_CACHED_REQUESTS 64
+
+PoolRequest *PoolRequest::create(PoolHost *host, lcbio_CONNDONE_cb cb, void *cbarg)
+{
+    std::vector< PoolRequest * > &cache = host->parent->reqcache;
+    PoolRequest *req;
+
+    if (cache.empty()) {
+        req = new PoolRequest(host, cb, cbarg);
+    } else {
+        req = cache.back();
+        cache.pop_back();
+        req->host = host;
+        req->callback = cb;
+        req->arg = cbarg;
+        req->state = PENDING;
+        req->sock = NULL;
+        req->err = LCB_SUCCESS;
+    }
+    /* the host must outlive its requests, since they are returned to its pool */
+    host->ref();
+    return req;
+}
+
+void PoolRequest::release()
+{
+    PoolHost *he = host;
+    Pool *pool = he->parent;
+
+    timer.cancel();
+    host = NULL;
+    if (pool && pool->reqcache.size() < MAX_CACHED_REQUESTS) {
+        pool->reqcache.push_back(this);
+    } else {
+        delete this;
+    }
+    he->unref();
+}
+
 typedef std::vector< PoolHost * > HeList;
 
 void Pool::ref()
@@ -242,10 +331,10 @@ void Pool::unref()
 void Pool::shutdown()
 {
     HeList hes;
-    HostMap::iterator h_it;
+    HostList::iterator h_it;
 
-    for (h_it = ht.begin(); h_it != ht.end(); ++h_it) {
-        PoolHost *he = h_it->second;
+    for (h_it = hosts.begin(); h_it != hosts.end(); ++h_it) {
+        PoolHost *he = *h_it;
 
         lcb_list_t *cur, *next;
         LCB_LIST_SAFE_FOR(cur, next, (lcb_list_t *)&he->ll_idle)
@@ -260,10 +349,12 @@ void Pool::shutdown()
         hes.push_back(he);
     }
 
+    hosts.clear();
     for (HeList::iterator it = hes.begin(); it != hes.end(); ++it) {
         PoolHost *he = *it;
-        ht.erase(he->key);
         he->async.release();
+        he->settle.release();
+        he->destroy_events();
         he->unref();
     }
 
@@ -285,18 +376,24 @@ static void endpointToJSON(hrtime_t now, Json::Value &node, const PoolHost *host
 
 void Pool::toJSON(hrtime_t now, Json::Value &node)
 {
-    lcbio_MGR::HostMap::const_iterator it;
-    for (it = ht.begin(); it != ht.end(); ++it) {
-        const PoolHost *host = it->second;
+    lcbio_MGR::HostList::const_iterator it;
+    for (it = hosts.begin(); it != hosts.end(); ++it) {
+        const PoolHost *host = *it;
         lcb_list_t *llcur;
+        Json::Value stats;
+        stats["remote"] = host->key;
+        stats["idle"] = (Json::Value::UInt64)host->num_idle();
+        stats["pending"] = (Json::Value::UInt64)host->num_pending();
+        stats["leased"] = (Json::Value::UInt64)host->num_leased();
+        stats["hits"] = (Json::Value::UInt64)host->n_hits;
+        stats["misses"] = (Json::Value::UInt64)host->n_misses;
+        stats["evictions"] = (Json::Value::UInt64)host->n_evicted;
+        node["pools"].append(stats);
         LCB_LIST_FOR(llcur, (lcb_list_t *)&host->ll_idle)
         {
             endpointToJSON(now, node, host, PoolConnInfo::from_llnode(llcur));
         }
-        LCB_LIST_FOR(llcur, (lcb_list_t *)&host->ll_pending)
-        {
-            endpointToJSON(now, node, host, PoolConnInfo::from_llnode(llcur));
-        }
+        /* pending entries have no socket yet, they are only counted above */
     }
 }
 
@@ -308,13 +405,14 @@ void PoolRequest::invoke()
         state = ASSIGNED;
         lcb_log(LOGARGS(info->parent->parent, DEBUG), HE_LOGFMT "Assigning R=%p SOCKET=%p", HE_LOGID(info->parent),
                 (void *)this, (void *)sock);
+        host->maybe_prewarm();
     }
 
     callback(sock, arg, err, 0);
     if (sock) {
         lcbio_unref(sock);
     }
-    delete this;
+    release();
 }
 
 /**
@@ -363,36 +461,86 @@ void PoolConnInfo::on_connected(lcbio_SOCKET *sock_, lcb_STATUS err)
         delete this;
 
     } else {
-        state = IDLE;
         sock = sock_;
         lcbio_ref(sock);
         lcbio_protoctx_add(sock, this);
 
-        lcb_clist_append(&parent->ll_idle, this);
-        idle_timer.rearm(parent->parent->options.maxidle);
+        set_idle();
         parent->connection_available();
     }
 }
 
+static void idle_event_cb(lcb_socket_t, short, void *arg)
+{
+    reinterpret_cast< PoolConnInfo * >(arg)->on_idle_event();
+}
+
+/**
+ * Nothing is expected from the peer while the connection is idle, so any
+ * input means the connection was closed (or is in an unknown state).
+ */
+void PoolConnInfo::on_idle_event()
+{
+    PoolHost *he = parent;
+    lcb_log(LOGARGS(he->parent, DEBUG), HE_LOGFMT "Pooled socket is dead or received unexpected data. Evicting I=%p",
+            HE_LOGID(he), (void *)this);
+    he->n_evicted++;
+    he->ref();
+    delete this;
+    he->maybe_prewarm();
+    he->unref();
+}
+
+void PoolConnInfo::watch_idle()
+{
+    lcbio_pTABLE iot = sock->io;
+    if (!iot->is_E()) {
+        /* a completion-model socket cannot be watched without a pending read.
+         * Pool::get() checks it instead */
+        return;
+    }
+    unwatch_idle();
+    event = iot->E_event_create();
+    evio = iot;
+    lcbio_table_ref(evio);
+    evfd = sock->u.fd;
+    iot->E_event_watch(evfd, event, LCB_READ_EVENT, this, idle_event_cb);
+    settled = false;
+    parent->settle.signal();
+}
+
+void PoolConnInfo::unwatch_idle()
+{
+    if (!event) {
+        return;
+    }
+    evio->E_event_cancel(evfd, event);
+    parent->dead_events.push_back(std::make_pair(evio, event));
+    parent->settle.signal();
+    event = NULL;
+    evio = NULL;
+}
+
+void PoolConnInfo::set_idle()
+{
+    state = IDLE;
+    lcb_clist_append(&parent->ll_idle, this);
+    idle_timer.rearm(parent->parent->options.tmoidle);
+    watch_idle();
+}
+
 PoolConnInfo::PoolConnInfo(PoolHost *he, uint32_t timeout)
-    : parent(he), sock(NULL), cs(NULL), idle_timer(he->parent->io, this), state(PENDING)
+    : parent(he), sock(NULL), cs(NULL), idle_timer(he->parent->io, this), event(NULL), evio(NULL), evfd(INVALID_SOCKET),
+      settled(false), state(PENDING)
 {
 
     // protoctx fields
     id = LCBIO_PROTOCTX_POOL;
     dtor = cinfo_protoctx_dtor;
 
-    lcb_host_t tmphost = {"", "", 0};
-    lcb_STATUS err = lcb_host_parsez(&tmphost, he->key.c_str(), 80);
-    if (err != LCB_SUCCESS) {
-        lcb_log(LOGARGS(he->parent, ERROR), HE_LOGFMT "Could not parse host! Will supply dummy host (I=%p)",
-                HE_LOGID(he), (void *)this);
-        strcpy(tmphost.host, "BADHOST");
-        strcpy(tmphost.port, "BADPORT");
-    }
     lcb_log(LOGARGS(he->parent, TRACE), HE_LOGFMT "New pool entry: I=%p", HE_LOGID(he), (void *)this);
 
-    cs = lcbio_connect(he->parent->io, he->parent->settings, &tmphost, timeout, ::on_connected, this);
+    cs = lcbio_connect(he->parent->io, he->parent->settings, &he->host, timeout, ::on_connected, this);
 }
 
 void PoolHost::start_new_connection(uint32_t tmo)
@@ -403,6 +551,63 @@ void PoolHost::start_new_connection(uint32_t tmo)
     refcount++;
 }
 
+void PoolHost::settle_idle()
+{
+    lcb_list_t *llcur;
+    LCB_LIST_FOR(llcur, (lcb_list_t *)&ll_idle)
+    {
+        PoolConnInfo::from_llnode(llcur)->settled = true;
+    }
+    destroy_events();
+}
+
+void PoolHost::destroy_events()
+{
+    for (size_t ii = 0; ii < dead_events.size(); ii++) {
+        lcbio_pTABLE iot = dead_events[ii].first;
+        iot->E_event_destroy(dead_events[ii].second);
+        lcbio_table_unref(iot);
+    }
+    dead_events.clear();
+}
+
+void Pool::loop_stopped()
+{
+    for (HostList::iterator it = hosts.begin(); it != hosts.end(); ++it) {
+        PoolHost *he = *it;
+        lcb_list_t *llcur;
+        /* a pending `settle` would vouch for the time the loop is stopped */
+        he->settle.cancel();
+        he->destroy_events();
+        LCB_LIST_FOR(llcur, (lcb_list_t *)&he->ll_idle)
+        {
+            PoolConnInfo::from_llnode(llcur)->settled = false;
+        }
+    }
+}
+
+unsigned PoolHost::min_idle() const
+{
+    const Pool::Options &options = parent->options;
+    return options.minidle < options.maxidle ? options.minidle : options.maxidle;
+}
+
+/** Open connections in the background, until there are `minidle` idle or connecting ones */
+void PoolHost::maybe_prewarm()
+{
+    if (!parent) {
+        return;
+    }
+    PoolHost *he = this;
+    unsigned target = min_idle();
+    unsigned maxtotal = parent->options.maxtotal;
+    while (num_idle() + num_pending() < target + num_requests() && (maxtotal == 0 || n_total < maxtotal)) {
+        lcb_log(LOGARGS(parent, DEBUG), HE_LOGFMT "Pre-connecting to keep %u idle connections", HE_LOGID(he),
+                target);
+        start_new_connection(tmoconnect);
+    }
+}
+
 void PoolRequest::timer_handler()
 {
     if (state == ASSIGNED) {
@@ -418,9 +623,15 @@ void PoolRequest::timer_handler()
     }
 }
 
-PoolHost::PoolHost(Pool *parent_, const std::string &key_)
-    : key(key_), parent(parent_), async(parent->io, this), n_total(0), refcount(1)
+PoolHost::PoolHost(Pool *parent_, const lcb_host_t &host_)
+    : host(host_), parent(parent_), async(parent->io, this), settle(parent->io, this), n_total(0), refcount(1),
+      tmoconnect(0), n_hits(0), n_misses(0), n_evicted(0)
 {
+    if (host.ipv6) {
+        key.append("[").append(host.host).append("]:").append(host.port);
+    } else {
+        key.append(host.host).append(":").append(host.port);
+    }
 
     lcb_clist_init(&ll_idle);
     lcb_clist_init(&ll_pending);
@@ -428,52 +639,55 @@ PoolHost::PoolHost(Pool *parent_, const std::string &key_)
     parent->ref();
 }
 
-ConnectionRequest *Pool::get(const lcb_host_t &dest, uint32_t timeout, lcbio_CONNDONE_cb cb, void *cbarg)
+PoolHost *Pool::find_host(const lcb_host_t &dest)
 {
-    PoolHost *he;
-    lcb_list_t *cur;
-
-    std::string key;
-    if (dest.ipv6) {
-        key.append("[").append(dest.host).append("]:").append(dest.port);
-    } else {
-        key.append(dest.host).append(":").append(dest.port);
+    for (HostList::iterator it = hosts.begin(); it != hosts.end(); ++it) {
+        PoolHost *he = *it;
+        if (he->host.ipv6 == dest.ipv6 && lcb_host_equals(&he->host, &dest)) {
+            return he;
+        }
     }
+    PoolHost *he = new PoolHost(this, dest);
+    hosts.push_back(he);
+    return he;
+}
 
-    HostMap::iterator m = ht.find(key);
-    if (m == ht.end()) {
-        he = new PoolHost(this, key);
-        ht.insert(std::make_pair(key, he));
-    } else {
-        he = m->second;
-    }
+ConnectionRequest *Pool::get(const lcb_host_t &dest, uint32_t timeout, lcbio_CONNDONE_cb cb, void *cbarg)
+{
+    PoolHost *he = find_host(dest);
+    lcb_list_t *cur;
 
-    PoolRequest *req = new PoolRequest(he, cb, cbarg);
+    PoolRequest *req = PoolRequest::create(he, cb, cbarg);
+    he->tmoconnect = timeout;
 
 GT_POPAGAIN:
 
     cur = lcb_clist_pop(&he->ll_idle);
     if (cur) {
-        int clstatus;
         PoolConnInfo *info = PoolConnInfo::from_llnode(cur);
 
-        clstatus = lcbio_is_netclosed(info->sock, LCB_IO_SOCKCHECK_PEND_IS_ERROR);
-
-        if (clstatus == LCB_IO_SOCKCHECK_STATUS_CLOSED) {
+        /* Idle sockets of event-based plugins are watched for hangups while
+         * in the pool. Others, and the ones which were not watched by a
+         * running loop since they were put back, need to be checked here */
+        if (!info->settled &&
+            lcbio_is_netclosed(info->sock, LCB_IO_SOCKCHECK_PEND_IS_ERROR) == LCB_IO_SOCKCHECK_STATUS_CLOSED) {
             lcb_log(LOGARGS(this, WARN), HE_LOGFMT "Pooled socket is dead. Continuing to next one", HE_LOGID(he));
 
             /* Set to LEASED, since it's not inside any of our lists */
             info->state = PoolConnInfo::LEASED;
+            he->n_evicted++;
             delete info;
             goto GT_POPAGAIN;
         }
 
+        he->n_hits++;
         req->set_ready(info);
         lcb_log(LOGARGS(this, DEBUG),
                 HE_LOGFMT "Found ready connection in pool. Reusing socket and not creating new connection",
                 HE_LOGID(he));
 
     } else {
+        he->n_misses++;
         req->set_pending(timeout);
 
         lcb_clist_append(&he->requests, req);
@@ -503,11 +717,16 @@ void PoolRequest::cancel()
         lcb_log(LOGARGS(mgr, DEBUG), HE_LOGFMT "Request=%p has no connection.. yet", HE_LOGID(host), (void *)this);
         lcb_clist_delete(&host->requests, this);
     }
-    delete this;
+    release();
 }
 
 void PoolConnInfo::on_idle_timeout()
 {
+    if (parent->num_idle() <= parent->min_idle()) {
+        /* keep the connection, unless there are more than `minidle` */
+        idle_timer.rearm(parent->parent->options.tmoidle);
+        return;
+    }
     lcb_log(LOGARGS(parent->parent, DEBUG), HE_LOGFMT "Idle connection expired", HE_LOGID(parent));
     lcbio_unref(sock);
 }
@@ -535,9 +754,7 @@ void Pool::put(lcbio_SOCKET *sock)
 
     lcb_log(LOGARGS(mgr, DEBUG), HE_LOGFMT "Placing socket back into the pool. I=%p,C=%p", HE_LOGID(he), (void *)info,
             (void *)sock);
-    info->idle_timer.rearm(mgr->options.tmoidle);
-    lcb_clist_append(&he->ll_idle, info);
-    info->state = PoolConnInfo::IDLE;
+    info->set_idle();
 }
 
 void Pool::discard(lcbio_SOCKET *sock)
@@ -610,8 +827,8 @@ void Pool::dump(FILE *out) const
     if (out == NULL) {
         out = stderr;
     }
-    HostMap::const_iterator ii;
-    for (ii = ht.begin(); ii != ht.end(); ++ii) {
-        ii->second->dump(out);
+    HostList::const_iterator ii;
+    for (ii = hosts.begin(); ii != hosts.end(); ++ii) {
+        (*ii)->dump(out);
     }
 }
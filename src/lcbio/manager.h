@@ -41,7 +41,7 @@
  */
 
 #ifdef __cplusplus
-#include <map>
+#include <vector>
 
 namespace lcb
 {
@@ -139,6 +139,13 @@ class Pool
 
     static bool is_from_pool(const lcbio_SOCKET *sock);
 
+    /**
+     * Must be called whenever the event loop stops. Idle sockets are not
+     * watched while it is stopped, so a hangup received in the meantime is
+     * only noticed by checking them again when they are leased.
+     */
+    void loop_stopped();
+
     /**
      * Dumps the connection manager state to stderr
      */
@@ -148,7 +155,7 @@ class Pool
     inline void unref();
 
     struct Options {
-        Options() : maxtotal(0), maxidle(0), tmoidle(0) {}
+        Options() : maxtotal(0), maxidle(0), minidle(0), tmoidle(0) {}
 
         /** Maximum *total* number of connections opened by the pool. If this
          * number is exceeded, the pool will black hole future requests until
@@ -161,6 +168,14 @@ class Pool
          */
         unsigned maxidle;
 
+        /**
+         * Minimum number of idle connections to keep around for each host
+         * once it has been used. Connections are opened in the background
+         * to replace the ones which are leased or closed. This is capped by
+         * `maxidle`
+         */
+        unsigned minidle;
+
         /**
          * The amount of time the pool should wait before closing idle
          * connections. In microseconds
@@ -185,8 +200,15 @@ class Pool
     friend struct PoolConnInfo;
     friend struct PoolHost;
 
-    typedef std::map< std::string, PoolHost * > HostMap;
-    HostMap ht;
+    ~Pool();
+    PoolHost *find_host(const lcb_host_t &);
+
+    /* There are only as many hosts as there are nodes, so a linear lookup
+     * (which does not need to format a key) is fastest */
+    typedef std::vector< PoolHost * > HostList;
+    HostList hosts;
+    /** Finished requests, kept for reuse */
+    std::vector< PoolRequest * > reqcache;
     lcb_settings *settings;
     lcbio_pTABLE io;
     Options options;
@@ -91,19 +91,110 @@ static INLINE lcbio_IOSTATUS lcbio_E_rdb_slurp(lcbio_CTX *ctx, rdb_IOROPE *ior)
     return LCBIO_IOERR;
 }
 
-static INLINE lcbio_IOSTATUS lcbio_E_rb_write(lcbio_CTX *ctx, ringbuffer_t *buf)
+/** Append `n` ringbuffer bytes starting `pos` bytes after its read head */
+static INLINE unsigned lcbio__erb_add_rb(const lcb_IOV *rbiov, unsigned pos, unsigned n, lcb_IOV *iov, unsigned niov,
+                                         unsigned maxiov)
 {
-    lcb_IOV iov[2] = {0};
+    unsigned ii;
+    for (ii = 0; ii < 2 && n && niov < maxiov; ii++) {
+        unsigned seglen = (unsigned)rbiov[ii].iov_len;
+        unsigned ncur;
+        if (pos >= seglen) {
+            pos -= seglen;
+            continue;
+        }
+        ncur = seglen - pos;
+        if (ncur > n) {
+            ncur = n;
+        }
+        iov[niov].iov_base = (char *)rbiov[ii].iov_base + pos;
+        iov[niov].iov_len = ncur;
+        niov++;
+        n -= ncur;
+        pos = 0;
+    }
+    return niov;
+}
+
+/**
+ * Fill `iov` with the pending output, interleaving the copied data with the
+ * referenced buffers. If there are more than `maxiov` segments, only the
+ * leading ones are returned.
+ */
+static INLINE unsigned lcbio__erb_get_iov(lcbio__EASYRB *erb, lcb_IOV *iov, unsigned maxiov)
+{
+    lcb_IOV rbiov[2] = {{0}};
+    const lcbio__OUTREF *ref;
+    unsigned pos = 0, niov = 0;
+
+    ringbuffer_get_iov(&erb->rb, RINGBUFFER_READ, rbiov);
+    for (ref = erb->refhead; ref && niov < maxiov; ref = ref->next) {
+        niov = lcbio__erb_add_rb(rbiov, pos, ref->offset - pos, iov, niov, maxiov);
+        pos = ref->offset;
+        if (niov < maxiov) {
+            iov[niov].iov_base = (void *)ref->buf;
+            iov[niov].iov_len = ref->nbuf;
+            niov++;
+        }
+    }
+    return lcbio__erb_add_rb(rbiov, pos, (unsigned)erb->rb.nbytes - pos, iov, niov, maxiov);
+}
+
+static INLINE void lcbio__erb_pop_ref(lcbio__EASYRB *erb)
+{
+    lcbio__OUTREF *ref = erb->refhead;
+    if (!(erb->refhead = ref->next)) {
+        erb->reftail = NULL;
+    }
+    erb->nrefs--;
+    erb->nrefbytes -= ref->nbuf;
+    if (ref->release) {
+        ref->release(ref->arg);
+    }
+    free(ref);
+}
+
+/** Consume `nw` bytes from the front of the output, releasing any buffers fully written */
+static INLINE void lcbio__erb_consumed(lcbio__EASYRB *erb, unsigned nw)
+{
+    while (nw) {
+        lcbio__OUTREF *ref = erb->refhead;
+        unsigned ncur;
+
+        if (ref == NULL || ref->offset) {
+            ncur = ref == NULL || ref->offset > nw ? nw : ref->offset;
+            ringbuffer_consumed(&erb->rb, ncur);
+            for (; ref; ref = ref->next) {
+                ref->offset -= ncur;
+            }
+        } else {
+            ncur = ref->nbuf > nw ? nw : ref->nbuf;
+            ref->buf += ncur;
+            ref->nbuf -= ncur;
+            erb->nrefbytes -= ncur;
+            if (!ref->nbuf) {
+                lcbio__erb_pop_ref(erb);
+            }
+        }
+        nw -= ncur;
+    }
+}
+
+/** Release all referenced buffers, whether written or not */
+static INLINE void lcbio__erb_release(lcbio__EASYRB *erb)
+{
+    while (erb->refhead) {
+        lcbio__erb_pop_ref(erb);
+    }
+}
+
+static INLINE lcbio_IOSTATUS lcbio_E_erb_write(lcbio_CTX *ctx, lcbio__EASYRB *erb)
+{
+    lcb_IOV iov[RWINL_IOVSIZE];
     lcb_ssize_t nw;
     lcbio_TABLE *iot = ctx->io;
-    while (buf->nbytes) {
-        unsigned niov;
-        ringbuffer_get_iov(buf, RINGBUFFER_READ, iov);
-#if RWINL_IOVSIZE < 2
-        niov = 1;
-#else
-        niov = iov[1].iov_len ? 2 : 1;
-#endif
+    while (LCBIO_EASYRB_NBYTES(erb)) {
+        unsigned niov = lcbio__erb_get_iov(erb, iov, RWINL_IOVSIZE);
         nw = IOT_V0IO(iot).sendv(IOT_ARG(iot), CTX_FD(ctx), iov, niov);
         if (nw == -1) {
             switch (IOT_ERRNO(iot)) {
@@ -117,7 +208,7 @@ static INLINE lcbio_IOSTATUS lcbio_E_rb_write(lcbio_CTX *ctx, ringbuffer_t *buf)
                     return LCBIO_IOERR;
             }
         }
-        if (nw) {
+        if (nw > 0) {
 #ifdef LCB_DUMP_PACKETS
             {
                 char *b64 = NULL;
@@ -127,7 +218,7 @@ static INLINE lcbio_IOSTATUS lcbio_E_rb_write(lcbio_CTX *ctx, ringbuffer_t *buf)
                 free(b64);
             }
 #endif
-            ringbuffer_consumed(buf, nw);
+            lcbio__erb_consumed(erb, (unsigned)nw);
             CTX_INCR_METRIC(ctx, bytes_sent, nw);
         }
     }
@@ -117,6 +117,34 @@ int lcbio_ssl_check(lcbio_SOCKET *sock);
 LCB_INTERNAL_API
 lcb_STATUS lcbio_ssl_get_error(lcbio_SOCKET *sock);
 
+/** @brief Directions of a connection which are handled by kernel TLS */
+typedef enum { LCBIO_KTLS_SEND = 0x01, LCBIO_KTLS_RECV = 0x02 } lcbio_KTLS;
+
+/**
+ * Check which directions of the connection were offloaded to the kernel.
+ * This is only ever the case with lcb_settings::ssl_ktls, and is known once
+ * the handshake is complete.
+ * @param sock the socket
+ * @return a mask of lcbio_KTLS flags, 0 if OpenSSL processes all records
+ */
+LCB_INTERNAL_API
+int lcbio_ssl_ktls(lcbio_SOCKET *sock);
+
+/** @brief Counters of the TLS session cache of an SSL context */
+typedef struct {
+    lcb_U64 hits;     /**< connections which offered a cached session */
+    lcb_U64 misses;   /**< connections without a (valid) cached session */
+    unsigned ncached; /**< number of endpoints with a cached session */
+} lcbio_SSLSESSIONSTATS;
+
+/**
+ * Get the counters of the TLS session cache. Sessions are cached per
+ * endpoint for up to lcb_settings::ssl_session_lifetime.
+ * @param ctx the context, may be NULL
+ * @param[out] stats the counters
+ */
+void lcbio_ssl_session_stats(lcbio_pSSLCTX ctx, lcbio_SSLSESSIONSTATS *stats);
+
 /**
  * @brief
  * Initialize any application-level globals needed for SSL support
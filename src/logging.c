@@ -164,6 +164,18 @@ void lcb_log(const struct lcb_settings_st *settings, const char *subsys, int sev
     va_end(ap);
 }
 
+LCB_INTERNAL_API
+int lcb_log_enabled(const struct lcb_settings_st *settings, int severity)
+{
+    if (!settings->logger || !settings->logger->callback) {
+        return 0;
+    }
+    if (settings->logger == lcb_console_logger) {
+        return severity >= console_logprocs.minlevel;
+    }
+    return 1;
+}
+
 LCB_INTERNAL_API
 void lcb_log_badconfig(const struct lcb_settings_st *settings, const char *subsys, int severity, const char *srcfile,
                        int srcline, const lcbvb_CONFIG *vbc, const char *origin_txt)
@@ -69,6 +69,14 @@ void lcb_log(const struct lcb_settings_st *settings, const char *subsys, int sev
 #endif
     ;
 
+/**
+ * Check whether a message of the given severity may be emitted. This is
+ * only known for the console logger, custom loggers are assumed to accept
+ * every severity.
+ */
+LCB_INTERNAL_API
+int lcb_log_enabled(const struct lcb_settings_st *settings, int severity);
+
 LCB_INTERNAL_API
 void lcb_log_badconfig(const struct lcb_settings_st *settings, const char *subsys, int severity, const char *srcfile,
                        int srcline, const struct lcbvb_CONFIG_st *vbc, const char *origin_txt);
@@ -20,6 +20,23 @@
 
 #include <snappy.h>
 #include <snappy-sinksource.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 
 class FragBufSource : public snappy::Source
 {
@@ -83,6 +100,96 @@ class FragBufSource : public snappy::Source
     unsigned int idx;
 };
 
+/* Number of evenly spaced windows which make up the sample */
+#define SAMPLE_NWINDOWS 4
+
+static size_t sample_bytes(const lcb_IOV *iov, unsigned niov, size_t total, size_t *hist)
+{
+    unsigned nwindows = SAMPLE_NWINDOWS, idx = 0;
+    size_t window = MCREQ_COMPRESS_SAMPLE / SAMPLE_NWINDOWS, pos = 0, nsampled = 0;
+
+    if (total <= MCREQ_COMPRESS_SAMPLE) {
+        nwindows = 1;
+        window = total;
+    }
+    for (unsigned ii = 0; ii < nwindows; ii++) {
+        size_t begin = total / nwindows * ii, left = window;
+        while (left && idx < niov) {
+            size_t len = iov[idx].iov_len;
+            if (begin >= pos + len) {
+                pos += len;
+                idx++;
+                continue;
+            }
+            const unsigned char *ptr = static_cast< const unsigned char * >(iov[idx].iov_base) + (begin - pos);
+            size_t n = std::min(left, pos + len - begin);
+            for (size_t jj = 0; jj < n; jj++) {
+                hist[ptr[jj]]++;
+            }
+            begin += n;
+            left -= n;
+            nsampled += n;
+        }
+    }
+    return nsampled;
+}
+
+int mcreq_compress_predict(const lcb_VALBUF *vbuf, lcb_SIZE nbytes, float min_ratio)
+{
+    size_t hist[256] = {0}, nsampled;
+
+    if (vbuf->vtype == LCB_KV_COPY || vbuf->vtype == LCB_KV_CONTIG) {
+        lcb_IOV iov;
+        iov.iov_base = const_cast< void * >(vbuf->u_buf.contig.bytes);
+        iov.iov_len = vbuf->u_buf.contig.nbytes;
+        nsampled = sample_bytes(&iov, 1, nbytes, hist);
+    } else {
+        nsampled = sample_bytes(vbuf->u_buf.multi.iov, vbuf->u_buf.multi.niov, nbytes, hist);
+    }
+    if (nsampled == 0) {
+        return 1;
+    }
+
+    /* Order-0 entropy in bits per byte. Snappy cannot do better than this
+     * unless the value repeats itself, and it is a small underestimate on a
+     * sample which is small compared to the alphabet, so a value is only
+     * skipped when it looks (almost) random. */
+    double entropy = 0;
+    for (unsigned ii = 0; ii < 256; ii++) {
+        if (hist[ii]) {
+            double p = (double)hist[ii] / nsampled;
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy / 8 <= min_ratio;
+}
+
+/* Buffer to compress up to `maxsize` bytes into. This is the scratch buffer of
+ * the queue if it may be large enough, otherwise `freeptr` is set to a
+ * temporary buffer which is returned */
+static char *compress_scratch(mc_PIPELINE *pl, size_t maxsize, char **freeptr)
+{
+    mc_CMDQUEUE *cq = pl->parent;
+
+    *freeptr = NULL;
+    if (cq == NULL || maxsize > MCREQ_COMPRESSBUF_MAX) {
+        *freeptr = static_cast< char * >(malloc(maxsize));
+        return *freeptr;
+    }
+    if (maxsize > cq->ncompbuf) {
+        size_t newsize = cq->ncompbuf ? cq->ncompbuf : 4096;
+        while (newsize < maxsize) {
+            newsize *= 2;
+        }
+        newsize = std::min(newsize, static_cast< size_t >(MCREQ_COMPRESSBUF_MAX));
+        /* no need to keep the contents */
+        free(cq->compbuf);
+        cq->compbuf = static_cast< char * >(malloc(newsize));
+        cq->ncompbuf = cq->compbuf ? newsize : 0;
+    }
+    return cq->compbuf;
+}
+
 int mcreq_compress_value(mc_PIPELINE *pl, mc_PACKET *pkt, const lcb_VALBUF *vbuf, lcb_settings *settings,
                          int *should_compress)
 {
@@ -121,33 +228,381 @@ int mcreq_compress_value(mc_PIPELINE *pl, mc_PACKET *pkt, const lcb_VALBUF *vbuf
             return -1;
     }
 
+    if (!mcreq_compress_predict(vbuf, origsize, settings->compress_min_ratio)) {
+        delete source;
+        MC_INCR_METRIC(pl, compress_skipped, 1);
+        *should_compress = 0;
+        mcreq_reserve_value(pl, pkt, vbuf);
+        return 0;
+    }
+
+    MC_INCR_METRIC(pl, compress_attempted, 1);
     maxsize = snappy::MaxCompressedLength(source->Available());
-    if (mcreq_reserve_value2(pl, pkt, maxsize) != LCB_SUCCESS) {
+    char *freeptr, *outbuf = compress_scratch(pl, maxsize, &freeptr);
+    if (outbuf == NULL) {
+        delete source;
         return -1;
     }
-    nb_SPAN *outspan = &pkt->u_value.single;
-    snappy::UncheckedByteArraySink sink(SPAN_BUFFER(outspan));
+    snappy::UncheckedByteArraySink sink(outbuf);
 
     Compress(source, &sink);
-    compsize = sink.CurrentDestination() - SPAN_BUFFER(outspan);
+    compsize = sink.CurrentDestination() - outbuf;
     delete source;
 
+    /* only now that the final size is known, take it from the pipeline */
     if (compsize == 0 || (((float)compsize / origsize) > settings->compress_min_ratio)) {
-        netbuf_mblock_release(&pl->nbmgr, outspan);
+        free(freeptr);
         *should_compress = 0;
         mcreq_reserve_value(pl, pkt, vbuf);
         return 0;
     }
+    if (mcreq_reserve_value2(pl, pkt, compsize) != LCB_SUCCESS) {
+        free(freeptr);
+        return -1;
+    }
+    memcpy(SPAN_BUFFER(&pkt->u_value.single), outbuf, compsize);
+    free(freeptr);
+    MC_INCR_METRIC(pl, compress_succeeded, 1);
+    return 0;
+}
+
+namespace
+{
+struct CompressJob {
+    enum State { PENDING, RUNNING, DONE };
+
+    mc_PIPELINE *pl;
+    mc_PACKET *pkt;
+    char *input;
+    size_t ninput;
+    /** Points into the span reserved for the value, `maxsize` bytes long */
+    char *output;
+    size_t maxsize;
+    size_t compsize;
+    float min_ratio;
+    State state;
+
+    void run()
+    {
+        snappy::ByteArraySource source(input, ninput);
+        snappy::UncheckedByteArraySink sink(output);
+        snappy::Compress(&source, &sink);
+        compsize = sink.CurrentDestination() - output;
+    }
+};
+} // namespace
+
+struct mc_compresspool_st {
+    std::mutex mutex;
+    /** Signalled when a job is queued, or the pool is stopping */
+    std::condition_variable work_cond;
+    /** Signalled when a job is done */
+    std::condition_variable done_cond;
+    /** PENDING jobs, in submission order */
+    std::deque< CompressJob * > queue;
+    /** All jobs which were not reaped yet. Only used by the submitting thread,
+     * while the `state` of each job is protected by `mutex` */
+    std::list< CompressJob * > jobs;
+    std::vector< std::thread > threads;
+    bool stopping;
+    /** Readable once a worker finished a job, see mcreq_compresspool_fd().
+     * Both are the same eventfd on Linux */
+    int notify_rd, notify_wr;
+    /** Whether `notify_rd` was made readable and not drained yet */
+    std::atomic< bool > notified;
+
+    void notify()
+    {
+#ifndef _WIN32
+        if (notify_wr != -1 && !notified.exchange(true)) {
+            uint64_t one = 1;
+            ssize_t rv;
+            do {
+                rv = write(notify_wr, &one, sizeof one);
+            } while (rv == -1 && errno == EINTR);
+        }
+#endif
+    }
+
+    /** Drain the notification. Done before looking for completed jobs, so
+     * that a job completing later notifies again */
+    void drain()
+    {
+#ifndef _WIN32
+        if (notify_rd != -1) {
+            uint64_t buf[8];
+            while (read(notify_rd, buf, sizeof buf) > 0) {
+            }
+            notified = false;
+        }
+#endif
+    }
+
+    void work()
+    {
+        std::unique_lock< std::mutex > lock(mutex);
+        while (true) {
+            work_cond.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            CompressJob *job = queue.front();
+            queue.pop_front();
+            job->state = CompressJob::RUNNING;
+            lock.unlock();
+            job->run();
+            lock.lock();
+            job->state = CompressJob::DONE;
+            done_cond.notify_all();
+            lock.unlock();
+            notify();
+            lock.lock();
+        }
+    }
+
+    /** Make sure `job` is done, running it here if no worker picked it yet */
+    void finish(CompressJob *job, std::unique_lock< std::mutex > &lock)
+    {
+        if (job->state == CompressJob::PENDING) {
+            queue.erase(std::find(queue.begin(), queue.end(), job));
+            job->state = CompressJob::RUNNING;
+            lock.unlock();
+            job->run();
+            lock.lock();
+            job->state = CompressJob::DONE;
+        }
+        done_cond.wait(lock, [job] { return job->state == CompressJob::DONE; });
+    }
+};
+
+mc_COMPRESSPOOL *mcreq_compresspool_new(unsigned nthreads)
+{
+    mc_COMPRESSPOOL *pool = new mc_COMPRESSPOOL();
+    pool->stopping = false;
+    pool->notify_rd = pool->notify_wr = -1;
+    pool->notified = false;
+#if defined(__linux__)
+    pool->notify_rd = pool->notify_wr = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#elif !defined(_WIN32)
+    int fds[2];
+    if (pipe(fds) == 0) {
+        for (int ii = 0; ii < 2; ii++) {
+            fcntl(fds[ii], F_SETFL, fcntl(fds[ii], F_GETFL) | O_NONBLOCK);
+            fcntl(fds[ii], F_SETFD, FD_CLOEXEC);
+        }
+        pool->notify_rd = fds[0];
+        pool->notify_wr = fds[1];
+    }
+#endif
+    for (unsigned ii = 0; ii < std::max(nthreads, 1u); ii++) {
+        pool->threads.push_back(std::thread(&mc_COMPRESSPOOL::work, pool));
+    }
+    return pool;
+}
+
+void mcreq_compresspool_free(mc_COMPRESSPOOL *pool)
+{
+    {
+        std::lock_guard< std::mutex > lock(pool->mutex);
+        pool->stopping = true;
+        pool->work_cond.notify_all();
+    }
+    for (size_t ii = 0; ii < pool->threads.size(); ii++) {
+        pool->threads[ii].join();
+    }
+    for (std::list< CompressJob * >::iterator it = pool->jobs.begin(); it != pool->jobs.end(); ++it) {
+        free((*it)->input);
+        delete *it;
+    }
+#ifndef _WIN32
+    if (pool->notify_rd != -1) {
+        close(pool->notify_rd);
+    }
+    if (pool->notify_wr != -1 && pool->notify_wr != pool->notify_rd) {
+        close(pool->notify_wr);
+    }
+#endif
+    delete pool;
+}
+
+int mcreq_compresspool_fd(mc_COMPRESSPOOL *pool)
+{
+    return pool->notify_rd;
+}
 
-    if (compsize < maxsize) {
-        /* chop off some bytes? */
+int mcreq_compress_value_async(mc_COMPRESSPOOL *pool, mc_PIPELINE *pl, mc_PACKET *pkt, const lcb_VALBUF *vbuf,
+                               lcb_settings *settings, int *should_compress)
+{
+    size_t origsize = 0;
+
+    switch (vbuf->vtype) {
+        case LCB_KV_COPY:
+        case LCB_KV_CONTIG:
+            origsize = vbuf->u_buf.contig.nbytes;
+            break;
+
+        case LCB_KV_IOV:
+        case LCB_KV_IOVCOPY:
+            origsize = vbuf->u_buf.multi.total_length;
+            if (origsize == 0) {
+                for (unsigned int ii = 0; ii < vbuf->u_buf.multi.niov; ii++) {
+                    origsize += vbuf->u_buf.multi.iov[ii].iov_len;
+                }
+            }
+            break;
+
+        default:
+            return -1;
+    }
+
+    if (origsize == 0 || origsize < settings->compress_min_size) {
+        *should_compress = 0;
+        mcreq_reserve_value(pl, pkt, vbuf);
+        return 0;
+    }
+    if (!mcreq_compress_predict(vbuf, origsize, settings->compress_min_ratio)) {
+        MC_INCR_METRIC(pl, compress_skipped, 1);
+        *should_compress = 0;
+        mcreq_reserve_value(pl, pkt, vbuf);
+        return 0;
+    }
+
+    /* the caller's buffer is only valid for the duration of the call */
+    char *input = static_cast< char * >(malloc(origsize));
+    if (input == NULL) {
+        return -1;
+    }
+    if (vbuf->vtype == LCB_KV_COPY || vbuf->vtype == LCB_KV_CONTIG) {
+        memcpy(input, vbuf->u_buf.contig.bytes, origsize);
+    } else {
+        size_t offset = 0;
+        for (unsigned int ii = 0; ii < vbuf->u_buf.multi.niov && offset < origsize; ii++) {
+            size_t n = std::min(static_cast< size_t >(vbuf->u_buf.multi.iov[ii].iov_len), origsize - offset);
+            memcpy(input + offset, vbuf->u_buf.multi.iov[ii].iov_base, n);
+            offset += n;
+        }
+    }
+
+    /* an uncompressible value is copied into the same span, which is larger */
+    size_t maxsize = snappy::MaxCompressedLength(origsize);
+    if (mcreq_reserve_value2(pl, pkt, maxsize) != LCB_SUCCESS) {
+        free(input);
+        return -1;
+    }
+
+    CompressJob *job = new CompressJob();
+    job->pl = pl;
+    job->pkt = pkt;
+    job->input = input;
+    job->ninput = origsize;
+    job->output = SPAN_BUFFER(&pkt->u_value.single);
+    job->maxsize = maxsize;
+    job->compsize = 0;
+    job->min_ratio = settings->compress_min_ratio;
+    job->state = CompressJob::PENDING;
+    pkt->flags |= MCREQ_F_PREPARING;
+    MC_INCR_METRIC(pl, compress_attempted, 1);
+
+    pool->jobs.push_back(job);
+    {
+        std::lock_guard< std::mutex > lock(pool->mutex);
+        pool->queue.push_back(job);
+        pool->work_cond.notify_one();
+    }
+    *should_compress = 1;
+    return 0;
+}
+
+/* Fix up the packet of a finished job. Returns the number of packets enqueued */
+static unsigned complete_job(CompressJob *job)
+{
+    mc_PIPELINE *pl = job->pl;
+    mc_PACKET *pkt = job->pkt;
+    nb_SPAN *outspan = &pkt->u_value.single;
+    size_t oldsize = mcreq_get_size(pkt), nvalue;
+    protocol_binary_request_header hdr;
+
+    mcreq_read_hdr(pkt, &hdr);
+    if (job->compsize == 0 || (((float)job->compsize / job->ninput) > job->min_ratio)) {
+        memcpy(job->output, job->input, job->ninput);
+        nvalue = job->ninput;
+        hdr.request.datatype &= ~PROTOCOL_BINARY_DATATYPE_COMPRESSED;
+    } else {
+        nvalue = job->compsize;
+        MC_INCR_METRIC(pl, compress_succeeded, 1);
+    }
+    if (nvalue < job->maxsize) {
         nb_SPAN trailspan = *outspan;
-        trailspan.offset += compsize;
-        trailspan.size = maxsize - compsize;
+        trailspan.offset += nvalue;
+        trailspan.size = job->maxsize - nvalue;
         netbuf_mblock_release(&pl->nbmgr, &trailspan);
-        outspan->size = compsize;
+        outspan->size = nvalue;
+    }
+    hdr.request.bodylen = htonl(ntohl(hdr.request.bodylen) - job->maxsize + nvalue);
+    mcreq_write_hdr(pkt, &hdr);
+
+    free(job->input);
+    delete job;
+    return mcreq_packet_prepared(pl, pkt, oldsize);
+}
+
+unsigned mcreq_compresspool_reap(mc_COMPRESSPOOL *pool, mc_PIPELINE *pl, int wait)
+{
+    std::vector< CompressJob * > done;
+    pool->drain();
+    {
+        std::unique_lock< std::mutex > lock(pool->mutex);
+        std::list< CompressJob * >::iterator it = pool->jobs.begin();
+        while (it != pool->jobs.end()) {
+            CompressJob *job = *it;
+            if (wait && (pl == NULL || job->pl == pl)) {
+                pool->finish(job, lock);
+            } else if (wait || job->state != CompressJob::DONE) {
+                ++it;
+                continue;
+            }
+            done.push_back(job);
+            it = pool->jobs.erase(it);
+        }
+    }
+
+    std::vector< mc_PIPELINE * > flush;
+    for (size_t ii = 0; ii < done.size(); ii++) {
+        mc_PIPELINE *jobpl = done[ii]->pl;
+        if (complete_job(done[ii]) && !wait && std::find(flush.begin(), flush.end(), jobpl) == flush.end()) {
+            flush.push_back(jobpl);
+        }
+    }
+    for (size_t ii = 0; ii < flush.size(); ii++) {
+        if (flush[ii]->flush_start) {
+            flush[ii]->flush_start(flush[ii]);
+        }
+    }
+    return pool->jobs.size();
+}
+
+void mcreq_compresspool_cancel(mc_COMPRESSPOOL *pool, mc_PACKET *pkt)
+{
+    for (std::list< CompressJob * >::iterator it = pool->jobs.begin(); it != pool->jobs.end(); ++it) {
+        CompressJob *job = *it;
+        if (job->pkt != pkt) {
+            continue;
+        }
+        {
+            std::unique_lock< std::mutex > lock(pool->mutex);
+            if (job->state == CompressJob::PENDING) {
+                /* the value is not needed anymore, don't compress it */
+                pool->queue.erase(std::find(pool->queue.begin(), pool->queue.end(), job));
+            } else {
+                pool->done_cond.wait(lock, [job] { return job->state == CompressJob::DONE; });
+            }
+        }
+        pool->jobs.erase(it);
+        pkt->flags &= ~MCREQ_F_PREPARING;
+        free(job->input);
+        delete job;
+        return;
     }
-    return 0;
 }
 
 int mcreq_inflate_value(const void *compressed, lcb_SIZE ncompressed, const void **bytes, lcb_SIZE *nbytes,
@@ -169,3 +624,56 @@ int mcreq_inflate_value(const void *compressed, lcb_SIZE ncompressed, const void
     *nbytes = compsize;
     return 0;
 }
+
+int mcreq_inflate_value_scratch(mc_INFLATEBUF *ib, const void *compressed, lcb_SIZE ncompressed, const void **bytes,
+                                lcb_SIZE *nbytes, void **freeptr)
+{
+    size_t compsize = 0;
+
+    if (!snappy::GetUncompressedLength(static_cast< const char * >(compressed), (size_t)ncompressed, &compsize)) {
+        return -1;
+    }
+    /* a nested callback may still be using the buffer */
+    if (ib->inuse || compsize > MCREQ_INFLATEBUF_MAX) {
+        return mcreq_inflate_value(compressed, ncompressed, bytes, nbytes, freeptr);
+    }
+    if (compsize > ib->size) {
+        /* grow in powers of two, so that the buffer settles quickly */
+        lcb_SIZE newsize = ib->size ? ib->size : 4096;
+        char *newbuf;
+        while (newsize < compsize) {
+            newsize *= 2;
+        }
+        if (newsize > MCREQ_INFLATEBUF_MAX) {
+            newsize = MCREQ_INFLATEBUF_MAX;
+        }
+        newbuf = static_cast< char * >(realloc(ib->buf, newsize));
+        if (newbuf == NULL) {
+            return mcreq_inflate_value(compressed, ncompressed, bytes, nbytes, freeptr);
+        }
+        ib->buf = newbuf;
+        ib->size = newsize;
+    }
+    if (!snappy::RawUncompress(static_cast< const char * >(compressed), ncompressed, ib->buf)) {
+        return -1;
+    }
+    ib->inuse = 1;
+    *bytes = ib->buf;
+    *nbytes = compsize;
+    return 0;
+}
+
+void mcreq_inflatebuf_release(mc_INFLATEBUF *ib, const void *bytes)
+{
+    if (ib->inuse && bytes == ib->buf) {
+        ib->inuse = 0;
+    }
+}
+
+void mcreq_inflatebuf_cleanup(mc_INFLATEBUF *ib)
+{
+    free(ib->buf);
+    ib->buf = NULL;
+    ib->size = 0;
+    ib->inuse = 0;
+}
@@ -24,8 +24,13 @@
 extern "C" {
 #endif
 
+/** Largest scratch buffer kept by mc_CMDQUEUE for mcreq_compress_value() */
+#define MCREQ_COMPRESSBUF_MAX (1024 * 1024)
+
 /**
- * Stores a compressed payload into a packet
+ * Stores a compressed payload into a packet. The value is compressed into
+ * a scratch buffer first, so that only its final size is reserved from the
+ * pipeline's buffers
  * @param pl The pipeline which hosts the packet
  * @param pkt The packet which hosts the value
  * @param vbuf The user input to be compressed
@@ -36,6 +41,77 @@ extern "C" {
 int mcreq_compress_value(mc_PIPELINE *pl, mc_PACKET *pkt, const lcb_VALBUF *vbuf, lcb_settings *settings,
                          int *should_compress);
 
+/** Maximum number of bytes of a value examined by mcreq_compress_predict() */
+#define MCREQ_COMPRESS_SAMPLE 1024
+
+/**
+ * Cheaply guess whether compressing a value is worth it, by estimating the
+ * entropy of a few windows spread over the value. Payloads which are already
+ * compressed or encrypted look random and are predicted not to compress.
+ * @param vbuf The user input to be compressed
+ * @param nbytes Total size of the value
+ * @param min_ratio The largest compressed/original ratio which is accepted
+ * @return nonzero if the value is expected to reach `min_ratio`
+ */
+int mcreq_compress_predict(const lcb_VALBUF *vbuf, lcb_SIZE nbytes, float min_ratio);
+
+/** Pool of threads compressing values in the background */
+typedef struct mc_compresspool_st mc_COMPRESSPOOL;
+
+/**
+ * Start a pool of compression threads
+ * @param nthreads number of threads, at least one is started
+ */
+mc_COMPRESSPOOL *mcreq_compresspool_new(unsigned nthreads);
+
+/**
+ * Stop the threads and free the pool. There must not be any outstanding
+ * jobs, see mcreq_compresspool_reap().
+ */
+void mcreq_compresspool_free(mc_COMPRESSPOOL *pool);
+
+/**
+ * Descriptor which becomes readable once a worker finished a job, i.e. when
+ * mcreq_compresspool_reap() has something to complete. It is drained by
+ * mcreq_compresspool_reap().
+ * @return the descriptor, or -1 if the platform has none, in which case the
+ * pool must be polled
+ */
+int mcreq_compresspool_fd(mc_COMPRESSPOOL *pool);
+
+/**
+ * Like mcreq_compress_value(), but let a worker thread of `pool` compress the
+ * value. The input is copied and buffer space for the worst case is reserved
+ * in the packet, which is flagged with MCREQ_F_PREPARING. The header may be
+ * written as if the value had the reserved size: it is fixed up, and the
+ * packet enqueued, by mcreq_compresspool_reap() once compression completes.
+ *
+ * Values which are not predicted to compress are reserved as-is, in which
+ * case `should_compress` is set to zero and the packet is ready immediately.
+ * @return 0 if successful, nonzero on error.
+ */
+int mcreq_compress_value_async(mc_COMPRESSPOOL *pool, mc_PIPELINE *pl, mc_PACKET *pkt, const lcb_VALBUF *vbuf,
+                               lcb_settings *settings, int *should_compress);
+
+/**
+ * Complete the packets whose values were compressed by the workers, and start
+ * flushing their pipelines. Must be called from the thread which submits
+ * the jobs.
+ * @param pool the pool
+ * @param pl if `wait` is set, only complete (and do not flush) the jobs of
+ * this pipeline, or of all pipelines if NULL
+ * @param wait whether to wait for jobs which are not done yet
+ * @return the number of jobs which are still outstanding
+ */
+unsigned mcreq_compresspool_reap(mc_COMPRESSPOOL *pool, mc_PIPELINE *pl, int wait);
+
+/**
+ * Abandon the job of a MCREQ_F_PREPARING packet which is about to be
+ * released, waiting for a worker which may be compressing it. A job which
+ * was not started yet is dropped without compressing the value.
+ */
+void mcreq_compresspool_cancel(mc_COMPRESSPOOL *pool, mc_PACKET *pkt);
+
 /**
  * Inflate a compressed value
  * @param compressed The value to inflate
@@ -50,6 +126,42 @@ int mcreq_compress_value(mc_PIPELINE *pl, mc_PACKET *pkt, const lcb_VALBUF *vbuf
 int mcreq_inflate_value(const void *compressed, lcb_SIZE ncompressed, const void **bytes, lcb_SIZE *nbytes,
                         void **freeptr);
 
+/** Largest buffer kept by mc_INFLATEBUF; bigger values get their own allocation */
+#define MCREQ_INFLATEBUF_MAX (1024 * 1024)
+
+/**
+ * Scratch space for inflating values which are only needed for the duration
+ * of a callback, so that the same memory is used for every response rather
+ * than allocating a buffer for each of them.
+ */
+typedef struct {
+    char *buf;     /**< Buffer, grows up to MCREQ_INFLATEBUF_MAX */
+    lcb_SIZE size; /**< Allocated size of `buf` */
+    int inuse;     /**< Whether `buf` holds a value which is still referenced */
+} mc_INFLATEBUF;
+
+/**
+ * Like mcreq_inflate_value(), but inflate into the scratch buffer when it is
+ * large enough (or may grow enough) and not already in use.
+ * @param ib the scratch buffer
+ * @param[in/out] freeptr Pointer initialized to NULL, which remains NULL if the
+ * value was inflated into `ib`.
+ * @note Call mcreq_inflatebuf_release() with the returned `bytes` once the
+ * value is not needed anymore, before freeing `freeptr`.
+ */
+int mcreq_inflate_value_scratch(mc_INFLATEBUF *ib, const void *compressed, lcb_SIZE ncompressed, const void **bytes,
+                                lcb_SIZE *nbytes, void **freeptr);
+
+/**
+ * Make the scratch buffer available again if it holds `bytes`
+ * @param ib the scratch buffer
+ * @param bytes the value which is no longer used (may point anywhere)
+ */
+void mcreq_inflatebuf_release(mc_INFLATEBUF *ib, const void *bytes);
+
+/** Free the memory held by the scratch buffer */
+void mcreq_inflatebuf_cleanup(mc_INFLATEBUF *ib);
+
 #ifdef __cplusplus
 }
 #endif
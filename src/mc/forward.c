@@ -108,7 +108,7 @@ lcb_STATUS mc_forward_packet(mc_CMDQUEUE *cq, mc_IOVINFO *info, mc_PACKET **pkt_
         if (srvix < 0 || (unsigned)srvix >= cq->npipelines) {
             return LCB_ERR_NO_MATCHING_SERVER;
         }
-        pl = cq->pipelines[srvix];
+        pl = mcreq_pipeline_lane(cq->pipelines[srvix], vbid);
         hdr.request.vbucket = htons(vbid);
 
     } else {
@@ -116,7 +116,10 @@ lcb_STATUS mc_forward_packet(mc_CMDQUEUE *cq, mc_IOVINFO *info, mc_PACKET **pkt_
         if (!pl) {
             return LCB_ERR_INVALID_ARGUMENT;
         }
-        srvix = pl->index;
+        /* The caller picked the node, the connection is picked here */
+        if (pl->index >= 0 && (unsigned)pl->index < cq->npipelines) {
+            pl = mcreq_pipeline_lane(cq->pipelines[pl->index], ntohs(hdr.request.vbucket));
+        }
     }
 
     pkt = mcreq_allocate_packet(pl);
@@ -232,6 +232,32 @@ static int pkt_tmo_compar(sllist_node *a, sllist_node *b)
     }
 }
 
+/**
+ * Account for a packet which was scheduled (`delta` is 1) or completed
+ * (`delta` is -1) on the pipeline.
+ */
+static void pipeline_track(mc_PIPELINE *pipeline, const mc_PACKET *packet, int delta)
+{
+    size_t size = mcreq_get_size(packet);
+    if (delta > 0) {
+        pipeline->nbytes_pending += size;
+    } else {
+        pipeline->nbytes_pending -= size < pipeline->nbytes_pending ? size : pipeline->nbytes_pending;
+    }
+
+    if (pipeline->vbpending) {
+        uint16_t vbid = mcreq_get_vbucket(packet);
+        if (vbid >= pipeline->nvb) {
+            return;
+        }
+        if (delta > 0) {
+            pipeline->vbpending[vbid]++;
+        } else if (pipeline->vbpending[vbid]) {
+            pipeline->vbpending[vbid]--;
+        }
+    }
+}
+
 void mcreq_reenqueue_packet(mc_PIPELINE *pipeline, mc_PACKET *packet)
 {
     sllist_root *reqs = &pipeline->requests;
@@ -240,7 +266,7 @@ void mcreq_reenqueue_packet(mc_PIPELINE *pipeline, mc_PACKET *packet)
     sllist_insert_sorted(reqs, &packet->slnode, pkt_tmo_compar);
 }
 
-void mcreq_enqueue_packet(mc_PIPELINE *pipeline, mc_PACKET *packet)
+static void enqueue_packet(mc_PIPELINE *pipeline, mc_PACKET *packet)
 {
     nb_SPAN *vspan = &packet->u_value.single;
     sllist_append(&pipeline->requests, &packet->slnode);
@@ -269,6 +295,40 @@ GT_ENQUEUE_PDU:
     MC_INCR_METRIC(pipeline, packets_queued, 1);
 }
 
+void mcreq_enqueue_packet(mc_PIPELINE *pipeline, mc_PACKET *packet)
+{
+    pipeline_track(pipeline, packet, 1);
+    enqueue_packet(pipeline, packet);
+}
+
+/* Enqueue the held packets up to the next one which is still being prepared */
+static unsigned pipeline_release_held(mc_PIPELINE *pipeline)
+{
+    unsigned count = 0;
+    while (!SLLIST_IS_EMPTY(&pipeline->held)) {
+        mc_PACKET *pkt = SLLIST_ITEM(SLLIST_FIRST(&pipeline->held), mc_PACKET, slnode);
+        if (pkt->flags & MCREQ_F_PREPARING) {
+            break;
+        }
+        sllist_remove_head(&pipeline->held);
+        enqueue_packet(pipeline, pkt);
+        count++;
+    }
+    return count;
+}
+
+unsigned mcreq_packet_prepared(mc_PIPELINE *pipeline, mc_PACKET *packet, size_t oldsize)
+{
+    size_t shrunk = oldsize - mcreq_get_size(packet);
+
+    packet->flags &= ~MCREQ_F_PREPARING;
+    pipeline->nbytes_pending -= shrunk < pipeline->nbytes_pending ? shrunk : pipeline->nbytes_pending;
+
+    /* the packet may still be in the scheduling context, in which case it is
+     * simply enqueued when leaving it */
+    return pipeline_release_held(pipeline);
+}
+
 void mcreq_wipe_packet(mc_PIPELINE *pipeline, mc_PACKET *packet)
 {
     if (!(packet->flags & MCREQ_F_KEY_NOCOPY)) {
@@ -496,7 +556,7 @@ lcb_STATUS mcreq_basic_packet(mc_CMDQUEUE *queue, const lcb_CMDBASE *cmd, protoc
 
     mcreq_map_key(queue, &cmd->key, sizeof(*req) + extlen + ffextlen, &vb, &srvix);
     if (srvix > -1 && srvix < (int)queue->npipelines) {
-        *pipeline = queue->pipelines[srvix];
+        *pipeline = mcreq_pipeline_lane(queue->pipelines[srvix], vb);
 
     } else {
         if ((options & MCREQ_BASICPACKET_F_FALLBACKOK) && queue->fallback) {
@@ -670,6 +730,11 @@ void mcreq_pipeline_cleanup(mc_PIPELINE *pipeline)
 {
     netbuf_cleanup(&pipeline->nbmgr);
     netbuf_cleanup(&pipeline->reqpool);
+    free(pipeline->vblanes);
+    free(pipeline->vbpending);
+    pipeline->vblanes = NULL;
+    pipeline->vbpending = NULL;
+    pipeline->nvb = 0;
 }
 
 int mcreq_pipeline_init(mc_PIPELINE *pipeline)
@@ -682,6 +747,7 @@ int mcreq_pipeline_init(mc_PIPELINE *pipeline)
     pipeline->flush_start = NULL;
     pipeline->index = 0;
     memset(&pipeline->ctxqueued, 0, sizeof pipeline->ctxqueued);
+    memset(&pipeline->held, 0, sizeof pipeline->held);
     pipeline->buf_done_callback = NULL;
 
     netbuf_default_settings(&settings);
@@ -694,33 +760,104 @@ int mcreq_pipeline_init(mc_PIPELINE *pipeline)
     netbuf_init(&pipeline->reqpool, &settings);
     ;
     pipeline->metrics = NULL;
+    pipeline->qpos = 0;
+    pipeline->lanes = NULL;
+    pipeline->nlanes = 0;
+    pipeline->vblanes = NULL;
+    pipeline->vbpending = NULL;
+    pipeline->nvb = 0;
+    pipeline->nbytes_pending = 0;
     return 0;
 }
 
+/** Allocate the per-vBucket state of a pipeline and its lanes, unless the number of vBuckets did not change */
+static void pipeline_resize_vbuckets(mc_PIPELINE *pipeline, unsigned nvb)
+{
+    unsigned ii;
+
+    if (pipeline->nvb == nvb) {
+        return;
+    }
+    free(pipeline->vblanes);
+    pipeline->vblanes = nvb ? calloc(nvb, sizeof(*pipeline->vblanes)) : NULL;
+    for (ii = 0; ii < pipeline->nlanes; ii++) {
+        mc_PIPELINE *lane = pipeline->lanes[ii];
+        free(lane->vbpending);
+        lane->vbpending = nvb ? calloc(nvb, sizeof(*lane->vbpending)) : NULL;
+        lane->nvb = nvb;
+    }
+}
+
+mc_PIPELINE *mcreq_pipeline_lane(mc_PIPELINE *pipeline, int vbid)
+{
+    mc_PIPELINE *cur, *best;
+    unsigned ii, bestix;
+
+    if (pipeline->nlanes < 2 || vbid < 0 || (unsigned)vbid >= pipeline->nvb) {
+        return pipeline;
+    }
+
+    bestix = pipeline->vblanes[vbid];
+    cur = best = pipeline->lanes[bestix];
+    if (cur->vbpending[vbid]) {
+        /* keep the order of the operations for this vBucket */
+        return cur;
+    }
+    for (ii = 0; ii < pipeline->nlanes; ii++) {
+        mc_PIPELINE *lane = pipeline->lanes[ii];
+        if (lane->nbytes_pending < best->nbytes_pending) {
+            best = lane;
+            bestix = ii;
+        }
+    }
+    pipeline->vblanes[vbid] = (uint8_t)bestix;
+    return best;
+}
+
 void mcreq_queue_add_pipelines(mc_CMDQUEUE *queue, mc_PIPELINE *const *pipelines, unsigned npipelines,
                                lcbvb_CONFIG *config)
 {
-    unsigned ii;
+    unsigned ii, jj, nlanes = npipelines;
 
     lcb_assert(queue->pipelines == NULL);
+    for (ii = 0; ii < npipelines; ii++) {
+        if (pipelines[ii]->nlanes > 1) {
+            nlanes += pipelines[ii]->nlanes - 1;
+        }
+    }
     queue->npipelines = npipelines;
-    queue->_npipelines_ex = queue->npipelines;
-    queue->pipelines = malloc(sizeof(*pipelines) * (npipelines + 1));
+    queue->nlanes = nlanes;
+    queue->_npipelines_ex = nlanes;
+    queue->pipelines = malloc(sizeof(*pipelines) * (nlanes + 1));
     queue->config = config;
 
     memcpy(queue->pipelines, pipelines, sizeof(*pipelines) * npipelines);
 
     free(queue->scheds);
-    queue->scheds = calloc(npipelines + 1, 1);
-
-    for (ii = 0; ii < npipelines; ii++) {
-        pipelines[ii]->parent = queue;
-        pipelines[ii]->index = ii;
+    queue->scheds = calloc(nlanes + 1, 1);
+
+    for (ii = 0, nlanes = npipelines; ii < npipelines; ii++) {
+        mc_PIPELINE *pipeline = pipelines[ii];
+        pipeline->parent = queue;
+        pipeline->index = ii;
+        pipeline->qpos = ii;
+        if (pipeline->nlanes < 2) {
+            continue;
+        }
+        for (jj = 1; jj < pipeline->nlanes; jj++) {
+            mc_PIPELINE *lane = pipeline->lanes[jj];
+            lane->parent = queue;
+            lane->index = ii;
+            lane->qpos = nlanes;
+            queue->pipelines[nlanes++] = lane;
+        }
+        pipeline_resize_vbuckets(pipeline, config ? (unsigned)config->nvb : 0);
     }
 
     if (queue->fallback) {
         queue->fallback->index = npipelines;
-        queue->pipelines[queue->npipelines] = queue->fallback;
+        queue->fallback->qpos = nlanes;
+        queue->pipelines[nlanes] = queue->fallback;
         queue->_npipelines_ex++;
     }
 }
@@ -731,6 +868,7 @@ mc_PIPELINE **mcreq_queue_take_pipelines(mc_CMDQUEUE *queue, unsigned *count)
     *count = queue->npipelines;
     queue->pipelines = NULL;
     queue->npipelines = 0;
+    queue->nlanes = 0;
     return ret;
 }
 
@@ -741,11 +879,22 @@ int mcreq_queue_init(mc_CMDQUEUE *queue)
     queue->scheds = NULL;
     queue->fallback = NULL;
     queue->npipelines = 0;
+    queue->nlanes = 0;
+    queue->cpool = NULL;
+    queue->compbuf = NULL;
+    queue->ncompbuf = 0;
     return 0;
 }
 
 void mcreq_queue_cleanup(mc_CMDQUEUE *queue)
 {
+    if (queue->cpool) {
+        mcreq_compresspool_free(queue->cpool);
+        queue->cpool = NULL;
+    }
+    free(queue->compbuf);
+    queue->compbuf = NULL;
+    queue->ncompbuf = 0;
     if (queue->fallback) {
         mcreq_pipeline_cleanup(queue->fallback);
         free(queue->fallback);
@@ -755,6 +904,7 @@ void mcreq_queue_cleanup(mc_CMDQUEUE *queue)
     free(queue->pipelines);
     queue->pipelines = NULL;
     queue->npipelines = 0;
+    queue->nlanes = 0;
     queue->scheds = NULL;
 }
 
@@ -787,8 +937,16 @@ static void queuectx_leave(mc_CMDQUEUE *queue, int success, int flush)
             ll_next = ll->next;
 
             if (success) {
-                mcreq_enqueue_packet(pipeline, pkt);
+                if ((pkt->flags & MCREQ_F_PREPARING) || !SLLIST_IS_EMPTY(&pipeline->held)) {
+                    sllist_append(&pipeline->held, &pkt->slnode);
+                } else {
+                    enqueue_packet(pipeline, pkt);
+                }
             } else {
+                if (pkt->flags & MCREQ_F_PREPARING) {
+                    mcreq_compresspool_cancel(queue->cpool, pkt);
+                }
+                pipeline_track(pipeline, pkt, -1);
                 if (pkt->flags & MCREQ_F_REQEXT) {
                     mc_REQDATAEX *rd = pkt->u_rdata.exdata;
                     if (rd->procs->fail_dtor) {
@@ -826,9 +984,10 @@ void mcreq_sched_add(mc_PIPELINE *pipeline, mc_PACKET *pkt)
         lcb_INSTANCE *instance = (lcb_INSTANCE *)pipeline->parent->cqdata;
         MCREQ_PKT_RDATA(pkt)->deadline = instance ? LCBT_SETTING(instance, operation_timeout) : LCB_DEFAULT_TIMEOUT;
     }
-    if (!cq->scheds[pipeline->index]) {
-        cq->scheds[pipeline->index] = 1;
+    if (!cq->scheds[pipeline->qpos]) {
+        cq->scheds[pipeline->qpos] = 1;
     }
+    pipeline_track(pipeline, pkt, 1);
     sllist_append(&pipeline->ctxqueued, &pkt->slnode);
     mcreq_rearm_timeout(pipeline);
 }
@@ -842,6 +1001,7 @@ static mc_PACKET *pipeline_find(mc_PIPELINE *pipeline, lcb_uint32_t opaque, int
         if (pkt->opaque == opaque) {
             if (do_remove) {
                 sllist_iter_remove(&pipeline->requests, &iter);
+                pipeline_track(pipeline, pkt, -1);
             }
             return pkt;
         }
@@ -901,22 +1061,61 @@ void mcreq_reset_timeouts(mc_PIPELINE *pl, lcb_U64 nstime)
     }
 }
 
+/* Wait for the values being prepared, so that all packets are in `requests` */
+static void pipeline_unhold(mc_PIPELINE *pl)
+{
+    if (!SLLIST_IS_EMPTY(&pl->held) && pl->parent && pl->parent->cpool) {
+        mcreq_compresspool_reap(pl->parent->cpool, pl, 1);
+    }
+}
+
 unsigned mcreq_pipeline_timeout(mc_PIPELINE *pl, lcb_STATUS err, mcreq_pktfail_fn failcb, void *cbarg, hrtime_t now)
 {
     sllist_iterator iter;
     unsigned count = 0;
 
+    if (now == 0) {
+        pipeline_unhold(pl);
+    }
+
     SLLIST_ITERFOR(&pl->requests, &iter)
     {
         mc_PACKET *pkt = SLLIST_ITEM(iter.cur, mc_PACKET, slnode);
         mc_REQDATA *rd = MCREQ_PKT_RDATA(pkt);
         if (now == 0 || rd->deadline <= now) {
             sllist_iter_remove(&pl->requests, &iter);
+            pipeline_track(pl, pkt, -1);
             failcb(pl, pkt, err, cbarg);
             mcreq_packet_handled(pl, pkt);
             count++;
         }
     }
+
+    if (now == 0 || SLLIST_IS_EMPTY(&pl->held)) {
+        return count;
+    }
+
+    /* Packets waiting for their value, or behind one, time out as well */
+    SLLIST_ITERFOR(&pl->held, &iter)
+    {
+        mc_PACKET *pkt = SLLIST_ITEM(iter.cur, mc_PACKET, slnode);
+        if (MCREQ_PKT_RDATA(pkt)->deadline > now) {
+            continue;
+        }
+        if (pkt->flags & MCREQ_F_PREPARING) {
+            mcreq_compresspool_cancel(pl->parent->cpool, pkt);
+        }
+        sllist_iter_remove(&pl->held, &iter);
+        pipeline_track(pl, pkt, -1);
+        failcb(pl, pkt, err, cbarg);
+        /* it was never enqueued, so there is nothing left to flush */
+        pkt->flags |= MCREQ_F_FLUSHED;
+        mcreq_packet_handled(pl, pkt);
+        count++;
+    }
+    if (pipeline_release_held(pl) && pl->flush_start) {
+        pl->flush_start(pl);
+    }
     return count;
 }
 
@@ -929,13 +1128,19 @@ void mcreq_iterwipe(mc_CMDQUEUE *queue, mc_PIPELINE *src, mcreq_iterwipe_fn call
 {
     sllist_iterator iter;
 
+    pipeline_unhold(src);
+
     SLLIST_ITERFOR(&src->requests, &iter)
     {
         int rv;
         mc_PACKET *orig = SLLIST_ITEM(iter.cur, mc_PACKET, slnode);
+        /* the callback may release the packet */
+        pipeline_track(src, orig, -1);
         rv = callback(queue, src, orig, arg);
         if (rv == MCREQ_REMOVE_PACKET) {
             sllist_iter_remove(&src->requests, &iter);
+        } else {
+            pipeline_track(src, orig, 1);
         }
     }
 }
@@ -961,6 +1166,7 @@ static void do_fallback_flush(mc_PIPELINE *pipeline)
     SLLIST_ITERFOR(&pipeline->requests, &iter)
     {
         mc_PACKET *pkt = SLLIST_ITEM(iter.cur, mc_PACKET, slnode);
+        pipeline_track(pipeline, pkt, -1);
         fpl->handler(pipeline->parent, pkt);
         sllist_iter_remove(&pipeline->requests, &iter);
         mcreq_packet_handled(pipeline, pkt);
@@ -976,6 +1182,7 @@ void mcreq_set_fallback_handler(mc_CMDQUEUE *cq, mcreq_fallback_cb handler)
     mcreq_pipeline_init(cq->fallback);
     cq->fallback->parent = cq;
     cq->fallback->index = cq->npipelines;
+    cq->fallback->qpos = cq->nlanes;
     ((mc_FALLBACKPL *)cq->fallback)->handler = handler;
     cq->fallback->flush_start = do_fallback_flush;
 }
@@ -288,7 +288,15 @@ typedef enum {
     /**
      * Do not encode collection ID for this packet
      */
-    MCREQ_F_NOCID = 1u << 10u
+    MCREQ_F_NOCID = 1u << 10u,
+
+    /**
+     * The value is still being prepared outside of the event loop (i.e.
+     * compressed by a worker thread). The packet, and the ones scheduled
+     * after it on the same pipeline, are held back until
+     * mcreq_packet_prepared() is called
+     */
+    MCREQ_F_PREPARING = 1u << 11u
 } mcreq_flags;
 
 /** @brief mask of flags indicating user-allocated buffers */
@@ -420,6 +428,35 @@ typedef struct mc_pipeline_st {
 
     /** Optional metrics structure for server */
     struct lcb_SERVERMETRICS_st *metrics;
+
+    /** Position of this pipeline within the parent's `pipelines` and `scheds` */
+    unsigned qpos;
+
+    /**
+     * Additional pipelines (i.e. connections) to the same server. The first
+     * element is this pipeline itself. See mcreq_pipeline_lane(). NULL if the
+     * server has a single pipeline.
+     */
+    struct mc_pipeline_st **lanes;
+    unsigned nlanes;
+
+    /** For each vBucket, the element of `lanes` it is bound to */
+    uint8_t *vblanes;
+
+    /** For each vBucket, the number of packets scheduled and not yet completed.
+     * Only maintained for pipelines which are part of `lanes` */
+    uint32_t *vbpending;
+    unsigned nvb;
+
+    /** Total size of the packets scheduled and not yet completed */
+    size_t nbytes_pending;
+
+    /**
+     * Packets which left the scheduling context but may not be flushed yet.
+     * The first one is MCREQ_F_PREPARING, the others were scheduled after it
+     * and wait in order to keep their position relative to it
+     */
+    sllist_root held;
 } mc_PIPELINE;
 
 typedef struct mc_cmdqueue_st {
@@ -440,7 +477,13 @@ typedef struct mc_cmdqueue_st {
     /** Number of pipelines in the queue */
     unsigned npipelines;
 
-    /** Number of pipelines, with fallback included */
+    /**
+     * Number of pipelines with the additional lanes of each pipeline
+     * included. These are placed after the first `npipelines` elements
+     */
+    unsigned nlanes;
+
+    /** Number of pipelines, with lanes and fallback included */
     unsigned _npipelines_ex;
 
     /** Sequence number for pipeline. Incremented for each new packet */
@@ -455,6 +498,13 @@ typedef struct mc_cmdqueue_st {
     /**Special pipeline used to contain orphaned packets within a scheduling
      * context. This field is used by mcreq_set_fallback_handler() */
     mc_PIPELINE *fallback;
+
+    /** Worker threads compressing values, created on demand. See compress.h */
+    struct mc_compresspool_st *cpool;
+
+    /** Scratch space for mcreq_compress_value(), up to MCREQ_COMPRESSBUF_MAX */
+    char *compbuf;
+    size_t ncompbuf;
 } mc_CMDQUEUE;
 
 /**
@@ -599,6 +649,18 @@ lcb_STATUS mcreq_reserve_value2(mc_PIPELINE *pipeline, mc_PACKET *packet, lcb_si
  */
 void mcreq_enqueue_packet(mc_PIPELINE *pipeline, mc_PACKET *packet);
 
+/**
+ * Signal that the value of a MCREQ_F_PREPARING packet is complete. The
+ * packet, and the packets held behind it, are enqueued in the pipeline.
+ *
+ * @param pipeline the pipeline of the packet
+ * @param packet the packet, whose header already reflects the final value
+ * @param oldsize the size of the packet when it was scheduled
+ * @return the number of packets which were enqueued. The caller should start
+ * flushing the pipeline if nonzero
+ */
+unsigned mcreq_packet_prepared(mc_PIPELINE *pipeline, mc_PACKET *packet, size_t oldsize);
+
 /**
  * Like enqueue packet, except it will also inspect the packet's timeout field
  * and if necessary, restructure the command inside the request list so that
@@ -697,10 +759,25 @@ int mcreq_pipeline_init(mc_PIPELINE *pipeline);
 /** Cleans up any initialization from pipeline_init */
 void mcreq_pipeline_cleanup(mc_PIPELINE *pipeline);
 
+/**
+ * Get the pipeline to which a packet for the given vBucket should be
+ * scheduled, among the lanes of the server's pipeline.
+ *
+ * A vBucket stays bound to its lane for as long as packets for it are
+ * pending there, so that operations on the same key are never reordered.
+ * Otherwise the lane with the fewest bytes pending is selected.
+ *
+ * @param pipeline the pipeline the vBucket is mapped to
+ * @param vbid the vBucket
+ * @return the lane to use, which is `pipeline` itself if it has no lanes
+ */
+mc_PIPELINE *mcreq_pipeline_lane(mc_PIPELINE *pipeline, int vbid);
+
 /**
  * Set the pipelines that this queue will manage
  * @param queue the queue to take the pipelines
- * @param pipelines an array of pipeline pointers. The array is copied
+ * @param pipelines an array of pipeline pointers. The array is copied. The
+ *        additional lanes of each pipeline (if any) are added as well
  * @param npipelines number of pipelines in the queue
  * @param config the configuration handle. The configuration is _not_ owned
  *        and _not_ copied and the caller must ensure it remains valid
@@ -113,8 +113,8 @@ void Server::flush()
 LIBCOUCHBASE_API
 void lcb_sched_flush(lcb_INSTANCE *instance)
 {
-    for (size_t ii = 0; ii < LCBT_NSERVERS(instance); ii++) {
-        Server *server = instance->get_server(ii);
+    for (size_t ii = 0; ii < LCBT_NLANES(instance); ii++) {
+        Server *server = instance->get_lane(ii);
 
         if (!server->has_pending()) {
             continue;
@@ -149,8 +149,7 @@ bool Server::handle_nmv(MemcachedResponse &resinfo, mc_PACKET *oldpkt)
     lcb_vbguess_remap(instance, vbid, index);
 
     if (resinfo.vallen() && cccp->enabled) {
-        std::string s(resinfo.value(), resinfo.vallen());
-        err = lcb::clconfig::cccp_update(cccp, curhost->host, s.c_str());
+        err = lcb::clconfig::cccp_update(cccp, curhost->host, resinfo.value(), resinfo.vallen());
     }
 
     if (err != LCB_SUCCESS) {
@@ -813,17 +812,21 @@ uint32_t Server::next_timeout() const
     hrtime_t now, expiry, diff, min = 0;
     mc_PACKET *pkt = NULL;
 
-    sllist_iterator iter;
-    SLLIST_ITERFOR(const_cast<sllist_root *>(&requests), &iter)
-    {
-        mc_PACKET *p = SLLIST_ITEM(iter.cur, mc_PACKET, slnode);
-        hrtime_t deadline = MCREQ_PKT_RDATA(p)->deadline;
-        if (pkt == NULL) {
-            min = deadline;
-            pkt = p;
-        } else if (deadline < min) {
-            min = deadline;
-            pkt = p;
+    /* packets held back while a value is compressed expire as well */
+    sllist_root *lists[] = {const_cast<sllist_root *>(&requests), const_cast<sllist_root *>(&held)};
+    for (size_t ii = 0; ii < 2; ii++) {
+        sllist_iterator iter;
+        SLLIST_ITERFOR(lists[ii], &iter)
+        {
+            mc_PACKET *p = SLLIST_ITEM(iter.cur, mc_PACKET, slnode);
+            hrtime_t deadline = MCREQ_PKT_RDATA(p)->deadline;
+            if (pkt == NULL) {
+                min = deadline;
+                pkt = p;
+            } else if (deadline < min) {
+                min = deadline;
+                pkt = p;
+            }
         }
     }
 
@@ -844,7 +847,7 @@ uint32_t Server::next_timeout() const
 
 void mcreq_rearm_timeout(mc_PIPELINE *pipeline)
 {
-    if ((unsigned)pipeline->index == pipeline->parent->npipelines) {
+    if (pipeline == pipeline->parent->fallback) {
         return; /* this is fallback pipeline, skip it */
     }
     Server *server = reinterpret_cast<Server *>(pipeline);
@@ -919,6 +922,7 @@ void Server::handle_connected(lcbio_SOCKET *sock, lcb_STATUS err, lcbio_OSERR sy
                 LOGFMT "Connection attempt failed. Received %s from libcouchbase, received %d from operating system",
                 LOGID_T(), lcb_strerror_short(err), syserr);
         MC_INCR_METRIC(this, iometrics.io_error, 1);
+        finish_preconnect();
         if (!maybe_reconnect_on_fake_timeout(err)) {
             socket_failed(err);
         }
@@ -958,6 +962,7 @@ void Server::handle_connected(lcbio_SOCKET *sock, lcb_STATUS err, lcbio_OSERR sy
 
     uint32_t tmo = next_timeout();
     lcbio_timer_rearm(io_timer, tmo);
+    finish_preconnect();
     flush();
 }
 
@@ -968,16 +973,56 @@ void Server::connect()
     state = Server::S_CLEAN;
 }
 
+void Server::preconnect()
+{
+    for (unsigned ii = 1; ii < nlanes; ii++) {
+        get_lane(ii)->preconnect();
+    }
+    if (state != Server::S_CLEAN || connctx || connreq || preconnecting || curhost->host[0] == '\0') {
+        return;
+    }
+    lcb_log(LOGARGS_T(DEBUG), LOGFMT "Pre-connecting", LOGID_T());
+    preconnecting = true;
+    lcb_aspend_add(&instance->pendops, LCB_PENDTYPE_COUNTER, NULL);
+    connect();
+}
+
+bool Server::cancel_preconnect()
+{
+    if (!preconnecting) {
+        return false;
+    }
+    preconnecting = false;
+    lcb_aspend_del(&instance->pendops, LCB_PENDTYPE_COUNTER, NULL);
+    return true;
+}
+
+void Server::finish_preconnect()
+{
+    if (!cancel_preconnect()) {
+        return;
+    }
+    for (size_t ii = 0; ii < LCBT_NLANES(instance); ii++) {
+        const Server *server = instance->get_lane(ii);
+        if (server && server->preconnecting) {
+            return;
+        }
+    }
+    lcb_log(LOGARGS_T(INFO), "Finished pre-connecting to data nodes");
+    lcb_maybe_breakout(instance);
+}
+
 static void buf_done_cb(mc_PIPELINE *pl, const void *cookie, void *, void *)
 {
     Server *server = static_cast<Server *>(pl);
     server->instance->callbacks.pktflushed(server->instance, cookie);
 }
 
-Server::Server(lcb_INSTANCE *instance_, int ix)
+Server::Server(lcb_INSTANCE *instance_, int ix, Server *primary, unsigned lane)
     : mc_PIPELINE(), state(S_CLEAN), io_timer(lcbio_timer_new(instance_->iotable, this, timeout_server)),
       instance(instance_), settings(lcb_settings_ref2(instance_->settings)), compsupport(0), jsonsupport(0),
-      mutation_tokens(0), new_durability(-1), selected_bucket(0), connctx(NULL), curhost(new lcb_host_t())
+      mutation_tokens(0), new_durability(-1), selected_bucket(0), preconnecting(false), connctx(NULL),
+      curhost(new lcb_host_t())
 {
     mcreq_pipeline_init(this);
     flush_start = (mcreq_flushstart_fn)server_connect;
@@ -994,15 +1039,24 @@ Server::Server(lcb_INSTANCE *instance_, int ix)
     }
 
     if (settings->metrics) {
-        /** Allocate / reinitialize the metrics here */
-        metrics = lcb_metrics_getserver(settings->metrics, curhost->host, curhost->port, 1);
+        /** Allocate / reinitialize the metrics here. Each lane has its own */
+        metrics = lcb_metrics_getlane(settings->metrics, curhost->host, curhost->port, lane, 1);
         lcb_metrics_reset_pipeline_gauges(metrics);
     }
+
+    if (primary == NULL && settings->kv_pool_size > 1) {
+        nlanes = settings->kv_pool_size;
+        lanes = new mc_PIPELINE *[nlanes];
+        lanes[0] = this;
+        for (unsigned ii = 1; ii < nlanes; ii++) {
+            lanes[ii] = new Server(instance, ix, this, ii);
+        }
+    }
 }
 
 Server::Server()
     : state(S_TEMPORARY), io_timer(NULL), instance(NULL), settings(NULL), compsupport(0), jsonsupport(0),
-      mutation_tokens(0), new_durability(0), connctx(NULL), connreq(NULL), curhost(NULL)
+      mutation_tokens(0), new_durability(0), preconnecting(false), connctx(NULL), connreq(NULL), curhost(NULL)
 {
 }
 
@@ -1015,7 +1069,7 @@ Server::~Server()
     if (this->instance) {
         unsigned ii;
         mc_CMDQUEUE *cmdq = &this->instance->cmdq;
-        for (ii = 0; ii < cmdq->npipelines; ii++) {
+        for (ii = 0; ii < cmdq->nlanes; ii++) {
             lcb::Server *server = static_cast<lcb::Server *>(cmdq->pipelines[ii]);
             if (server == this) {
                 cmdq->pipelines[ii] = NULL;
@@ -1024,6 +1078,7 @@ Server::~Server()
         }
     }
     this->instance = NULL;
+    delete[] lanes;
     mcreq_pipeline_cleanup(this);
 
     if (io_timer) {
@@ -1059,6 +1114,8 @@ void Server::socket_failed(lcb_STATUS err)
         return;
     }
 
+    /* The node may come back running another version */
+    lcb_sesscache_forget(settings->sesscache, curhost->host, curhost->port);
     purge(err, 0, REFRESH_ALWAYS);
     lcb_maybe_breakout(instance);
     start_errored_ctx(S_ERRDRAIN);
@@ -1068,6 +1125,14 @@ void Server::close()
 {
     /* Should never be called twice */
     lcb_assert(state != Server::S_CLOSED);
+    for (unsigned ii = 1; ii < nlanes; ii++) {
+        get_lane(ii)->close();
+    }
+    /* Don't break out of lcb_wait() here: a server is closed either when the
+     * instance is destroyed, or by replace_config() before the servers of the
+     * new configuration are pre-connected. lcb_update_vbconfig() breaks out
+     * itself once those have been registered */
+    cancel_preconnect();
     start_errored_ctx(S_CLOSED);
 }
 
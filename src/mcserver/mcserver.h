@@ -41,8 +41,11 @@ class Server : public mc_PIPELINE
      * connected
      * @param instance the instance to which the server belongs
      * @param ix the server index in the configuration
+     * @param primary the server whose connection pool this object becomes a
+     *  lane of, or NULL to create a server with `kv_pool_size` lanes
+     * @param lane the index of the lane within the pool of `primary`
      */
-    Server(lcb_INSTANCE *, int);
+    Server(lcb_INSTANCE *, int, Server *primary = NULL, unsigned lane = 0);
 
     /**
      * Close the server. The resources of the server may still continue to persist
@@ -83,7 +86,7 @@ class Server : public mc_PIPELINE
      */
     bool has_pending() const
     {
-        return !SLLIST_IS_EMPTY(&requests);
+        return !SLLIST_IS_EMPTY(&requests) || !SLLIST_IS_EMPTY(&held);
     }
 
     int get_index() const
@@ -103,9 +106,23 @@ class Server : public mc_PIPELINE
 
     void set_new_index(int new_index)
     {
+        for (unsigned ii = 1; ii < nlanes; ii++) {
+            lanes[ii]->index = new_index;
+        }
         mc_PIPELINE::index = new_index;
     }
 
+    /** Get a lane of the server, the server itself being lane 0 */
+    Server *get_lane(unsigned ix) const
+    {
+        return ix == 0 ? const_cast< Server * >(this) : static_cast< Server * >(lanes[ix]);
+    }
+
+    unsigned get_nlanes() const
+    {
+        return nlanes ? nlanes : 1;
+    }
+
     const lcb_host_t &get_host() const
     {
         return *curhost;
@@ -188,6 +205,16 @@ class Server : public mc_PIPELINE
 
     void connect();
 
+    /**
+     * Connect without waiting for an operation to be scheduled. lcb_wait()
+     * will block until the connection has been negotiated or has failed.
+     * Does nothing if the server is already connected or connecting.
+     */
+    void preconnect();
+    void finish_preconnect();
+    /** Drop the pending counter of preconnect() without breaking out */
+    bool cancel_preconnect();
+
     void handle_connected(lcbio_SOCKET *socket, lcb_STATUS err, lcbio_OSERR syserr);
 
     enum ReadState { PKT_READ_COMPLETE, PKT_READ_PARTIAL, PKT_READ_ABORT };
@@ -228,6 +255,9 @@ class Server : public mc_PIPELINE
     /** Whether bucket has been selected */
     short selected_bucket;
 
+    /** Whether a connection was started by preconnect() and is not yet ready */
+    bool preconnecting;
+
     lcbio_CTX *connctx;
     lcb::io::ConnectionRequest *connreq;
 
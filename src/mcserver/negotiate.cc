@@ -16,6 +16,7 @@
  */
 
 #include <algorithm>
+#include <map>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -43,6 +44,45 @@ static void handle_ioerr(lcbio_CTX *ctx, lcb_STATUS err);
 
 static void timeout_handler(void *arg);
 
+/**
+ * Remembers the mechanism negotiated with each node, so that subsequent
+ * connections may send their authentication without listing mechanisms first.
+ */
+struct lcb_SESSCACHE {
+    std::map< std::string, std::string > mechs;
+    /**
+     * Nodes whose error map was already loaded into the instance, with the
+     * error map version and revision the instance held after reading it.
+     * The entries are stale once the instance's map changes.
+     */
+    std::map< std::string, std::pair< size_t, size_t > > errmaps;
+    /** SCRAM salted passwords, shared by all connections of the instance */
+    cbsasl_scram_cache_t *scram;
+
+    lcb_SESSCACHE() : scram(cbsasl_scram_cache_new()) {}
+    ~lcb_SESSCACHE()
+    {
+        cbsasl_scram_cache_free(scram);
+    }
+};
+
+lcb_SESSCACHE *lcb_sesscache_new(void)
+{
+    return new lcb_SESSCACHE();
+}
+
+void lcb_sesscache_free(lcb_SESSCACHE *cache)
+{
+    delete cache;
+}
+
+void lcb_sesscache_forget(lcb_SESSCACHE *cache, const char *host, const char *port)
+{
+    if (cache) {
+        cache->errmaps.erase(std::string(host).append(":").append(port));
+    }
+}
+
 static void close_cb(lcbio_SOCKET *s, int reusable, void *arg)
 {
     *(lcbio_SOCKET **)arg = s;
@@ -65,6 +105,9 @@ class lcb::SessionRequestImpl : public SessionRequest
 
     bool setup(const lcbio_NAMEINFO &nistrs, const lcb_host_t &host, const lcb::Authenticator &auth);
     void start(lcbio_SOCKET *sock);
+    bool start_pipelined();
+    void start_serial();
+    bool restart_serial(const char *reason, uint16_t status, const char *detail = NULL);
     void send_list_mechs();
     std::string generate_agent_json();
     bool send_hello();
@@ -78,12 +121,15 @@ class lcb::SessionRequestImpl : public SessionRequest
     enum MechStatus { MECH_UNAVAILABLE, MECH_NOT_NEEDED, MECH_OK };
     MechStatus set_chosen_mech(std::string &mechlist, const char **data, unsigned int *ndata);
     bool request_errmap();
-    bool update_errmap(const lcb::MemcachedResponse &packet);
+    bool update_errmap(const lcb::MemcachedResponse &packet, std::string &errmsg);
+    bool has_cached_errmap() const;
+    void cache_errmap(bool updated);
 
     SessionRequestImpl(lcbio_CONNDONE_cb callback, void *data, uint32_t timeout, lcbio_TABLE *iot,
                        lcb_settings *settings_)
         : ctx(NULL), cb(callback), cbdata(data), timer(lcbio_timer_new(iot, this, timeout_handler)),
-          last_err(LCB_SUCCESS), info(NULL), settings(settings_)
+          last_err(LCB_SUCCESS), sasl_client(NULL), info(NULL), settings(settings_), nsent(0), nreceived(0),
+          nskip(0), errmap_pending(false), pipelined(false), select_pipelined(false), ready(false)
     {
 
         if (timeout) {
@@ -123,6 +169,9 @@ class lcb::SessionRequestImpl : public SessionRequest
         lcbio_ctx_close(ctx, close_cb, &s);
         ctx = NULL;
 
+        if (settings->sesscache && !info->mech.empty()) {
+            settings->sesscache->mechs[host_key] = info->mech;
+        }
         lcbio_protoctx_add(s, info);
         info = NULL;
 
@@ -180,6 +229,23 @@ class lcb::SessionRequestImpl : public SessionRequest
     cbsasl_conn_t *sasl_client;
     SessionInfo *info;
     lcb_settings *settings;
+    std::string host_key;
+
+    /** Number of requests written, and of replies read. The server replies
+     * to negotiation requests in order */
+    unsigned nsent;
+    unsigned nreceived;
+    /** Replies to requests sent before falling back to the serial sequence
+     * are ignored */
+    unsigned nskip;
+    /** GET_ERROR_MAP reply not yet received */
+    bool errmap_pending;
+    /** HELLO and SASL_AUTH were sent in a single flight */
+    bool pipelined;
+    /** SELECT_BUCKET was sent before the pipelined SASL_AUTH completed */
+    bool select_pipelined;
+    /** Negotiation is done, once the outstanding GET_ERROR_MAP reply arrives */
+    bool ready;
 };
 
 static void handle_read(lcbio_CTX *ioctx, unsigned)
@@ -241,6 +307,9 @@ bool SessionRequestImpl::setup(const lcbio_NAMEINFO &nistrs, const lcb_host_t &h
 
     cbsasl_error_t saslerr =
         cbsasl_client_new("couchbase", host.host, nistrs.local, nistrs.remote, &sasl_callbacks, 0, &sasl_client);
+    if (saslerr == SASL_OK && settings->sesscache) {
+        cbsasl_client_set_scram_cache(sasl_client, settings->sesscache->scram);
+    }
     return saslerr == SASL_OK;
 }
 
@@ -317,6 +386,7 @@ void SessionRequestImpl::send_auth(const char *sasl_data, unsigned ndata)
     lcbio_ctx_put(ctx, info->mech.c_str(), info->mech.size());
     lcbio_ctx_put(ctx, sasl_data, ndata);
     lcbio_ctx_rwant(ctx, 24);
+    nsent++;
 }
 
 bool SessionRequestImpl::send_step(const lcb::MemcachedResponse &packet)
@@ -338,6 +408,7 @@ bool SessionRequestImpl::send_step(const lcb::MemcachedResponse &packet)
     lcbio_ctx_put(ctx, info->mech.c_str(), info->mech.size());
     lcbio_ctx_put(ctx, step_data, ndata);
     lcbio_ctx_rwant(ctx, 24);
+    nsent++;
     return true;
 }
 
@@ -434,6 +505,7 @@ bool SessionRequestImpl::send_hello()
             agent.c_str(), fstr.c_str());
 
     lcbio_ctx_rwant(ctx, 24);
+    nsent++;
     return true;
 }
 
@@ -442,6 +514,7 @@ void SessionRequestImpl::send_list_mechs()
     lcb::MemcachedRequest req(PROTOCOL_BINARY_CMD_SASL_LIST_MECHS);
     lcbio_ctx_put(ctx, req.data(), req.size());
     LCBIO_CTX_RSCHEDULE(ctx, 24);
+    nsent++;
 }
 
 bool SessionRequestImpl::read_hello(const lcb::MemcachedResponse &resp)
@@ -475,24 +548,61 @@ bool SessionRequestImpl::request_errmap()
     lcbio_ctx_put(ctx, hdr.data(), hdr.size());
     lcbio_ctx_put(ctx, p, 2);
     lcbio_ctx_rwant(ctx, 24);
+    nsent++;
+    errmap_pending = true;
     return true;
 }
 
-bool SessionRequestImpl::update_errmap(const lcb::MemcachedResponse &resp)
+/**
+ * Whether the instance already holds the error map of this node, so that
+ * GET_ERROR_MAP can be skipped. The map must not have changed since it was
+ * last read from the node.
+ */
+bool SessionRequestImpl::has_cached_errmap() const
+{
+    const lcb::errmap::ErrorMap &mm = *settings->errmap;
+    if (!settings->sesscache || !mm.isLoaded()) {
+        return false;
+    }
+    std::map< std::string, std::pair< size_t, size_t > >::const_iterator it =
+        settings->sesscache->errmaps.find(host_key);
+    if (it == settings->sesscache->errmaps.end()) {
+        return false;
+    }
+    return it->second == std::make_pair(mm.getVersion(), mm.getRevision());
+}
+
+/**
+ * Record that the error map of this node was read. If it replaced the map of
+ * the instance, other nodes may serve a newer one as well, so they are all
+ * asked again.
+ */
+void SessionRequestImpl::cache_errmap(bool updated)
+{
+    if (!settings->sesscache) {
+        return;
+    }
+    const lcb::errmap::ErrorMap &mm = *settings->errmap;
+    if (updated) {
+        settings->sesscache->errmaps.clear();
+    }
+    settings->sesscache->errmaps[host_key] = std::make_pair(mm.getVersion(), mm.getRevision());
+}
+
+bool SessionRequestImpl::update_errmap(const lcb::MemcachedResponse &resp, std::string &errmsg)
 {
     // Get the error map object
     using lcb::errmap::ErrorMap;
 
-    std::string errmsg;
     ErrorMap &mm = *settings->errmap;
     ErrorMap::ParseStatus status = mm.parse(resp.value(), resp.vallen(), errmsg);
 
     if (status != ErrorMap::UPDATED && status != ErrorMap::NOT_UPDATED) {
         errmsg = "Couldn't update error map: " + errmsg;
-        set_error(LCB_ERR_PROTOCOL_ERROR, errmsg.c_str());
         return false;
     }
 
+    cache_errmap(status == ErrorMap::UPDATED);
     return true;
 }
 
@@ -521,6 +631,7 @@ bool SessionRequestImpl::maybe_select_bucket()
         lcbio_ctx_put(ctx, settings->bucket, strlen(settings->bucket));
     }
     LCBIO_CTX_RSCHEDULE(ctx, 24);
+    nsent++;
     return true;
 }
 
@@ -538,9 +649,10 @@ void SessionRequestImpl::handle_read(lcbio_CTX *ioctx)
 {
     lcb::MemcachedResponse resp;
     unsigned required;
-    bool completed = false;
+    bool completed;
 
 GT_NEXT_PACKET:
+    completed = false;
 
     if (!resp.load(ioctx, &required)) {
         LCBIO_CTX_RSCHEDULE(ioctx, required);
@@ -548,6 +660,12 @@ GT_NEXT_PACKET:
     }
     const uint16_t status = resp.status();
 
+    if (nreceived++ < nskip) {
+        // Sent before falling back to the serial sequence
+        resp.release(ioctx);
+        goto GT_NEXT_PACKET;
+    }
+
     switch (resp.opcode()) {
         case PROTOCOL_BINARY_CMD_SASL_LIST_MECHS: {
             const char *mechlist_data;
@@ -567,10 +685,14 @@ GT_NEXT_PACKET:
 
         case PROTOCOL_BINARY_CMD_SASL_AUTH: {
             if (status == PROTOCOL_BINARY_RESPONSE_SUCCESS) {
-                completed = !maybe_select_bucket();
+                if (!select_pipelined) {
+                    completed = !maybe_select_bucket();
+                }
                 break;
             } else if (status == PROTOCOL_BINARY_RESPONSE_AUTH_CONTINUE) {
                 send_step(resp);
+            } else if (pipelined) {
+                restart_serial("SASL AUTH", status);
             } else {
                 set_error(LCB_ERR_AUTHENTICATION_FAILURE, "SASL AUTH failed", &resp);
                 break;
@@ -596,6 +718,9 @@ GT_NEXT_PACKET:
                 }
             } else if (isUnsupported(status)) {
                 lcb_log(LOGARGS(this, DEBUG), LOGFMT "Server does not support HELLO", LOGID(this));
+            } else if (pipelined) {
+                restart_serial("HELLO", status);
+                break;
             } else {
                 lcb_log(LOGARGS(this, ERROR), LOGFMT "Unexpected status 0x%x received for HELLO", LOGID(this), status);
                 set_error(LCB_ERR_PROTOCOL_ERROR, "Hello response unexpected", &resp);
@@ -603,12 +728,23 @@ GT_NEXT_PACKET:
             }
 
             if (info->has_feature(PROTOCOL_BINARY_FEATURE_XERROR)) {
-                request_errmap();
+                if (has_cached_errmap()) {
+                    lcb_log(LOGARGS(this, TRACE), LOGFMT "Using cached error map (revision %u)", LOGID(this),
+                            (unsigned)settings->errmap->getRevision());
+                } else {
+                    request_errmap();
+                }
             } else {
                 lcb_log(LOGARGS(this, TRACE), LOGFMT "GET_ERRORMAP unsupported/disabled", LOGID(this));
             }
 
-            if (settings->keypath) {
+            if (pipelined) {
+                // SASL_AUTH is already on the wire. A single step mechanism
+                // is done with it, so the bucket may be selected right away
+                if (info->mech == MECH_PLAIN) {
+                    select_pipelined = maybe_select_bucket();
+                }
+            } else if (settings->keypath) {
                 completed = !maybe_select_bucket();
             } else {
                 // In any event, it's also time to send the LIST_MECHS request
@@ -618,18 +754,29 @@ GT_NEXT_PACKET:
         }
 
         case PROTOCOL_BINARY_CMD_GET_ERROR_MAP: {
+            std::string errmsg;
+            errmap_pending = false;
             if (status == PROTOCOL_BINARY_RESPONSE_SUCCESS) {
-                if (!update_errmap(resp)) {
+                if (!update_errmap(resp, errmsg)) {
+                    if (pipelined) {
+                        restart_serial("GET_ERRMAP", status, errmsg.c_str());
+                    } else {
+                        set_error(LCB_ERR_PROTOCOL_ERROR, errmsg.c_str());
+                    }
                 }
             } else if (isUnsupported(status)) {
                 lcb_log(LOGARGS(this, DEBUG), LOGFMT "Server does not support GET_ERRMAP (0x%x)", LOGID(this), status);
+            } else if (pipelined) {
+                restart_serial("GET_ERRMAP", status);
             } else {
                 lcb_log(LOGARGS(this, ERROR), LOGFMT "Unexpected status 0x%x received for GET_ERRMAP", LOGID(this),
                         status);
                 set_error(LCB_ERR_PROTOCOL_ERROR, "GET_ERRMAP response unexpected", &resp);
             }
             // Note, there is no explicit state transition here. LIST_MECHS is
-            // pipelined after this request.
+            // pipelined after this request. With pipelined negotiation, the
+            // authentication may have completed before this reply.
+            completed = ready;
             break;
         }
 
@@ -664,6 +811,10 @@ GT_NEXT_PACKET:
     // or fail the request, potentially destroying the underlying connection
     if (has_error()) {
         fail();
+    } else if (completed && errmap_pending) {
+        // GET_ERROR_MAP was sent after the pipelined SASL_AUTH
+        ready = true;
+        goto GT_NEXT_PACKET;
     } else if (completed) {
         success();
     } else {
@@ -671,6 +822,106 @@ GT_NEXT_PACKET:
     }
 }
 
+/**
+ * Write HELLO and SASL_AUTH without waiting for the HELLO reply. This is only
+ * possible if the mechanism is already known, as LIST_MECHS is skipped.
+ * GET_ERROR_MAP and (if the mechanism completes in a single step)
+ * SELECT_BUCKET follow once HELLO has confirmed the server supports them,
+ * still ahead of the SASL_AUTH reply.
+ *
+ * @return true if the requests were sent, false if the regular sequence
+ * should be used instead
+ */
+bool SessionRequestImpl::start_pipelined()
+{
+    std::string mech;
+    if (settings->sasl_mech_force) {
+        mech = settings->sasl_mech_force;
+    } else if (settings->sesscache) {
+        std::map< std::string, std::string >::const_iterator it = settings->sesscache->mechs.find(host_key);
+        if (it != settings->sesscache->mechs.end()) {
+            mech = it->second;
+        }
+    }
+    if (mech.empty()) {
+        return false;
+    }
+    if (mech == MECH_PLAIN && !settings->ssl_ctx) {
+        // Let the regular sequence decide whether PLAIN may be used
+        return false;
+    }
+
+    const char *data, *chosenmech;
+    unsigned int ndata;
+    cbsasl_error_t saslerr = cbsasl_client_start(sasl_client, mech.c_str(), NULL, &data, &ndata, &chosenmech);
+    if (saslerr == SASL_NOMECH) {
+        return false;
+    } else if (saslerr != SASL_OK) {
+        lcb_log(LOGARGS(this, ERROR), LOGFMT "cbsasl_client_start returned %d", LOGID(this), saslerr);
+        set_error(LCB_ERR_SDK_INTERNAL, "Couldn't start SASL client");
+        return false;
+    }
+    info->mech.assign(chosenmech);
+
+    lcb_log(LOGARGS(this, DEBUG), LOGFMT "Pipelining negotiation using %s", LOGID(this), chosenmech);
+    pipelined = true;
+    send_hello();
+    send_auth(data, ndata);
+    return true;
+}
+
+/** Send the first request(s) of the regular sequence */
+void SessionRequestImpl::start_serial()
+{
+    if (settings->send_hello) {
+        send_hello();
+    } else {
+        lcb_log(LOGARGS(this, WARN), LOGFMT "HELLO negotiation disabled by user", LOGID(this));
+        send_list_mechs();
+    }
+    LCBIO_CTX_RSCHEDULE(ctx, 24);
+}
+
+/**
+ * Called when a reply to the pipelined negotiation indicates a failure.
+ * Forget the mechanism and negotiate again on the same connection, with the
+ * regular sequence. Replies to the requests already sent are ignored, and
+ * any failure from now on is final. `detail` describes a failure of a
+ * successful reply, e.g. one which could not be parsed.
+ */
+bool SessionRequestImpl::restart_serial(const char *reason, uint16_t status, const char *detail)
+{
+    if (detail) {
+        lcb_log(LOGARGS(this, INFO),
+                LOGFMT "Pipelined %s failed: %s (mechanism %s). Falling back to serial negotiation", LOGID(this),
+                reason, detail, info->mech.c_str());
+    } else {
+        lcb_log(LOGARGS(this, INFO),
+                LOGFMT "Pipelined %s failed with STATUS=0x%x (mechanism %s). Falling back to serial negotiation",
+                LOGID(this), reason, status, info->mech.c_str());
+    }
+    if (settings->sesscache) {
+        settings->sesscache->mechs.erase(host_key);
+    }
+    nskip = nsent;
+    errmap_pending = false;
+    pipelined = false;
+    select_pipelined = false;
+    ready = false;
+    info->mech.clear();
+    info->server_features.clear();
+
+    cbsasl_dispose(&sasl_client);
+    lcbio_NAMEINFO nistrs;
+    lcbio_get_nameinfo(ctx->sock, &nistrs);
+    if (!setup(nistrs, *lcbio_get_host(ctx->sock), *settings->auth)) {
+        set_error(LCB_ERR_SDK_INTERNAL, "Couldn't start SASL client");
+        return false;
+    }
+    start_serial();
+    return true;
+}
+
 static void handle_ioerr(lcbio_CTX *ctx, lcb_STATUS err)
 {
     SessionRequestImpl *sreq = SessionRequestImpl::get(lcbio_ctx_data(ctx));
@@ -708,14 +959,16 @@ void SessionRequestImpl::start(lcbio_SOCKET *sock)
         lcbio_async_signal(timer);
         return;
     }
+    host_key.assign(curhost->host).append(":").append(curhost->port);
 
-    if (settings->send_hello) {
-        send_hello();
-    } else {
-        lcb_log(LOGARGS(this, WARN), LOGFMT "HELLO negotiation disabled by user", LOGID(this));
-        send_list_mechs();
+    if (settings->pipeline_negotiation && settings->send_hello && !settings->keypath && start_pipelined()) {
+        LCBIO_CTX_RSCHEDULE(ctx, 24);
+        return;
+    } else if (has_error()) {
+        lcbio_async_signal(timer);
+        return;
     }
-    LCBIO_CTX_RSCHEDULE(ctx, 24);
+    start_serial();
 }
 
 SessionRequestImpl::~SessionRequestImpl()
@@ -51,9 +51,14 @@ public:
         }
     }
 
-    MetricsEntry *get(const char *host, const char *port, int create) {
+    MetricsEntry *get(const char *host, const char *port, unsigned lane, int create) {
         std::string key;
         key.append(host).append(":").append(port);
+        if (lane) {
+            char buf[16];
+            sprintf(buf, "#%u", lane);
+            key.append(buf);
+        }
         for (size_t ii = 0; ii < entries.size(); ++ii) {
             if (entries[ii]->m_hostport == key) {
                 return entries[ii];
@@ -96,7 +101,13 @@ lcb_metrics_destroy(lcb_METRICS *metrics)
 lcb_SERVERMETRICS *
 lcb_metrics_getserver(lcb_METRICS *metrics, const char *h, const char *p, int c)
 {
-    return Metrics::from(metrics)->get(h, p, c);
+    return Metrics::from(metrics)->get(h, p, 0, c);
+}
+
+lcb_SERVERMETRICS *
+lcb_metrics_getlane(lcb_METRICS *metrics, const char *h, const char *p, unsigned lane, int c)
+{
+    return Metrics::from(metrics)->get(h, p, lane, c);
 }
 
 void
@@ -119,7 +130,10 @@ lcb_metrics_dumpserver(const lcb_SERVERMETRICS *metrics, FILE *fp)
     fprintf(fp, "Packets errored: %lu\n", (unsigned long int)metrics->packets_errored);
     fprintf(fp, "Packets NMV: %lu\n", (unsigned long int)metrics->packets_nmv);
     fprintf(fp, "Packets timeout: %lu\n", (unsigned long int)metrics->packets_timeout);
-    fprintf(fp, "Packets orphaned: %lu", (unsigned long int)metrics->packets_ownerless);
+    fprintf(fp, "Packets orphaned: %lu\n", (unsigned long int)metrics->packets_ownerless);
+    fprintf(fp, "Compression attempted: %lu\n", (unsigned long int)metrics->compress_attempted);
+    fprintf(fp, "Compression skipped: %lu\n", (unsigned long int)metrics->compress_skipped);
+    fprintf(fp, "Compression succeeded: %lu", (unsigned long int)metrics->compress_succeeded);
 }
 
 void
@@ -198,9 +198,11 @@ iterwipe_cb(mc_CMDQUEUE *cq, mc_PIPELINE *oldpl, mc_PACKET *oldpkt, void *)
     protocol_binary_request_header hdr;
     lcb::Server *srv = static_cast<lcb::Server *>(oldpl);
     int newix;
+    uint16_t vbid;
     lcb_INSTANCE *instance = (lcb_INSTANCE *)cq->cqdata;
 
     mcreq_read_hdr(oldpkt, &hdr);
+    vbid = ntohs(hdr.request.vbucket);
 
     lcb_RETRY_ACTION retry = lcb_kv_should_retry(srv->get_settings(), oldpkt, LCB_ERR_TOPOLOGY_CHANGE);
     if (!retry.should_retry) {
@@ -208,7 +210,7 @@ iterwipe_cb(mc_CMDQUEUE *cq, mc_PIPELINE *oldpl, mc_PACKET *oldpkt, void *)
     }
 
     if (LCBVB_DISTTYPE(cq->config) == LCBVB_DIST_VBUCKET) {
-        newix = lcbvb_vbmaster(cq->config, ntohs(hdr.request.vbucket));
+        newix = lcbvb_vbmaster(cq->config, vbid);
 
     } else {
         const char *key = NULL;
@@ -226,10 +228,16 @@ iterwipe_cb(mc_CMDQUEUE *cq, mc_PIPELINE *oldpl, mc_PACKET *oldpkt, void *)
     }
 
 
-    mc_PIPELINE *newpl = cq->pipelines[newix];
-    if (newpl == oldpl || newpl == NULL) {
+    lcb::Server *newsrv = static_cast<lcb::Server *>(cq->pipelines[newix]);
+    if (newsrv == NULL) {
         return MCREQ_KEEP_PACKET;
     }
+    for (unsigned ii = 0; ii < newsrv->get_nlanes(); ii++) {
+        if (newsrv->get_lane(ii) == oldpl) {
+            return MCREQ_KEEP_PACKET;
+        }
+    }
+    mc_PIPELINE *newpl = mcreq_pipeline_lane(newsrv, vbid);
 
     lcb_log(LOGARGS(instance, DEBUG), "Remapped packet %p (SEQ=%u) from " SERVER_FMT " to " SERVER_FMT,
         (void*)oldpkt, oldpkt->opaque, SERVER_ARGS((lcb::Server*)oldpl), SERVER_ARGS((lcb::Server*)newpl));
@@ -287,8 +295,8 @@ replace_config(lcb_INSTANCE *instance, lcbvb_CONFIG *oldconfig, lcbvb_CONFIG *ne
      * transfer the new config along with the new list over to the CQ structure.
      */
     mcreq_queue_add_pipelines(cq, ppnew, nnew, newconfig);
-    for (ii = 0; ii < nnew; ii++) {
-        mcreq_iterwipe(cq, ppnew[ii], iterwipe_cb, NULL);
+    for (ii = 0; ii < cq->nlanes; ii++) {
+        mcreq_iterwipe(cq, cq->pipelines[ii], iterwipe_cb, NULL);
     }
 
     /**
@@ -300,14 +308,17 @@ replace_config(lcb_INSTANCE *instance, lcbvb_CONFIG *oldconfig, lcbvb_CONFIG *ne
             continue;
         }
 
-        mcreq_iterwipe(cq, ppold[ii], iterwipe_cb, NULL);
-        static_cast< lcb::Server * >(ppold[ii])->purge(LCB_ERR_MAP_CHANGED);
-        static_cast<lcb::Server*>(ppold[ii])->close();
+        lcb::Server *oldsrv = static_cast<lcb::Server *>(ppold[ii]);
+        for (unsigned jj = 0; jj < oldsrv->get_nlanes(); jj++) {
+            mcreq_iterwipe(cq, oldsrv->get_lane(jj), iterwipe_cb, NULL);
+            oldsrv->get_lane(jj)->purge(LCB_ERR_MAP_CHANGED);
+        }
+        oldsrv->close();
     }
 
-    for (ii = 0; ii < nnew; ii++) {
-        if (static_cast<lcb::Server*>(ppnew[ii])->has_pending()) {
-            ppnew[ii]->flush_start(ppnew[ii]);
+    for (ii = 0; ii < cq->nlanes; ii++) {
+        if (static_cast<lcb::Server*>(cq->pipelines[ii])->has_pending()) {
+            cq->pipelines[ii]->flush_start(cq->pipelines[ii]);
         }
     }
 
@@ -359,5 +370,11 @@ void lcb_update_vbconfig(lcb_INSTANCE *instance, lcb_pCONFIGINFO config)
         }
     }
 
+    if (LCBT_SETTING(instance, kv_preconnect)) {
+        for (size_t ii = 0; ii < LCBT_NSERVERS(instance); ++ii) {
+            instance->get_server(ii)->preconnect();
+        }
+    }
+
     lcb_maybe_breakout(instance);
 }
@@ -18,6 +18,7 @@
 #include "internal.h"
 #include "http/http.h"
 #include "auth-priv.h"
+#include <lcbio/ssl.h>
 
 LIBCOUCHBASE_API lcb_STATUS lcb_respping_status(const lcb_RESPPING *resp)
 {
@@ -347,6 +348,31 @@ static void build_ping_json(lcb_INSTANCE *instance, lcb_RESPPING &ping, Json::Va
     root["config_rev"] = config_rev;
 }
 
+/** Report the effective socket options, as the kernel may have adjusted the requested values */
+static void add_sockopts_json(lcbio_SOCKET *sock, Json::Value &endpoint)
+{
+    static const struct {
+        int cntl;
+        const char *name;
+    } opts[] = {{LCB_IO_CNTL_SO_RCVBUF, "rcvbuf"},
+                {LCB_IO_CNTL_SO_SNDBUF, "sndbuf"},
+                {LCB_IO_CNTL_SO_BUSY_POLL, "busy_poll_us"},
+                {LCB_IO_CNTL_TCP_USER_TIMEOUT, "user_timeout_ms"},
+                {LCB_IO_CNTL_IP_TOS, "tos"},
+                {LCB_IO_CNTL_SO_INCOMING_CPU, "incoming_cpu"}};
+    Json::Value sockopts;
+
+    for (size_t ii = 0; ii < sizeof(opts) / sizeof(opts[0]); ii++) {
+        int value = 0;
+        if (lcbio_get_sockopt(sock, opts[ii].cntl, &value) == LCB_SUCCESS) {
+            sockopts[opts[ii].name] = value;
+        }
+    }
+    if (!sockopts.empty()) {
+        endpoint["sockopts"] = sockopts;
+    }
+}
+
 static void invoke_ping_callback(lcb_INSTANCE *instance, PingCookie *ck)
 {
     lcb_RESPPING ping;
@@ -670,7 +696,7 @@ lcb_STATUS lcb_diag(lcb_INSTANCE *instance, void *cookie, const lcb_CMDDIAG *cmd
 
     size_t ii;
     Json::Value kv;
-    for (ii = 0; ii < instance->cmdq.npipelines; ii++) {
+    for (ii = 0; ii < instance->cmdq.nlanes; ii++) {
         lcb::Server *server = static_cast< lcb::Server * >(instance->cmdq.pipelines[ii]);
         lcbio_CTX *ctx = server->connctx;
         if (ctx) {
@@ -687,11 +713,24 @@ lcb_STATUS lcb_diag(lcb_INSTANCE *instance, void *cookie, const lcb_CMDDIAG *cmd
             endpoint["local"] = ctx->sock->info->ep_local;
             endpoint["last_activity_us"] = (Json::Value::UInt64)(now > ctx->sock->atime ? now - ctx->sock->atime : 0);
             endpoint["status"] = "connected";
+            add_sockopts_json(ctx->sock, endpoint);
+            if (instance->cmdq.nlanes > instance->cmdq.npipelines) {
+                endpoint["pending_bytes"] = (Json::Value::UInt64)server->nbytes_pending;
+            }
             root[lcbio_svcstr(ctx->sock->service)].append(endpoint);
         }
     }
     instance->memd_sockpool->toJSON(now, root);
     instance->http_sockpool->toJSON(now, root);
+    if (LCBT_SETTING(instance, ssl_ctx)) {
+        lcbio_SSLSESSIONSTATS stats;
+        Json::Value sessions;
+        lcbio_ssl_session_stats(LCBT_SETTING(instance, ssl_ctx), &stats);
+        sessions["hits"] = (Json::Value::UInt64)stats.hits;
+        sessions["misses"] = (Json::Value::UInt64)stats.misses;
+        sessions["cached"] = stats.ncached;
+        root["ssl_sessions"] = sessions;
+    }
     {
         Json::Value cur;
         lcb_ASPEND_SETTYPE::iterator it;
@@ -714,6 +753,7 @@ lcb_STATUS lcb_diag(lcb_INSTANCE *instance, void *cookie, const lcb_CMDDIAG *cmd
                     endpoint["last_activity_us"] =
                         (Json::Value::UInt64)(now > ctx->sock->atime ? now - ctx->sock->atime : 0);
                     endpoint["status"] = "connected";
+                    add_sockopts_json(ctx->sock, endpoint);
                     root[lcbio_svcstr(ctx->sock->service)].append(endpoint);
                 }
             }
@@ -17,6 +17,7 @@
 #include "internal.h"
 #include "collections.h"
 #include "mc/compress.h"
+#include <lcbio/iotable.h>
 #include "trace.h"
 #include "durability_internal.h"
 
@@ -390,6 +391,60 @@ static int can_compress(lcb_INSTANCE *instance, const mc_PIPELINE *pipeline, uin
     return 1;
 }
 
+/* How often to look for values compressed in the background, with I/O
+ * plugins which cannot watch the descriptor of the compression pool */
+#define COMPRESS_REAP_INTERVAL 500
+
+static void compress_reap_cb(void *arg)
+{
+    lcb_INSTANCE *instance = reinterpret_cast<lcb_INSTANCE *>(arg);
+    if (mcreq_compresspool_reap(instance->cmdq.cpool, NULL, 0)) {
+        lcbio_timer_rearm(instance->compress_timer, COMPRESS_REAP_INTERVAL);
+    }
+}
+
+static void compress_event_cb(lcb_socket_t, short, void *arg)
+{
+    lcb_INSTANCE *instance = reinterpret_cast<lcb_INSTANCE *>(arg);
+    mcreq_compresspool_reap(instance->cmdq.cpool, NULL, 0);
+}
+
+/* Whether the value should be handed to the compression threads */
+static bool compress_async(lcb_INSTANCE *instance, const mc_PIPELINE *pipeline, const lcb_VALBUF *value)
+{
+    lcb_U32 min_size = LCBT_SETTING(instance, compress_async_min_size);
+    size_t size = 0;
+
+    if (min_size == 0 || pipeline == instance->cmdq.fallback) {
+        return false;
+    }
+    if (value->vtype == LCB_KV_COPY || value->vtype == LCB_KV_CONTIG) {
+        size = value->u_buf.contig.nbytes;
+    } else if (value->vtype == LCB_KV_IOV || value->vtype == LCB_KV_IOVCOPY) {
+        size = value->u_buf.multi.total_length;
+        for (unsigned ii = 0; size == 0 && ii < value->u_buf.multi.niov; ii++) {
+            size += value->u_buf.multi.iov[ii].iov_len;
+        }
+    }
+    if (size < min_size) {
+        return false;
+    }
+
+    if (instance->cmdq.cpool == NULL) {
+        lcbio_pTABLE iot = instance->iotable;
+        instance->cmdq.cpool = mcreq_compresspool_new(LCBT_SETTING(instance, compress_async_threads));
+        int fd = mcreq_compresspool_fd(instance->cmdq.cpool);
+        if (fd != -1 && iot->is_E()) {
+            /* the workers wake the loop up as they complete values */
+            instance->compress_event = iot->E_event_create();
+            iot->E_event_watch(fd, instance->compress_event, LCB_READ_EVENT, instance, compress_event_cb);
+        } else {
+            instance->compress_timer = lcbio_timer_new(iot, instance, compress_reap_cb);
+        }
+    }
+    return true;
+}
+
 static lcb_STATUS store_validate(lcb_INSTANCE *instance, const lcb_CMDSTORE *cmd)
 {
     int new_durability_supported = LCBT_SUPPORT_SYNCREPLICATION(instance);
@@ -479,7 +534,17 @@ LIBCOUCHBASE_API lcb_STATUS lcb_store(lcb_INSTANCE *instance, void *cookie, cons
 
         should_compress = can_compress(instance, pipeline, cmd->datatype);
         if (should_compress) {
-            int rv = mcreq_compress_value(pipeline, packet, &cmd->value, instance->settings, &should_compress);
+            int rv;
+            if (compress_async(instance, pipeline, &cmd->value)) {
+                rv = mcreq_compress_value_async(cq->cpool, pipeline, packet, &cmd->value, instance->settings,
+                                                &should_compress);
+                if (rv == 0 && (packet->flags & MCREQ_F_PREPARING) && instance->compress_timer &&
+                    !lcbio_timer_armed(instance->compress_timer)) {
+                    lcbio_timer_rearm(instance->compress_timer, COMPRESS_REAP_INTERVAL);
+                }
+            } else {
+                rv = mcreq_compress_value(pipeline, packet, &cmd->value, instance->settings, &should_compress);
+            }
             if (rv != 0) {
                 mcreq_release_packet(pipeline, packet);
                 return LCB_ERR_NO_MEMORY;
@@ -499,6 +564,9 @@ LIBCOUCHBASE_API lcb_STATUS lcb_store(lcb_INSTANCE *instance, void *cookie, cons
 
             err = lcb_durability_validate(instance, &persist_u, &replicate_u, duropts);
             if (err != LCB_SUCCESS) {
+                if (packet->flags & MCREQ_F_PREPARING) {
+                    mcreq_compresspool_cancel(cq->cpool, packet);
+                }
                 mcreq_wipe_packet(pipeline, packet);
                 mcreq_release_packet(pipeline, packet);
                 return err;
@@ -261,7 +261,7 @@ RetryQueue::flush(bool throttle)
                 fail(op, LCB_ERR_NO_MATCHING_SERVER);
             }
         } else {
-            mc_PIPELINE *newpl = cq->pipelines[srvix];
+            mc_PIPELINE *newpl = mcreq_pipeline_lane(cq->pipelines[srvix], vbid);
             mcreq_enqueue_packet(newpl, op->pkt);
             newpl->flush_start(newpl);
             erase(op);
@@ -334,7 +334,7 @@ RetryQueue::add(mc_EXPACKET *pkt, const lcb_STATUS err,
         /* if there is an old packet associated, we make sure that none
          * of the pipelines use it in the pending/flush queues
          */
-        for (size_t ii = 0; ii < cq->npipelines; ii++) {
+        for (size_t ii = 0; ii < cq->nlanes; ii++) {
             sllist_iterator iter;
             lcb::Server *server = static_cast<lcb::Server*>(cq->pipelines[ii]);
             if (server == NULL) {
@@ -48,6 +48,8 @@ void lcb_default_settings(lcb_settings *settings)
     settings->compressopts = LCB_DEFAULT_COMPRESSOPTS;
     settings->compress_min_size = LCB_DEFAULT_COMPRESS_MIN_SIZE;
     settings->compress_min_ratio = (float)LCB_DEFAULT_COMPRESS_MIN_RATIO;
+    settings->compress_async_min_size = 0;
+    settings->compress_async_threads = LCB_DEFAULT_COMPRESS_ASYNC_THREADS;
     settings->allocator_factory = rdb_bigalloc_new;
     settings->detailed_neterr = 0;
     settings->refresh_on_hterr = 1;
@@ -79,6 +81,19 @@ void lcb_default_settings(lcb_settings *settings)
     settings->tracer_threshold[LCBTRACE_THRESHOLD_ANALYTICS] = LCBTRACE_DEFAULT_THRESHOLD_ANALYTICS;
     settings->wait_for_config = 0;
     settings->enable_durable_write = 0;
+    settings->config_cache_binary = 0;
+    settings->kv_preconnect = 0;
+    settings->pipeline_negotiation = 0;
+    settings->tcp_quickack = 0;
+    settings->tcp_busy_poll = 0;
+    settings->tcp_rcvbuf = 0;
+    settings->tcp_sndbuf = 0;
+    settings->tcp_user_timeout = 0;
+    settings->ip_tos = 0;
+    settings->kv_pool_size = 1;
+    settings->ssl_session_lifetime = LCB_DEFAULT_SSL_SESSION_LIFETIME;
+    settings->ssl_ktls = 0;
+    settings->ssl_log_handshake = 0;
     settings->retry_strategy = lcb_retry_strategy_best_effort;
 }
 
@@ -90,6 +105,7 @@ lcb_settings *lcb_settings_new(void)
     settings->refcount = 1;
     settings->auth = lcbauth_new();
     settings->errmap = lcb_errmap_new();
+    settings->sesscache = lcb_sesscache_new();
     return settings;
 }
 
@@ -108,6 +124,7 @@ void lcb_settings_unref(lcb_settings *settings)
 
     lcbauth_unref(settings->auth);
     lcb_errmap_free(settings->errmap);
+    lcb_sesscache_free(settings->sesscache);
 
     if (settings->ssl_ctx) {
         lcbio_ssl_free(settings->ssl_ctx);
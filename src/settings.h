@@ -82,6 +82,8 @@
 #define LCB_DEFAULT_COMPRESS_MIN_SIZE 32
 /* compressed_bytes / original_bytes */
 #define LCB_DEFAULT_COMPRESS_MIN_RATIO 0.83
+/* number of threads compressing values of compress_async_min_size or more */
+#define LCB_DEFAULT_COMPRESS_ASYNC_THREADS 2
 
 #define LCB_DEFAULT_NVM_RETRY_IMM 1
 #define LCB_DEFAULT_RETRY_NMV_INTERVAL LCB_MS2US(100)
@@ -107,6 +109,9 @@
 
 #define LCB_DEFAULT_PERSISTENCE_TIMEOUT_FLOOR 1500000
 
+/* 5 minutes */
+#define LCB_DEFAULT_SSL_SESSION_LIFETIME LCB_MS2US(300000)
+
 #include "config.h"
 #include <libcouchbase/couchbase.h>
 #include <libcouchbase/metrics.h>
@@ -121,6 +126,7 @@ extern "C" {
 struct lcbio_SSLCTX;
 struct rdb_ALLOCATOR;
 struct lcb_METRICS_st;
+struct lcb_SESSCACHE;
 
 /**
  * Stateless setting structure.
@@ -190,6 +196,17 @@ typedef struct lcb_settings_st {
      * when it is the only request in retry queue */
     unsigned wait_for_config : 1;
     unsigned enable_durable_write : 1;
+    /** Write the file-based configuration cache as a binary snapshot rather than JSON */
+    unsigned config_cache_binary : 1;
+    /** Connect to all data nodes as soon as a configuration is applied */
+    unsigned kv_preconnect : 1;
+    /** Send the whole KV negotiation in one flight when the mechanism is known */
+    unsigned pipeline_negotiation : 1;
+    unsigned tcp_quickack : 1;
+    /** Let the kernel process TLS records once the handshake is complete */
+    unsigned ssl_ktls : 1;
+    /** Log the state transitions of TLS handshakes with a custom logger */
+    unsigned ssl_log_handshake : 1;
 
     lcb_RETRY_STRATEGY retry_strategy;
     short max_redir;
@@ -210,6 +227,8 @@ typedef struct lcb_settings_st {
     void *dtorarg;
     char *client_string;
     lcb_pERRMAP errmap;
+    /** Results of previous negotiations (SASL mechanisms per node, SCRAM salted passwords) */
+    struct lcb_SESSCACHE *sesscache;
     lcb_U32 retry_nmv_interval;
     struct lcb_METRICS_st *metrics;
     lcbtrace_TRACER *tracer;
@@ -220,6 +239,19 @@ typedef struct lcb_settings_st {
     lcb_U32 tracer_threshold[LCBTRACE_THRESHOLD__MAX];
     lcb_U32 compress_min_size;
     float compress_min_ratio;
+    /** Values of at least this size are compressed by worker threads. 0 disables */
+    lcb_U32 compress_async_min_size;
+    lcb_U32 compress_async_threads;
+    /** Socket options applied to new connections. 0 keeps the system default */
+    lcb_U32 tcp_busy_poll;
+    lcb_U32 tcp_rcvbuf;
+    lcb_U32 tcp_sndbuf;
+    lcb_U32 tcp_user_timeout;
+    int ip_tos;
+    /** Number of KV connections (pipelines) to each node */
+    lcb_U32 kv_pool_size;
+    /** Maximum age of cached TLS sessions. 0 disables resumption */
+    lcb_U32 ssl_session_lifetime;
     char *network; /** network resolution, AKA "Multi Network Configurations" */
 } lcb_settings;
 
@@ -249,8 +281,22 @@ void lcb_metrics_destroy(lcb_METRICS *metrics);
 
 lcb_SERVERMETRICS *lcb_metrics_getserver(lcb_METRICS *metrics, const char *host, const char *port, int create);
 
+/** Like lcb_metrics_getserver(), for an additional connection (lane) to the
+ * server. Lane 0 is the server itself */
+lcb_SERVERMETRICS *lcb_metrics_getlane(lcb_METRICS *metrics, const char *host, const char *port, unsigned lane,
+                                       int create);
+
 void lcb_metrics_reset_pipeline_gauges(lcb_SERVERMETRICS *metrics);
 
+/** Defined in mcserver/negotiate.cc */
+struct lcb_SESSCACHE *lcb_sesscache_new(void);
+
+void lcb_sesscache_free(struct lcb_SESSCACHE *cache);
+
+/** Forget the error map read from a node, e.g. because it may have been
+ * restarted with a different server version */
+void lcb_sesscache_forget(struct lcb_SESSCACHE *cache, const char *host, const char *port);
+
 #ifdef __cplusplus
 }
 #endif
@@ -98,6 +98,21 @@ static void appdata_free_flushed(lcbio_CSSL *cs)
     }
 }
 
+/* Skip `nw` bytes which were consumed from the IOV array */
+static void iov_advance(lcb_IOV **iov, lcb_size_t *niov, lcb_SIZE nw)
+{
+    while (nw && *niov) {
+        if ((*iov)->iov_len > nw) {
+            (*iov)->iov_base = (char *)(*iov)->iov_base + nw;
+            (*iov)->iov_len -= nw;
+            return;
+        }
+        nw -= (*iov)->iov_len;
+        (*iov)++;
+        (*niov)--;
+    }
+}
+
 /* This function will attempt to encode pending user data into SSL data. This
  * will be output to the wbio. */
 static void appdata_encode(lcbio_CSSL *cs)
@@ -109,11 +124,10 @@ static void appdata_encode(lcbio_CSSL *cs)
     {
         my_WCTX *ctx = SLLIST_ITEM(cur, my_WCTX, slnode);
 
-        for (; ctx->niov && cs->error == 0; ctx->niov--, ctx->iov++) {
-            int rv;
-
-            lcb_assert(ctx->iov->iov_len);
-            rv = SSL_write(cs->ssl, ctx->iov->iov_base, ctx->iov->iov_len);
+        if (ctx->niov && cs->error == 0) {
+            lcb_SIZE nw;
+            int rv = iotssl_writev((lcbio_XSSL *)cs, ctx->iov, ctx->niov, &nw);
+            iov_advance(&ctx->iov, &ctx->niov, nw);
             if (rv > 0) {
                 continue;
             } else if (maybe_set_error(cs, rv) == 0) {
@@ -130,6 +144,7 @@ static void appdata_encode(lcbio_CSSL *cs)
                 return;
             } else {
                 IOTSSL_ERRNO(cs) = EINVAL;
+                cs->error = 1;
             }
         }
     }
@@ -332,6 +347,7 @@ static int Cssl_write2(lcb_io_opt_t io, lcb_sockdata_t *sd, lcb_IOV *iov, lcb_si
 {
     lcbio_CSSL *cs = CS_FROM_IOPS(io);
     my_WCTX *wc;
+    lcb_SIZE nw = 0;
 
     /* We keep one of these cached inside the cs structure so we don't have
      * to make a new malloc for each write */
@@ -350,16 +366,9 @@ static int Cssl_write2(lcb_io_opt_t io, lcb_sockdata_t *sd, lcb_IOV *iov, lcb_si
     /* If the socket does not have a pending error and there are no other
      * writes before this, then try to write the current buffer immediately. */
     if (cs->error == 0 && SLLIST_IS_EMPTY(&cs->writes)) {
-        unsigned ii;
-        for (ii = 0; ii < niov; ++ii) {
-            int rv = SSL_write(cs->ssl, iov->iov_base, iov->iov_len);
-            if (rv > 0) {
-                iov++;
-                niov--;
-            } else {
-                maybe_set_error(cs, rv);
-                break;
-            }
+        int rv = iotssl_writev((lcbio_XSSL *)cs, iov, niov, &nw);
+        if (rv <= 0) {
+            maybe_set_error(cs, rv);
         }
     }
 
@@ -367,6 +376,13 @@ static int Cssl_write2(lcb_io_opt_t io, lcb_sockdata_t *sd, lcb_IOV *iov, lcb_si
      * no other items were pending */
     sllist_append(&cs->writes, &wc->slnode);
 
+    /* skip the IOVs which were written completely */
+    while (niov && nw >= iov->iov_len) {
+        nw -= iov->iov_len;
+        iov++;
+        niov--;
+    }
+
     /* If we have some IOVs remaining then it means we couldn't write all the
      * data. If so, reschedule and place in the queue for later */
     if (niov && cs->error == 0) {
@@ -374,6 +390,8 @@ static int Cssl_write2(lcb_io_opt_t io, lcb_sockdata_t *sd, lcb_IOV *iov, lcb_si
         wc->iov = malloc(sizeof(*iov) * wc->niov);
         wc->iovroot_ = wc->iov;
         memcpy(wc->iov, iov, sizeof(*iov) * niov);
+        /* the first one may have been written partially */
+        iov_advance(&wc->iov, &wc->niov, nw);
         /* This function will try to schedule the proper events. We need at least
          * one SSL_write() in order to advance the state machine. In the future
          * we could determine if we performed a previous SSL_write above */
@@ -390,6 +408,7 @@ static unsigned Cssl_close(lcb_io_opt_t io, lcb_sockdata_t *sd)
 {
     lcbio_CSSL *cs = CS_FROM_IOPS(io);
     IOT_V1(cs->orig).close(IOT_ARG(cs->orig), sd);
+    iotssl_close_common((lcbio_XSSL *)cs);
     cs->error = 1;
     if (!SLLIST_IS_EMPTY(&cs->writes)) {
         /* It is possible that a prior call to SSL_write returned an SSL_want_read
@@ -24,9 +24,11 @@
 #include "logging.h"
 #include <openssl/err.h>
 #include <openssl/opensslv.h>
+#include <time.h>
 
 #if OPENSSL_VERSION_NUMBER >= 0x1010100fL
 #define HAVE_CIPHERSUITES 1
+#define HAVE_SESSION_IS_RESUMABLE 1
 #endif
 
 #define LOGARGS(ssl, lvl) ((lcbio_SOCKET *)SSL_get_app_data(ssl))->settings, "SSL", lvl, __FILE__, __LINE__
@@ -135,10 +137,20 @@ void iotssl_init_common(lcbio_XSSL *xs, lcbio_TABLE *orig, SSL_CTX *sctx)
 void iotssl_destroy_common(lcbio_XSSL *xs)
 {
     free(xs->iops_dummy_);
+    free(xs->wstage);
     SSL_free(xs->ssl);
     lcbio_table_unref(xs->orig);
 }
 
+void iotssl_close_common(lcbio_XSSL *xs)
+{
+    if (!xs->error) {
+        /* SSL_free() without a close_notify would mark the session as not
+         * resumable */
+        SSL_set_shutdown(xs->ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    }
+}
+
 #if LCB_CAN_OPTIMIZE_SSL_BIO
 void iotssl_bm_reserve(BUF_MEM *bm)
 {
@@ -153,6 +165,70 @@ void iotssl_bm_reserve(BUF_MEM *bm)
 }
 #endif
 
+int iotssl_writev(lcbio_XSSL *xs, const lcb_IOV *iov, lcb_SIZE niov, lcb_SIZE *nw)
+{
+    lcb_SIZE ii = 0, off = 0; /* current position within the IOVs */
+    *nw = 0;
+
+    while (ii < niov) {
+        const char *buf;
+        lcb_SIZE nbuf;
+        int rv;
+
+        if (iov[ii].iov_len == off) {
+            ii++;
+            off = 0;
+            continue;
+        }
+        if (iov[ii].iov_len - off < IOTSSL_RECORD_SIZE && ii != niov - 1 && xs->wstage == NULL) {
+            /* without a staging buffer, small IOVs are written one by one */
+            xs->wstage = malloc(IOTSSL_RECORD_SIZE);
+        }
+        if (iov[ii].iov_len - off >= IOTSSL_RECORD_SIZE || ii == niov - 1 || xs->wstage == NULL) {
+            buf = (const char *)iov[ii].iov_base + off;
+            nbuf = iov[ii].iov_len - off;
+        } else {
+            lcb_SIZE jj = ii, joff = off;
+            for (nbuf = 0; jj < niov && nbuf < IOTSSL_RECORD_SIZE;) {
+                lcb_SIZE ncopy = iov[jj].iov_len - joff;
+                if (ncopy > IOTSSL_RECORD_SIZE - nbuf) {
+                    ncopy = IOTSSL_RECORD_SIZE - nbuf;
+                }
+                memcpy(xs->wstage + nbuf, (const char *)iov[jj].iov_base + joff, ncopy);
+                nbuf += ncopy;
+                joff += ncopy;
+                if (joff == iov[jj].iov_len) {
+                    jj++;
+                    joff = 0;
+                }
+            }
+            buf = xs->wstage;
+        }
+
+        /* Without SSL_MODE_ENABLE_PARTIAL_WRITE this either writes the whole
+         * buffer or fails. The memory BIO never blocks, so failures are fatal
+         * or a renegotiation wanting to read */
+        rv = SSL_write(xs->ssl, buf, nbuf);
+        if (rv <= 0) {
+            return rv;
+        }
+        *nw += nbuf;
+
+        /* skip the bytes just written */
+        while (nbuf) {
+            lcb_SIZE nskip = iov[ii].iov_len - off;
+            if (nskip > nbuf) {
+                off += nbuf;
+                break;
+            }
+            nbuf -= nskip;
+            ii++;
+            off = 0;
+        }
+    }
+    return 1;
+}
+
 void iotssl_log_errors(lcbio_XSSL *xs)
 {
     unsigned long curerr;
@@ -217,6 +293,7 @@ int iotssl_maybe_error(lcbio_XSSL *xs, int rv)
  ** Higher Level SSL_CTX Wrappers                                            **
  ******************************************************************************
  ******************************************************************************/
+#ifndef LCB_NO_SSL_DEBUG
 static void log_callback(const SSL *ssl, int where, int ret)
 {
     const char *retstr = "";
@@ -247,6 +324,7 @@ static void log_callback(const SSL *ssl, int where, int ret)
                 SSL_get_version(ssl), SSL_get_cipher_name(ssl));
     }
 }
+#endif
 
 #if 0
 static void
@@ -259,12 +337,24 @@ msg_callback(int write_p, int version, int ctype, const void *buf, size_t n,
 }
 #endif
 
+/** Last session received from an endpoint */
+typedef struct ssl_CACHEDSESSION {
+    struct ssl_CACHEDSESSION *next;
+    lcb_host_t host;
+    SSL_SESSION *session;
+} ssl_CACHEDSESSION;
+
 struct lcbio_SSLCTX {
     SSL_CTX *ctx;
+    ssl_CACHEDSESSION *sessions;
+    lcb_U64 sess_hits;
+    lcb_U64 sess_misses;
 };
 
 #define LOGARGS_S(settings, lvl) settings, "SSL", lvl, __FILE__, __LINE__
 
+static int new_session_callback(SSL *ssl, SSL_SESSION *session);
+
 static long decode_ssl_protocol(const char *protocol)
 {
     long disallow = SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3;
@@ -368,7 +458,6 @@ lcbio_pSSLCTX lcbio_ssl_new(const char *tsfile, const char *cafile, const char *
         SSL_CTX_set_verify(ret->ctx, SSL_VERIFY_PEER, NULL);
     }
 
-    SSL_CTX_set_info_callback(ret->ctx, log_callback);
 #if 0
     SSL_CTX_set_msg_callback(ret->ctx, msg_callback);
 #endif
@@ -382,6 +471,12 @@ lcbio_pSSLCTX lcbio_ssl_new(const char *tsfile, const char *cafile, const char *
      */
     SSL_CTX_set_mode(ret->ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
     SSL_CTX_set_options(ret->ctx, decode_ssl_protocol(minimum_tls));
+
+    /* Sessions are looked up by endpoint in lcbio_ssl_apply() rather than by
+     * OpenSSL's internal (server side) cache */
+    SSL_CTX_set_app_data(ret->ctx, ret);
+    SSL_CTX_set_session_cache_mode(ret->ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ret->ctx, new_session_callback);
     return ret;
 
 GT_ERR:
@@ -400,13 +495,120 @@ static void noop_dtor(lcbio_PROTOCTX *arg)
     free(arg);
 }
 
+static int same_host(const lcb_host_t *a, const lcb_host_t *b)
+{
+    return strcmp(a->host, b->host) == 0 && strcmp(a->port, b->port) == 0;
+}
+
+/** Pop the session cached for the endpoint, or NULL */
+static ssl_CACHEDSESSION *session_detach(lcbio_pSSLCTX sctx, const lcb_host_t *host)
+{
+    ssl_CACHEDSESSION **pp;
+    for (pp = &sctx->sessions; *pp; pp = &(*pp)->next) {
+        ssl_CACHEDSESSION *cur = *pp;
+        if (same_host(&cur->host, host)) {
+            *pp = cur->next;
+            return cur;
+        }
+    }
+    return NULL;
+}
+
+static void session_free(ssl_CACHEDSESSION *ent)
+{
+    SSL_SESSION_free(ent->session);
+    free(ent);
+}
+
+static int session_is_fresh(SSL_SESSION *session, lcb_U32 lifetime)
+{
+    long age = (long)time(NULL) - SSL_SESSION_get_time(session);
+    if (age < 0 || age >= SSL_SESSION_get_timeout(session) || (lcb_U64)age * 1000000 >= lifetime) {
+        return 0;
+    }
+#ifdef HAVE_SESSION_IS_RESUMABLE
+    return SSL_SESSION_is_resumable(session);
+#else
+    return 1;
+#endif
+}
+
+/** Offer the cached session of the endpoint, if it is still fresh */
+static void session_resume(lcbio_pSSLCTX sctx, lcbio_SOCKET *sock, SSL *ssl)
+{
+    ssl_CACHEDSESSION *ent;
+    lcb_U32 lifetime = sock->settings->ssl_session_lifetime;
+
+    if (lifetime == 0) {
+        return;
+    }
+    ent = session_detach(sctx, lcbio_get_host(sock));
+    if (ent) {
+        if (session_is_fresh(ent->session, lifetime)) {
+            SSL_set_session(ssl, ent->session);
+            /* keep it at the front, as the most recently used */
+            ent->next = sctx->sessions;
+            sctx->sessions = ent;
+            sctx->sess_hits++;
+            return;
+        }
+        session_free(ent);
+    }
+    sctx->sess_misses++;
+}
+
+/* Invoked once a session (or a TLS 1.3 ticket) was received from the server */
+static int new_session_callback(SSL *ssl, SSL_SESSION *session)
+{
+    lcbio_SOCKET *sock = SSL_get_app_data(ssl);
+    lcbio_pSSLCTX sctx = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    ssl_CACHEDSESSION *ent;
+
+    if (sock == NULL || sock->settings->ssl_session_lifetime == 0) {
+        return 0;
+    }
+    ent = session_detach(sctx, lcbio_get_host(sock));
+    if (ent) {
+        SSL_SESSION_free(ent->session);
+    } else {
+        ent = calloc(1, sizeof(*ent));
+        if (ent == NULL) {
+            /* OpenSSL keeps ownership of the session */
+            return 0;
+        }
+        ent->host = *lcbio_get_host(sock);
+    }
+    ent->session = session;
+    ent->next = sctx->sessions;
+    sctx->sessions = ent;
+    lcb_log(LOGARGS(ssl, LCB_LOG_TRACE), "sock=%p: Cached TLS session for " LCB_LOG_SPEC("%s:%s"), (void *)sock,
+            sock->settings->log_redaction ? LCB_LOG_SD_OTAG : "", ent->host.host, ent->host.port,
+            sock->settings->log_redaction ? LCB_LOG_SD_CTAG : "");
+    /* keep the reference */
+    return 1;
+}
+
+void lcbio_ssl_session_stats(lcbio_pSSLCTX sctx, lcbio_SSLSESSIONSTATS *stats)
+{
+    ssl_CACHEDSESSION *cur;
+    memset(stats, 0, sizeof(*stats));
+    if (sctx == NULL) {
+        return;
+    }
+    stats->hits = sctx->sess_hits;
+    stats->misses = sctx->sess_misses;
+    for (cur = sctx->sessions; cur; cur = cur->next) {
+        stats->ncached++;
+    }
+}
+
 lcb_STATUS lcbio_ssl_apply(lcbio_SOCKET *sock, lcbio_pSSLCTX sctx)
 {
     lcbio_pTABLE old_iot = sock->io, new_iot;
     lcbio_PROTOCTX *sproto;
 
     if (old_iot->model == LCB_IOMODEL_EVENT) {
-        new_iot = lcbio_Essl_new(old_iot, sock->u.fd, sctx->ctx);
+        new_iot = lcbio_Essl_new(old_iot, sock->u.fd, sctx->ctx, sock->settings->ssl_ktls);
     } else {
         new_iot = lcbio_Cssl_new(old_iot, sock->u.sd, sctx->ctx);
     }
@@ -418,8 +620,20 @@ lcb_STATUS lcbio_ssl_apply(lcbio_SOCKET *sock, lcbio_pSSLCTX sctx)
         lcbio_protoctx_add(sock, sproto);
         lcbio_table_unref(old_iot);
         sock->io = new_iot;
-        /* just for logging */
+        /* for logging and the session cache */
         SSL_set_app_data(((lcbio_XSSL *)new_iot)->ssl, sock);
+#ifndef LCB_NO_SSL_DEBUG
+        /* OpenSSL invokes the callback on every state transition, so only
+         * install it when its messages would be logged. The level of a custom
+         * logger is unknown, so it has to ask for them. This is evaluated for
+         * each new connection, after any change of the settings or the
+         * logger. */
+        if (lcb_log_enabled(sock->settings, LCB_LOG_DEBUG) &&
+            (sock->settings->logger == lcb_console_logger || sock->settings->ssl_log_handshake)) {
+            SSL_set_info_callback(((lcbio_XSSL *)new_iot)->ssl, log_callback);
+        }
+#endif
+        session_resume(sctx, sock, ((lcbio_XSSL *)new_iot)->ssl);
         return LCB_SUCCESS;
 
     } else {
@@ -438,8 +652,21 @@ lcb_STATUS lcbio_ssl_get_error(lcbio_SOCKET *sock)
     return xs->errcode;
 }
 
+int lcbio_ssl_ktls(lcbio_SOCKET *sock)
+{
+    if (!lcbio_ssl_check(sock)) {
+        return 0;
+    }
+    return ((lcbio_XSSL *)sock->io)->ktls;
+}
+
 void lcbio_ssl_free(lcbio_pSSLCTX ctx)
 {
+    while (ctx->sessions) {
+        ssl_CACHEDSESSION *next = ctx->sessions->next;
+        session_free(ctx->sessions);
+        ctx->sessions = next;
+    }
     SSL_CTX_free(ctx->ctx);
     free(ctx);
 }
@@ -16,6 +16,8 @@
  */
 
 #include "ssl_iot_common.h"
+#include "settings.h"
+#include "logging.h"
 #include <openssl/err.h>
 /**
  * Event-Style SSL Wrapping.
@@ -28,6 +30,13 @@
  *
  * - SSL_want_read() is true
  * - The wbio is not empty
+ *
+ * With LCB_CNTL_SSL_KTLS the memory BIOs are replaced by a socket BIO, so
+ * that OpenSSL can hand the keys over to the kernel at the end of the
+ * handshake. Each direction which the kernel accepted then bypasses OpenSSL
+ * and uses the socket routines of the wrapped table. The other directions
+ * (all of them if the kernel or the cipher does not support kTLS) keep using
+ * SSL_read and SSL_write, which perform the socket I/O themselves.
  */
 
 typedef struct {
@@ -42,6 +51,8 @@ typedef struct {
     lcb_socket_t fd; /**< Socket descriptor */
     lcbio_pTIMER as_fake;
     lcb_SIZE last_nw; /**< Last failed call to SSL_write() */
+    int direct;       /**< OpenSSL performs the socket I/O (kTLS mode) */
+    int handshaked;   /**< Handshake completed in direct mode */
 } lcbio_ESSL;
 
 #ifdef USE_EAGAIN
@@ -53,6 +64,7 @@ typedef struct {
 #endif
 
 #define ES_FROM_IOPS(iops) (lcbio_ESSL *)(IOTSSL_FROM_IOPS(iops))
+#define LOGARGS(es, lvl) ((lcbio_SOCKET *)SSL_get_app_data((es)->ssl))->settings, "SSL", lvl, __FILE__, __LINE__
 #define MINIMUM(a, b) a < b ? a : b
 
 static int maybe_error(lcbio_ESSL *es, int rv)
@@ -77,18 +89,22 @@ static void schedule_pending(lcbio_ESSL *es)
     /* Bitflags of events that the SSL pointer needs in order to progress */
     short wanted = 0;
 
-    IOTSSL_PENDING_PRECHECK(es->ssl);
-    if (IOTSSL_IS_PENDING(es->ssl)) {
-        /* have user data in buffer */
-        avail |= LCB_READ_EVENT;
-    }
+    /* With kTLS, OpenSSL does not read from the socket anymore, and must not
+     * buffer any application data either */
+    if (!(es->ktls & LCBIO_KTLS_RECV)) {
+        IOTSSL_PENDING_PRECHECK(es->ssl);
+        if (IOTSSL_IS_PENDING(es->ssl)) {
+            /* have user data in buffer */
+            avail |= LCB_READ_EVENT;
+        }
 
-    if (SSL_want_read(es->ssl)) {
-        /* SSL need data from the network */
-        wanted |= LCB_READ_EVENT;
+        if (SSL_want_read(es->ssl)) {
+            /* SSL need data from the network */
+            wanted |= LCB_READ_EVENT;
+        }
     }
 
-    if (BIO_ctrl_pending(es->wbio)) {
+    if (es->direct ? SSL_want_write(es->ssl) : BIO_ctrl_pending(es->wbio)) {
         /* have data to flush */
         wanted |= LCB_WRITE_EVENT;
     }
@@ -225,6 +241,77 @@ GT_WRITE_DONE:
     return 0;
 }
 
+/* In direct mode the handshake only progresses when OpenSSL is called. It is
+ * completed before any application data is exchanged, so that a direction
+ * which the kernel took over never has data buffered within OpenSSL */
+static int direct_handshake(lcbio_ESSL *es)
+{
+    int rv;
+    if (es->handshaked) {
+        return 1;
+    }
+    rv = SSL_do_handshake(es->ssl);
+    if (rv != 1) {
+        return rv;
+    }
+    es->handshaked = 1;
+#ifdef BIO_get_ktls_send
+    if (BIO_get_ktls_send(SSL_get_wbio(es->ssl))) {
+        es->ktls |= LCBIO_KTLS_SEND;
+    }
+    if (BIO_get_ktls_recv(SSL_get_rbio(es->ssl))) {
+        es->ktls |= LCBIO_KTLS_RECV;
+    }
+#endif
+    lcb_log(LOGARGS(es, LCB_LOG_DEBUG), "sock=%p: kTLS send=%s, recv=%s (cipher %s)", SSL_get_app_data(es->ssl),
+            (es->ktls & LCBIO_KTLS_SEND) ? "yes" : "no", (es->ktls & LCBIO_KTLS_RECV) ? "yes" : "no",
+            SSL_get_cipher_name(es->ssl));
+    return 1;
+}
+
+/* Returns -1 with the errno set if application data cannot be exchanged yet */
+static int direct_prepare(lcbio_ESSL *es)
+{
+    int rv = direct_handshake(es);
+    if (rv == 1) {
+        return 0;
+    }
+    IOTSSL_ERRNO(es) = maybe_error(es, rv) ? EINVAL : EWOULDBLOCK;
+    return -1;
+}
+
+/* Receive straight from the socket when the kernel decrypts the records.
+ * Returns 0 if the data has to be read through OpenSSL instead */
+static int ktls_recvv(lcbio_ESSL *es, lcb_IOV *iov, lcb_size_t niov, lcb_ssize_t *nr)
+{
+    if (!(es->ktls & LCBIO_KTLS_RECV)) {
+        return 0;
+    }
+    *nr = IOT_V0IO(es->orig).recvv(IOT_ARG(es->orig), es->fd, iov, niov);
+    if (*nr < 0) {
+        if (IOT_ERRNO(es->orig) == EIO) {
+            /* the next record is not application data (e.g. an alert), only
+             * OpenSSL can process it */
+            return 0;
+        }
+        IOTSSL_ERRNO(es) = IOT_ERRNO(es->orig);
+    }
+    return 1;
+}
+
+/* Send straight to the socket when the kernel encrypts the records */
+static int ktls_sendv(lcbio_ESSL *es, lcb_IOV *iov, lcb_size_t niov, lcb_ssize_t *nw)
+{
+    if (!(es->ktls & LCBIO_KTLS_SEND)) {
+        return 0;
+    }
+    *nw = IOT_V0IO(es->orig).sendv(IOT_ARG(es->orig), es->fd, iov, niov);
+    if (*nw < 0) {
+        IOTSSL_ERRNO(es) = IOT_ERRNO(es->orig);
+    }
+    return 1;
+}
+
 /* This is the raw event handler called from the underlying IOPS */
 static void event_handler(lcb_socket_t fd, short which, void *arg)
 {
@@ -233,11 +320,17 @@ static void event_handler(lcb_socket_t fd, short which, void *arg)
     int u_which;
     es->entered++;
 
-    if (which & LCB_READ_EVENT) {
-        rv = read_ssl_data(es);
-    }
-    if (rv == 0 && (which & LCB_WRITE_EVENT)) {
-        rv = flush_ssl_data(es);
+    if (es->direct) {
+        /* OpenSSL reads and writes the socket by itself */
+        rv = direct_handshake(es);
+        rv = (rv == 1 || maybe_error(es, rv) == 0) ? 0 : -1;
+    } else {
+        if (which & LCB_READ_EVENT) {
+            rv = read_ssl_data(es);
+        }
+        if (rv == 0 && (which & LCB_WRITE_EVENT)) {
+            rv = flush_ssl_data(es);
+        }
     }
 
     if (rv == -1) {
@@ -316,9 +409,8 @@ static void stop_watch(lcb_io_opt_t iops, lcb_socket_t sock, void *event)
 }
 
 /** socket routines go here now.. */
-static lcb_ssize_t Essl_recv(lcb_io_opt_t iops, lcb_socket_t sock, void *buf, lcb_size_t nbuf, int ign)
+static lcb_ssize_t ssl_recv(lcbio_ESSL *es, void *buf, lcb_size_t nbuf)
 {
-    lcbio_ESSL *es = ES_FROM_IOPS(iops);
     int rv = SSL_read(es->ssl, buf, nbuf);
 
     if (es->error) {
@@ -336,9 +428,28 @@ static lcb_ssize_t Essl_recv(lcb_io_opt_t iops, lcb_socket_t sock, void *buf, lc
     } else {
         IOTSSL_ERRNO(es) = EWOULDBLOCK;
     }
+    return -1;
+}
+
+static lcb_ssize_t Essl_recv(lcb_io_opt_t iops, lcb_socket_t sock, void *buf, lcb_size_t nbuf, int ign)
+{
+    lcbio_ESSL *es = ES_FROM_IOPS(iops);
     (void)ign;
     (void)sock;
-    return -1;
+
+    if (es->direct && !es->error) {
+        lcb_IOV iov;
+        lcb_ssize_t nr;
+        if (direct_prepare(es) != 0) {
+            return -1;
+        }
+        iov.iov_base = buf;
+        iov.iov_len = nbuf;
+        if (ktls_recvv(es, &iov, 1, &nr)) {
+            return nr;
+        }
+    }
+    return ssl_recv(es, buf, nbuf);
 }
 
 static lcb_ssize_t Essl_send(lcb_io_opt_t iops, lcb_socket_t sock, const void *buf, lcb_size_t nbuf, int ign)
@@ -353,6 +464,19 @@ static lcb_ssize_t Essl_send(lcb_io_opt_t iops, lcb_socket_t sock, const void *b
         return -1;
     }
 
+    if (es->direct) {
+        lcb_IOV iov;
+        lcb_ssize_t nw;
+        if (direct_prepare(es) != 0) {
+            return -1;
+        }
+        iov.iov_base = (void *)buf;
+        iov.iov_len = nbuf;
+        if (ktls_sendv(es, &iov, 1, &nw)) {
+            return nw;
+        }
+    }
+
     rv = SSL_write(es->ssl, buf, nbuf);
     if (rv >= 0) {
         /* still need to schedule data to get flushed to the network */
@@ -369,20 +493,63 @@ static lcb_ssize_t Essl_send(lcb_io_opt_t iops, lcb_socket_t sock, const void *b
 
 static lcb_ssize_t Essl_recvv(lcb_io_opt_t iops, lcb_socket_t sock, lcb_IOV *iov, lcb_size_t niov)
 {
-    (void)niov;
-    return Essl_recv(iops, sock, iov->iov_base, iov->iov_len, 0);
+    lcbio_ESSL *es = ES_FROM_IOPS(iops);
+    (void)sock;
+
+    if (es->direct && !es->error) {
+        lcb_ssize_t nr;
+        if (direct_prepare(es) != 0) {
+            return -1;
+        }
+        /* decrypted data lands in all the buffers at once */
+        if (ktls_recvv(es, iov, niov, &nr)) {
+            return nr;
+        }
+    }
+    return ssl_recv(es, iov->iov_base, iov->iov_len);
 }
 
 static lcb_ssize_t Essl_sendv(lcb_io_opt_t iops, lcb_socket_t sock, lcb_IOV *iov, lcb_size_t niov)
 {
-    (void)niov;
-    return Essl_send(iops, sock, iov->iov_base, iov->iov_len, 0);
+    lcbio_ESSL *es = ES_FROM_IOPS(iops);
+    lcb_SIZE nw;
+    int rv;
+    (void)sock;
+
+    if (es->error) {
+        IOTSSL_ERRNO(es) = EINVAL;
+        return -1;
+    }
+
+    if (es->direct) {
+        lcb_ssize_t knw;
+        if (direct_prepare(es) != 0) {
+            return -1;
+        }
+        if (ktls_sendv(es, iov, niov, &knw)) {
+            return knw;
+        }
+    }
+
+    rv = iotssl_writev((lcbio_XSSL *)es, iov, niov, &nw);
+    if (nw || rv > 0) {
+        /* A failure after some data was consumed is reported by the next call */
+        SCHEDULE_PENDING_SAFE(es);
+        return nw;
+    } else if (maybe_error(es, rv)) {
+        IOTSSL_ERRNO(es) = EINVAL;
+        return -1;
+    } else {
+        IOTSSL_ERRNO(es) = EWOULDBLOCK;
+        return -1;
+    }
 }
 
 static void Essl_close(lcb_io_opt_t iops, lcb_socket_t fd)
 {
     lcbio_ESSL *es = ES_FROM_IOPS(iops);
     IOT_V0IO(es->orig).close(IOT_ARG(es->orig), fd);
+    iotssl_close_common((lcbio_XSSL *)es);
     es->fd = -1;
 }
 
@@ -395,7 +562,7 @@ static void Essl_dtor(void *arg)
     free(es);
 }
 
-lcbio_pTABLE lcbio_Essl_new(lcbio_pTABLE orig, lcb_socket_t fd, SSL_CTX *sctx)
+lcbio_pTABLE lcbio_Essl_new(lcbio_pTABLE orig, lcb_socket_t fd, SSL_CTX *sctx, int ktls)
 {
     lcbio_ESSL *es = calloc(1, sizeof(*es));
     lcbio_TABLE *iot = &es->base_;
@@ -411,5 +578,23 @@ lcbio_pTABLE lcbio_Essl_new(lcbio_pTABLE orig, lcb_socket_t fd, SSL_CTX *sctx)
     iot->u_io.v0.io.close = Essl_close;
     iot->dtor = Essl_dtor;
     iotssl_init_common((lcbio_XSSL *)es, orig, sctx);
+#ifdef __linux__
+    if (ktls) {
+        /* OpenSSL only enables kTLS on sockets it owns */
+        BIO *sbio = BIO_new_socket(fd, BIO_NOCLOSE);
+        SSL_set_bio(es->ssl, sbio, sbio);
+        es->rbio = es->wbio = sbio;
+        es->direct = 1;
+#ifdef SSL_OP_ENABLE_KTLS
+        SSL_set_options(es->ssl, SSL_OP_ENABLE_KTLS);
+#endif
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+        /* report a closed connection like the memory BIOs do */
+        SSL_set_options(es->ssl, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+    }
+#else
+    (void)ktls;
+#endif
     return iot;
 }
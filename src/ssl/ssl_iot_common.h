@@ -34,7 +34,9 @@
     BIO *rbio;                /**< BIO used for reading data from network */                                           \
     lcb_io_opt_t iops_dummy_; /**< Dummy IOPS structure which is exposed to LCB */                                     \
     int error;                /**< Internal error flag set once a fatal error is detect */                             \
-    lcb_STATUS errcode;       /**< The error, converted into libcouchbase */
+    lcb_STATUS errcode;       /**< The error, converted into libcouchbase */                                           \
+    char *wstage;             /**< Staging buffer for coalescing small writes, see iotssl_writev() */            \
+    int ktls;                 /**< Directions handled by kernel TLS, see lcbio_ssl_ktls() */
 
 /**
  * @brief
@@ -81,6 +83,28 @@ typedef struct {
  */
 int iotssl_maybe_error(lcbio_XSSL *xs, int rv);
 
+/** Largest amount of application data carried by a single TLS record */
+#define IOTSSL_RECORD_SIZE SSL3_RT_MAX_PLAIN_LENGTH
+
+/**
+ * @brief Encrypt the contents of an IOV array
+ *
+ * Small buffers are packed together into records of up to IOTSSL_RECORD_SIZE
+ * bytes, rather than paying for the header and MAC of a record per buffer.
+ * Buffers which are large enough to fill a record on their own (and the last
+ * one) are passed to `SSL_write()` in place, so that the common case of a
+ * single buffer is not copied.
+ *
+ * @param xs The XSSL context
+ * @param iov the buffers to write
+ * @param niov number of buffers
+ * @param[out] nw number of bytes consumed from the buffers
+ * @return 1 if all the data was consumed, or the return value of the
+ * `SSL_write()` call which failed. Pass it to iotssl_maybe_error() to find
+ * out whether the write may be retried.
+ */
+int iotssl_writev(lcbio_XSSL *xs, const lcb_IOV *iov, lcb_SIZE niov, lcb_SIZE *nw);
+
 /**
  * Flush errors from the internal error queue. Call this whenever an error
  * has taken place
@@ -109,6 +133,13 @@ void iotssl_init_common(lcbio_XSSL *xs, lcbio_TABLE *orig, SSL_CTX *ctx);
  */
 void iotssl_destroy_common(lcbio_XSSL *xs);
 
+/**
+ * Called when the underlying socket is closed. If no error occurred, the
+ * session is kept resumable even though no close_notify is exchanged.
+ * @param xs the lcbio_XSSL being closed
+ */
+void iotssl_close_common(lcbio_XSSL *xs);
+
 #if LCB_CAN_OPTIMIZE_SSL_BIO
 /**
  * Reserve a specified amount of bytes for reading into a `BUF_MEM*` structure.
@@ -168,8 +199,10 @@ lcbio_pTABLE lcbio_Cssl_new(lcbio_pTABLE orig, lcb_sockdata_t *sd, SSL_CTX *sctx
  * @param orig The original pointer
  * @param fd Socket descriptor
  * @param sctx
+ * @param ktls whether to let OpenSSL perform the socket I/O and try to
+ * offload the record processing to the kernel, see LCB_CNTL_SSL_KTLS
  * @return NULL on error.
  */
-lcbio_pTABLE lcbio_Essl_new(lcbio_pTABLE orig, lcb_socket_t fd, SSL_CTX *sctx);
+lcbio_pTABLE lcbio_Essl_new(lcbio_pTABLE orig, lcb_socket_t fd, SSL_CTX *sctx, int ktls);
 
 #endif
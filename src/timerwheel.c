@@ -0,0 +1,253 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "internal.h"
+#include "timerwheel.h"
+
+/*
+ * A timer lives in the level of the most significant base-64 digit in which
+ * its expiration tick differs from the current tick, in the slot of that
+ * digit. When the lower digits of the current tick wrap around to zero, the
+ * slot matching the new digit of the level above is emptied and its timers
+ * are reinserted, ending up in a lower level.
+ */
+
+#define SLOT_NONE (-1)
+#define SLOT_OVERFLOW (LCB_TW_LEVELS * LCB_TW_SLOTS)
+#define SLOT_MASK (LCB_TW_SLOTS - 1)
+
+static unsigned lowest_bit(lcb_U64 bits)
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctzll(bits);
+#else
+    unsigned ret = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        ret++;
+    }
+    return ret;
+#endif
+}
+
+/** Move all items of `src` to the end of `dst` */
+static void list_splice(lcb_list_t *dst, lcb_list_t *src)
+{
+    if (LCB_LIST_IS_EMPTY(src)) {
+        return;
+    }
+    src->next->prev = dst->prev;
+    dst->prev->next = src->next;
+    src->prev->next = dst;
+    dst->prev = src->prev;
+    lcb_list_init(src);
+}
+
+void lcb_timerwheel_init(lcb_TIMERWHEEL *tw, hrtime_t now)
+{
+    unsigned ii;
+    memset(tw, 0, sizeof(*tw));
+    tw->base = now;
+    for (ii = 0; ii < LCB_TW_LEVELS * LCB_TW_SLOTS; ii++) {
+        lcb_list_init(&tw->slots[ii]);
+    }
+    lcb_list_init(&tw->overflow);
+    lcb_list_init(&tw->due);
+}
+
+void lcb_timerwheel_entry_init(lcb_TWENTRY *ent)
+{
+    memset(ent, 0, sizeof(*ent));
+    ent->slot = SLOT_NONE;
+}
+
+/** Place an entry which expires after the current tick */
+static void insert(lcb_TIMERWHEEL *tw, lcb_TWENTRY *ent)
+{
+    lcb_U64 diff = ent->expires ^ tw->now;
+    unsigned level;
+
+    for (level = 0; level < LCB_TW_LEVELS; level++) {
+        if ((diff >> (LCB_TW_BITS * (level + 1))) == 0) {
+            unsigned slot = (unsigned)(ent->expires >> (LCB_TW_BITS * level)) & SLOT_MASK;
+            ent->slot = (int)(level * LCB_TW_SLOTS + slot);
+            lcb_list_append(&tw->slots[ent->slot], &ent->list);
+            tw->occupied[level] |= (lcb_U64)1 << slot;
+            tw->nwheel++;
+            return;
+        }
+    }
+    ent->slot = SLOT_OVERFLOW;
+    lcb_list_append(&tw->overflow, &ent->list);
+    tw->nwheel++;
+}
+
+void lcb_timerwheel_schedule(lcb_TIMERWHEEL *tw, lcb_TWENTRY *ent, hrtime_t now, lcb_U32 usec)
+{
+    hrtime_t exptime = now + (usec * (hrtime_t)1000);
+
+    lcb_assert(!ent->active);
+    ent->active = 1;
+    if (exptime <= tw->base) {
+        ent->expires = 0;
+    } else {
+        /* round up, so that a timer never fires early */
+        ent->expires = (exptime - tw->base + LCB_TW_TICK - 1) / LCB_TW_TICK;
+    }
+    if (usec == 0 || ent->expires <= tw->now) {
+        ent->slot = SLOT_NONE;
+        lcb_list_append(&tw->due, &ent->list);
+    } else {
+        insert(tw, ent);
+    }
+}
+
+void lcb_timerwheel_cancel(lcb_TIMERWHEEL *tw, lcb_TWENTRY *ent)
+{
+    if (!ent->active) {
+        return;
+    }
+    ent->active = 0;
+    lcb_list_delete(&ent->list);
+    if (ent->slot == SLOT_NONE) {
+        return;
+    }
+    tw->nwheel--;
+    if (ent->slot != SLOT_OVERFLOW && LCB_LIST_IS_EMPTY(&tw->slots[ent->slot])) {
+        tw->occupied[ent->slot / LCB_TW_SLOTS] &= ~((lcb_U64)1 << (ent->slot & SLOT_MASK));
+    }
+    ent->slot = SLOT_NONE;
+}
+
+int lcb_timerwheel_empty(const lcb_TIMERWHEEL *tw)
+{
+    return tw->nwheel == 0 && LCB_LIST_IS_EMPTY(&tw->due);
+}
+
+/** Take all entries off a list and insert them again relative to the current tick */
+static void reinsert(lcb_TIMERWHEEL *tw, lcb_list_t *list, lcb_list_t *expired)
+{
+    lcb_list_t *ll;
+    while ((ll = lcb_list_shift(list)) != NULL) {
+        lcb_TWENTRY *ent = LCB_LIST_ITEM(ll, lcb_TWENTRY, list);
+        tw->nwheel--;
+        if (ent->expires <= tw->now) {
+            ent->slot = SLOT_NONE;
+            lcb_list_append(expired, &ent->list);
+        } else {
+            insert(tw, ent);
+        }
+    }
+}
+
+/** Called when the lowest digit of the current tick wrapped to zero */
+static void cascade(lcb_TIMERWHEEL *tw, lcb_list_t *expired)
+{
+    unsigned level;
+    for (level = 1; level < LCB_TW_LEVELS; level++) {
+        unsigned slot = (unsigned)(tw->now >> (LCB_TW_BITS * level)) & SLOT_MASK;
+        tw->occupied[level] &= ~((lcb_U64)1 << slot);
+        reinsert(tw, &tw->slots[level * LCB_TW_SLOTS + slot], expired);
+        if (slot != 0) {
+            return;
+        }
+    }
+    reinsert(tw, &tw->overflow, expired);
+}
+
+/** Next tick after the current one at which the wheel has something to do */
+static lcb_U64 next_tick(const lcb_TIMERWHEEL *tw)
+{
+    unsigned level;
+    for (level = 0; level < LCB_TW_LEVELS; level++) {
+        unsigned shift = LCB_TW_BITS * level;
+        unsigned digit = (unsigned)(tw->now >> shift) & SLOT_MASK;
+        /* slots of this level which the current tick has not reached yet */
+        lcb_U64 ahead = digit == SLOT_MASK ? 0 : tw->occupied[level] & (~(lcb_U64)0 << (digit + 1));
+        if (ahead) {
+            lcb_U64 start = (tw->now >> (shift + LCB_TW_BITS)) << (shift + LCB_TW_BITS);
+            return start + ((lcb_U64)lowest_bit(ahead) << shift);
+        }
+    }
+    /* only the overflow list remains: wake up when the whole wheel wraps */
+    return ((tw->now >> (LCB_TW_BITS * LCB_TW_LEVELS)) + 1) << (LCB_TW_BITS * LCB_TW_LEVELS);
+}
+
+int lcb_timerwheel_next(const lcb_TIMERWHEEL *tw, hrtime_t now, hrtime_t *delta)
+{
+    hrtime_t exptime;
+    if (!LCB_LIST_IS_EMPTY(&tw->due)) {
+        *delta = 0;
+        return 1;
+    }
+    if (tw->nwheel == 0) {
+        return 0;
+    }
+    exptime = tw->base + next_tick(tw) * LCB_TW_TICK;
+    *delta = exptime > now ? exptime - now : 0;
+    return 1;
+}
+
+void lcb_timerwheel_expire(lcb_TIMERWHEEL *tw, hrtime_t now, lcb_list_t *expired)
+{
+    lcb_U64 target = now > tw->base ? (now - tw->base) / LCB_TW_TICK : 0;
+
+    list_splice(expired, &tw->due);
+    while (tw->now < target) {
+        lcb_U64 next;
+        unsigned slot;
+
+        if (tw->nwheel == 0) {
+            tw->now = target;
+            break;
+        }
+        next = next_tick(tw);
+        if (next > target) {
+            tw->now = target;
+            break;
+        }
+        /* The ticks in between have nothing scheduled. Any cascade on the
+         * way is for an empty upper slot, except for the one at `next` */
+        tw->now = next;
+        if ((next & SLOT_MASK) == 0) {
+            cascade(tw, expired);
+        }
+        slot = (unsigned)next & SLOT_MASK;
+        if (tw->occupied[0] & ((lcb_U64)1 << slot)) {
+            lcb_list_t *ll;
+            tw->occupied[0] &= ~((lcb_U64)1 << slot);
+            LCB_LIST_FOR(ll, &tw->slots[slot])
+            {
+                LCB_LIST_ITEM(ll, lcb_TWENTRY, list)->slot = SLOT_NONE;
+                tw->nwheel--;
+            }
+            list_splice(expired, &tw->slots[slot]);
+        }
+    }
+}
+
+void lcb_timerwheel_drain(lcb_TIMERWHEEL *tw, lcb_list_t *out)
+{
+    unsigned ii;
+    for (ii = 0; ii < LCB_TW_LEVELS * LCB_TW_SLOTS; ii++) {
+        list_splice(out, &tw->slots[ii]);
+    }
+    list_splice(out, &tw->overflow);
+    list_splice(out, &tw->due);
+    memset(tw->occupied, 0, sizeof(tw->occupied));
+    tw->nwheel = 0;
+}
@@ -0,0 +1,123 @@
+/* -*- Mode: C; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef LCB_TIMERWHEEL_H
+#define LCB_TIMERWHEEL_H 1
+
+#include "list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Hierarchical timing wheel, shared by the built-in I/O plugins.
+ *
+ * Expiration times are rounded up to ticks of LCB_TW_TICK nanoseconds, so
+ * that timers expiring within the same tick share a slot and are dispatched
+ * together. Scheduling and cancelling are O(1); timers further away than
+ * the lowest level are moved down ("cascaded") as the wheel turns.
+ *
+ *      lcb_timerwheel_schedule(&wheel, &tm->entry, gethrtime(), usec);
+ *      ...
+ *      lcb_timerwheel_expire(&wheel, gethrtime(), &expired);
+ *      while ((ll = lcb_list_shift(&expired))) {
+ *          lcb_TWENTRY *ent = LCB_LIST_ITEM(ll, lcb_TWENTRY, list);
+ *          ent->active = 0;
+ *          ...
+ *      }
+ */
+
+#define LCB_TW_TICK 1000000 /* 1ms */
+#define LCB_TW_BITS 6
+#define LCB_TW_SLOTS (1 << LCB_TW_BITS)
+#define LCB_TW_LEVELS 4
+
+/** Embed this in the timer structure */
+typedef struct {
+    lcb_list_t list;
+    /** tick at which the timer expires */
+    lcb_U64 expires;
+    /** flat slot index (level * LCB_TW_SLOTS + slot), or -1 */
+    int slot;
+    /** scheduled, or expired but not yet removed from the expired list */
+    int active;
+} lcb_TWENTRY;
+
+typedef struct {
+    hrtime_t base;
+    /** tick the wheel has been advanced to */
+    lcb_U64 now;
+    lcb_list_t slots[LCB_TW_LEVELS * LCB_TW_SLOTS];
+    /** bitmap of the non-empty slots of each level */
+    lcb_U64 occupied[LCB_TW_LEVELS];
+    /** timers beyond the range of the wheel */
+    lcb_list_t overflow;
+    /** timers which were already due when scheduled */
+    lcb_list_t due;
+    /** number of timers in slots or in the overflow list */
+    unsigned nwheel;
+} lcb_TIMERWHEEL;
+
+void lcb_timerwheel_init(lcb_TIMERWHEEL *tw, hrtime_t now);
+
+/** Initialize an entry, so that cancelling it before scheduling is safe */
+void lcb_timerwheel_entry_init(lcb_TWENTRY *ent);
+
+/**
+ * Schedule the entry to expire `usec` microseconds after `now`. The entry
+ * must not be active. Zero-delay timers are dispatched by the next call to
+ * lcb_timerwheel_expire() without waiting for a tick.
+ */
+void lcb_timerwheel_schedule(lcb_TIMERWHEEL *tw, lcb_TWENTRY *ent, hrtime_t now, lcb_U32 usec);
+
+/**
+ * Unschedule the entry. Entries not yet taken off the expired list of
+ * lcb_timerwheel_expire() are removed from it as well.
+ */
+void lcb_timerwheel_cancel(lcb_TIMERWHEEL *tw, lcb_TWENTRY *ent);
+
+/** Check whether there are any scheduled timers */
+int lcb_timerwheel_empty(const lcb_TIMERWHEEL *tw);
+
+/**
+ * Get the time to wait for the next expiration.
+ * @param tw the wheel
+ * @param now the current time
+ * @param[out] delta nanoseconds from `now`. The wheel might be woken up
+ *  earlier than needed for timers in the upper levels.
+ * @return 0 if there are no timers
+ */
+int lcb_timerwheel_next(const lcb_TIMERWHEEL *tw, hrtime_t now, hrtime_t *delta);
+
+/**
+ * Advance the wheel to `now` and append all expired entries to `expired`.
+ * The entries are still marked active: clear the flag when removing them
+ * from the list.
+ */
+void lcb_timerwheel_expire(lcb_TIMERWHEEL *tw, hrtime_t now, lcb_list_t *expired);
+
+/**
+ * Move every scheduled entry to `out`, e.g. to release them when the
+ * wheel is destroyed. The entries are still marked active.
+ */
+void lcb_timerwheel_drain(lcb_TIMERWHEEL *tw, lcb_list_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
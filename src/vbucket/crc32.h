@@ -46,3 +46,19 @@ static uint32_t hash_crc32(const char *key, size_t key_length)
 
     return ((~crc) >> 16) & 0x7fff;
 }
+
+/**
+ * Full 32 bit CRC, used for integrity checks rather than key hashing.
+ * (hash_crc32() truncates the value to 15 bits for vBucket mapping)
+ */
+static uint32_t vb__crc32(const void *buf, size_t nbuf)
+{
+    const unsigned char *p = (const unsigned char *)buf;
+    uint32_t crc = UINT32_MAX;
+    size_t x;
+
+    for (x = 0; x < nbuf; x++)
+        crc = (crc >> 8) ^ crc32tab[(crc ^ p[x]) & 0xff];
+
+    return ~crc;
+}
@@ -21,8 +21,15 @@
 #include <libcouchbase/couchbase.h>
 #include <libcouchbase/vbucket.h>
 #include "config.h"
+#if defined(__GNUC__)
+#define JSONSL_API static __attribute__((unused))
+#elif defined(_MSC_VER)
+#define JSONSL_API static __inline
+#else
+#define JSONSL_API static
+#endif
+#include "contrib/jsonsl/jsonsl.c"
 #include "contrib/cJSON/cJSON.h"
-#include "json-inl.h"
 #include "hash.h"
 #include "crc32.h"
 
@@ -39,57 +46,6 @@
  ** Core Parsing Routines                                                    **
  ******************************************************************************
  ******************************************************************************/
-static lcbvb_VBUCKET *build_vbmap(lcbvb_CONFIG *cfg, cJSON *cj, unsigned *nitems)
-{
-    lcbvb_VBUCKET *vblist = NULL;
-    cJSON *jvb;
-    unsigned ii, nalloc;
-
-    /** FIXME: Realloc dynamically when too small */
-    if (!(nalloc = cJSON_GetArraySize(cj))) {
-        goto GT_ERR;
-    }
-
-    if (!(vblist = calloc(nalloc, sizeof(*vblist)))) {
-        goto GT_ERR;
-    }
-
-    /* Iterate over all the vbuckets */
-    jvb = cj->child;
-    for (ii = 0; ii < nalloc && jvb; ++ii, jvb = jvb->next) {
-        cJSON *jsix;
-        lcbvb_VBUCKET *cvb;
-        unsigned jj, nservers;
-
-        if (jvb->type != cJSON_Array) {
-            goto GT_ERR;
-        }
-
-        nservers = cJSON_GetArraySize(jvb);
-        jsix = jvb->child;
-        cvb = vblist + ii;
-
-        /* Iterate over each index in the vbucket */
-        for (jj = 0; jj < nservers && jsix; ++jj, jsix = jsix->next) {
-            if (jsix->type != cJSON_Number) {
-                goto GT_ERR;
-            }
-            cvb->servers[jj] = jsix->valueint;
-            if (cvb->servers[jj] > (int)cfg->nsrv - 1) {
-                SET_ERRSTR(cfg, "Invalid vBucket map received from server. Above-bounds vBucket target found");
-                goto GT_ERR;
-            }
-        }
-    }
-
-    *nitems = nalloc;
-    return vblist;
-
-GT_ERR:
-    free(vblist);
-    return NULL;
-}
-
 static void copy_address(char *buf, size_t nbuf, const char *host, lcb_U16 port)
 {
     if (strchr(host, ':')) {
@@ -159,18 +115,10 @@ static void set_vb_count(lcbvb_CONFIG *cfg, lcbvb_VBUCKET *vbs)
     }
 }
 
-static int pair_server_list(lcbvb_CONFIG *cfg, cJSON *vbconfig)
+static int pair_server_list(lcbvb_CONFIG *cfg, char **servers, unsigned nsrv)
 {
-    cJSON *servers;
     lcbvb_SERVER *newlist = NULL;
-    unsigned ii, nsrv;
-
-    if (!get_jarray(vbconfig, "serverList", &servers)) {
-        SET_ERRSTR(cfg, "Couldn't find serverList");
-        goto GT_ERROR;
-    }
-
-    nsrv = cJSON_GetArraySize(servers);
+    unsigned ii;
 
     if (nsrv > cfg->nsrv) {
         /* nodes in serverList which are not in nodes/nodesExt */
@@ -187,18 +135,13 @@ static int pair_server_list(lcbvb_CONFIG *cfg, cJSON *vbconfig)
     newlist = calloc(nsrv, sizeof(*cfg->servers));
 
     for (ii = 0; ii < nsrv; ii++) {
-        char *tmp;
-        cJSON *jst;
-        lcbvb_SERVER *cur;
-        jst = cJSON_GetArrayItem(servers, ii);
-        tmp = jst->valuestring;
-        cur = find_server_memd(cfg->servers, cfg->nsrv, tmp);
+        lcbvb_SERVER *cur = find_server_memd(cfg->servers, cfg->nsrv, servers[ii]);
 
         if (cur) {
             newlist[ii] = *cur;
         } else {
             /* found server inside serverList but not in nodes? */
-            if (!assign_dumy_server(cfg, &newlist[ii], tmp)) {
+            if (!assign_dumy_server(cfg, &newlist[ii], servers[ii])) {
                 goto GT_ERROR;
             }
         }
@@ -213,50 +156,6 @@ GT_ERROR:
     return 0;
 }
 
-static int parse_vbucket(lcbvb_CONFIG *cfg, cJSON *cj)
-{
-    cJSON *vbconfig, *vbmap, *ffmap = NULL;
-
-    if (!get_jobj(cj, "vBucketServerMap", &vbconfig)) {
-        SET_ERRSTR(cfg, "Expected top-level 'vBucketServerMap'");
-        goto GT_ERROR;
-    }
-
-    if (!get_juint(vbconfig, "numReplicas", &cfg->nrepl)) {
-        SET_ERRSTR(cfg, "'numReplicas' missing");
-        goto GT_ERROR;
-    }
-
-    if (!get_jarray(vbconfig, "vBucketMap", &vbmap)) {
-        SET_ERRSTR(cfg, "Missing 'vBucketMap'");
-        goto GT_ERROR;
-    }
-
-    get_jarray(vbconfig, "vBucketMapForward", &ffmap);
-
-    if ((cfg->vbuckets = build_vbmap(cfg, vbmap, &cfg->nvb)) == NULL) {
-        goto GT_ERROR;
-    }
-
-    if (ffmap && (cfg->ffvbuckets = build_vbmap(cfg, ffmap, &cfg->nvb)) == NULL) {
-        goto GT_ERROR;
-    }
-
-    if (!cfg->is3x) {
-        if (!pair_server_list(cfg, vbconfig)) {
-            goto GT_ERROR;
-        }
-    }
-
-    /** Now figure out which server goes where */
-    set_vb_count(cfg, cfg->vbuckets);
-    set_vb_count(cfg, cfg->ffvbuckets);
-    return 1;
-
-GT_ERROR:
-    return 0;
-}
-
 static int server_cmp(const void *s1, const void *s2)
 {
     return strcmp(((const lcbvb_SERVER *)s1)->authority, ((const lcbvb_SERVER *)s2)->authority);
@@ -310,36 +209,6 @@ static int update_ketama(lcbvb_CONFIG *cfg)
     return 1;
 }
 
-static int extract_services(lcbvb_CONFIG *cfg, cJSON *jsvc, lcbvb_SERVICES *svc, int is_ssl)
-{
-    int itmp;
-    int rv;
-    const char *key;
-
-#define EXTRACT_SERVICE(k, fld)                                                                                        \
-    key = is_ssl ? k "SSL" : k;                                                                                        \
-    rv = get_jint(jsvc, key, &itmp);                                                                                   \
-    if (rv) {                                                                                                          \
-        svc->fld = itmp;                                                                                               \
-    } else {                                                                                                           \
-        svc->fld = 0;                                                                                                  \
-    }
-
-    EXTRACT_SERVICE("kv", data);
-    EXTRACT_SERVICE("mgmt", mgmt);
-    EXTRACT_SERVICE("capi", views);
-    EXTRACT_SERVICE("n1ql", n1ql);
-    EXTRACT_SERVICE("fts", fts);
-    EXTRACT_SERVICE("indexAdmin", ixadmin);
-    EXTRACT_SERVICE("indexScan", ixquery);
-    EXTRACT_SERVICE("cbas", cbas);
-
-#undef EXTRACT_SERVICE
-
-    (void)cfg;
-    return 1;
-}
-
 static int build_server_strings(lcbvb_CONFIG *cfg, lcbvb_SERVER *server)
 {
     /* get the authority */
@@ -369,53 +238,736 @@ static int build_server_strings(lcbvb_CONFIG *cfg, lcbvb_SERVER *server)
     return 1;
 }
 
+/******************************************************************************
+ ******************************************************************************
+ ** Streaming Parsing Routines                                               **
+ ******************************************************************************
+ ******************************************************************************/
+
+/*
+ * The configuration is lexed in a single pass using jsonsl; no document tree
+ * is built. Each container is tagged when it is pushed, based on the tag of
+ * its parent and the key under which it appears. Scalars are consumed when
+ * they are popped: node information is collected into small temporary
+ * structures (selecting the network needs all of the nodes before any of them
+ * can be built), while vBucket map entries are written directly into the
+ * arrays which are later handed over to the lcbvb_CONFIG. Containers which are
+ * not needed (e.g. 'ddocs') are skipped without invoking any callbacks.
+ */
+
+typedef enum {
+    VBP_T_IGNORE = 0,
+    VBP_T_ROOT,
+    VBP_T_NODES,      /* "nodes" */
+    VBP_T_NODESEXT,   /* "nodesExt" */
+    VBP_T_NODE,       /* element of "nodes" or "nodesExt" */
+    VBP_T_PORTS,      /* "ports" of a 2.x node */
+    VBP_T_SERVICES,   /* "services" of a 3.x node */
+    VBP_T_ALTADDRS,   /* "alternateAddresses" of a node */
+    VBP_T_ALTNET,     /* network within "alternateAddresses" */
+    VBP_T_ALTPORTS,   /* "ports" of an alternate network */
+    VBP_T_BCAPS,      /* "bucketCapabilities" */
+    VBP_T_CCAPS,      /* "clusterCapabilities" */
+    VBP_T_CCAPS_N1QL, /* "clusterCapabilities"/"n1ql" */
+    VBP_T_VBSMAP,     /* "vBucketServerMap" */
+    VBP_T_SERVERLIST, /* "vBucketServerMap"/"serverList" */
+    VBP_T_VBMAP,      /* "vBucketServerMap"/"vBucketMap" */
+    VBP_T_FFMAP,      /* "vBucketServerMap"/"vBucketMapForward" */
+    VBP_T_VBENTRY     /* element of "vBucketMap" or "vBucketMapForward" */
+} vbpTAG;
+
+#define VBP_GET_TAG(st) ((vbpTAG)(size_t)(st)->data)
+#define VBP_SET_TAG(st, t) (st)->data = (void *)(size_t)(t)
+#define VBP_KEY_IS(p, s) ((p)->nkey == sizeof(s) - 1 && memcmp((p)->key, s, sizeof(s) - 1) == 0)
+#define VBP_MAXLEVELS 64
+
+typedef enum { VBP_S_PARSING = 0, VBP_S_COMPLETE, VBP_S_ERROR } vbpSTATUS;
+
+typedef struct {
+    char *name;
+    char *hostname;
+    int has_ports;
+    lcbvb_SERVICES svc;
+    lcbvb_SERVICES svc_ssl;
+} vbpALTNET;
+
+typedef struct {
+    char *hostname;
+    char *couchapi;   /* 2.x "couchApiBase" */
+    int has_ports;    /* 2.x "ports" */
+    int has_direct;   /* 2.x "ports"/"direct" */
+    int direct;
+    int has_services; /* 3.x "services" */
+    lcbvb_SERVICES svc;
+    lcbvb_SERVICES svc_ssl;
+    vbpALTNET *alts;
+    unsigned nalts;
+    unsigned aalts;
+} vbpNODE;
+
+typedef struct {
+    int present;
+    vbpNODE *items;
+    unsigned n;
+    unsigned alloc;
+} vbpNODELIST;
+
+typedef struct {
+    int present;
+    int invalid; /* malformed entry; only an error for vBucket configurations */
+    int maxix;   /* largest server index referenced */
+    lcbvb_VBUCKET *items;
+    unsigned n;
+    unsigned alloc;
+} vbpVBLIST;
+
+typedef struct {
+    lcbvb_CONFIG *cfg;
+    const char *data;
+    const char *key; /* most recently popped hash key */
+    size_t nkey;
+    vbpSTATUS status;
+
+    char *name;
+    int is_cluster_cfg;
+    int have_locator;
+    int have_rev;
+    int have_revepoch;
+    int have_vbsmap;
+    int have_nrepl;
+    int nrepl;
+    vbpNODELIST nodes;
+    vbpNODELIST nodes_ext;
+    vbpNODELIST *curnodes; /* list the current VBP_T_NODE belongs to */
+    int have_serverlist;
+    char **serverlist;
+    unsigned nserverlist;
+    unsigned aserverlist;
+    vbpVBLIST vbmap;
+    vbpVBLIST ffmap;
+    vbpVBLIST *curmap; /* map the current VBP_T_VBENTRY belongs to */
+} vbPARSER;
+
+static int vbp_grow(void **items, unsigned *alloc, unsigned n, size_t size)
+{
+    void *tmp;
+    unsigned nalloc;
+    if (n < *alloc) {
+        return 1;
+    }
+    nalloc = *alloc ? *alloc * 2 : 8;
+    if ((tmp = realloc(*items, nalloc * size)) == NULL) {
+        return 0;
+    }
+    memset((char *)tmp + *alloc * size, 0, (nalloc - *alloc) * size);
+    *items = tmp;
+    *alloc = nalloc;
+    return 1;
+}
+
+static vbpNODE *vbp_add_node(vbpNODELIST *list)
+{
+    if (!vbp_grow((void **)&list->items, &list->alloc, list->n, sizeof(*list->items))) {
+        return NULL;
+    }
+    return list->items + list->n++;
+}
+
+static vbpNODE *vbp_cur_node(vbPARSER *p)
+{
+    return p->curnodes->items + p->curnodes->n - 1;
+}
+
+static vbpALTNET *vbp_cur_altnet(vbPARSER *p)
+{
+    vbpNODE *node = vbp_cur_node(p);
+    return node->alts + node->nalts - 1;
+}
+
+static void vbp_free_nodes(vbpNODELIST *list)
+{
+    unsigned ii, jj;
+    for (ii = 0; ii < list->n; ii++) {
+        vbpNODE *node = list->items + ii;
+        free(node->hostname);
+        free(node->couchapi);
+        for (jj = 0; jj < node->nalts; jj++) {
+            free(node->alts[jj].name);
+            free(node->alts[jj].hostname);
+        }
+        free(node->alts);
+    }
+    free(list->items);
+}
+
 /**
- * Parse a node from the 'nodesExt' array
- * @param cfg
- * @param server
- * @param js
- * @return
+ * Copy a string which was just popped, unescaping it if necessary
  */
-static int build_server_3x(lcbvb_CONFIG *cfg, lcbvb_SERVER *server, cJSON *js, char **network)
+static char *vbp_strndup(const char *s, size_t n, unsigned nescapes)
+{
+    static const int unescapes[128] = {['"'] = 1, ['\\'] = 1, ['/'] = 1, ['b'] = 1, ['f'] = 1,
+                                       ['n'] = 1, ['r'] = 1,  ['t'] = 1, ['u'] = 1};
+    char *ret = malloc(n + 1);
+    if (ret == NULL) {
+        return NULL;
+    }
+    if (nescapes) {
+        jsonsl_error_t err = JSONSL_ERROR_SUCCESS;
+        n = jsonsl_util_unescape(s, ret, n, unescapes, &err);
+        if (err != JSONSL_ERROR_SUCCESS) {
+            free(ret);
+            return NULL;
+        }
+    } else {
+        memcpy(ret, s, n);
+    }
+    ret[n] = '\0';
+    return ret;
+}
+
+static char *vbp_get_str(vbPARSER *p, jsonsl_t jsn, const struct jsonsl_state_st *state)
 {
-    cJSON *jsvcs;
-    char *htmp;
+    return vbp_strndup(p->data + state->pos_begin + 1, jsn->pos - state->pos_begin - 1, state->nescapes);
+}
 
-    if (!get_jstr(js, "hostname", &htmp)) {
-        htmp = "$HOST";
+static int vbp_str_is(vbPARSER *p, jsonsl_t jsn, const struct jsonsl_state_st *state, const char *s)
+{
+    size_t n = jsn->pos - state->pos_begin - 1;
+    return state->nescapes == 0 && strlen(s) == n && memcmp(p->data + state->pos_begin + 1, s, n) == 0;
+}
+
+/**
+ * Extract an integer from a popped value.
+ * @return nonzero if the value is a number, zero otherwise
+ */
+static int vbp_get_int(vbPARSER *p, jsonsl_t jsn, const struct jsonsl_state_st *state, int *value)
+{
+    if (state->type != JSONSL_T_SPECIAL || (state->special_flags & JSONSL_SPECIALf_NUMERIC) == 0) {
+        return 0;
     }
-    if (!(server->hostname = strdup(htmp))) {
-        SET_ERRSTR(cfg, "Couldn't allocate memory");
-        goto GT_ERR;
+    if (state->special_flags & JSONSL_SPECIALf_NUMNOINT) {
+        char buf[64];
+        size_t n = jsn->pos - state->pos_begin;
+        if (n >= sizeof(buf)) {
+            n = sizeof(buf) - 1;
+        }
+        memcpy(buf, p->data + state->pos_begin, n);
+        buf[n] = '\0';
+        *value = (int)strtod(buf, NULL);
+    } else if (state->special_flags & JSONSL_SPECIALf_SIGNED) {
+        *value = -(int)state->nelem;
+    } else {
+        *value = (int)state->nelem;
     }
+    return 1;
+}
 
-    if (!get_jobj(js, "services", &jsvcs)) {
-        SET_ERRSTR(cfg, "Couldn't find 'services'");
-        goto GT_ERR;
+static int vbp_get_int64(vbPARSER *p, jsonsl_t jsn, const struct jsonsl_state_st *state, int64_t *value)
+{
+    char buf[32];
+    size_t n = jsn->pos - state->pos_begin;
+    if (state->type != JSONSL_T_SPECIAL || (state->special_flags & JSONSL_SPECIALf_NUMERIC) == 0 ||
+        (state->special_flags & JSONSL_SPECIALf_NUMNOINT) || n >= sizeof(buf)) {
+        return 0;
+    }
+    memcpy(buf, p->data + state->pos_begin, n);
+    buf[n] = '\0';
+    *value = strtoll(buf, NULL, 10);
+    return 1;
+}
+
+static lcb_U16 *vbp_service_port(lcbvb_SERVICES *svc, lcbvb_SERVICES *svc_ssl, const char *key, size_t nkey)
+{
+    static const struct {
+        const char *name;
+        size_t offset;
+    } ports[] = {{"kv", offsetof(lcbvb_SERVICES, data)},         {"mgmt", offsetof(lcbvb_SERVICES, mgmt)},
+                 {"capi", offsetof(lcbvb_SERVICES, views)},      {"n1ql", offsetof(lcbvb_SERVICES, n1ql)},
+                 {"fts", offsetof(lcbvb_SERVICES, fts)},         {"indexAdmin", offsetof(lcbvb_SERVICES, ixadmin)},
+                 {"indexScan", offsetof(lcbvb_SERVICES, ixquery)}, {"cbas", offsetof(lcbvb_SERVICES, cbas)}};
+    size_t ii;
+
+    if (nkey > 3 && memcmp(key + nkey - 3, "SSL", 3) == 0) {
+        svc = svc_ssl;
+        nkey -= 3;
+    }
+    for (ii = 0; ii < sizeof(ports) / sizeof(ports[0]); ii++) {
+        if (strlen(ports[ii].name) == nkey && memcmp(ports[ii].name, key, nkey) == 0) {
+            return (lcb_U16 *)((char *)svc + ports[ii].offset);
+        }
+    }
+    return NULL;
+}
+
+static vbpTAG vbp_tag_container(vbPARSER *p, vbpTAG parent, const struct jsonsl_state_st *state)
+{
+    int is_object = state->type == JSONSL_T_OBJECT;
+
+    switch (parent) {
+        case VBP_T_ROOT:
+            if (VBP_KEY_IS(p, "buckets")) {
+                /* cluster-level configurations have a 'buckets' object */
+                p->is_cluster_cfg = is_object;
+            } else if (is_object) {
+                if (VBP_KEY_IS(p, "vBucketServerMap") && !p->have_vbsmap) {
+                    p->have_vbsmap = 1;
+                    return VBP_T_VBSMAP;
+                } else if (VBP_KEY_IS(p, "clusterCapabilities")) {
+                    return VBP_T_CCAPS;
+                }
+            } else if (VBP_KEY_IS(p, "nodes") && !p->nodes.present) {
+                p->nodes.present = 1;
+                return VBP_T_NODES;
+            } else if (VBP_KEY_IS(p, "nodesExt") && !p->nodes_ext.present) {
+                p->nodes_ext.present = 1;
+                return VBP_T_NODESEXT;
+            } else if (VBP_KEY_IS(p, "bucketCapabilities")) {
+                return VBP_T_BCAPS;
+            }
+            break;
+
+        case VBP_T_NODES:
+        case VBP_T_NODESEXT:
+            p->curnodes = parent == VBP_T_NODES ? &p->nodes : &p->nodes_ext;
+            if (vbp_add_node(p->curnodes) == NULL) {
+                p->status = VBP_S_ERROR;
+                break;
+            }
+            if (is_object) {
+                return VBP_T_NODE;
+            }
+            break;
+
+        case VBP_T_NODE:
+            if (!is_object) {
+                break;
+            }
+            if (VBP_KEY_IS(p, "ports")) {
+                vbp_cur_node(p)->has_ports = 1;
+                return VBP_T_PORTS;
+            } else if (VBP_KEY_IS(p, "services")) {
+                vbp_cur_node(p)->has_services = 1;
+                return VBP_T_SERVICES;
+            } else if (VBP_KEY_IS(p, "alternateAddresses")) {
+                return VBP_T_ALTADDRS;
+            }
+            break;
+
+        case VBP_T_ALTADDRS:
+            if (is_object) {
+                vbpNODE *node = vbp_cur_node(p);
+                if (!vbp_grow((void **)&node->alts, &node->aalts, node->nalts, sizeof(*node->alts)) ||
+                    (node->alts[node->nalts].name = vbp_strndup(p->key, p->nkey, 0)) == NULL) {
+                    p->status = VBP_S_ERROR;
+                    break;
+                }
+                node->nalts++;
+                return VBP_T_ALTNET;
+            }
+            break;
+
+        case VBP_T_ALTNET:
+            if (is_object && VBP_KEY_IS(p, "ports")) {
+                vbp_cur_altnet(p)->has_ports = 1;
+                return VBP_T_ALTPORTS;
+            }
+            break;
+
+        case VBP_T_CCAPS:
+            if (!is_object && VBP_KEY_IS(p, "n1ql")) {
+                return VBP_T_CCAPS_N1QL;
+            }
+            break;
+
+        case VBP_T_VBSMAP:
+            if (is_object) {
+                break;
+            }
+            if (VBP_KEY_IS(p, "serverList") && !p->have_serverlist) {
+                p->have_serverlist = 1;
+                return VBP_T_SERVERLIST;
+            } else if (VBP_KEY_IS(p, "vBucketMap") && !p->vbmap.present) {
+                p->vbmap.present = 1;
+                return VBP_T_VBMAP;
+            } else if (VBP_KEY_IS(p, "vBucketMapForward") && !p->ffmap.present) {
+                p->ffmap.present = 1;
+                return VBP_T_FFMAP;
+            }
+            break;
+
+        case VBP_T_VBMAP:
+        case VBP_T_FFMAP:
+            p->curmap = parent == VBP_T_VBMAP ? &p->vbmap : &p->ffmap;
+            if (is_object) {
+                p->curmap->invalid = 1;
+                break;
+            }
+            if (!vbp_grow((void **)&p->curmap->items, &p->curmap->alloc, p->curmap->n, sizeof(*p->curmap->items))) {
+                p->status = VBP_S_ERROR;
+                break;
+            }
+            p->curmap->n++;
+            return VBP_T_VBENTRY;
+
+        default:
+            break;
+    }
+    return VBP_T_IGNORE;
+}
+
+static void vbp_push_callback(jsonsl_t jsn, jsonsl_action_t action, struct jsonsl_state_st *state,
+                              const jsonsl_char_t *at)
+{
+    vbPARSER *p = jsn->data;
+    struct jsonsl_state_st *parent;
+    vbpTAG tag;
+
+    if (!JSONSL_STATE_IS_CONTAINER(state)) {
+        /* Scalars are handled when popped */
+        return;
+    }
+
+    parent = jsonsl_last_state(jsn, state);
+    if (parent == NULL) {
+        tag = state->type == JSONSL_T_OBJECT ? VBP_T_ROOT : VBP_T_IGNORE;
+    } else {
+        tag = vbp_tag_container(p, VBP_GET_TAG(parent), state);
+    }
+
+    if (p->status != VBP_S_PARSING) {
+        jsonsl_stop(jsn);
+        return;
+    }
+
+    VBP_SET_TAG(state, tag);
+    if (tag == VBP_T_IGNORE && parent != NULL) {
+        /* Not interested in anything inside this container */
+        state->ignore_callback = 1;
+    }
+    (void)action;
+    (void)at;
+}
+
+static void vbp_pop_value(vbPARSER *p, jsonsl_t jsn, vbpTAG parent, struct jsonsl_state_st *state)
+{
+    lcbvb_CONFIG *cfg = p->cfg;
+    int is_string = state->type == JSONSL_T_STRING;
+    int itmp;
+
+    switch (parent) {
+        case VBP_T_ROOT:
+            if (VBP_KEY_IS(p, "buckets")) {
+                p->is_cluster_cfg = 1;
+            } else if (VBP_KEY_IS(p, "rev")) {
+                if (!p->have_rev && vbp_get_int(p, jsn, state, &itmp)) {
+                    p->have_rev = 1;
+                    cfg->revid = itmp;
+                }
+            } else if (VBP_KEY_IS(p, "revEpoch")) {
+                if (!p->have_revepoch) {
+                    p->have_revepoch = vbp_get_int64(p, jsn, state, &cfg->revepoch);
+                }
+            } else if (!is_string) {
+                break;
+            } else if (VBP_KEY_IS(p, "name")) {
+                if (p->name == NULL && (p->name = vbp_get_str(p, jsn, state)) == NULL) {
+                    p->status = VBP_S_ERROR;
+                }
+            } else if (VBP_KEY_IS(p, "uuid")) {
+                if (cfg->buuid == NULL && (cfg->buuid = vbp_get_str(p, jsn, state)) == NULL) {
+                    p->status = VBP_S_ERROR;
+                }
+            } else if (VBP_KEY_IS(p, "nodeLocator")) {
+                if (!p->have_locator) {
+                    p->have_locator = 1;
+                    cfg->dtype = vbp_str_is(p, jsn, state, "ketama") ? LCBVB_DIST_KETAMA : LCBVB_DIST_VBUCKET;
+                }
+            }
+            break;
+
+        case VBP_T_NODES:
+        case VBP_T_NODESEXT:
+            /* Not an object; building this node will fail */
+            if (vbp_add_node(parent == VBP_T_NODES ? &p->nodes : &p->nodes_ext) == NULL) {
+                p->status = VBP_S_ERROR;
+            }
+            break;
+
+        case VBP_T_NODE:
+            if (is_string) {
+                vbpNODE *node = vbp_cur_node(p);
+                char **dst = NULL;
+                if (VBP_KEY_IS(p, "hostname")) {
+                    dst = &node->hostname;
+                } else if (VBP_KEY_IS(p, "couchApiBase")) {
+                    dst = &node->couchapi;
+                }
+                if (dst && *dst == NULL && (*dst = vbp_get_str(p, jsn, state)) == NULL) {
+                    p->status = VBP_S_ERROR;
+                }
+            }
+            break;
+
+        case VBP_T_PORTS:
+            if (VBP_KEY_IS(p, "direct")) {
+                vbpNODE *node = vbp_cur_node(p);
+                if (!node->has_direct && vbp_get_int(p, jsn, state, &node->direct)) {
+                    node->has_direct = 1;
+                }
+            }
+            break;
+
+        case VBP_T_SERVICES:
+        case VBP_T_ALTPORTS: {
+            lcb_U16 *port;
+            if (parent == VBP_T_SERVICES) {
+                vbpNODE *node = vbp_cur_node(p);
+                port = vbp_service_port(&node->svc, &node->svc_ssl, p->key, p->nkey);
+            } else {
+                vbpALTNET *alt = vbp_cur_altnet(p);
+                port = vbp_service_port(&alt->svc, &alt->svc_ssl, p->key, p->nkey);
+            }
+            if (port && vbp_get_int(p, jsn, state, &itmp)) {
+                *port = itmp;
+            }
+            break;
+        }
+
+        case VBP_T_ALTNET:
+            if (is_string && VBP_KEY_IS(p, "hostname")) {
+                vbpALTNET *alt = vbp_cur_altnet(p);
+                if (alt->hostname == NULL && (alt->hostname = vbp_get_str(p, jsn, state)) == NULL) {
+                    p->status = VBP_S_ERROR;
+                }
+            }
+            break;
+
+        case VBP_T_BCAPS:
+            if (!is_string) {
+                break;
+            } else if (vbp_str_is(p, jsn, state, "xattr")) {
+                cfg->caps |= LCBVB_CAP_XATTR;
+            } else if (vbp_str_is(p, jsn, state, "dcp")) {
+                cfg->caps |= LCBVB_CAP_DCP;
+            } else if (vbp_str_is(p, jsn, state, "cbhello")) {
+                cfg->caps |= LCBVB_CAP_CBHELLO;
+            } else if (vbp_str_is(p, jsn, state, "touch")) {
+                cfg->caps |= LCBVB_CAP_TOUCH;
+            } else if (vbp_str_is(p, jsn, state, "couchapi")) {
+                cfg->caps |= LCBVB_CAP_COUCHAPI;
+            } else if (vbp_str_is(p, jsn, state, "cccp")) {
+                cfg->caps |= LCBVB_CAP_CCCP;
+            } else if (vbp_str_is(p, jsn, state, "xdcrCheckpointing")) {
+                cfg->caps |= LCBVB_CAP_XDCR_CHECKPOINTING;
+            } else if (vbp_str_is(p, jsn, state, "nodesExt")) {
+                cfg->caps |= LCBVB_CAP_NODES_EXT;
+            } else if (vbp_str_is(p, jsn, state, "collections")) {
+                cfg->caps |= LCBVB_CAP_COLLECTIONS;
+            } else if (vbp_str_is(p, jsn, state, "durableWrite")) {
+                cfg->caps |= LCBVB_CAP_DURABLE_WRITE;
+            }
+            break;
+
+        case VBP_T_CCAPS_N1QL:
+            if (is_string && vbp_str_is(p, jsn, state, "enhancedPreparedStatements")) {
+                cfg->ccaps |= LCBVB_CCAP_N1QL_ENHANCED_PREPARED_STATEMENTS;
+            }
+            break;
+
+        case VBP_T_VBSMAP:
+            if (VBP_KEY_IS(p, "numReplicas") && !p->have_nrepl) {
+                p->have_nrepl = vbp_get_int(p, jsn, state, &p->nrepl);
+            }
+            break;
+
+        case VBP_T_SERVERLIST:
+            if (!is_string) {
+                SET_ERRSTR(cfg, "Expected string in 'serverList'");
+                p->status = VBP_S_ERROR;
+            } else if (!vbp_grow((void **)&p->serverlist, &p->aserverlist, p->nserverlist, sizeof(*p->serverlist)) ||
+                       (p->serverlist[p->nserverlist++] = vbp_get_str(p, jsn, state)) == NULL) {
+                p->status = VBP_S_ERROR;
+            }
+            break;
+
+        case VBP_T_VBMAP:
+            p->vbmap.invalid = 1;
+            break;
+
+        case VBP_T_FFMAP:
+            p->ffmap.invalid = 1;
+            break;
+
+        case VBP_T_VBENTRY: {
+            struct jsonsl_state_st *entry = jsonsl_last_state(jsn, state);
+            lcbvb_VBUCKET *vb = p->curmap->items + p->curmap->n - 1;
+            size_t ix = entry->nelem - 1;
+            if (!vbp_get_int(p, jsn, state, &itmp) || ix >= sizeof(vb->servers) / sizeof(vb->servers[0])) {
+                p->curmap->invalid = 1;
+            } else {
+                vb->servers[ix] = itmp;
+                if (itmp > p->curmap->maxix) {
+                    p->curmap->maxix = itmp;
+                }
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static void vbp_pop_callback(jsonsl_t jsn, jsonsl_action_t action, struct jsonsl_state_st *state,
+                             const jsonsl_char_t *at)
+{
+    vbPARSER *p = jsn->data;
+    struct jsonsl_state_st *parent;
+
+    if (state->type == JSONSL_T_HKEY) {
+        p->key = p->data + state->pos_begin + 1;
+        p->nkey = jsn->pos - state->pos_begin - 1;
+        return;
+    }
+
+    parent = jsonsl_last_state(jsn, state);
+    if (parent == NULL) {
+        if (JSONSL_STATE_IS_CONTAINER(state)) {
+            /* Anything following the top-level value is ignored */
+            p->status = VBP_S_COMPLETE;
+        }
+    } else if (!JSONSL_STATE_IS_CONTAINER(state)) {
+        vbp_pop_value(p, jsn, VBP_GET_TAG(parent), state);
     }
 
-    if (!extract_services(cfg, jsvcs, &server->svc, 0)) {
+    if (p->status != VBP_S_PARSING) {
+        jsonsl_stop(jsn);
+    }
+    (void)action;
+    (void)at;
+}
+
+static int vbp_error_callback(jsonsl_t jsn, jsonsl_error_t err, struct jsonsl_state_st *state, jsonsl_char_t *at)
+{
+    vbPARSER *p = jsn->data;
+    p->status = VBP_S_ERROR;
+    (void)err;
+    (void)state;
+    (void)at;
+    return 0;
+}
+
+static void vbp_cleanup(vbPARSER *p)
+{
+    unsigned ii;
+    free(p->name);
+    vbp_free_nodes(&p->nodes);
+    vbp_free_nodes(&p->nodes_ext);
+    for (ii = 0; ii < p->nserverlist; ii++) {
+        free(p->serverlist[ii]);
+    }
+    free(p->serverlist);
+    free(p->vbmap.items);
+    free(p->ffmap.items);
+}
+
+/**
+ * Lex the configuration, storing everything needed into the parser.
+ * @return The final parser status
+ */
+static vbpSTATUS vbp_scan(vbPARSER *p, const char *data)
+{
+    jsonsl_t jsn = jsonsl_new(VBP_MAXLEVELS);
+    if (jsn == NULL) {
+        return VBP_S_ERROR;
+    }
+
+    jsonsl_enable_all_callbacks(jsn);
+    jsn->action_callback_PUSH = vbp_push_callback;
+    jsn->action_callback_POP = vbp_pop_callback;
+    jsn->error_callback = vbp_error_callback;
+    jsn->data = p;
+
+    p->data = data;
+    jsonsl_feed(jsn, data, strlen(data));
+    jsonsl_destroy(jsn);
+
+    if (p->status == VBP_S_PARSING) {
+        /* Ran out of input before the top-level value was complete */
+        p->status = VBP_S_ERROR;
+    }
+    return p->status;
+}
+
+/**
+ * Pick the network which contains the address we bootstrapped from
+ */
+static char *vbp_guess_network(const vbpNODELIST *nodes, const char *source)
+{
+    unsigned ii, jj;
+    for (ii = 0; ii < nodes->n && source; ii++) {
+        const vbpNODE *node = nodes->items + ii;
+        if (node->hostname && strcmp(node->hostname, source) == 0) {
+            return strdup("default");
+        }
+        for (jj = 0; jj < node->nalts; jj++) {
+            if (node->alts[jj].hostname && strcmp(node->alts[jj].hostname, source) == 0) {
+                return strdup(node->alts[jj].name);
+            }
+        }
+    }
+    return strdup("default");
+}
+
+/**
+ * Build a server from a 'nodesExt' entry
+ */
+static int build_server_3x(lcbvb_CONFIG *cfg, lcbvb_SERVER *server, const vbpNODE *node, char **network)
+{
+    const char *htmp = node->hostname ? node->hostname : "$HOST";
+
+    if (!(server->hostname = strdup(htmp))) {
+        SET_ERRSTR(cfg, "Couldn't allocate memory");
         goto GT_ERR;
     }
-    if (!extract_services(cfg, jsvcs, &server->svc_ssl, 1)) {
+
+    if (!node->has_services) {
+        SET_ERRSTR(cfg, "Couldn't find 'services'");
         goto GT_ERR;
     }
+    server->svc.data = node->svc.data;
+    server->svc.mgmt = node->svc.mgmt;
+    server->svc.views = node->svc.views;
+    server->svc.n1ql = node->svc.n1ql;
+    server->svc.fts = node->svc.fts;
+    server->svc.ixadmin = node->svc.ixadmin;
+    server->svc.ixquery = node->svc.ixquery;
+    server->svc.cbas = node->svc.cbas;
+    server->svc_ssl.data = node->svc_ssl.data;
+    server->svc_ssl.mgmt = node->svc_ssl.mgmt;
+    server->svc_ssl.views = node->svc_ssl.views;
+    server->svc_ssl.n1ql = node->svc_ssl.n1ql;
+    server->svc_ssl.fts = node->svc_ssl.fts;
+    server->svc_ssl.ixadmin = node->svc_ssl.ixadmin;
+    server->svc_ssl.ixquery = node->svc_ssl.ixquery;
+    server->svc_ssl.cbas = node->svc_ssl.cbas;
 
     if (!build_server_strings(cfg, server)) {
         goto GT_ERR;
     }
 
     if (network && *network && strcmp(*network, "default") != 0) {
-        cJSON *jaltaddr = cJSON_GetObjectItem(js, "alternateAddresses");
-        if (jaltaddr && jaltaddr->type == cJSON_Object) {
-            cJSON *jnetwork = cJSON_GetObjectItem(jaltaddr, *network);
-            if (jnetwork && get_jstr(jnetwork, "hostname", &htmp)) {
-                cJSON *jports;
-                server->alt_hostname = strdup(htmp);
-                jports = cJSON_GetObjectItem(jnetwork, "ports");
-                if (jports && jports->type == cJSON_Object) {
-                    extract_services(cfg, jports, &server->alt_svc, 0);
-                    extract_services(cfg, jports, &server->alt_svc_ssl, 1);
+        unsigned ii;
+        for (ii = 0; ii < node->nalts; ii++) {
+            const vbpALTNET *alt = node->alts + ii;
+            if (strcmp(alt->name, *network) != 0) {
+                continue;
+            }
+            if (alt->hostname) {
+                server->alt_hostname = strdup(alt->hostname);
+                if (alt->has_ports) {
+                    server->alt_svc = alt->svc;
+                    server->alt_svc_ssl = alt->svc_ssl;
                 }
 
 #define COPY_SERVICE(src, dst)                                                                                         \
@@ -441,6 +993,7 @@ static int build_server_3x(lcbvb_CONFIG *cfg, lcbvb_SERVER *server, cJSON *js, c
 
 #undef COPY_SERVICE
             }
+            break;
         }
     }
 
@@ -451,24 +1004,20 @@ GT_ERR:
 }
 
 /**
- * Initialize a server from a JSON Object
- * @param server The server to initialize
- * @param js The object which contains the server information
- * @return nonzero on success, 0 on failure.
+ * Build a server from a 'nodes' entry
  */
-static int build_server_2x(lcbvb_CONFIG *cfg, lcbvb_SERVER *server, cJSON *js)
+static int build_server_2x(lcbvb_CONFIG *cfg, lcbvb_SERVER *server, const vbpNODE *node)
 {
-    char *tmp = NULL, *colon;
+    char *colon;
     int itmp;
-    cJSON *jsports;
 
-    if (!get_jstr(js, "hostname", &tmp)) {
+    if (!node->hostname) {
         SET_ERRSTR(cfg, "Couldn't find hostname");
         goto GT_ERR;
     }
 
     /** Hostname is the _rest_ API host, e.g. '8091' */
-    if ((server->hostname = strdup(tmp)) == NULL) {
+    if ((server->hostname = strdup(node->hostname)) == NULL) {
         SET_ERRSTR(cfg, "Couldn't allocate hostname");
         goto GT_ERR;
     }
@@ -488,10 +1037,10 @@ static int build_server_2x(lcbvb_CONFIG *cfg, lcbvb_SERVER *server, cJSON *js)
     *colon = '\0';
 
     /** Handle the views name */
-    if (get_jstr(js, "couchApiBase", &tmp)) {
+    if (node->couchapi) {
         /** Have views */
-        char *path_begin;
-        colon = strrchr(tmp, ':');
+        const char *path_begin;
+        colon = strrchr(node->couchapi, ':');
 
         if (!colon) {
             /* no port */
@@ -514,14 +1063,14 @@ static int build_server_2x(lcbvb_CONFIG *cfg, lcbvb_SERVER *server, cJSON *js)
     }
 
     /* get the 'ports' dictionary */
-    if (!get_jobj(js, "ports", &jsports)) {
+    if (!node->has_ports) {
         SET_ERRSTR(cfg, "Expected 'ports' dictionary");
         goto GT_ERR;
     }
 
     /* memcached port */
-    if (get_jint(jsports, "direct", &itmp)) {
-        server->svc.data = itmp;
+    if (node->has_direct) {
+        server->svc.data = node->direct;
     } else {
         SET_ERRSTR(cfg, "Expected 'direct' field in 'ports'");
         goto GT_ERR;
@@ -531,181 +1080,149 @@ static int build_server_2x(lcbvb_CONFIG *cfg, lcbvb_SERVER *server, cJSON *js)
     if (!build_server_strings(cfg, server)) {
         goto GT_ERR;
     }
-    return 1;
+    return 1;
+
+GT_ERR:
+    return 0;
+}
+
+/**
+ * Validate a vBucket map and hand it over to the configuration
+ */
+static lcbvb_VBUCKET *build_vbmap(lcbvb_CONFIG *cfg, vbpVBLIST *list, unsigned *nitems)
+{
+    lcbvb_VBUCKET *vblist = list->items;
+
+    if (!list->n || list->invalid) {
+        return NULL;
+    }
+    if (list->maxix > (int)cfg->nsrv - 1) {
+        SET_ERRSTR(cfg, "Invalid vBucket map received from server. Above-bounds vBucket target found");
+        return NULL;
+    }
+
+    list->items = NULL;
+    *nitems = list->n;
+    return vblist;
+}
+
+static int parse_vbucket(lcbvb_CONFIG *cfg, vbPARSER *p)
+{
+    if (!p->have_vbsmap) {
+        SET_ERRSTR(cfg, "Expected top-level 'vBucketServerMap'");
+        goto GT_ERROR;
+    }
+
+    if (!p->have_nrepl) {
+        SET_ERRSTR(cfg, "'numReplicas' missing");
+        goto GT_ERROR;
+    }
+    if (p->nrepl < 0 || p->nrepl > 3) {
+        SET_ERRSTR(cfg, "Invalid 'numReplicas'");
+        goto GT_ERROR;
+    }
+    cfg->nrepl = p->nrepl;
+
+    if (!p->vbmap.present) {
+        SET_ERRSTR(cfg, "Missing 'vBucketMap'");
+        goto GT_ERROR;
+    }
+
+    if ((cfg->vbuckets = build_vbmap(cfg, &p->vbmap, &cfg->nvb)) == NULL) {
+        goto GT_ERROR;
+    }
 
-GT_ERR:
-    return 0;
-}
+    if (p->ffmap.present && (cfg->ffvbuckets = build_vbmap(cfg, &p->ffmap, &cfg->nvb)) == NULL) {
+        goto GT_ERROR;
+    }
 
-static void guess_network(cJSON *jnodes, int nsrv, const char *source, char **network)
-{
-    int ii;
-    for (ii = 0; ii < nsrv; ii++) {
-        cJSON *jsrv = cJSON_GetArrayItem(jnodes, ii);
-        {
-            cJSON *jhostname = cJSON_GetObjectItem(jsrv, "hostname");
-            if (jhostname && jhostname->type == cJSON_String) {
-                if (strcmp(jhostname->valuestring, source) == 0) {
-                    *network = strdup("default");
-                    return;
-                }
-            }
+    if (!cfg->is3x) {
+        if (!p->have_serverlist) {
+            SET_ERRSTR(cfg, "Couldn't find serverList");
+            goto GT_ERROR;
         }
-        {
-            cJSON *jaltaddr = cJSON_GetObjectItem(jsrv, "alternateAddresses");
-            if (jaltaddr && jaltaddr->type == cJSON_Object) {
-                cJSON *cur;
-                for (cur = jaltaddr->child; cur != NULL; cur = cur->next) {
-                    if (cur->type == cJSON_Object) {
-                        cJSON *jhostname = cJSON_GetObjectItem(cur, "hostname");
-                        if (jhostname && jhostname->type == cJSON_String) {
-                            if (strcmp(jhostname->valuestring, source) == 0) {
-                                *network = strdup(cur->string);
-                                return;
-                            }
-                        }
-                    }
-                }
-            }
+        if (!pair_server_list(cfg, p->serverlist, p->nserverlist)) {
+            goto GT_ERROR;
         }
     }
-    *network = strdup("default");
+
+    /** Now figure out which server goes where */
+    set_vb_count(cfg, cfg->vbuckets);
+    set_vb_count(cfg, cfg->ffvbuckets);
+    return 1;
+
+GT_ERROR:
+    return 0;
 }
 
 int lcbvb_load_json_ex(lcbvb_CONFIG *cfg, const char *data, const char *source, char **network)
 {
-    cJSON *cj = NULL, *jnodes_ext = NULL, *jnodes = NULL, *buckets = NULL;
-    char *tmp = NULL;
-    unsigned ii, jnodes_size = 0;
-    int jnodes_defined = 0;
-    int is_cluster_cfg = 0;
+    vbPARSER parser;
+    vbpNODELIST *jnodes = NULL;
+    vbpSTATUS status;
+    unsigned ii;
+    int ret = -1;
 
-    if ((cj = cJSON_Parse(data)) == NULL) {
-        SET_ERRSTR(cfg, "Couldn't parse JSON");
-        goto GT_ERROR;
-    }
+    memset(&parser, 0, sizeof(parser));
+    parser.cfg = cfg;
+    parser.vbmap.maxix = -1;
+    parser.ffmap.maxix = -1;
+    cfg->dtype = LCBVB_DIST_UNKNOWN;
+    cfg->caps = 0;
+    cfg->ccaps = 0;
 
-    buckets = cJSON_GetObjectItem(cj, "buckets");
-    if (buckets != NULL && buckets->type != cJSON_Array) {
-        is_cluster_cfg = 1;
+    status = vbp_scan(&parser, data);
+    if (status != VBP_S_COMPLETE) {
+        SET_ERRSTR(cfg, "Couldn't parse JSON");
+        goto GT_DONE;
     }
 
-    if (!is_cluster_cfg && get_jstr(cj, "name", &tmp)) {
-        cfg->bname = strdup(tmp);
+    if (!parser.is_cluster_cfg && parser.name) {
+        cfg->bname = parser.name;
         cfg->bname_len = strlen(cfg->bname);
+        parser.name = NULL;
     }
 
-    cfg->dtype = LCBVB_DIST_UNKNOWN;
-    if (get_jstr(cj, "nodeLocator", &tmp)) {
-        if (!strcmp(tmp, "ketama")) {
-            cfg->dtype = LCBVB_DIST_KETAMA;
-        } else {
-            cfg->dtype = LCBVB_DIST_VBUCKET;
-        }
-    }
-
-    if (get_jstr(cj, "uuid", &tmp)) {
-        cfg->buuid = strdup(tmp);
-    }
-
-    if (!get_jint(cj, "rev", &cfg->revid)) {
+    if (!parser.have_rev) {
         cfg->revid = -1;
     }
 
-    get_jarray(cj, "nodes", &jnodes);
-    if (jnodes) {
-        jnodes_defined = 1;
-        jnodes_size = cJSON_GetArraySize(jnodes);
-    }
-    if (get_jarray(cj, "nodesExt", &jnodes_ext)) {
+    if (parser.nodes_ext.present) {
         cfg->is3x = 1;
-        cfg->nsrv = cJSON_GetArraySize(jnodes_ext);
-        jnodes = jnodes_ext;
-    } else if (jnodes == NULL) {
+        jnodes = &parser.nodes_ext;
+    } else if (parser.nodes.present) {
+        jnodes = &parser.nodes;
+    } else {
         SET_ERRSTR(cfg, "expected 'nodesExt' or 'nodes' array");
-        goto GT_ERROR;
-    }
-
-    cfg->caps = 0;
-    {
-        cJSON *jcaps = NULL;
-        if (get_jarray(cj, "bucketCapabilities", &jcaps)) {
-            unsigned ncaps = cJSON_GetArraySize(jcaps);
-            for (ii = 0; ii < ncaps; ii++) {
-                cJSON *jcap = cJSON_GetArrayItem(jcaps, ii);
-                if (jcap && jcap->type == cJSON_String) {
-                    if (strcmp(jcap->valuestring, "xattr") == 0) {
-                        cfg->caps |= LCBVB_CAP_XATTR;
-                    } else if (strcmp(jcap->valuestring, "dcp") == 0) {
-                        cfg->caps |= LCBVB_CAP_DCP;
-                    } else if (strcmp(jcap->valuestring, "cbhello") == 0) {
-                        cfg->caps |= LCBVB_CAP_CBHELLO;
-                    } else if (strcmp(jcap->valuestring, "touch") == 0) {
-                        cfg->caps |= LCBVB_CAP_TOUCH;
-                    } else if (strcmp(jcap->valuestring, "couchapi") == 0) {
-                        cfg->caps |= LCBVB_CAP_COUCHAPI;
-                    } else if (strcmp(jcap->valuestring, "cccp") == 0) {
-                        cfg->caps |= LCBVB_CAP_CCCP;
-                    } else if (strcmp(jcap->valuestring, "xdcrCheckpointing") == 0) {
-                        cfg->caps |= LCBVB_CAP_XDCR_CHECKPOINTING;
-                    } else if (strcmp(jcap->valuestring, "nodesExt") == 0) {
-                        cfg->caps |= LCBVB_CAP_NODES_EXT;
-                    } else if (strcmp(jcap->valuestring, "collections") == 0) {
-                        cfg->caps |= LCBVB_CAP_COLLECTIONS;
-                    } else if (strcmp(jcap->valuestring, "durableWrite") == 0) {
-                        cfg->caps |= LCBVB_CAP_DURABLE_WRITE;
-                    }
-                }
-            }
-        }
-    }
-    cfg->ccaps = 0;
-    {
-        cJSON *jcaps = NULL;
-        if (get_jobj(cj, "clusterCapabilities", &jcaps)) {
-            cJSON *jn1ql = NULL;
-            if (get_jarray(jcaps, "n1ql", &jn1ql)) {
-                unsigned ncaps = cJSON_GetArraySize(jn1ql);
-                for (ii = 0; ii < ncaps; ii++) {
-                    cJSON *jcap = cJSON_GetArrayItem(jn1ql, ii);
-                    if (jcap && jcap->type == cJSON_String) {
-                        if (strcmp(jcap->valuestring, "enhancedPreparedStatements") == 0) {
-                            cfg->ccaps |= LCBVB_CCAP_N1QL_ENHANCED_PREPARED_STATEMENTS;
-                        }
-                    }
-                }
-            }
-        }
+        goto GT_DONE;
     }
 
-    /** Get the number of nodes. This traverses the list. Yuck */
-    cfg->nsrv = cJSON_GetArraySize(jnodes);
+    cfg->nsrv = jnodes->n;
 
     if (network && *network == NULL) {
-        guess_network(jnodes, cfg->nsrv, source, network);
+        *network = vbp_guess_network(jnodes, source);
     }
 
-    /** Allocate a temporary one on the heap */
     cfg->servers = calloc(cfg->nsrv, sizeof(*cfg->servers));
     for (ii = 0; ii < cfg->nsrv; ii++) {
-        int rv;
-        cJSON *jsrv = cJSON_GetArrayItem(jnodes, ii);
+        int rv = 0;
+        const vbpNODE *node = jnodes->items + ii;
 
         if (cfg->is3x) {
-            rv = build_server_3x(cfg, cfg->servers + ii, jsrv, network);
-            if (jnodes_defined && rv && ii >= jnodes_size) {
+            rv = build_server_3x(cfg, cfg->servers + ii, node, network);
+            if (parser.nodes.present && rv && ii >= parser.nodes.n) {
                 cfg->servers[ii].svc.data = 0;
                 cfg->servers[ii].svc_ssl.data = 0;
                 cfg->servers[ii].alt_svc.data = 0;
                 cfg->servers[ii].alt_svc_ssl.data = 0;
             }
         } else {
-            rv = build_server_2x(cfg, cfg->servers + ii, jsrv);
+            rv = build_server_2x(cfg, cfg->servers + ii, node);
         }
 
         if (!rv) {
             SET_ERRSTR(cfg, "Failed to build server");
-            goto GT_ERROR;
+            goto GT_DONE;
         }
     }
 
@@ -719,9 +1236,9 @@ int lcbvb_load_json_ex(lcbvb_CONFIG *cfg, const char *data, const char *source,
     cfg->ndatasrv = ii;
 
     if (cfg->dtype == LCBVB_DIST_VBUCKET) {
-        if (!parse_vbucket(cfg, cj)) {
+        if (!parse_vbucket(cfg, &parser)) {
             SET_ERRSTR(cfg, "Failed to parse vBucket map");
-            goto GT_ERROR;
+            goto GT_DONE;
         }
     } else {
         /* If there is no $HOST then we can update the ketama config, otherwise
@@ -734,14 +1251,11 @@ int lcbvb_load_json_ex(lcbvb_CONFIG *cfg, const char *data, const char *source,
     }
     cfg->servers = realloc(cfg->servers, sizeof(*cfg->servers) * cfg->nsrv);
     cfg->randbuf = malloc(cfg->nsrv * sizeof(*cfg->randbuf));
-    cJSON_Delete(cj);
-    return 0;
+    ret = 0;
 
-GT_ERROR:
-    if (cj) {
-        cJSON_Delete(cj);
-    }
-    return -1;
+GT_DONE:
+    vbp_cleanup(&parser);
+    return ret;
 }
 
 int lcbvb_load_json(lcbvb_CONFIG *cfg, const char *data)
@@ -749,6 +1263,105 @@ int lcbvb_load_json(lcbvb_CONFIG *cfg, const char *data)
     return lcbvb_load_json_ex(cfg, data, NULL, NULL);
 }
 
+/**
+ * Read an integer following the ':' of a key, skipping whitespace.
+ * @return pointer to the first character after the number, or NULL if the
+ * value is not an integer
+ */
+static const char *peek_int(const char *cur, const char *end, int64_t *value)
+{
+    int64_t n = 0;
+    int neg = 0;
+    const char *begin;
+
+    while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\r' || *cur == '\n')) {
+        cur++;
+    }
+    if (cur < end && *cur == '-') {
+        neg = 1;
+        cur++;
+    }
+    for (begin = cur; cur < end && *cur >= '0' && *cur <= '9'; cur++) {
+        n = n * 10 + (*cur - '0');
+    }
+    if (cur == begin || (cur < end && (*cur == '.' || *cur == 'e' || *cur == 'E'))) {
+        return NULL;
+    }
+    *value = neg ? -n : n;
+    return cur;
+}
+
+int lcbvb_peek_revision(const char *data, size_t ndata, int64_t *epoch, int64_t *rev)
+{
+    const char *cur = data, *end = data + ndata;
+    const char *key = NULL;
+    size_t nkey = 0;
+    int depth = 0, have_rev = 0, have_epoch = 0;
+
+    *epoch = 0;
+    *rev = -1;
+
+    /* Only the structure is tracked: strings are skipped (honoring escapes)
+     * and a top-level string followed by ':' is taken as a key */
+    for (; cur < end && !(have_rev && have_epoch); cur++) {
+        switch (*cur) {
+            case '"': {
+                const char *begin = cur + 1;
+                for (cur = begin; cur < end && *cur != '"'; cur++) {
+                    if (*cur == '\\') {
+                        cur++;
+                    }
+                }
+                if (cur >= end) {
+                    return have_rev;
+                }
+                key = depth == 1 ? begin : NULL;
+                nkey = cur - begin;
+                break;
+            }
+            case ':': {
+                const char *next;
+                int64_t value;
+                if (key == NULL || (next = peek_int(cur + 1, end, &value)) == NULL) {
+                    key = NULL;
+                    break;
+                }
+                if (nkey == 3 && memcmp(key, "rev", 3) == 0 && !have_rev) {
+                    *rev = value;
+                    have_rev = 1;
+                } else if (nkey == 8 && memcmp(key, "revEpoch", 8) == 0 && !have_epoch) {
+                    *epoch = value;
+                    have_epoch = 1;
+                }
+                key = NULL;
+                cur = next - 1;
+                break;
+            }
+            case '{':
+            case '[':
+                depth++;
+                key = NULL;
+                break;
+            case '}':
+            case ']':
+                if (--depth <= 0) {
+                    return have_rev;
+                }
+                key = NULL;
+                break;
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                break;
+            default:
+                key = NULL;
+                break;
+        }
+    }
+    return have_rev;
+}
+
 static void replace_hoststr(char **orig, const char *replacement)
 {
     char *match;
@@ -919,6 +1532,10 @@ char *lcbvb_save_json(lcbvb_CONFIG *cfg)
         tmp = cJSON_CreateNumber(cfg->revid);
         cJSON_AddItemToObject(root, "rev", tmp);
     }
+    if (cfg->revepoch > 0) {
+        tmp = cJSON_CreateNumber((double)cfg->revepoch);
+        cJSON_AddItemToObject(root, "revEpoch", tmp);
+    }
     tmp = cJSON_CreateString(cfg->bname);
     cJSON_AddItemToObject(root, "name", tmp);
 
@@ -1004,6 +1621,416 @@ char *lcbvb_save_json(lcbvb_CONFIG *cfg)
     return ret;
 }
 
+/******************************************************************************
+ ******************************************************************************
+ ** Binary Snapshot Routines                                                 **
+ ******************************************************************************
+ ******************************************************************************/
+
+/*
+ * The binary snapshot is a flat, position-independent encoding of the parsed
+ * configuration (no pointers, all integers little-endian), so that it may be
+ * read directly from a file or a mapped memory region.
+ *
+ * Header (VB_BIN_HDRSIZE bytes):
+ *   magic[8]     "LCBVBBIN"
+ *   u32 version  VB_BIN_VERSION
+ *   u32 length   number of payload bytes following the header
+ *   u32 crc32    checksum of the payload
+ *   u32 reserved
+ *
+ * Payload:
+ *   u32 dtype, u32 is3x, u32 revid, u64 revepoch, u64 caps, u64 ccaps, str bname, str buuid
+ *   u32 nsrv, u32 ndatasrv, then for each server:
+ *     str hostname, viewpath, querypath, ftspath, cbaspath, alt_hostname
+ *     svc svc, svc_ssl, alt_svc, alt_svc_ssl (8 x u16 each)
+ *   u32 nvb, u32 nrepl, u32 has_ffmap, then nvb * (nrepl + 1) u32 indexes for
+ *   the vBucket map (and again for the forward map if present)
+ *
+ * Strings are encoded as u32 length followed by the bytes (no NUL). A length
+ * of VB_BIN_NULLSTR means the string was NULL.
+ */
+#define VB_BIN_MAGIC "LCBVBBIN"
+#define VB_BIN_MAGIC_LEN 8
+#define VB_BIN_VERSION 2
+#define VB_BIN_HDRSIZE (VB_BIN_MAGIC_LEN + 16)
+#define VB_BIN_NULLSTR 0xffffffffU
+
+typedef struct {
+    unsigned char *buf;
+    size_t nbuf;
+    size_t nalloc;
+    int failed;
+} vbBINWRITER;
+
+typedef struct {
+    const unsigned char *p;
+    size_t n;
+    int failed;
+} vbBINREADER;
+
+static void bin_put(vbBINWRITER *w, const void *p, size_t n)
+{
+    if (w->failed) {
+        return;
+    }
+    if (w->nbuf + n > w->nalloc) {
+        size_t nalloc = w->nalloc ? w->nalloc : 1024;
+        unsigned char *tmp;
+        while (nalloc < w->nbuf + n) {
+            nalloc *= 2;
+        }
+        if (!(tmp = realloc(w->buf, nalloc))) {
+            w->failed = 1;
+            return;
+        }
+        w->buf = tmp;
+        w->nalloc = nalloc;
+    }
+    memcpy(w->buf + w->nbuf, p, n);
+    w->nbuf += n;
+}
+
+static void bin_encode_u32(unsigned char *p, lcb_U32 v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = (v >> 24) & 0xff;
+}
+
+static lcb_U32 bin_decode_u32(const unsigned char *p)
+{
+    return (lcb_U32)p[0] | ((lcb_U32)p[1] << 8) | ((lcb_U32)p[2] << 16) | ((lcb_U32)p[3] << 24);
+}
+
+static void bin_put_u16(vbBINWRITER *w, lcb_U16 v)
+{
+    unsigned char b[2];
+    b[0] = v & 0xff;
+    b[1] = (v >> 8) & 0xff;
+    bin_put(w, b, sizeof b);
+}
+
+static void bin_put_u32(vbBINWRITER *w, lcb_U32 v)
+{
+    unsigned char b[4];
+    bin_encode_u32(b, v);
+    bin_put(w, b, sizeof b);
+}
+
+static void bin_put_u64(vbBINWRITER *w, lcb_U64 v)
+{
+    bin_put_u32(w, (lcb_U32)(v & 0xffffffffU));
+    bin_put_u32(w, (lcb_U32)(v >> 32));
+}
+
+static void bin_put_str(vbBINWRITER *w, const char *s)
+{
+    if (s == NULL) {
+        bin_put_u32(w, VB_BIN_NULLSTR);
+    } else {
+        size_t n = strlen(s);
+        bin_put_u32(w, (lcb_U32)n);
+        bin_put(w, s, n);
+    }
+}
+
+static void bin_put_svcs(vbBINWRITER *w, const lcbvb_SERVICES *svc)
+{
+    bin_put_u16(w, svc->data);
+    bin_put_u16(w, svc->mgmt);
+    bin_put_u16(w, svc->views);
+    bin_put_u16(w, svc->ixquery);
+    bin_put_u16(w, svc->ixadmin);
+    bin_put_u16(w, svc->n1ql);
+    bin_put_u16(w, svc->fts);
+    bin_put_u16(w, svc->cbas);
+}
+
+static void bin_put_vbmap(vbBINWRITER *w, const lcbvb_CONFIG *cfg, const lcbvb_VBUCKET *vbs)
+{
+    unsigned ii, jj;
+    for (ii = 0; ii < cfg->nvb; ii++) {
+        for (jj = 0; jj < cfg->nrepl + 1; jj++) {
+            bin_put_u32(w, (lcb_U32)vbs[ii].servers[jj]);
+        }
+    }
+}
+
+static const unsigned char *bin_get(vbBINREADER *r, size_t n)
+{
+    const unsigned char *p = r->p;
+    if (r->failed || r->n < n) {
+        r->failed = 1;
+        return NULL;
+    }
+    r->p += n;
+    r->n -= n;
+    return p;
+}
+
+static lcb_U16 bin_get_u16(vbBINREADER *r)
+{
+    const unsigned char *p = bin_get(r, 2);
+    return p ? (lcb_U16)(p[0] | (p[1] << 8)) : 0;
+}
+
+static lcb_U32 bin_get_u32(vbBINREADER *r)
+{
+    const unsigned char *p = bin_get(r, 4);
+    return p ? bin_decode_u32(p) : 0;
+}
+
+static lcb_U64 bin_get_u64(vbBINREADER *r)
+{
+    lcb_U64 lo = bin_get_u32(r);
+    lcb_U64 hi = bin_get_u32(r);
+    return lo | (hi << 32);
+}
+
+static char *bin_get_str(vbBINREADER *r)
+{
+    const unsigned char *p;
+    char *ret;
+    lcb_U32 n = bin_get_u32(r);
+
+    if (r->failed || n == VB_BIN_NULLSTR) {
+        return NULL;
+    }
+    if (!(p = bin_get(r, n))) {
+        return NULL;
+    }
+    if (!(ret = malloc(n + 1))) {
+        r->failed = 1;
+        return NULL;
+    }
+    memcpy(ret, p, n);
+    ret[n] = '\0';
+    return ret;
+}
+
+static void bin_get_svcs(vbBINREADER *r, lcbvb_SERVICES *svc)
+{
+    svc->data = bin_get_u16(r);
+    svc->mgmt = bin_get_u16(r);
+    svc->views = bin_get_u16(r);
+    svc->ixquery = bin_get_u16(r);
+    svc->ixadmin = bin_get_u16(r);
+    svc->n1ql = bin_get_u16(r);
+    svc->fts = bin_get_u16(r);
+    svc->cbas = bin_get_u16(r);
+}
+
+static lcbvb_VBUCKET *bin_get_vbmap(lcbvb_CONFIG *cfg, vbBINREADER *r)
+{
+    unsigned ii, jj;
+    lcbvb_VBUCKET *vbs;
+
+    if (!(vbs = calloc(cfg->nvb, sizeof(*vbs)))) {
+        SET_ERRSTR(cfg, "Couldn't allocate vBucket map");
+        return NULL;
+    }
+    for (ii = 0; ii < cfg->nvb; ii++) {
+        for (jj = 0; jj < cfg->nrepl + 1; jj++) {
+            int ix = (int)bin_get_u32(r);
+            if (ix < -1 || ix > (int)cfg->nsrv - 1) {
+                SET_ERRSTR(cfg, "Out-of-bounds vBucket target found in binary config");
+                free(vbs);
+                return NULL;
+            }
+            vbs[ii].servers[jj] = ix;
+        }
+    }
+    if (r->failed) {
+        SET_ERRSTR(cfg, "Truncated vBucket map in binary config");
+        free(vbs);
+        return NULL;
+    }
+    return vbs;
+}
+
+LIBCOUCHBASE_API
+char *lcbvb_save_binary(lcbvb_CONFIG *cfg, size_t *nbuf)
+{
+    vbBINWRITER w = {NULL, 0, 0, 0};
+    unsigned char hdr[VB_BIN_HDRSIZE] = {0};
+    unsigned ii;
+
+    /* reserve the header, filled in once the payload is known */
+    bin_put(&w, hdr, sizeof hdr);
+
+    bin_put_u32(&w, cfg->dtype);
+    bin_put_u32(&w, cfg->is3x);
+    bin_put_u32(&w, (lcb_U32)cfg->revid);
+    bin_put_u64(&w, (lcb_U64)cfg->revepoch);
+    bin_put_u64(&w, cfg->caps);
+    bin_put_u64(&w, cfg->ccaps);
+    bin_put_str(&w, cfg->bname);
+    bin_put_str(&w, cfg->buuid);
+
+    bin_put_u32(&w, cfg->nsrv);
+    bin_put_u32(&w, cfg->ndatasrv);
+    for (ii = 0; ii < cfg->nsrv; ii++) {
+        const lcbvb_SERVER *srv = cfg->servers + ii;
+        bin_put_str(&w, srv->hostname);
+        bin_put_str(&w, srv->viewpath);
+        bin_put_str(&w, srv->querypath);
+        bin_put_str(&w, srv->ftspath);
+        bin_put_str(&w, srv->cbaspath);
+        bin_put_str(&w, srv->alt_hostname);
+        bin_put_svcs(&w, &srv->svc);
+        bin_put_svcs(&w, &srv->svc_ssl);
+        bin_put_svcs(&w, &srv->alt_svc);
+        bin_put_svcs(&w, &srv->alt_svc_ssl);
+    }
+
+    if (cfg->dtype == LCBVB_DIST_VBUCKET) {
+        bin_put_u32(&w, cfg->nvb);
+        bin_put_u32(&w, cfg->nrepl);
+        bin_put_u32(&w, cfg->ffvbuckets != NULL);
+        bin_put_vbmap(&w, cfg, cfg->vbuckets);
+        if (cfg->ffvbuckets) {
+            bin_put_vbmap(&w, cfg, cfg->ffvbuckets);
+        }
+    } else {
+        bin_put_u32(&w, 0);
+        bin_put_u32(&w, 0);
+        bin_put_u32(&w, 0);
+    }
+
+    if (w.failed) {
+        free(w.buf);
+        return NULL;
+    }
+
+    memcpy(w.buf, VB_BIN_MAGIC, VB_BIN_MAGIC_LEN);
+    bin_encode_u32(w.buf + VB_BIN_MAGIC_LEN, VB_BIN_VERSION);
+    bin_encode_u32(w.buf + VB_BIN_MAGIC_LEN + 4, (lcb_U32)(w.nbuf - VB_BIN_HDRSIZE));
+    bin_encode_u32(w.buf + VB_BIN_MAGIC_LEN + 8, vb__crc32(w.buf + VB_BIN_HDRSIZE, w.nbuf - VB_BIN_HDRSIZE));
+    *nbuf = w.nbuf;
+    return (char *)w.buf;
+}
+
+LIBCOUCHBASE_API
+int lcbvb_is_binary(const void *data, size_t ndata)
+{
+    return ndata >= VB_BIN_HDRSIZE && memcmp(data, VB_BIN_MAGIC, VB_BIN_MAGIC_LEN) == 0;
+}
+
+LIBCOUCHBASE_API
+int lcbvb_load_binary(lcbvb_CONFIG *cfg, const void *data, size_t ndata)
+{
+    const unsigned char *hdr = data;
+    vbBINREADER r;
+    lcb_U32 version, length;
+    unsigned ii, nsrv, has_ffmap, need_ketama = 1;
+
+    if (!lcbvb_is_binary(data, ndata)) {
+        SET_ERRSTR(cfg, "Not a binary config");
+        return -1;
+    }
+
+    version = bin_decode_u32(hdr + VB_BIN_MAGIC_LEN);
+    length = bin_decode_u32(hdr + VB_BIN_MAGIC_LEN + 4);
+    if (version != VB_BIN_VERSION) {
+        SET_ERRSTR(cfg, "Unsupported binary config version");
+        return -1;
+    }
+    if (length > ndata - VB_BIN_HDRSIZE) {
+        SET_ERRSTR(cfg, "Truncated binary config");
+        return -1;
+    }
+    if (bin_decode_u32(hdr + VB_BIN_MAGIC_LEN + 8) != vb__crc32(hdr + VB_BIN_HDRSIZE, length)) {
+        SET_ERRSTR(cfg, "Checksum mismatch in binary config");
+        return -1;
+    }
+
+    r.p = hdr + VB_BIN_HDRSIZE;
+    r.n = length;
+    r.failed = 0;
+
+    cfg->dtype = (lcbvb_DISTMODE)bin_get_u32(&r);
+    cfg->is3x = bin_get_u32(&r);
+    cfg->revid = (int)bin_get_u32(&r);
+    cfg->revepoch = (int64_t)bin_get_u64(&r);
+    cfg->caps = bin_get_u64(&r);
+    cfg->ccaps = bin_get_u64(&r);
+    cfg->bname = bin_get_str(&r);
+    if (cfg->bname) {
+        cfg->bname_len = strlen(cfg->bname);
+    }
+    cfg->buuid = bin_get_str(&r);
+
+    nsrv = bin_get_u32(&r);
+    cfg->ndatasrv = bin_get_u32(&r);
+    if (r.failed || nsrv > r.n || cfg->ndatasrv > nsrv) {
+        SET_ERRSTR(cfg, "Invalid server count in binary config");
+        return -1;
+    }
+
+    if (!(cfg->servers = calloc(nsrv ? nsrv : 1, sizeof(*cfg->servers)))) {
+        SET_ERRSTR(cfg, "Couldn't allocate memory for server list");
+        return -1;
+    }
+    cfg->nsrv = nsrv;
+
+    for (ii = 0; ii < nsrv; ii++) {
+        lcbvb_SERVER *srv = cfg->servers + ii;
+        srv->hostname = bin_get_str(&r);
+        srv->viewpath = bin_get_str(&r);
+        srv->querypath = bin_get_str(&r);
+        srv->ftspath = bin_get_str(&r);
+        srv->cbaspath = bin_get_str(&r);
+        srv->alt_hostname = bin_get_str(&r);
+        bin_get_svcs(&r, &srv->svc);
+        bin_get_svcs(&r, &srv->svc_ssl);
+        bin_get_svcs(&r, &srv->alt_svc);
+        bin_get_svcs(&r, &srv->alt_svc_ssl);
+        if (r.failed || srv->hostname == NULL) {
+            SET_ERRSTR(cfg, "Truncated server entry in binary config");
+            return -1;
+        }
+        if (!build_server_strings(cfg, srv)) {
+            return -1;
+        }
+        if (strstr(srv->hostname, "$HOST")) {
+            need_ketama = 0;
+        }
+    }
+
+    cfg->nvb = bin_get_u32(&r);
+    cfg->nrepl = bin_get_u32(&r);
+    has_ffmap = bin_get_u32(&r);
+    if (r.failed) {
+        SET_ERRSTR(cfg, "Truncated binary config");
+        return -1;
+    }
+
+    if (cfg->dtype == LCBVB_DIST_VBUCKET) {
+        if (!cfg->nvb || cfg->nrepl > 3 || (lcb_U64)cfg->nvb * (cfg->nrepl + 1) * 4 > r.n) {
+            SET_ERRSTR(cfg, "Invalid vBucket map dimensions in binary config");
+            return -1;
+        }
+        if (!(cfg->vbuckets = bin_get_vbmap(cfg, &r))) {
+            return -1;
+        }
+        if (has_ffmap && !(cfg->ffvbuckets = bin_get_vbmap(cfg, &r))) {
+            return -1;
+        }
+        set_vb_count(cfg, cfg->vbuckets);
+        set_vb_count(cfg, cfg->ffvbuckets);
+    } else if (need_ketama) {
+        /* If there is a $HOST placeholder, continuums will be built by lcbvb_replace_host() */
+        if (!update_ketama(cfg)) {
+            SET_ERRSTR(cfg, "Failed to establish ketama continuums");
+        }
+    }
+
+    cfg->randbuf = malloc((nsrv ? nsrv : 1) * sizeof(*cfg->randbuf));
+    return 0;
+}
+
 /******************************************************************************
  ******************************************************************************
  ** Mapping Routines                                                         **
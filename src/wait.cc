@@ -30,8 +30,8 @@ has_pending(lcb_INSTANCE *instance)
         return true;
     }
 
-    for (size_t ii = 0; ii < LCBT_NSERVERS(instance); ii++) {
-        if (instance->get_server(ii)->has_pending()) {
+    for (size_t ii = 0; ii < LCBT_NLANES(instance); ii++) {
+        if (instance->get_lane(ii)->has_pending()) {
             return true;
         }
     }
@@ -47,8 +47,8 @@ maybe_reset_timeouts(lcb_INSTANCE *instance)
     }
 
     uint64_t now = lcb_nstime();
-    for (size_t ii = 0; ii < LCBT_NSERVERS(instance); ++ii) {
-        mcreq_reset_timeouts(instance->get_server(ii), now);
+    for (size_t ii = 0; ii < LCBT_NLANES(instance); ++ii) {
+        mcreq_reset_timeouts(instance->get_lane(ii), now);
     }
     instance->retryq->reset_timeouts(now);
 }
@@ -78,6 +78,13 @@ int lcb_is_waiting(lcb_INSTANCE *instance)
     return instance->wait != 0;
 }
 
+/* Idle pooled sockets were only watched while the loop was running */
+static void loop_stopped(lcb_INSTANCE *instance)
+{
+    instance->memd_sockpool->loop_stopped();
+    instance->http_sockpool->loop_stopped();
+}
+
 LIBCOUCHBASE_API
 lcb_STATUS lcb_tick_nowait(lcb_INSTANCE *instance)
 {
@@ -87,6 +94,7 @@ lcb_STATUS lcb_tick_nowait(lcb_INSTANCE *instance)
     } else {
         maybe_reset_timeouts(instance);
         tick(IOT_ARG(instance->iotable));
+        loop_stopped(instance);
         return LCB_SUCCESS;
     }
 }
@@ -108,6 +116,7 @@ lcb_STATUS lcb_wait(lcb_INSTANCE *instance, lcb_WAITFLAGS flags)
     instance->wait = 1;
     IOT_START(instance->iotable);
     instance->wait = 0;
+    loop_stopped(instance);
 
     if (LCBT_VBCONFIG(instance)) {
         return LCB_SUCCESS;
@@ -0,0 +1,115 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+#include "internal.h"
+#include <gtest/gtest.h>
+#include <libcouchbase/couchbase.h>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace lcb::clconfig;
+
+class CompressAsyncTest : public ::testing::Test
+{
+  protected:
+    void SetUp()
+    {
+        struct sockaddr_in addr = {};
+        socklen_t addrlen = sizeof addr;
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_NE(-1, listener);
+        ASSERT_EQ(0, bind(listener, (struct sockaddr *)&addr, sizeof addr));
+        ASSERT_EQ(0, listen(listener, 8));
+        ASSERT_EQ(0, getsockname(listener, (struct sockaddr *)&addr, &addrlen));
+        port = ntohs(addr.sin_port);
+    }
+
+    void TearDown()
+    {
+        close(listener);
+    }
+
+    /* Connections are accepted by the kernel but never answered, so the
+     * packets stay queued on the pipeline */
+    int listener;
+    int port;
+};
+
+static lcb_INSTANCE *create()
+{
+    const char *connstr = "couchbase://127.0.0.1/default?compression=force&enable_collections=false&compression_async_min_size=65536";
+    lcb_CREATEOPTS *crst = NULL;
+    lcb_createopts_create(&crst, LCB_TYPE_BUCKET);
+    lcb_createopts_connstr(crst, connstr, strlen(connstr));
+    lcb_INSTANCE *ret = NULL;
+    lcb_STATUS rc = lcb_create(&ret, crst);
+    lcb_createopts_destroy(crst);
+    EXPECT_EQ(LCB_SUCCESS, rc);
+    return ret;
+}
+
+static void apply_config(lcb_INSTANCE *instance, int port)
+{
+    lcbvb_SERVER server = {};
+    server.hostname = const_cast< char * >("127.0.0.1");
+    server.svc.data = port;
+    server.svc.mgmt = port + 1;
+
+    lcbvb_CONFIG *vbc = lcbvb_create();
+    ASSERT_EQ(0, lcbvb_genconfig_ex(vbc, "default", NULL, &server, 1, 0, 64));
+    ConfigInfo *info = ConfigInfo::create(vbc, CLCONFIG_CCCP);
+    lcb_update_vbconfig(instance, info);
+    info->decref();
+}
+
+TEST_F(CompressAsyncTest, testWakeup)
+{
+    lcb_INSTANCE *instance = create();
+    apply_config(instance, port);
+
+    std::string value;
+    while (value.size() < 1024 * 1024) {
+        value += "{\"field\":42},";
+    }
+    lcb_CMDSTORE *cmd;
+    lcb_cmdstore_create(&cmd, LCB_STORE_UPSERT);
+    lcb_cmdstore_key(cmd, "key", 3);
+    lcb_cmdstore_value(cmd, value.c_str(), value.size());
+    ASSERT_EQ(LCB_SUCCESS, lcb_store(instance, NULL, cmd));
+    lcb_cmdstore_destroy(cmd);
+
+    /* the loop is woken up by the compression pool, there is no timer */
+    ASSERT_TRUE(instance->compress_event != NULL);
+    ASSERT_TRUE(instance->compress_timer == NULL);
+    lcb::Server *server = instance->get_server(0);
+    hrtime_t deadline = gethrtime() + LCB_S2NS(5);
+    while (!SLLIST_IS_EMPTY(&server->held) && gethrtime() < deadline) {
+        lcb_tick_nowait(instance);
+    }
+    ASSERT_TRUE(SLLIST_IS_EMPTY(&server->held));
+    ASSERT_FALSE(SLLIST_IS_EMPTY(&server->requests));
+
+    lcb_destroy(instance);
+}
+#endif
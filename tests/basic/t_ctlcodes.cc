@@ -72,6 +72,8 @@ TEST_F(CtlTest, testStringCtls)
                         {"error_thresh_delay", LCB_CNTL_CONFDELAY_THRESH},
                         {"config_total_timeout", LCB_CNTL_CONFIGURATION_TIMEOUT},
                         {"config_node_timeout", LCB_CNTL_CONFIG_NODE_TIMEOUT},
+                        {"tcp_user_timeout", LCB_CNTL_TCP_USER_TIMEOUT},
+                        {"ssl_session_lifetime", LCB_CNTL_SSL_SESSION_LIFETIME},
                         {NULL, 0}};
 
     for (PairMap *cur = ctlMap; cur->key; cur++) {
@@ -89,6 +91,23 @@ TEST_F(CtlTest, testStringCtls)
     ASSERT_EQ(LCB_SUCCESS, err);
     ASSERT_EQ(1, getSetting< int >(instance, LCB_CNTL_RANDOMIZE_BOOTSTRAP_HOSTS));
 
+    err = lcb_cntl_string(instance, "ssl_ktls", "true");
+    ASSERT_EQ(LCB_SUCCESS, err);
+    ASSERT_EQ(1, getSetting< int >(instance, LCB_CNTL_SSL_KTLS));
+
+    err = lcb_cntl_string(instance, "ssl_log_handshake", "true");
+    ASSERT_EQ(LCB_SUCCESS, err);
+    ASSERT_EQ(1, getSetting< int >(instance, LCB_CNTL_SSL_LOG_HANDSHAKE));
+
+    err = lcb_cntl_string(instance, "compression_async_min_size", "1048576");
+    ASSERT_EQ(LCB_SUCCESS, err);
+    ASSERT_EQ(1048576, getSetting< lcb_U32 >(instance, LCB_CNTL_COMPRESSION_ASYNC_MIN_SIZE));
+    err = lcb_cntl_string(instance, "compression_async_threads", "4");
+    ASSERT_EQ(LCB_SUCCESS, err);
+    ASSERT_EQ(4, getSetting< lcb_U32 >(instance, LCB_CNTL_COMPRESSION_ASYNC_THREADS));
+    err = lcb_cntl_string(instance, "compression_async_threads", "0");
+    ASSERT_EQ(LCB_ERR_INVALID_ARGUMENT, err);
+
     // try with compression
     err = lcb_cntl_string(instance, "compression", "on");
     ASSERT_EQ(LCB_SUCCESS, err);
@@ -102,6 +121,33 @@ TEST_F(CtlTest, testStringCtls)
     ASSERT_EQ(LCB_SUCCESS, err);
     ASSERT_EQ(LCB_COMPRESS_IN, getSetting< lcb_COMPRESSOPTS >(instance, LCB_CNTL_COMPRESSION_OPTS));
 
+    // socket options
+    err = lcb_cntl_string(instance, "tcp_rcvbuf", "262144");
+    ASSERT_EQ(LCB_SUCCESS, err);
+    ASSERT_EQ(262144, lcb_cntl_getu32(instance, LCB_CNTL_TCP_RCVBUF));
+    err = lcb_cntl_string(instance, "tcp_busy_poll", "50");
+    ASSERT_EQ(LCB_SUCCESS, err);
+    ASSERT_EQ(50, lcb_cntl_getu32(instance, LCB_CNTL_TCP_BUSY_POLL));
+    err = lcb_cntl_string(instance, "ip_tos", "184");
+    ASSERT_EQ(LCB_SUCCESS, err);
+    ASSERT_EQ(184, getSetting< int >(instance, LCB_CNTL_IP_TOS));
+    err = lcb_cntl_string(instance, "ip_tos", "256");
+    ASSERT_EQ(LCB_ERR_INVALID_ARGUMENT, err);
+    ASSERT_EQ(184, getSetting< int >(instance, LCB_CNTL_IP_TOS));
+
+    err = lcb_cntl_string(instance, "kv_pool_size", "4");
+    ASSERT_EQ(LCB_SUCCESS, err);
+    ASSERT_EQ(4, lcb_cntl_getu32(instance, LCB_CNTL_KV_POOL_SIZE));
+    err = lcb_cntl_string(instance, "kv_pool_size", "0");
+    ASSERT_EQ(LCB_ERR_INVALID_ARGUMENT, err);
+    err = lcb_cntl_string(instance, "kv_pool_size", "17");
+    ASSERT_EQ(LCB_ERR_INVALID_ARGUMENT, err);
+    ASSERT_EQ(4, lcb_cntl_getu32(instance, LCB_CNTL_KV_POOL_SIZE));
+
+    err = lcb_cntl_string(instance, "http_pool_min_idle", "2");
+    ASSERT_EQ(LCB_SUCCESS, err);
+    ASSERT_EQ(2, getSetting< lcb_SIZE >(instance, LCB_CNTL_HTTP_POOL_MIN_IDLE));
+
     err = lcb_cntl_string(instance, "unsafe_optimize", "1");
     ASSERT_EQ(LCB_SUCCESS, err);
     err = lcb_cntl_string(instance, "unsafe_optimize", "0");
@@ -0,0 +1,62 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+#include "internal.h"
+#include <gtest/gtest.h>
+#include <libcouchbase/couchbase.h>
+#include <libcouchbase/metrics.h>
+
+using namespace lcb::clconfig;
+
+class MetricsTest : public ::testing::Test
+{
+};
+
+TEST_F(MetricsTest, testLaneMetrics)
+{
+    const char *connstr = "couchbase://localhost/default?kv_pool_size=3&metrics=true";
+    lcb_CREATEOPTS *crst = NULL;
+    lcb_createopts_create(&crst, LCB_TYPE_BUCKET);
+    lcb_createopts_connstr(crst, connstr, strlen(connstr));
+    lcb_INSTANCE *instance = NULL;
+    ASSERT_EQ(LCB_SUCCESS, lcb_create(&instance, crst));
+    lcb_createopts_destroy(crst);
+
+    lcbvb_SERVER server = {};
+    server.hostname = const_cast< char * >("localhost");
+    server.svc.data = 11210;
+    server.svc.mgmt = 8091;
+    lcbvb_CONFIG *vbc = lcbvb_create();
+    ASSERT_EQ(0, lcbvb_genconfig_ex(vbc, "default", NULL, &server, 1, 0, 64));
+    ConfigInfo *info = ConfigInfo::create(vbc, CLCONFIG_CCCP);
+    lcb_update_vbconfig(instance, info);
+    info->decref();
+
+    /* Every connection to the node is accounted separately */
+    lcb_METRICS *metrics = NULL;
+    ASSERT_EQ(LCB_SUCCESS, lcb_cntl(instance, LCB_CNTL_GET, LCB_CNTL_METRICS, &metrics));
+    ASSERT_EQ(3, metrics->nservers);
+    ASSERT_STREQ("localhost:11210", metrics->servers[0]->iometrics.hostport);
+    ASSERT_STREQ("localhost:11210#1", metrics->servers[1]->iometrics.hostport);
+    ASSERT_STREQ("localhost:11210#2", metrics->servers[2]->iometrics.hostport);
+    for (unsigned ii = 0; ii < 3; ii++) {
+        ASSERT_EQ(metrics->servers[ii], instance->get_lane(ii)->metrics);
+    }
+
+    lcb_destroy(instance);
+}
@@ -0,0 +1,102 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+#include "internal.h"
+#include <gtest/gtest.h>
+#include <libcouchbase/couchbase.h>
+
+using namespace lcb::clconfig;
+
+class PreconnectTest : public ::testing::Test
+{
+};
+
+static lcb_INSTANCE *create()
+{
+    const char *connstr = "couchbase://localhost/default?kv_preconnect=true";
+    lcb_CREATEOPTS *crst = NULL;
+    lcb_createopts_create(&crst, LCB_TYPE_BUCKET);
+    lcb_createopts_connstr(crst, connstr, strlen(connstr));
+    lcb_INSTANCE *ret = NULL;
+    lcb_STATUS rc = lcb_create(&ret, crst);
+    lcb_createopts_destroy(crst);
+    EXPECT_EQ(LCB_SUCCESS, rc);
+    return ret;
+}
+
+/** Apply a single node configuration whose data service listens on @p port */
+static void apply_config(lcb_INSTANCE *instance, int port)
+{
+    lcbvb_SERVER server = {};
+    server.hostname = const_cast< char * >("localhost");
+    server.svc.data = port;
+    server.svc.mgmt = port + 1;
+
+    lcbvb_CONFIG *vbc = lcbvb_create();
+    ASSERT_EQ(0, lcbvb_genconfig_ex(vbc, "default", NULL, &server, 1, 0, 64));
+    ConfigInfo *info = ConfigInfo::create(vbc, CLCONFIG_CCCP);
+    lcb_update_vbconfig(instance, info);
+    info->decref();
+}
+
+/*
+ * The event loop is never run, so the connections started by preconnect()
+ * stay pending for the whole test.
+ */
+TEST_F(PreconnectTest, testPendingUntilConnected)
+{
+    lcb_INSTANCE *instance = create();
+    ASSERT_FALSE(lcb_aspend_pending(&instance->pendops));
+
+    apply_config(instance, 11210);
+    ASSERT_TRUE(lcb_aspend_pending(&instance->pendops));
+
+    lcb::Server *server = instance->get_server(0);
+    ASSERT_TRUE(server->preconnecting);
+
+    /* The instance is only released once every pre-connection is done */
+    instance->wait = 1;
+    server->finish_preconnect();
+    ASSERT_FALSE(lcb_aspend_pending(&instance->pendops));
+    ASSERT_EQ(0, instance->wait);
+
+    lcb_destroy(instance);
+}
+
+TEST_F(PreconnectTest, testReplacedServerKeepsWaiting)
+{
+    lcb_INSTANCE *instance = create();
+    apply_config(instance, 11210);
+    ASSERT_TRUE(instance->get_server(0)->preconnecting);
+
+    /* Pretend lcb_wait() is running. Replacing the only node closes its
+     * pending pre-connection, which must not break out before the node of
+     * the new configuration is pre-connected */
+    instance->wait = 1;
+    apply_config(instance, 11220);
+    ASSERT_EQ(1, instance->wait);
+    ASSERT_TRUE(lcb_aspend_pending(&instance->pendops));
+    ASSERT_TRUE(instance->get_server(0)->preconnecting);
+    ASSERT_STREQ("11220", instance->get_server(0)->get_host().port);
+
+    instance->get_server(0)->finish_preconnect();
+    ASSERT_EQ(0, instance->wait);
+    ASSERT_FALSE(lcb_aspend_pending(&instance->pendops));
+
+    lcb_destroy(instance);
+}
@@ -511,4 +511,52 @@ TEST_F(ScramTest, FinalServerCheck_SHA1)
     EXPECT_EQ(SASL_OK, cbsasl_client_check(&ctx, valid_sign, strlen(valid_sign)));
 }
 
+TEST_F(ScramTest, SaltedPasswordCache)
+{
+    union {
+        cbsasl_secret_t secret;
+        char buffer[30];
+    } u_auth;
+    unsigned char salted[CBSASL_SHA512_DIGEST_SIZE];
+    unsigned int saltedlen = 0;
+    unsigned char cached[CBSASL_SHA512_DIGEST_SIZE];
+    unsigned int cachedlen = 0;
+    const char *salt = "c2FsdA==";
+    memcpy(u_auth.secret.data, "password", 8);
+    u_auth.secret.len = 8;
+
+    cbsasl_scram_cache_t *cache = cbsasl_scram_cache_new();
+    ASSERT_TRUE(cache != NULL);
+    ASSERT_EQ(0, scram_cache_get(cache, SASL_AUTH_MECH_SCRAM_SHA512, "foo", 3, &u_auth.secret, salt, strlen(salt),
+                                 1000, cached, &cachedlen));
+
+    ASSERT_EQ(SASL_OK, generate_salted_password(SASL_AUTH_MECH_SCRAM_SHA512, &u_auth.secret, salt, strlen(salt), 1000,
+                                                salted, &saltedlen));
+    scram_cache_put(cache, SASL_AUTH_MECH_SCRAM_SHA512, "foo", 3, &u_auth.secret, salt, strlen(salt), 1000, salted,
+                    saltedlen);
+
+    ASSERT_EQ(1, scram_cache_get(cache, SASL_AUTH_MECH_SCRAM_SHA512, "foo", 3, &u_auth.secret, salt, strlen(salt),
+                                 1000, cached, &cachedlen));
+    ASSERT_EQ(saltedlen, cachedlen);
+    ASSERT_EQ(0, memcmp(salted, cached, saltedlen));
+
+    // any other part of the key misses
+    ASSERT_EQ(0, scram_cache_get(cache, SASL_AUTH_MECH_SCRAM_SHA256, "foo", 3, &u_auth.secret, salt, strlen(salt),
+                                 1000, cached, &cachedlen));
+    ASSERT_EQ(0, scram_cache_get(cache, SASL_AUTH_MECH_SCRAM_SHA512, "bar", 3, &u_auth.secret, salt, strlen(salt),
+                                 1000, cached, &cachedlen));
+    ASSERT_EQ(0, scram_cache_get(cache, SASL_AUTH_MECH_SCRAM_SHA512, "foo", 3, &u_auth.secret, salt, strlen(salt),
+                                 4096, cached, &cachedlen));
+
+    // changed password misses, and drops the entry
+    memcpy(u_auth.secret.data, "passw0rd", 8);
+    ASSERT_EQ(0, scram_cache_get(cache, SASL_AUTH_MECH_SCRAM_SHA512, "foo", 3, &u_auth.secret, salt, strlen(salt),
+                                 1000, cached, &cachedlen));
+    memcpy(u_auth.secret.data, "password", 8);
+    ASSERT_EQ(0, scram_cache_get(cache, SASL_AUTH_MECH_SCRAM_SHA512, "foo", 3, &u_auth.secret, salt, strlen(salt),
+                                 1000, cached, &cachedlen));
+
+    cbsasl_scram_cache_free(cache);
+}
+
 #endif // LCB_NO_SSL
@@ -0,0 +1,242 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "config.h"
+#include "internal.h"
+#include "bucketconfig/bc_shm.h"
+#include <gtest/gtest.h>
+#include <libcouchbase/couchbase.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace lcb::clconfig;
+
+class ShmTest : public ::testing::Test
+{
+  protected:
+    void SetUp()
+    {
+        static int counter = 0;
+        char buf[64];
+        sprintf(buf, "/lcb-test-shm-%d-%d", (int)getpid(), counter++);
+        name = buf;
+        shm_unlink(name.c_str());
+    }
+
+    void TearDown()
+    {
+        shm_unlink(name.c_str());
+    }
+
+    std::string name;
+};
+
+static lcb_INSTANCE *create()
+{
+    const char *connstr = "couchbase://localhost/default";
+    lcb_CREATEOPTS *crst = NULL;
+    lcb_createopts_create(&crst, LCB_TYPE_BUCKET);
+    lcb_createopts_connstr(crst, connstr, strlen(connstr));
+    lcb_INSTANCE *ret = NULL;
+    lcb_STATUS rc = lcb_create(&ret, crst);
+    lcb_createopts_destroy(crst);
+    EXPECT_EQ(LCB_SUCCESS, rc);
+    return ret;
+}
+
+static ShmProvider *attach(lcb_INSTANCE *instance, const std::string &name)
+{
+    if (lcb_cntl_string(instance, "config_shm", name.c_str()) != LCB_SUCCESS) {
+        return NULL;
+    }
+    return static_cast< ShmProvider * >(instance->confmon->get_provider(CLCONFIG_SHM));
+}
+
+/** Publish a generated configuration with the given revision */
+static void publish(ShmProvider *provider, int revid)
+{
+    lcbvb_CONFIG *vbc = lcbvb_create();
+    ASSERT_EQ(0, lcbvb_genconfig(vbc, 2, 1, 64));
+    vbc->revid = revid;
+    ConfigInfo *info = ConfigInfo::create(vbc, CLCONFIG_CCCP);
+    provider->clconfig_lsn(CLCONFIG_EVENT_GOT_NEW_CONFIG, info);
+    info->decref();
+}
+
+TEST_F(ShmTest, testPublishAndAttach)
+{
+    lcb_INSTANCE *owner = create(), *reader = create();
+    ShmProvider *pown = attach(owner, name);
+    ShmProvider *prd = attach(reader, name);
+    ASSERT_TRUE(pown != NULL);
+    ASSERT_TRUE(prd != NULL);
+
+    /* nothing published yet */
+    ASSERT_EQ(ShmProvider::SHM_ERROR, prd->load_snapshot());
+
+    publish(pown, 42);
+    ASSERT_TRUE(pown->is_owner());
+    ASSERT_FALSE(prd->try_acquire());
+
+    ASSERT_EQ(ShmProvider::UPDATED, prd->load_snapshot());
+    ASSERT_EQ(42, prd->config->vbc->revid);
+    ASSERT_EQ(64, (int)prd->config->vbc->nvb);
+    ASSERT_EQ(CLCONFIG_SHM, prd->config->get_origin());
+    ASSERT_EQ(ShmProvider::NO_CHANGES, prd->load_snapshot());
+
+    publish(pown, 43);
+    ASSERT_EQ(ShmProvider::UPDATED, prd->load_snapshot());
+    ASSERT_EQ(43, prd->config->vbc->revid);
+
+    /* configurations from the segment itself are never published back */
+    ASSERT_FALSE(prd->is_owner());
+
+    lcb_destroy(reader);
+    lcb_destroy(owner);
+}
+
+TEST_F(ShmTest, testOwnerReleasedOnDetach)
+{
+    lcb_INSTANCE *owner = create(), *reader = create();
+    ShmProvider *pown = attach(owner, name);
+    ShmProvider *prd = attach(reader, name);
+    ASSERT_TRUE(pown->try_acquire());
+    ASSERT_FALSE(prd->try_acquire());
+    lcb_destroy(owner);
+    ASSERT_TRUE(prd->try_acquire());
+    ASSERT_EQ((int32_t)getpid(), prd->header->owner);
+    lcb_destroy(reader);
+}
+
+TEST_F(ShmTest, testStaleOwnerTakeover)
+{
+    int ready[2], done[2];
+    ASSERT_EQ(0, pipe(ready));
+    ASSERT_EQ(0, pipe(done));
+
+    pid_t child = fork();
+    ASSERT_NE(-1, child);
+    if (child == 0) {
+        /* Become the owner, publish, then die without detaching */
+        char c = 0;
+        lcb_INSTANCE *instance = create();
+        ShmProvider *provider = attach(instance, name);
+        if (provider == NULL || !provider->try_acquire()) {
+            _exit(1);
+        }
+        publish(provider, 7);
+        if (write(ready[1], &c, 1) != 1 || read(done[0], &c, 1) != 1) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    char c;
+    ASSERT_EQ(1, read(ready[0], &c, 1));
+
+    lcb_INSTANCE *reader = create();
+    ShmProvider *prd = attach(reader, name);
+    ASSERT_TRUE(prd != NULL);
+    ASSERT_EQ(child, prd->header->owner);
+    ASSERT_FALSE(prd->try_acquire());
+    ASSERT_EQ(ShmProvider::UPDATED, prd->load_snapshot());
+    ASSERT_EQ(7, prd->config->vbc->revid);
+
+    ASSERT_EQ(1, write(done[1], &c, 1));
+    int status = -1;
+    ASSERT_EQ(child, waitpid(child, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    /* The owner's PID is still recorded, but its lock went with it */
+    ASSERT_EQ(child, prd->header->owner);
+    ASSERT_TRUE(prd->try_acquire());
+    ASSERT_EQ((int32_t)getpid(), prd->header->owner);
+
+    lcb_destroy(reader);
+    close(ready[0]);
+    close(ready[1]);
+    close(done[0]);
+    close(done[1]);
+}
+
+TEST_F(ShmTest, testRecordedPidIsIgnored)
+{
+    /* A live process recorded as owner (e.g. a reused PID, or a process in
+     * another PID namespace) does not prevent a takeover */
+    lcb_INSTANCE *instance = create();
+    ShmProvider *provider = attach(instance, name);
+    provider->header->owner = 1;
+    ASSERT_TRUE(provider->try_acquire());
+    lcb_destroy(instance);
+}
+
+TEST_F(ShmTest, testCorruptSegment)
+{
+    lcb_INSTANCE *owner = create(), *reader = create();
+    ShmProvider *pown = attach(owner, name);
+    ShmProvider *prd = attach(reader, name);
+    publish(pown, 10);
+    ASSERT_EQ(ShmProvider::UPDATED, prd->load_snapshot());
+
+    ShmHeader *hdr = pown->header;
+    char *payload = reinterpret_cast< char * >(hdr + 1);
+
+    /* damaged payload fails the snapshot checksum */
+    hdr->seq += 2;
+    payload[hdr->length - 1] ^= 0xff;
+    ASSERT_EQ(ShmProvider::SHM_ERROR, prd->load_snapshot());
+    payload[hdr->length - 1] ^= 0xff;
+
+    /* length beyond the segment */
+    uint32_t length = hdr->length;
+    hdr->seq += 2;
+    hdr->length = (uint32_t)prd->maplen;
+    ASSERT_EQ(ShmProvider::SHM_ERROR, prd->load_snapshot());
+    hdr->length = length;
+
+    /* unknown layout */
+    hdr->seq += 2;
+    hdr->magic[0] = 'X';
+    ASSERT_EQ(ShmProvider::SHM_ERROR, prd->load_snapshot());
+    hdr->magic[0] = SHM_MAGIC[0];
+
+    /* the previous configuration is kept and a valid segment is read again */
+    ASSERT_EQ(10, prd->config->vbc->revid);
+    hdr->seq += 2;
+    ASSERT_EQ(ShmProvider::UPDATED, prd->load_snapshot());
+
+    lcb_destroy(reader);
+    lcb_destroy(owner);
+}
+
+TEST_F(ShmTest, testUndersizedSegment)
+{
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    ASSERT_NE(-1, fd);
+    ASSERT_EQ(0, ftruncate(fd, 4));
+    close(fd);
+
+    lcb_INSTANCE *instance = create();
+    ASSERT_TRUE(attach(instance, name) == NULL);
+    lcb_destroy(instance);
+}
+#endif
@@ -0,0 +1,211 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "config.h"
+#include <gtest/gtest.h>
+#include <libcouchbase/couchbase.h>
+#include "timerwheel.h"
+#include <vector>
+
+extern "C" hrtime_t gethrtime(void);
+
+#define MS(n) ((hrtime_t)(n)*1000000)
+
+struct TestTimer {
+    lcb_TWENTRY entry;
+    hrtime_t exptime;
+    int fired;
+};
+
+class TimerWheel : public ::testing::Test
+{
+  protected:
+    lcb_TIMERWHEEL wheel;
+
+    void SetUp() override
+    {
+        lcb_timerwheel_init(&wheel, 0);
+    }
+
+    void schedule(TestTimer *tm, hrtime_t now, lcb_U32 usec)
+    {
+        lcb_timerwheel_entry_init(&tm->entry);
+        tm->exptime = now + (hrtime_t)usec * 1000;
+        tm->fired = 0;
+        lcb_timerwheel_schedule(&wheel, &tm->entry, now, usec);
+    }
+
+    /** Expire everything due at `now`, return the number of timers fired */
+    int advance(hrtime_t now)
+    {
+        lcb_list_t expired, *ll;
+        int nfired = 0;
+        lcb_list_init(&expired);
+        lcb_timerwheel_expire(&wheel, now, &expired);
+        while ((ll = lcb_list_shift(&expired)) != NULL) {
+            TestTimer *tm = LCB_LIST_ITEM(ll, TestTimer, entry.list);
+            tm->entry.active = 0;
+            EXPECT_LE(tm->exptime, now);
+            tm->fired++;
+            nfired++;
+        }
+        return nfired;
+    }
+};
+
+TEST_F(TimerWheel, testBasic)
+{
+    TestTimer t1, t2;
+    hrtime_t delta = 0;
+
+    EXPECT_TRUE(lcb_timerwheel_empty(&wheel));
+    EXPECT_EQ(0, lcb_timerwheel_next(&wheel, 0, &delta));
+
+    schedule(&t1, 0, 5000);
+    schedule(&t2, 0, 10000);
+    EXPECT_FALSE(lcb_timerwheel_empty(&wheel));
+    ASSERT_EQ(1, lcb_timerwheel_next(&wheel, 0, &delta));
+    EXPECT_EQ(MS(5), delta);
+
+    EXPECT_EQ(0, advance(MS(4)));
+    EXPECT_EQ(1, advance(MS(5)));
+    EXPECT_EQ(1, t1.fired);
+    EXPECT_EQ(0, t2.fired);
+    ASSERT_EQ(1, lcb_timerwheel_next(&wheel, MS(5), &delta));
+    EXPECT_EQ(MS(5), delta);
+
+    lcb_timerwheel_cancel(&wheel, &t2.entry);
+    EXPECT_TRUE(lcb_timerwheel_empty(&wheel));
+    EXPECT_EQ(0, advance(MS(100)));
+    EXPECT_EQ(0, t2.fired);
+}
+
+TEST_F(TimerWheel, testZeroDelay)
+{
+    TestTimer tm;
+    hrtime_t delta = 1;
+    schedule(&tm, MS(1) + 500, 0);
+    ASSERT_EQ(1, lcb_timerwheel_next(&wheel, MS(1) + 500, &delta));
+    EXPECT_EQ(0, delta);
+    EXPECT_EQ(1, advance(MS(1) + 500));
+}
+
+TEST_F(TimerWheel, testCoalescing)
+{
+    TestTimer timers[10];
+    /* all of these round up to the same tick */
+    for (size_t ii = 0; ii < 10; ii++) {
+        schedule(&timers[ii], 0, 2100 + ii * 50);
+    }
+    EXPECT_EQ(0, advance(MS(2)));
+    EXPECT_EQ(10, advance(MS(3)));
+}
+
+TEST_F(TimerWheel, testCascade)
+{
+    /* one timer in each level */
+    static const lcb_U32 delays[] = {30000, 3000000, 200000000, 4000000000U};
+    const size_t ntimers = sizeof(delays) / sizeof(delays[0]);
+    TestTimer timers[ntimers];
+    hrtime_t now = 0;
+
+    for (size_t ii = 0; ii < ntimers; ii++) {
+        schedule(&timers[ii], now, delays[ii]);
+    }
+    lcb_timerwheel_cancel(&wheel, &timers[1].entry);
+
+    for (size_t ii = 0; ii < ntimers; ii++) {
+        hrtime_t delta;
+        if (ii == 1) {
+            continue;
+        }
+        /* follow the wake up hints, which may come early but never late */
+        while (timers[ii].fired == 0) {
+            ASSERT_EQ(1, lcb_timerwheel_next(&wheel, now, &delta));
+            now += delta;
+            ASSERT_LE(now, timers[ii].exptime);
+            advance(now);
+        }
+        EXPECT_EQ(timers[ii].exptime, now);
+    }
+    EXPECT_EQ(0, timers[1].fired);
+    EXPECT_TRUE(lcb_timerwheel_empty(&wheel));
+}
+
+TEST_F(TimerWheel, testOverflow)
+{
+    TestTimer tm;
+    hrtime_t now = MS((1 << 24) - 10), delta;
+
+    advance(now);
+    /* crosses the range of the top level */
+    schedule(&tm, now, 30000);
+    ASSERT_EQ(1, lcb_timerwheel_next(&wheel, now, &delta));
+    EXPECT_EQ(MS(10), delta);
+    EXPECT_EQ(0, advance(now + delta));
+    EXPECT_EQ(0, advance(now + MS(29)));
+    EXPECT_EQ(1, advance(now + MS(30)));
+}
+
+TEST_F(TimerWheel, testRandomized)
+{
+    std::vector< TestTimer > timers(5000);
+    hrtime_t now = 0;
+    size_t nfired = 0;
+
+    srand(42);
+    for (size_t ii = 0; ii < timers.size(); ii++) {
+        schedule(&timers[ii], now, (lcb_U32)(rand() % 5000000) + 1);
+    }
+    while (nfired < timers.size()) {
+        now += MS(rand() % 50);
+        nfired += advance(now);
+        for (size_t ii = 0; ii < timers.size(); ii++) {
+            if (timers[ii].fired == 0) {
+                /* nothing may be left behind */
+                ASSERT_GT(timers[ii].exptime + MS(1), now);
+            }
+        }
+    }
+    for (size_t ii = 0; ii < timers.size(); ii++) {
+        EXPECT_EQ(1, timers[ii].fired);
+    }
+}
+
+/* Arming and disarming must not depend on the number of scheduled timers */
+TEST_F(TimerWheel, testThroughput)
+{
+    const size_t ntimers = 100000;
+    std::vector< TestTimer > timers(ntimers);
+    hrtime_t now = 0;
+
+    srand(42);
+    hrtime_t begin = gethrtime();
+    for (size_t ii = 0; ii < ntimers; ii++) {
+        schedule(&timers[ii], now, (lcb_U32)(rand() % 75000000));
+    }
+    hrtime_t armed = gethrtime();
+    for (size_t ii = 0; ii < ntimers; ii++) {
+        lcb_timerwheel_cancel(&wheel, &timers[ii].entry);
+    }
+    hrtime_t disarmed = gethrtime();
+    EXPECT_TRUE(lcb_timerwheel_empty(&wheel));
+
+    fprintf(stderr, "%lu timers: arm %.1f ns/op, disarm %.1f ns/op\n", (unsigned long)ntimers,
+            (double)(armed - begin) / ntimers, (double)(disarmed - armed) / ntimers);
+    /* generous bound, a sorted list takes seconds here */
+    EXPECT_LT(disarmed - begin, MS(1000));
+}
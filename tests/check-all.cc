@@ -57,6 +57,12 @@ const char default_plugins_string[] = "select;iocp;libuv";
 #include <signal.h>
 #include <unistd.h> /* usleep */
 const char default_plugins_string[] = "select"
+#ifdef HAVE_EPOLL
+                                      ";epoll"
+#endif
+#ifdef HAVE_IO_URING
+                                      ";uring"
+#endif
 #if defined(HAVE_LIBEV3) || defined(HAVE_LIBEV4)
                                       ";libev"
 #endif
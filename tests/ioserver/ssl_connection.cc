@@ -98,9 +98,15 @@ static void genCertificate(SSL_CTX *ctx)
     EVP_PKEY_free(pkey);
 }
 
-SslSocket::SslSocket(SockFD *inner) : SockFD(inner->getFD())
+// Connections share the context (and therefore the session ticket keys), so
+// that clients may resume their sessions. They are all accepted by the same
+// thread.
+static SSL_CTX *serverContext()
 {
-    sfd = inner;
+    static SSL_CTX *ctx = NULL;
+    if (ctx) {
+        return ctx;
+    }
     ctx = SSL_CTX_new(SSLv23_server_method());
     assert(ctx != NULL);
 
@@ -110,6 +116,13 @@ SslSocket::SslSocket(SockFD *inner) : SockFD(inner->getFD())
     SSL_CTX_set_options(ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
     SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
     SSL_CTX_load_verify_locations(ctx, NULL, NULL);
+    return ctx;
+}
+
+SslSocket::SslSocket(SockFD *inner) : SockFD(inner->getFD())
+{
+    sfd = inner;
+    ctx = serverContext();
 
     ssl = SSL_new(ctx);
     assert(ssl != NULL);
@@ -136,7 +149,6 @@ void SslSocket::close()
 SslSocket::~SslSocket()
 {
     SSL_free(ssl);
-    SSL_CTX_free(ctx);
     delete sfd;
 }
 
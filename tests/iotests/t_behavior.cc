@@ -59,6 +59,12 @@ class PluginMap
         kv["select"] = LCB_IO_OPS_SELECT;
         kv["libevent"] = LCB_IO_OPS_LIBEVENT;
         kv["libev"] = LCB_IO_OPS_LIBEV;
+#ifdef HAVE_EPOLL
+        kv["epoll"] = LCB_IO_OPS_EPOLL;
+#endif
+#ifdef HAVE_IO_URING
+        kv["uring"] = LCB_IO_OPS_URING;
+#endif
 #ifdef _WIN32
         kv["iocp"] = LCB_IO_OPS_WINIOCP;
         kv["winsock"] = LCB_IO_OPS_WINSOCK;
@@ -639,6 +639,23 @@ TEST_F(MockUnitTest, testRefreshConfig)
     lcb_wait(instance, LCB_WAIT_NOCHECK);
 }
 
+TEST_F(MockUnitTest, testKvPreconnect)
+{
+    SKIP_UNLESS_MOCK();
+    HandleWrap hw;
+    lcb_INSTANCE *instance;
+    MockEnvironment::getInstance()->createConnection(hw, &instance);
+    ASSERT_EQ(LCB_SUCCESS, lcb_cntl_string(instance, "kv_preconnect", "true"));
+    ASSERT_EQ(LCB_SUCCESS, lcb_connect(instance));
+    lcb_wait(instance, LCB_WAIT_DEFAULT);
+    ASSERT_EQ(LCB_SUCCESS, lcb_get_bootstrap_status(instance));
+
+    // All data nodes should be connected without any operation scheduled
+    for (size_t ii = 0; ii < LCBVB_NDATASERVERS(LCBT_VBCONFIG(instance)); ii++) {
+        ASSERT_TRUE(instance->get_server(ii)->is_connected());
+    }
+}
+
 extern "C" {
 static void tickOpCb(lcb_INSTANCE *, int, const lcb_RESPBASE *rb)
 {
@@ -0,0 +1,565 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mctest.h"
+#include "mc/compress.h"
+#include "mc/mcreq-flush-inl.h"
+#include <snappy.h>
+#include <string>
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+extern "C" hrtime_t gethrtime(void);
+
+class McInflate : public ::testing::Test
+{
+  protected:
+    mc_INFLATEBUF ib;
+
+    void SetUp() override
+    {
+        memset(&ib, 0, sizeof(ib));
+    }
+
+    void TearDown() override
+    {
+        mcreq_inflatebuf_cleanup(&ib);
+    }
+
+    static std::string compress(const std::string &value)
+    {
+        std::string out;
+        snappy::Compress(value.c_str(), value.size(), &out);
+        return out;
+    }
+
+    static std::string makeValue(size_t size, char fill)
+    {
+        std::string value(size, fill);
+        for (size_t ii = 0; ii < size; ii += 97) {
+            value[ii] = 'a' + (ii % 26);
+        }
+        return value;
+    }
+};
+
+TEST_F(McInflate, testScratchReused)
+{
+    std::string v1 = makeValue(3000, 'x'), v2 = makeValue(5000, 'y');
+    std::string c1 = compress(v1), c2 = compress(v2);
+    const void *bytes;
+    lcb_SIZE nbytes;
+    void *freeptr = NULL;
+
+    ASSERT_EQ(0, mcreq_inflate_value_scratch(&ib, c1.c_str(), c1.size(), &bytes, &nbytes, &freeptr));
+    ASSERT_TRUE(freeptr == NULL);
+    ASSERT_EQ(ib.buf, bytes);
+    ASSERT_EQ(v1, std::string((const char *)bytes, nbytes));
+    ASSERT_NE(0, ib.inuse);
+    mcreq_inflatebuf_release(&ib, bytes);
+    ASSERT_EQ(0, ib.inuse);
+
+    /* grows once, then stays */
+    ASSERT_EQ(0, mcreq_inflate_value_scratch(&ib, c2.c_str(), c2.size(), &bytes, &nbytes, &freeptr));
+    ASSERT_TRUE(freeptr == NULL);
+    ASSERT_EQ(v2, std::string((const char *)bytes, nbytes));
+    mcreq_inflatebuf_release(&ib, bytes);
+    char *buf = ib.buf;
+    lcb_SIZE size = ib.size;
+    for (int ii = 0; ii < 10; ii++) {
+        ASSERT_EQ(0, mcreq_inflate_value_scratch(&ib, c1.c_str(), c1.size(), &bytes, &nbytes, &freeptr));
+        ASSERT_EQ(v1, std::string((const char *)bytes, nbytes));
+        mcreq_inflatebuf_release(&ib, bytes);
+    }
+    ASSERT_EQ(buf, ib.buf);
+    ASSERT_EQ(size, ib.size);
+    ASSERT_TRUE(freeptr == NULL);
+}
+
+/* A value inflated while the scratch buffer is referenced gets its own memory */
+TEST_F(McInflate, testNested)
+{
+    std::string v1 = makeValue(1000, 'x'), v2 = makeValue(1000, 'y');
+    std::string c1 = compress(v1), c2 = compress(v2);
+    const void *outer, *inner;
+    lcb_SIZE nouter, ninner;
+    void *outer_free = NULL, *inner_free = NULL;
+
+    ASSERT_EQ(0, mcreq_inflate_value_scratch(&ib, c1.c_str(), c1.size(), &outer, &nouter, &outer_free));
+    ASSERT_EQ(0, mcreq_inflate_value_scratch(&ib, c2.c_str(), c2.size(), &inner, &ninner, &inner_free));
+    ASSERT_FALSE(inner_free == NULL);
+    ASSERT_EQ(inner_free, inner);
+    ASSERT_EQ(v2, std::string((const char *)inner, ninner));
+
+    mcreq_inflatebuf_release(&ib, inner);
+    free(inner_free);
+    ASSERT_NE(0, ib.inuse);
+    ASSERT_EQ(v1, std::string((const char *)outer, nouter));
+    mcreq_inflatebuf_release(&ib, outer);
+    ASSERT_EQ(0, ib.inuse);
+}
+
+TEST_F(McInflate, testLargeValue)
+{
+    std::string value = makeValue(MCREQ_INFLATEBUF_MAX + 1, 'z');
+    std::string comp = compress(value);
+    const void *bytes;
+    lcb_SIZE nbytes;
+    void *freeptr = NULL;
+
+    ASSERT_EQ(0, mcreq_inflate_value_scratch(&ib, comp.c_str(), comp.size(), &bytes, &nbytes, &freeptr));
+    ASSERT_FALSE(freeptr == NULL);
+    ASSERT_EQ(value, std::string((const char *)bytes, nbytes));
+    ASSERT_EQ(0, ib.size);
+    mcreq_inflatebuf_release(&ib, bytes);
+    free(freeptr);
+}
+
+TEST_F(McInflate, testCorrupt)
+{
+    std::string comp = compress(makeValue(1000, 'x'));
+    comp.resize(comp.size() / 2);
+    const void *bytes = NULL;
+    lcb_SIZE nbytes = 0;
+    void *freeptr = NULL;
+
+    ASSERT_NE(0, mcreq_inflate_value_scratch(&ib, comp.c_str(), comp.size(), &bytes, &nbytes, &freeptr));
+    ASSERT_TRUE(freeptr == NULL);
+    ASSERT_EQ(0, ib.inuse);
+}
+
+class McCompress : public ::testing::Test
+{
+  protected:
+    lcb_settings *settings;
+
+    void SetUp() override
+    {
+        settings = lcb_settings_new();
+    }
+
+    void TearDown() override
+    {
+        lcb_settings_unref(settings);
+    }
+
+    /* Random bytes out of an alphabet of `nsymbols` */
+    static std::string randomValue(size_t size, unsigned nsymbols = 256)
+    {
+        std::string value(size, '\0');
+        unsigned seed = 42;
+        for (size_t ii = 0; ii < size; ii++) {
+            seed = seed * 1103515245 + 12345;
+            value[ii] = (char)((seed >> 16) % nsymbols);
+        }
+        return value;
+    }
+
+    static std::string jsonValue(size_t size)
+    {
+        std::string value;
+        for (int ii = 0; value.size() < size; ii++) {
+            char buf[64];
+            sprintf(buf, "{\"id\":%d,\"name\":\"user_%d\",\"active\":true},", ii, ii * 7);
+            value += buf;
+        }
+        value.resize(size);
+        return value;
+    }
+
+    static lcb_VALBUF contig(const std::string &value)
+    {
+        lcb_VALBUF vb;
+        memset(&vb, 0, sizeof(vb));
+        vb.vtype = LCB_KV_CONTIG;
+        vb.u_buf.contig.bytes = value.c_str();
+        vb.u_buf.contig.nbytes = value.size();
+        return vb;
+    }
+
+    /* Store the value into a new packet and return whether it was compressed */
+    int store(CQWrap &cq, const lcb_VALBUF &vb)
+    {
+        PacketWrap pw;
+        int should_compress = 1;
+        pw.setCopyKey("key");
+        EXPECT_TRUE(pw.reservePacket(&cq));
+        EXPECT_EQ(0, mcreq_compress_value(pw.pipeline, pw.pkt, &vb, settings, &should_compress));
+        mcreq_wipe_packet(pw.pipeline, pw.pkt);
+        mcreq_release_packet(pw.pipeline, pw.pkt);
+        return should_compress;
+    }
+};
+
+TEST_F(McCompress, testPredict)
+{
+    std::string random = randomValue(8192), json = jsonValue(8192);
+    lcb_VALBUF vb_random = contig(random), vb_json = contig(json);
+    float ratio = settings->compress_min_ratio;
+
+    ASSERT_EQ(0, mcreq_compress_predict(&vb_random, random.size(), ratio));
+    ASSERT_NE(0, mcreq_compress_predict(&vb_json, json.size(), ratio));
+
+    /* a compressible header does not hide the random payload behind it */
+    std::string mixed = json.substr(0, 200) + random;
+    lcb_VALBUF vb_mixed = contig(mixed);
+    ASSERT_EQ(0, mcreq_compress_predict(&vb_mixed, mixed.size(), ratio));
+
+    /* values smaller than the sample */
+    std::string small_json = json.substr(0, 500), small_random = randomValue(MCREQ_COMPRESS_SAMPLE / 2);
+    lcb_VALBUF vb_small_json = contig(small_json), vb_small_random = contig(small_random);
+    ASSERT_NE(0, mcreq_compress_predict(&vb_small_json, small_json.size(), ratio));
+    ASSERT_EQ(0, mcreq_compress_predict(&vb_small_random, small_random.size(), 0.5));
+
+    /* a ratio of 1 accepts anything */
+    ASSERT_NE(0, mcreq_compress_predict(&vb_random, random.size(), 1));
+}
+
+TEST_F(McCompress, testPredictIov)
+{
+    std::string random = randomValue(3000), json = jsonValue(3000);
+    lcb_IOV iov[3];
+    iov[0].iov_base = (void *)json.c_str();
+    iov[0].iov_len = 100;
+    iov[1].iov_base = (void *)random.c_str();
+    iov[1].iov_len = random.size();
+    iov[2].iov_base = (void *)json.c_str();
+    iov[2].iov_len = 1;
+
+    lcb_VALBUF vb;
+    memset(&vb, 0, sizeof(vb));
+    vb.vtype = LCB_KV_IOV;
+    vb.u_buf.multi.iov = iov;
+    vb.u_buf.multi.niov = 3;
+    ASSERT_EQ(0, mcreq_compress_predict(&vb, 3101, settings->compress_min_ratio));
+
+    iov[1].iov_base = (void *)json.c_str();
+    ASSERT_NE(0, mcreq_compress_predict(&vb, 3101, settings->compress_min_ratio));
+}
+
+TEST_F(McCompress, testMetrics)
+{
+    CQWrap cq;
+    lcb_SERVERMETRICS metrics[NUM_PIPELINES];
+    memset(metrics, 0, sizeof(metrics));
+    for (unsigned ii = 0; ii < cq.npipelines; ii++) {
+        cq.pipelines[ii]->metrics = &metrics[ii];
+    }
+
+    std::string random = randomValue(4096), json = jsonValue(4096), tiny("{}");
+    ASSERT_EQ(0, store(cq, contig(random)));
+    ASSERT_NE(0, store(cq, contig(json)));
+    ASSERT_EQ(0, store(cq, contig(tiny)));
+
+    /* low entropy, but without repetitions for snappy to find */
+    std::string hex = randomValue(4096, 16);
+    ASSERT_EQ(0, store(cq, contig(hex)));
+
+    lcb_SIZE attempted = 0, skipped = 0, succeeded = 0;
+    for (unsigned ii = 0; ii < cq.npipelines; ii++) {
+        attempted += metrics[ii].compress_attempted;
+        skipped += metrics[ii].compress_skipped;
+        succeeded += metrics[ii].compress_succeeded;
+        cq.pipelines[ii]->metrics = NULL;
+    }
+    ASSERT_EQ(2, attempted);
+    ASSERT_EQ(1, skipped);
+    ASSERT_EQ(1, succeeded);
+}
+
+TEST_F(McCompress, testScratchBuffer)
+{
+    CQWrap cq;
+    std::string json = jsonValue(16 * 1024), expected;
+    snappy::Compress(json.c_str(), json.size(), &expected);
+
+    PacketWrap pw;
+    int should_compress = 1;
+    pw.setCopyKey("key");
+    ASSERT_TRUE(pw.reservePacket(&cq));
+    lcb_VALBUF vb = contig(json);
+    ASSERT_EQ(0, mcreq_compress_value(pw.pipeline, pw.pkt, &vb, settings, &should_compress));
+    ASSERT_NE(0, should_compress);
+    /* exactly the compressed size is taken from the pipeline */
+    ASSERT_EQ(expected.size(), pw.pkt->u_value.single.size);
+    ASSERT_EQ(expected, std::string(SPAN_BUFFER(&pw.pkt->u_value.single), pw.pkt->u_value.single.size));
+    mcreq_wipe_packet(pw.pipeline, pw.pkt);
+    mcreq_release_packet(pw.pipeline, pw.pkt);
+
+    char *compbuf = cq.compbuf;
+    size_t ncompbuf = cq.ncompbuf;
+    ASSERT_TRUE(compbuf != NULL);
+    ASSERT_GE(ncompbuf, expected.size());
+    for (int ii = 0; ii < 10; ii++) {
+        ASSERT_NE(0, store(cq, contig(json)));
+    }
+    ASSERT_EQ(compbuf, cq.compbuf);
+    ASSERT_EQ(ncompbuf, cq.ncompbuf);
+
+    /* larger values use a temporary buffer */
+    std::string big = jsonValue(MCREQ_COMPRESSBUF_MAX * 2);
+    ASSERT_NE(0, store(cq, contig(big)));
+    ASSERT_LE(cq.ncompbuf, (size_t)MCREQ_COMPRESSBUF_MAX);
+}
+
+class McCompressAsync : public McCompress
+{
+  protected:
+    struct Scheduled {
+        mc_PIPELINE *pipeline;
+        mc_PACKET *pkt;
+        int compressed;
+    };
+
+    /* Schedule a store of `value` for "key", compressed in the background */
+    Scheduled schedule(CQWrap &cq, const std::string &value)
+    {
+        PacketWrap pw;
+        Scheduled res;
+        res.compressed = 1;
+        pw.setCopyKey("key");
+        EXPECT_TRUE(pw.reservePacket(&cq));
+        lcb_VALBUF vb = contig(value);
+        EXPECT_EQ(0, mcreq_compress_value_async(cq.cpool, pw.pipeline, pw.pkt, &vb, settings, &res.compressed));
+        pw.hdr.request.datatype = res.compressed ? PROTOCOL_BINARY_DATATYPE_COMPRESSED : 0;
+        pw.hdr.request.bodylen = htonl((lcb_uint32_t)(3 + pw.pkt->u_value.single.size));
+        pw.hdr.request.opaque = pw.pkt->opaque;
+        pw.copyHeader();
+        mcreq_sched_add(pw.pipeline, pw.pkt);
+        res.pipeline = pw.pipeline;
+        res.pkt = pw.pkt;
+        return res;
+    }
+
+    static std::string sentValue(mc_PACKET *pkt)
+    {
+        protocol_binary_request_header hdr;
+        mcreq_read_hdr(pkt, &hdr);
+        std::string value(SPAN_BUFFER(&pkt->u_value.single), pkt->u_value.single.size);
+        EXPECT_EQ(3 + value.size(), ntohl(hdr.request.bodylen));
+        if (hdr.request.datatype & PROTOCOL_BINARY_DATATYPE_COMPRESSED) {
+            std::string out;
+            EXPECT_TRUE(snappy::Uncompress(value.c_str(), value.size(), &out));
+            return out;
+        }
+        return value;
+    }
+
+    static void drain(CQWrap &cq)
+    {
+        for (unsigned ii = 0; ii < cq.npipelines; ii++) {
+            mc_PIPELINE *pl = cq.pipelines[ii];
+            nb_IOV iov;
+            unsigned toflush;
+            while ((toflush = mcreq_flush_iov_fill(pl, &iov, 1, NULL))) {
+                mcreq_flush_done(pl, toflush, toflush);
+            }
+        }
+        cq.clearPipelines();
+    }
+};
+
+TEST_F(McCompressAsync, testOrderPreserved)
+{
+    CQWrap cq;
+    cq.cpool = mcreq_compresspool_new(2);
+    std::string big = jsonValue(256 * 1024), small("{}");
+
+    mcreq_sched_enter(&cq);
+    Scheduled first = schedule(cq, big);
+    Scheduled second = schedule(cq, small);
+    mcreq_sched_leave(&cq, 0);
+
+    ASSERT_EQ(first.pipeline, second.pipeline);
+    ASSERT_NE(0, first.pkt->flags & MCREQ_F_PREPARING);
+    ASSERT_EQ(0, second.pkt->flags & MCREQ_F_PREPARING);
+    ASSERT_TRUE(SLLIST_IS_EMPTY(&first.pipeline->requests));
+    ASSERT_FALSE(SLLIST_IS_EMPTY(&first.pipeline->held));
+
+    while (mcreq_compresspool_reap(cq.cpool, NULL, 0)) {
+    }
+    ASSERT_TRUE(SLLIST_IS_EMPTY(&first.pipeline->held));
+    ASSERT_EQ(0, first.pkt->flags & MCREQ_F_PREPARING);
+    ASSERT_EQ(first.pkt, mcreq_first_packet(first.pipeline));
+    ASSERT_EQ(second.pkt, SLLIST_ITEM(first.pipeline->requests.last, mc_PACKET, slnode));
+    ASSERT_LT(first.pkt->u_value.single.size, big.size());
+    ASSERT_EQ(big, sentValue(first.pkt));
+    ASSERT_EQ(small, sentValue(second.pkt));
+    ASSERT_EQ(mcreq_get_size(first.pkt) + mcreq_get_size(second.pkt), first.pipeline->nbytes_pending);
+    drain(cq);
+}
+
+TEST_F(McCompressAsync, testNotCompressed)
+{
+    CQWrap cq;
+    cq.cpool = mcreq_compresspool_new(1);
+    /* passes the prediction, but snappy does not find anything to compress */
+    std::string hex = randomValue(64 * 1024, 16);
+
+    mcreq_sched_enter(&cq);
+    Scheduled sched = schedule(cq, hex);
+    mcreq_sched_leave(&cq, 0);
+    ASSERT_NE(0, sched.compressed);
+
+    ASSERT_EQ(0, mcreq_compresspool_reap(cq.cpool, sched.pipeline, 1));
+    ASSERT_EQ(sched.pkt, mcreq_first_packet(sched.pipeline));
+    protocol_binary_request_header hdr;
+    mcreq_read_hdr(sched.pkt, &hdr);
+    ASSERT_EQ(0, hdr.request.datatype & PROTOCOL_BINARY_DATATYPE_COMPRESSED);
+    ASSERT_EQ(hex, sentValue(sched.pkt));
+    drain(cq);
+}
+
+TEST_F(McCompressAsync, testSchedFail)
+{
+    CQWrap cq;
+    cq.cpool = mcreq_compresspool_new(1);
+    std::string big = jsonValue(1024 * 1024);
+
+    mcreq_sched_enter(&cq);
+    for (int ii = 0; ii < 4; ii++) {
+        schedule(cq, big);
+    }
+    mcreq_sched_fail(&cq);
+    ASSERT_EQ(0, mcreq_compresspool_reap(cq.cpool, NULL, 0));
+}
+
+TEST_F(McCompressAsync, testPipelineFail)
+{
+    CQWrap cq;
+    cq.cpool = mcreq_compresspool_new(1);
+    std::string big = jsonValue(1024 * 1024);
+
+    mcreq_sched_enter(&cq);
+    Scheduled sched = schedule(cq, big);
+    schedule(cq, big);
+    mcreq_sched_leave(&cq, 0);
+
+    struct Counter {
+        static void fail(mc_PIPELINE *, mc_PACKET *, lcb_STATUS, void *arg)
+        {
+            (*reinterpret_cast< int * >(arg))++;
+        }
+    };
+    int nfailed = 0;
+    ASSERT_EQ(2, mcreq_pipeline_fail(sched.pipeline, LCB_ERR_NETWORK, Counter::fail, &nfailed));
+    ASSERT_EQ(2, nfailed);
+    ASSERT_TRUE(SLLIST_IS_EMPTY(&sched.pipeline->held));
+    ASSERT_EQ(0, mcreq_compresspool_reap(cq.cpool, NULL, 0));
+    drain(cq);
+}
+
+TEST_F(McCompressAsync, testHeldTimeout)
+{
+    CQWrap cq;
+    cq.cpool = mcreq_compresspool_new(1);
+    std::string big = jsonValue(1024 * 1024), small("{}");
+
+    mcreq_sched_enter(&cq);
+    Scheduled first = schedule(cq, big);
+    Scheduled second = schedule(cq, small);
+    Scheduled third = schedule(cq, small);
+    mcreq_sched_leave(&cq, 0);
+    ASSERT_FALSE(SLLIST_IS_EMPTY(&first.pipeline->held));
+
+    struct Counter {
+        static void fail(mc_PIPELINE *, mc_PACKET *, lcb_STATUS err, void *arg)
+        {
+            EXPECT_EQ(LCB_ERR_TIMEOUT, err);
+            (*reinterpret_cast< int * >(arg))++;
+        }
+        /* the small values are not copied */
+        static void buf_done(mc_PIPELINE *, const void *, void *, void *)
+        {
+        }
+    };
+    cq.setBufFreeCallback(Counter::buf_done);
+    hrtime_t now = MCREQ_PKT_RDATA(second.pkt)->deadline;
+    MCREQ_PKT_RDATA(third.pkt)->deadline = now + 1;
+
+    /* the packet being prepared and the one behind it expire, the last one
+     * is enqueued once nothing is in front of it anymore */
+    int nfailed = 0;
+    ASSERT_EQ(2, mcreq_pipeline_timeout(first.pipeline, LCB_ERR_TIMEOUT, Counter::fail, &nfailed, now));
+    ASSERT_EQ(2, nfailed);
+    ASSERT_TRUE(SLLIST_IS_EMPTY(&first.pipeline->held));
+    ASSERT_EQ(third.pkt, mcreq_first_packet(first.pipeline));
+    ASSERT_EQ(mcreq_get_size(third.pkt), first.pipeline->nbytes_pending);
+    ASSERT_EQ(0, mcreq_compresspool_reap(cq.cpool, NULL, 0));
+    drain(cq);
+}
+
+#ifndef _WIN32
+TEST_F(McCompressAsync, testWakeup)
+{
+    CQWrap cq;
+    cq.cpool = mcreq_compresspool_new(1);
+    int fd = mcreq_compresspool_fd(cq.cpool);
+    ASSERT_NE(-1, fd);
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    ASSERT_EQ(0, poll(&pfd, 1, 0));
+    mcreq_sched_enter(&cq);
+    Scheduled sched = schedule(cq, jsonValue(1024 * 1024));
+    mcreq_sched_leave(&cq, 0);
+
+    /* readable once the value is ready, and drained by reaping it */
+    ASSERT_EQ(1, poll(&pfd, 1, 5000));
+    ASSERT_EQ(0, mcreq_compresspool_reap(cq.cpool, NULL, 0));
+    ASSERT_EQ(0, poll(&pfd, 1, 0));
+    ASSERT_EQ(sched.pkt, mcreq_first_packet(sched.pipeline));
+    drain(cq);
+}
+#endif
+
+/* Time spent on the scheduling (event loop) thread for one value */
+TEST_F(McCompressAsync, testLoopLatency)
+{
+    CQWrap cq;
+    cq.cpool = mcreq_compresspool_new(2);
+    const size_t sizes[] = {256 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+    const int nruns = 5;
+    hrtime_t inline_ns = 0, async_ns = 0;
+
+    for (size_t ii = 0; ii < sizeof(sizes) / sizeof(sizes[0]); ii++) {
+        std::string value = jsonValue(sizes[ii]);
+        lcb_VALBUF vb = contig(value);
+        inline_ns = async_ns = 0;
+        for (int jj = 0; jj < nruns; jj++) {
+            hrtime_t begin = gethrtime();
+            store(cq, vb);
+            inline_ns += gethrtime() - begin;
+
+            begin = gethrtime();
+            mcreq_sched_enter(&cq);
+            schedule(cq, value);
+            mcreq_sched_leave(&cq, 0);
+            async_ns += gethrtime() - begin;
+            while (mcreq_compresspool_reap(cq.cpool, NULL, 1)) {
+            }
+            drain(cq);
+        }
+        fprintf(stderr, "%luKiB: inline %.2f ms, async %.2f ms\n", (unsigned long)(sizes[ii] / 1024),
+                (double)inline_ns / nruns / 1000000, (double)async_ns / nruns / 1000000);
+    }
+    /* generous bound, for the largest value the copy is much cheaper than
+     * compressing it */
+    EXPECT_LT(async_ns, inline_ns);
+}
@@ -0,0 +1,249 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "mctest.h"
+#include "mc/mcreq-flush-inl.h"
+#include "mc/forward.h"
+#include "pktmaker.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define NUM_LANES 3
+
+class McLanes : public ::testing::Test
+{
+};
+
+/** A single server with NUM_LANES connections */
+struct LaneCQ : mc_CMDQUEUE {
+    lcbvb_CONFIG *config;
+    mc_PIPELINE *lanebuf[NUM_LANES];
+
+    LaneCQ()
+    {
+        config = lcbvb_create();
+        for (unsigned ii = 0; ii < NUM_LANES; ii++) {
+            lanebuf[ii] = new lcb::Server();
+            mcreq_pipeline_init(lanebuf[ii]);
+        }
+        lanebuf[0]->lanes = lanebuf;
+        lanebuf[0]->nlanes = NUM_LANES;
+        lcbvb_genconfig(config, 1, 0, 64);
+        cqdata = NULL;
+        mcreq_queue_init(this);
+        seq = 100;
+        mcreq_queue_add_pipelines(this, lanebuf, 1, config);
+    }
+
+    ~LaneCQ()
+    {
+        for (unsigned ii = 0; ii < NUM_LANES; ii++) {
+            EXPECT_EQ(0, lanebuf[ii]->nbytes_pending);
+            EXPECT_NE(0, netbuf_is_clean(&lanebuf[ii]->nbmgr));
+            EXPECT_NE(0, netbuf_is_clean(&lanebuf[ii]->reqpool));
+            mcreq_pipeline_cleanup(lanebuf[ii]);
+            delete lanebuf[ii];
+        }
+        mcreq_queue_cleanup(this);
+        lcbvb_destroy(config);
+    }
+
+    /** Find a key which maps to a vBucket not in `used` */
+    std::string keyForNewVb(std::vector< int > &used)
+    {
+        for (int ii = 0;; ii++) {
+            char kbuf[32];
+            int vb, srvix;
+            sprintf(kbuf, "key_%d", ii);
+            lcbvb_map_key(config, kbuf, strlen(kbuf), &vb, &srvix);
+            if (std::find(used.begin(), used.end(), vb) == used.end()) {
+                used.push_back(vb);
+                return kbuf;
+            }
+        }
+    }
+
+    /** Schedule a packet with `nbody` bytes of value, return its lane */
+    mc_PIPELINE *enqueue(const std::string &key, size_t nbody, mc_PACKET **pkt)
+    {
+        PacketWrap pw;
+        pw.setCopyKey(key.c_str());
+        EXPECT_TRUE(pw.reservePacket(this));
+        pw.hdr.request.bodylen = htonl((lcb_uint32_t)(key.size() + nbody));
+        std::vector< char > body(nbody, 'x');
+        lcb_VALBUF vb;
+        memset(&vb, 0, sizeof(vb));
+        vb.vtype = LCB_KV_COPY;
+        vb.u_buf.contig.bytes = &body[0];
+        vb.u_buf.contig.nbytes = nbody;
+        EXPECT_EQ(LCB_SUCCESS, mcreq_reserve_value(pw.pipeline, pw.pkt, &vb));
+        pw.hdr.request.opaque = pw.pkt->opaque;
+        pw.copyHeader();
+        mcreq_enqueue_packet(pw.pipeline, pw.pkt);
+        *pkt = pw.pkt;
+        return pw.pipeline;
+    }
+
+    /** Forward a packet for `key` through `pl` (if given), return its lane */
+    mc_PIPELINE *forward(const std::string &key, int options, mc_PIPELINE *pl = NULL)
+    {
+        std::vector< char > buf;
+        PacketMaker::StorageRequest(key, "value").serialize(buf);
+        int vb, srvix;
+        lcbvb_map_key(config, key.c_str(), key.size(), &vb, &srvix);
+        reinterpret_cast< protocol_binary_request_header * >(&buf[0])->request.vbucket = htons((uint16_t)vb);
+
+        nb_IOV iov;
+        iov.iov_base = &buf[0];
+        iov.iov_len = buf.size();
+        mc_IOVINFO ioi;
+        memset(&ioi, 0, sizeof(ioi));
+        mc_iovinfo_init(&ioi, &iov, 1);
+        mc_PACKET *pkt = NULL;
+        EXPECT_EQ(LCB_SUCCESS, mc_forward_packet(this, &ioi, &pkt, &pl, options | MC_FWD_OPT_COPY));
+        return pl;
+    }
+
+    void complete(mc_PIPELINE *pl, mc_PACKET *pkt)
+    {
+        ASSERT_EQ(pkt, mcreq_pipeline_remove(pl, pkt->opaque));
+        unsigned toflush;
+        nb_IOV iov;
+        while ((toflush = mcreq_flush_iov_fill(pl, &iov, 1, NULL))) {
+            mcreq_flush_done(pl, toflush, toflush);
+        }
+        mcreq_packet_handled(pl, pkt);
+    }
+};
+
+TEST_F(McLanes, testLanesInQueue)
+{
+    LaneCQ cq;
+    ASSERT_EQ(1, cq.npipelines);
+    ASSERT_EQ(NUM_LANES, cq.nlanes);
+    for (unsigned ii = 0; ii < NUM_LANES; ii++) {
+        ASSERT_EQ(cq.lanebuf[ii], cq.pipelines[ii]);
+        ASSERT_EQ(0, cq.lanebuf[ii]->index);
+        ASSERT_EQ(ii, cq.lanebuf[ii]->qpos);
+        ASSERT_EQ(64, cq.lanebuf[ii]->nvb);
+    }
+}
+
+TEST_F(McLanes, testBalanceAndPinning)
+{
+    LaneCQ cq;
+    std::vector< int > used;
+    mc_PACKET *pkts[4];
+    mc_PIPELINE *pls[4];
+
+    std::string k1 = cq.keyForNewVb(used);
+    std::string k2 = cq.keyForNewVb(used);
+    std::string k3 = cq.keyForNewVb(used);
+
+    /* the first lane takes the large value */
+    pls[0] = cq.enqueue(k1, 4096, &pkts[0]);
+    ASSERT_EQ(cq.lanebuf[0], pls[0]);
+
+    /* another vBucket goes to an idle lane */
+    pls[1] = cq.enqueue(k2, 16, &pkts[1]);
+    ASSERT_NE(pls[0], pls[1]);
+
+    /* the same vBucket sticks to the busy lane while it has pending packets */
+    pls[2] = cq.enqueue(k1, 16, &pkts[2]);
+    ASSERT_EQ(pls[0], pls[2]);
+    ASSERT_EQ(2, pls[0]->vbpending[used[0]]);
+
+    /* a new vBucket goes to the lane with the fewest pending bytes */
+    pls[3] = cq.enqueue(k3, 16, &pkts[3]);
+    ASSERT_NE(pls[0], pls[3]);
+    ASSERT_NE(pls[1], pls[3]);
+
+    size_t total = 0;
+    for (unsigned ii = 0; ii < NUM_LANES; ii++) {
+        total += cq.lanebuf[ii]->nbytes_pending;
+    }
+    size_t expected = 0;
+    for (unsigned ii = 0; ii < 4; ii++) {
+        expected += mcreq_get_size(pkts[ii]);
+    }
+    ASSERT_EQ(expected, total);
+
+    for (unsigned ii = 0; ii < 4; ii++) {
+        cq.complete(pls[ii], pkts[ii]);
+    }
+}
+
+TEST_F(McLanes, testRepinWhenDrained)
+{
+    LaneCQ cq;
+    std::vector< int > used;
+    mc_PACKET *big, *small, *other;
+
+    std::string k1 = cq.keyForNewVb(used);
+    std::string k2 = cq.keyForNewVb(used);
+    std::string k3 = cq.keyForNewVb(used);
+
+    mc_PIPELINE *bigpl = cq.enqueue(k1, 8192, &big);
+    mc_PIPELINE *smallpl = cq.enqueue(k2, 16, &small);
+    ASSERT_NE(bigpl, smallpl);
+    mc_PIPELINE *otherpl = cq.enqueue(k3, 16, &other);
+
+    /* once drained, k2 may move to whichever lane is least loaded */
+    cq.complete(smallpl, small);
+    ASSERT_EQ(0, smallpl->vbpending[used[1]]);
+    mc_PIPELINE *next = mcreq_pipeline_lane(cq.lanebuf[0], used[1]);
+    ASSERT_NE(bigpl, next);
+    ASSERT_EQ(0, next->nbytes_pending);
+
+    /* while k1 stays pinned, regardless of the load */
+    ASSERT_EQ(bigpl, mcreq_pipeline_lane(cq.lanebuf[0], used[0]));
+
+    cq.complete(bigpl, big);
+    cq.complete(otherpl, other);
+    ASSERT_EQ(0, bigpl->nbytes_pending);
+}
+
+TEST_F(McLanes, testForward)
+{
+    LaneCQ cq;
+    std::vector< int > used;
+    mc_PACKET *big;
+
+    std::string k1 = cq.keyForNewVb(used);
+    std::string k2 = cq.keyForNewVb(used);
+    mc_PIPELINE *bigpl = cq.enqueue(k1, 8192, &big);
+
+    /* forwarded packets keep the order of their vBucket */
+    ASSERT_EQ(bigpl, cq.forward(k1, 0));
+    /* and are otherwise balanced, also when the caller picked the node */
+    ASSERT_NE(bigpl, cq.forward(k2, 0));
+    ASSERT_NE(bigpl, cq.forward(k2, MC_FWD_OPT_NOMAP, bigpl));
+
+    mcreq_sched_fail(&cq);
+    cq.complete(bigpl, big);
+}
+
+TEST_F(McLanes, testSingleLane)
+{
+    CQWrap cq;
+    for (unsigned ii = 0; ii < cq.npipelines; ii++) {
+        ASSERT_EQ(cq.pipelines[ii], mcreq_pipeline_lane(cq.pipelines[ii], 0));
+        ASSERT_TRUE(cq.pipelines[ii]->vbpending == NULL);
+    }
+    ASSERT_EQ(cq.npipelines, cq.nlanes);
+}
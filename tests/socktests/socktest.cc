@@ -311,7 +311,7 @@ bool FlushedBreakCondition::shouldBreakImpl()
         return false;
     }
 
-    if (ctx->output && ctx->output->rb.nbytes == 0) {
+    if (ctx->output && LCBIO_EASYRB_NBYTES(ctx->output) == 0) {
         return true;
     }
     return false;
@@ -78,6 +78,31 @@ static bool isRefused(lcbio_OSERR err)
     return false;
 }
 // Test a connect without an accept
+TEST_F(SockConnTest, testSockopts)
+{
+    ESocket sock;
+    int value = 0;
+
+    loop->settings->tcp_rcvbuf = 65536;
+    loop->settings->tcp_sndbuf = 65536;
+    loop->connect(&sock);
+    ASSERT_FALSE(sock.sock == NULL);
+
+    lcb_STATUS err = lcbio_get_sockopt(sock.sock, LCB_IO_CNTL_SO_RCVBUF, &value);
+    if (err == LCB_ERR_UNSUPPORTED_OPERATION) {
+        return;
+    }
+    ASSERT_EQ(LCB_SUCCESS, err);
+    // the kernel might round the value, or reserve extra room for bookkeeping
+    ASSERT_GE(value, 32768);
+    ASSERT_EQ(LCB_SUCCESS, lcbio_get_sockopt(sock.sock, LCB_IO_CNTL_SO_SNDBUF, &value));
+    ASSERT_GE(value, 32768);
+
+    ASSERT_EQ(LCB_SUCCESS, lcbio_set_sockopt(sock.sock, LCB_IO_CNTL_TCP_NODELAY, 1));
+    ASSERT_EQ(LCB_SUCCESS, lcbio_get_sockopt(sock.sock, LCB_IO_CNTL_TCP_NODELAY, &value));
+    ASSERT_NE(0, value);
+}
+
 TEST_F(SockConnTest, testRefused)
 {
     ESocket sock;
@@ -157,3 +182,64 @@ TEST_F(SockConnTest, testImmediateUnref)
     ASSERT_EQ(1, sock.callCount);
     ASSERT_TRUE(sock.sock == NULL);
 }
+
+/** Breaks once the counter is non-zero, or after about two seconds */
+class CountBreakCondition : public BreakCondition
+{
+  public:
+    CountBreakCondition(int *count_) : count(count_), remaining(1000) {}
+
+  protected:
+    bool shouldBreakImpl()
+    {
+        return *count > 0 || --remaining == 0;
+    }
+    int *count;
+    unsigned remaining;
+};
+
+extern "C" {
+static void count_event_cb(lcb_socket_t, short, void *arg)
+{
+    *(int *)arg += 1;
+}
+}
+
+// Several events watching the same descriptor in turn (as the socket pool's
+// idle watcher and a connection's context do) must each be delivered
+TEST_F(SockConnTest, testSharedDescriptor)
+{
+    ESocket sock;
+    loop->connect(&sock);
+    ASSERT_FALSE(sock.sock == NULL);
+    if (!loop->iot->is_E()) {
+        return;
+    }
+    lcbio_TABLE *iot = loop->iot;
+    lcb_socket_t fd = sock.sock->u.fd;
+    int countA = 0, countB = 0;
+    void *evA = iot->E_event_create();
+    void *evB = iot->E_event_create();
+
+    iot->E_event_watch(fd, evA, LCB_READ_EVENT, &countA, count_event_cb);
+    iot->E_event_cancel(fd, evA);
+    iot->E_event_watch(fd, evB, LCB_READ_EVENT, &countB, count_event_cb);
+    iot->E_event_cancel(fd, evB);
+    iot->E_event_watch(fd, evA, LCB_READ_EVENT, &countA, count_event_cb);
+    iot->E_event_destroy(evB);
+
+    string msg("Hello");
+    SendFuture sf(msg);
+    sock.conn->setSend(&sf);
+    sf.wait();
+    ASSERT_TRUE(sf.isOk());
+
+    CountBreakCondition cbc(&countA);
+    loop->setBreakCondition(&cbc);
+    loop->start();
+    ASSERT_GT(countA, 0);
+    ASSERT_EQ(0, countB);
+
+    iot->E_event_cancel(fd, evA);
+    iot->E_event_destroy(evA);
+}
@@ -30,6 +30,21 @@ TEST_F(SockMgrTest, testBasic)
     delete sock2;
 }
 
+// Finished requests are kept by the pool and reused
+TEST_F(SockMgrTest, testRequestReuse)
+{
+    lcb_host_t host = {0};
+    loop->populateHost(&host);
+    lcb::io::ConnectionRequest *req1 = loop->sockpool->get(host, LCB_MS2US(1000), NULL, NULL);
+    ASSERT_FALSE(req1 == NULL);
+    req1->cancel();
+    lcb::io::ConnectionRequest *req2 = loop->sockpool->get(host, LCB_MS2US(1000), NULL, NULL);
+    ASSERT_EQ(req1, req2);
+    req2->cancel();
+    loop->sockpool->get_options().tmoidle = LCB_MS2US(2);
+    loop->start();
+}
+
 TEST_F(SockMgrTest, testCancellation)
 {
     lcb_host_t host = {0};
@@ -160,3 +175,218 @@ TEST_F(SockMgrTest, testMaxIdle)
         delete otherSocks[ii];
     }
 }
+
+/** Breaks the loop once a counter of the (single) pooled host reaches a value */
+class PoolStatBreakCondition : public BreakCondition
+{
+  public:
+    PoolStatBreakCondition(lcb::io::Pool *pool_, const char *field_, unsigned value_)
+        : pool(pool_), field(field_), value(value_), remaining(1000)
+    {
+    }
+
+    unsigned current()
+    {
+        Json::Value root;
+        pool->toJSON(0, root);
+        if (root["pools"].size() != 1) {
+            return 0;
+        }
+        return root["pools"][0][field].asUInt();
+    }
+
+  protected:
+    bool shouldBreakImpl()
+    {
+        return current() >= value || --remaining == 0;
+    }
+
+    lcb::io::Pool *pool;
+    const char *field;
+    unsigned value;
+    unsigned remaining;
+};
+
+// Idle sockets closed by the peer are evicted without being checked out
+TEST_F(SockMgrTest, testIdleEviction)
+{
+    if (loop->iot->model != LCB_IOMODEL_EVENT) {
+        // completion based plugins check the socket on checkout
+        return;
+    }
+    ESocket *sock1 = new ESocket();
+    loop->connectPooled(sock1);
+    TestConnection *tc = sock1->conn;
+    delete sock1;
+
+    CloseFuture cf(CloseFuture::BEFORE_IO);
+    tc->setClose(&cf);
+    cf.wait();
+
+    PoolStatBreakCondition bc(loop->sockpool, "evictions", 1);
+    loop->setBreakCondition(&bc);
+    loop->start();
+    ASSERT_EQ(1, bc.current());
+
+    PoolStatBreakCondition idle(loop->sockpool, "idle", 0);
+    ASSERT_EQ(0, idle.current());
+
+    ESocket *sock2 = new ESocket();
+    loop->connectPooled(sock2);
+    ASSERT_TRUE(sock2->sock != NULL);
+    delete sock2;
+}
+
+// A socket which was leased and released again is still watched while idle
+TEST_F(SockMgrTest, testIdleEvictionAfterRelease)
+{
+    if (loop->iot->model != LCB_IOMODEL_EVENT) {
+        return;
+    }
+    ESocket *sock1 = new ESocket();
+    loop->connectPooled(sock1);
+    lcbio_SOCKET *rawsock = sock1->sock;
+    TestConnection *tc = sock1->conn;
+    delete sock1;
+
+    // Lease it again and perform I/O, so that the connection's own event
+    // watches the descriptor as well
+    ESocket *sock2 = new ESocket();
+    loop->connectPooled(sock2);
+    ASSERT_EQ(rawsock, sock2->sock);
+    string msg("Hello World!");
+    RecvFuture rf(msg.size());
+    FutureBreakCondition fbc(&rf);
+    tc->setRecv(&rf);
+    sock2->put(msg);
+    sock2->schedule();
+    loop->setBreakCondition(&fbc);
+    loop->start();
+    rf.wait();
+    ASSERT_TRUE(rf.isOk());
+    delete sock2;
+
+    CloseFuture cf(CloseFuture::BEFORE_IO);
+    tc->setClose(&cf);
+    cf.wait();
+
+    PoolStatBreakCondition bc(loop->sockpool, "evictions", 1);
+    loop->setBreakCondition(&bc);
+    loop->start();
+    ASSERT_EQ(1, bc.current());
+    PoolStatBreakCondition idle(loop->sockpool, "idle", 0);
+    ASSERT_EQ(0, idle.current());
+}
+
+// A hangup received while the loop is stopped is noticed on checkout
+TEST_F(SockMgrTest, testIdleClosedWhileStopped)
+{
+    ESocket *sock1 = new ESocket();
+    loop->connectPooled(sock1);
+    TestConnection *tc = sock1->conn;
+    delete sock1;
+
+    // let the loop run while the socket is idle
+    PoolStatBreakCondition idle(loop->sockpool, "idle", 1);
+    loop->setBreakCondition(&idle);
+    loop->start();
+    loop->sockpool->loop_stopped();
+
+    CloseFuture cf(CloseFuture::BEFORE_IO);
+    tc->setClose(&cf);
+    cf.wait();
+
+    ESocket *sock2 = new ESocket();
+    loop->connectPooled(sock2);
+    ASSERT_TRUE(sock2->sock != NULL);
+    PoolStatBreakCondition evictions(loop->sockpool, "evictions", 0);
+    ASSERT_EQ(1, evictions.current());
+    delete sock2;
+}
+
+#ifndef _WIN32
+/** Requests a pooled connection from the callback of an unrelated event */
+struct LeaseTrigger {
+    Loop *loop;
+    void *event;
+    int fds[2];
+    ESocket sock;
+};
+
+extern "C" {
+static void lease_done(lcbio_SOCKET *sock, void *arg, lcb_STATUS err, lcbio_OSERR)
+{
+    LeaseTrigger *trigger = reinterpret_cast< LeaseTrigger * >(arg);
+    trigger->sock.assign(sock, err);
+    trigger->loop->stop();
+}
+
+static void lease_trigger_cb(lcb_socket_t, short, void *arg)
+{
+    LeaseTrigger *trigger = reinterpret_cast< LeaseTrigger * >(arg);
+    lcb_host_t host = {0};
+    trigger->loop->iot->E_event_cancel(trigger->fds[0], trigger->event);
+    trigger->loop->populateHost(&host);
+    trigger->sock.creq = trigger->loop->sockpool->get(host, LCB_MS2US(1000), lease_done, trigger);
+}
+}
+
+// The idle socket is leased while the loop is about to dispatch its own
+// (ready) idle event in the same iteration
+TEST_F(SockMgrTest, testLeaseWhileIdleEventReady)
+{
+    if (loop->iot->model != LCB_IOMODEL_EVENT) {
+        return;
+    }
+    ESocket *sock1 = new ESocket();
+    loop->connectPooled(sock1);
+    TestConnection *tc = sock1->conn;
+    delete sock1;
+
+    CloseFuture cf(CloseFuture::BEFORE_IO);
+    tc->setClose(&cf);
+    cf.wait();
+
+    // created after the idle event, so the select plugin dispatches it first
+    LeaseTrigger trigger;
+    trigger.loop = loop;
+    trigger.sock.parent = loop;
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, trigger.fds));
+    ASSERT_EQ(1, write(trigger.fds[1], "x", 1));
+    trigger.event = loop->iot->E_event_create();
+    loop->iot->E_event_watch(trigger.fds[0], trigger.event, LCB_READ_EVENT, &trigger, lease_trigger_cb);
+
+    loop->start();
+    ASSERT_TRUE(trigger.sock.sock != NULL);
+    trigger.sock.close();
+    loop->iot->E_event_destroy(trigger.event);
+    close(trigger.fds[0]);
+    close(trigger.fds[1]);
+}
+#endif
+
+TEST_F(SockMgrTest, testMinIdle)
+{
+    loop->sockpool->get_options().minidle = 2;
+
+    ESocket *sock1 = new ESocket();
+    loop->connectPooled(sock1);
+    ASSERT_TRUE(sock1->sock != NULL);
+
+    // connections are opened in the background to replace the leased one
+    PoolStatBreakCondition bc(loop->sockpool, "idle", 2);
+    loop->setBreakCondition(&bc);
+    loop->start();
+    ASSERT_EQ(2, bc.current());
+
+    ESocket *sock2 = new ESocket();
+    loop->connectPooled(sock2);
+    ASSERT_TRUE(sock2->sock != NULL);
+    PoolStatBreakCondition hits(loop->sockpool, "hits", 0);
+    ASSERT_EQ(1, hits.current());
+    PoolStatBreakCondition misses(loop->sockpool, "misses", 0);
+    ASSERT_EQ(1, misses.current());
+
+    delete sock2;
+    delete sock1;
+}
@@ -0,0 +1,409 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2020 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "socktest.h"
+#include "mcserver/negotiate.h"
+#include <memcached/protocol_binary.h>
+#include <map>
+using namespace LCBTest;
+using std::string;
+using std::vector;
+
+/**
+ * Memcached peer answering negotiation requests from a script. Each opcode
+ * has a list of replies; the last one is repeated once the others are used.
+ * Opcodes without a script get an empty successful reply.
+ */
+class ScriptedServer
+{
+  public:
+    ScriptedServer() : lsn(SockFD::newListener()), thr(NULL) {}
+
+    ~ScriptedServer()
+    {
+        delete thr;
+        delete lsn;
+    }
+
+    void reply(uint8_t opcode, uint16_t status, const string &value = "")
+    {
+        Reply r = {status, value};
+        script[opcode].push_back(r);
+    }
+
+    /** Accept the next client. May be called again once it was joined */
+    void start()
+    {
+        delete thr;
+        received.clear();
+        thr = new Thread(run_thread, this);
+    }
+
+    /** Wait for the client to disconnect */
+    void join()
+    {
+        thr->join();
+    }
+
+    void populateHost(lcb_host_t *host)
+    {
+        char port[16];
+        sprintf(port, "%d", (int)lsn->getLocalPort());
+        strcpy(host->host, lsn->getLocalHost().c_str());
+        strcpy(host->port, port);
+    }
+
+    /** Opcodes of the requests received, in order */
+    vector< uint8_t > received;
+
+  private:
+    struct Reply {
+        uint16_t status;
+        string value;
+    };
+
+    static void run_thread(void *arg)
+    {
+        reinterpret_cast< ScriptedServer * >(arg)->run();
+    }
+
+    static bool recv_all(SockFD *fd, char *buf, size_t n)
+    {
+        while (n) {
+            ssize_t rv = fd->recv(buf, n);
+            if (rv <= 0) {
+                return false;
+            }
+            buf += rv;
+            n -= rv;
+        }
+        return true;
+    }
+
+    void run()
+    {
+        SockFD *conn = lsn->acceptClient();
+        protocol_binary_request_header req;
+        while (recv_all(conn, (char *)req.bytes, sizeof(req.bytes))) {
+            vector< char > body(ntohl(req.request.bodylen));
+            if (!body.empty() && !recv_all(conn, &body[0], body.size())) {
+                break;
+            }
+            uint8_t opcode = req.request.opcode;
+            received.push_back(opcode);
+
+            Reply r = {PROTOCOL_BINARY_RESPONSE_SUCCESS, ""};
+            std::list< Reply > &replies = script[opcode];
+            if (!replies.empty()) {
+                r = replies.front();
+                if (replies.size() > 1) {
+                    replies.pop_front();
+                }
+            }
+
+            protocol_binary_response_header res;
+            memset(&res, 0, sizeof(res));
+            res.response.magic = PROTOCOL_BINARY_RES;
+            res.response.opcode = opcode;
+            res.response.status = htons(r.status);
+            res.response.bodylen = htonl((uint32_t)r.value.size());
+            res.response.opaque = req.request.opaque;
+            string out((const char *)res.bytes, sizeof(res.bytes));
+            out += r.value;
+            conn->send(out.c_str(), out.size());
+        }
+        delete conn;
+    }
+
+    SockFD *lsn;
+    Thread *thr;
+    std::map< uint8_t, std::list< Reply > > script;
+};
+
+static string features(uint16_t a, uint16_t b = 0)
+{
+    string ret;
+    uint16_t tmp = htons(a);
+    ret.append((const char *)&tmp, sizeof tmp);
+    if (b) {
+        tmp = htons(b);
+        ret.append((const char *)&tmp, sizeof tmp);
+    }
+    return ret;
+}
+
+static string errmap_json(int revision)
+{
+    char buf[256];
+    sprintf(buf,
+            "{\"version\":1,\"revision\":%d,\"errors\":"
+            "{\"20\":{\"name\":\"AUTH_ERROR\",\"desc\":\"Auth error\",\"attrs\":[\"auth\"]}}}",
+            revision);
+    return buf;
+}
+
+struct Negotiation {
+    Loop *loop;
+    lcb::SessionRequest *req;
+    lcbio_SOCKET *sock;
+    lcb_STATUS err;
+    bool done;
+};
+
+extern "C" {
+static void negotiated_cb(lcbio_SOCKET *sock, void *arg, lcb_STATUS err, lcbio_OSERR)
+{
+    Negotiation *n = reinterpret_cast< Negotiation * >(arg);
+    n->req = NULL;
+    n->done = true;
+    n->err = err;
+    n->sock = sock;
+    if (sock) {
+        lcbio_ref(sock);
+    }
+    n->loop->stop();
+}
+
+static void connected_cb(lcbio_SOCKET *sock, void *arg, lcb_STATUS err, lcbio_OSERR syserr)
+{
+    Negotiation *n = reinterpret_cast< Negotiation * >(arg);
+    if (sock == NULL) {
+        negotiated_cb(NULL, arg, err, syserr);
+        return;
+    }
+    n->req = lcb::SessionRequest::start(sock, n->loop->settings, LCB_MS2US(5000), negotiated_cb, n);
+}
+}
+
+class SockNegotiateTest : public SockTest
+{
+  protected:
+    void SetUp()
+    {
+        SockTest::SetUp();
+        lcb_settings *settings = loop->settings;
+        settings->pipeline_negotiation = 1;
+        settings->sasl_mech_force = strdup("SCRAM-SHA512");
+        settings->bucket = strdup("default");
+        settings->conntype = LCB_TYPE_BUCKET;
+        settings->select_bucket = 1;
+        settings->use_errmap = 1;
+        lcbauth_set_mode(settings->auth, LCBAUTH_MODE_RBAC);
+        lcbauth_add_pass(settings->auth, "user", "password", LCBAUTH_F_CLUSTER);
+        prepare(server);
+    }
+
+    static void prepare(ScriptedServer &srv)
+    {
+        srv.reply(PROTOCOL_BINARY_CMD_SASL_LIST_MECHS, PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                  "SCRAM-SHA512 SCRAM-SHA256 SCRAM-SHA1");
+    }
+
+    /**
+     * Connect to a scripted server and negotiate the session. The server
+     * replies to GET_ERROR_MAP with a map of the given revision unless
+     * scripted otherwise.
+     */
+    Negotiation negotiate(ScriptedServer &srv, int errmap_revision = 1)
+    {
+        srv.reply(PROTOCOL_BINARY_CMD_GET_ERROR_MAP, PROTOCOL_BINARY_RESPONSE_SUCCESS, errmap_json(errmap_revision));
+        Negotiation n = {loop, NULL, NULL, LCB_SUCCESS, false};
+        lcb_host_t host = {0};
+        srv.populateHost(&host);
+        srv.start();
+        lcbio_connect(loop->iot, loop->settings, &host, LCB_MS2US(5000), connected_cb, &n);
+        loop->start();
+        EXPECT_TRUE(n.done);
+        if (n.sock) {
+            lcbio_unref(n.sock);
+            n.sock = NULL;
+        }
+        srv.join();
+        return n;
+    }
+
+    Negotiation negotiate()
+    {
+        return negotiate(server);
+    }
+
+    /** The opcodes a server received, as a comma separated list of names */
+    static string received(const ScriptedServer &srv)
+    {
+        string ret;
+        for (size_t ii = 0; ii < srv.received.size(); ii++) {
+            if (ii) {
+                ret += ",";
+            }
+            switch (srv.received[ii]) {
+                case PROTOCOL_BINARY_CMD_HELLO:
+                    ret += "HELLO";
+                    break;
+                case PROTOCOL_BINARY_CMD_SASL_LIST_MECHS:
+                    ret += "LIST_MECHS";
+                    break;
+                case PROTOCOL_BINARY_CMD_SASL_AUTH:
+                    ret += "AUTH";
+                    break;
+                case PROTOCOL_BINARY_CMD_GET_ERROR_MAP:
+                    ret += "ERRMAP";
+                    break;
+                case PROTOCOL_BINARY_CMD_SELECT_BUCKET:
+                    ret += "SELECT";
+                    break;
+                default:
+                    ret += "?";
+            }
+        }
+        return ret;
+    }
+
+    string received()
+    {
+        return received(server);
+    }
+
+    ScriptedServer server;
+};
+
+TEST_F(SockNegotiateTest, testPipelined)
+{
+    server.reply(PROTOCOL_BINARY_CMD_HELLO, PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                 features(PROTOCOL_BINARY_FEATURE_XERROR, PROTOCOL_BINARY_FEATURE_SELECT_BUCKET));
+    Negotiation n = negotiate();
+    ASSERT_EQ(LCB_SUCCESS, n.err);
+    // GET_ERROR_MAP is only sent once HELLO has confirmed XERROR
+    ASSERT_EQ("HELLO,AUTH,ERRMAP,SELECT", received());
+    ASSERT_TRUE(loop->settings->errmap->isLoaded());
+}
+
+TEST_F(SockNegotiateTest, testPipelinedWithoutFeatures)
+{
+    // Neither XERROR nor SELECT_BUCKET
+    server.reply(PROTOCOL_BINARY_CMD_HELLO, PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                 features(PROTOCOL_BINARY_FEATURE_JSON));
+    Negotiation n = negotiate();
+    ASSERT_EQ(LCB_SUCCESS, n.err);
+    ASSERT_EQ("HELLO,AUTH", received());
+    ASSERT_FALSE(loop->settings->errmap->isLoaded());
+}
+
+TEST_F(SockNegotiateTest, testFallbackOnHello)
+{
+    server.reply(PROTOCOL_BINARY_CMD_HELLO, PROTOCOL_BINARY_RESPONSE_EINTERNAL);
+    server.reply(PROTOCOL_BINARY_CMD_HELLO, PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                 features(PROTOCOL_BINARY_FEATURE_XERROR, PROTOCOL_BINARY_FEATURE_SELECT_BUCKET));
+    Negotiation n = negotiate();
+    ASSERT_EQ(LCB_SUCCESS, n.err);
+    ASSERT_EQ("HELLO,AUTH,HELLO,ERRMAP,LIST_MECHS,AUTH,SELECT", received());
+}
+
+TEST_F(SockNegotiateTest, testFallbackOnAuth)
+{
+    server.reply(PROTOCOL_BINARY_CMD_HELLO, PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                 features(PROTOCOL_BINARY_FEATURE_XERROR, PROTOCOL_BINARY_FEATURE_SELECT_BUCKET));
+    server.reply(PROTOCOL_BINARY_CMD_SASL_AUTH, PROTOCOL_BINARY_RESPONSE_AUTH_ERROR);
+    server.reply(PROTOCOL_BINARY_CMD_SASL_AUTH, PROTOCOL_BINARY_RESPONSE_SUCCESS);
+    Negotiation n = negotiate();
+    ASSERT_EQ(LCB_SUCCESS, n.err);
+    ASSERT_EQ("HELLO,AUTH,ERRMAP,HELLO,ERRMAP,LIST_MECHS,AUTH,SELECT", received());
+}
+
+TEST_F(SockNegotiateTest, testFallbackOnErrmap)
+{
+    server.reply(PROTOCOL_BINARY_CMD_HELLO, PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                 features(PROTOCOL_BINARY_FEATURE_XERROR, PROTOCOL_BINARY_FEATURE_SELECT_BUCKET));
+    server.reply(PROTOCOL_BINARY_CMD_GET_ERROR_MAP, PROTOCOL_BINARY_RESPONSE_SUCCESS, "{");
+    Negotiation n = negotiate();
+    ASSERT_EQ(LCB_SUCCESS, n.err);
+    ASSERT_EQ("HELLO,AUTH,ERRMAP,SELECT,HELLO,ERRMAP,LIST_MECHS,AUTH,SELECT", received());
+    ASSERT_TRUE(loop->settings->errmap->isLoaded());
+}
+
+TEST_F(SockNegotiateTest, testFallbackFailure)
+{
+    // Failures of the serial sequence are final
+    server.reply(PROTOCOL_BINARY_CMD_HELLO, PROTOCOL_BINARY_RESPONSE_SUCCESS,
+                 features(PROTOCOL_BINARY_FEATURE_XERROR, PROTOCOL_BINARY_FEATURE_SELECT_BUCKET));
+    server.reply(PROTOCOL_BINARY_CMD_SASL_AUTH, PROTOCOL_BINARY_RESPONSE_AUTH_ERROR);
+    Negotiation n = negotiate();
+    ASSERT_EQ(LCB_ERR_AUTHENTICATION_FAILURE, n.err);
+    ASSERT_EQ("HELLO,AUTH,ERRMAP,HELLO,ERRMAP,LIST_MECHS,AUTH", received());
+}
+
+static void enable_features(ScriptedServer &srv)
+{
+    srv.reply(PROTOCOL_BINARY_CMD_HELLO, PROTOCOL_BINARY_RESPONSE_SUCCESS,
+              features(PROTOCOL_BINARY_FEATURE_XERROR, PROTOCOL_BINARY_FEATURE_SELECT_BUCKET));
+}
+
+TEST_F(SockNegotiateTest, testErrmapCached)
+{
+    enable_features(server);
+    ASSERT_EQ(LCB_SUCCESS, negotiate().err);
+    ASSERT_EQ("HELLO,AUTH,ERRMAP,SELECT", received());
+
+    // Same node, same map: GET_ERROR_MAP is skipped
+    ASSERT_EQ(LCB_SUCCESS, negotiate().err);
+    ASSERT_EQ("HELLO,AUTH,SELECT", received());
+
+    // Once its connection failed the node is asked again
+    lcb_host_t host = {0};
+    server.populateHost(&host);
+    lcb_sesscache_forget(loop->settings->sesscache, host.host, host.port);
+    ASSERT_EQ(LCB_SUCCESS, negotiate().err);
+    ASSERT_EQ("HELLO,AUTH,ERRMAP,SELECT", received());
+}
+
+TEST_F(SockNegotiateTest, testErrmapNotCachedForOtherNode)
+{
+    ScriptedServer other;
+    prepare(other);
+    enable_features(server);
+    enable_features(other);
+    ASSERT_EQ(LCB_SUCCESS, negotiate().err);
+    ASSERT_EQ("HELLO,AUTH,ERRMAP,SELECT", received());
+
+    ASSERT_EQ(LCB_SUCCESS, negotiate(other).err);
+    ASSERT_EQ("HELLO,AUTH,ERRMAP,SELECT", received(other));
+}
+
+TEST_F(SockNegotiateTest, testErrmapInvalidated)
+{
+    ScriptedServer other;
+    prepare(other);
+    enable_features(server);
+    enable_features(other);
+    ASSERT_EQ(LCB_SUCCESS, negotiate(server, 1).err);
+    ASSERT_EQ(1U, loop->settings->errmap->getRevision());
+
+    // Another node serves a newer revision, e.g. during an upgrade
+    ASSERT_EQ(LCB_SUCCESS, negotiate(other, 2).err);
+    ASSERT_EQ("HELLO,AUTH,ERRMAP,SELECT", received(other));
+    ASSERT_EQ(2U, loop->settings->errmap->getRevision());
+
+    // The first node is asked again. Its older map does not replace the
+    // newer one, but is cached again
+    ASSERT_EQ(LCB_SUCCESS, negotiate(server, 1).err);
+    ASSERT_EQ("HELLO,AUTH,ERRMAP,SELECT", received());
+    ASSERT_EQ(2U, loop->settings->errmap->getRevision());
+
+    ASSERT_EQ(LCB_SUCCESS, negotiate(server, 1).err);
+    ASSERT_EQ("HELLO,AUTH,SELECT", received());
+    ASSERT_EQ(LCB_SUCCESS, negotiate(other, 2).err);
+    ASSERT_EQ("HELLO,AUTH,SELECT", received(other));
+}
@@ -20,6 +20,9 @@
 #ifndef LCB_NO_SSL
 
 #include <lcbio/ssl.h>
+#include "ssl/ssl_iot_common.h"
+#include "logging.h"
+#include <ctime>
 using namespace LCBTest;
 using std::string;
 using std::vector;
@@ -91,6 +94,264 @@ TEST_F(SSLTest, testBasic)
     sock.close();
 }
 
+/** Send and receive a message, so that the handshake is complete */
+static void exchangeMessages(Loop *loop, ESocket &sock)
+{
+    string sendStr("Hello World");
+    RecvFuture rf(sendStr.size());
+    FutureBreakCondition wbc(&rf);
+    sock.conn->setRecv(&rf);
+    sock.put(sendStr);
+    sock.schedule();
+    loop->setBreakCondition(&wbc);
+    loop->start();
+    rf.wait();
+    ASSERT_TRUE(rf.isOk());
+
+    string recvStr("Goodbye World!");
+    SendFuture sf(recvStr);
+    ReadBreakCondition rbc(&sock, recvStr.size());
+    sock.conn->setSend(&sf);
+    sock.reqrd(recvStr.size());
+    sock.schedule();
+    loop->setBreakCondition(&rbc);
+    loop->start();
+    sf.wait();
+    ASSERT_TRUE(sf.isOk());
+    ASSERT_EQ(sock.getReceived(), recvStr);
+}
+
+static bool sessionReused(ESocket &sock)
+{
+    lcbio_XSSL *xs = (lcbio_XSSL *)IOTSSL_FROM_IOPS(sock.sock->io->p);
+    return SSL_session_reused(xs->ssl) == 1;
+}
+
+TEST_F(SSLTest, testSessionResumption)
+{
+    lcbio_SSLSESSIONSTATS stats;
+
+    for (int ii = 0; ii < 2; ii++) {
+        ESocket sock;
+        loop->connect(&sock);
+        ASSERT_FALSE(sock.sock == NULL);
+        exchangeMessages(loop, sock);
+        // the second connection resumes the session of the first one
+        ASSERT_EQ(ii == 1, sessionReused(sock));
+        sock.close();
+    }
+    lcbio_ssl_session_stats(loop->settings->ssl_ctx, &stats);
+    ASSERT_EQ(1, stats.hits);
+    ASSERT_EQ(1, stats.misses);
+    ASSERT_EQ(1, stats.ncached);
+
+    // a lifetime of 0 disables resumption
+    loop->settings->ssl_session_lifetime = 0;
+    ESocket sock;
+    loop->connect(&sock);
+    ASSERT_FALSE(sock.sock == NULL);
+    exchangeMessages(loop, sock);
+    ASSERT_FALSE(sessionReused(sock));
+    sock.close();
+    lcbio_ssl_session_stats(loop->settings->ssl_ctx, &stats);
+    ASSERT_EQ(1, stats.hits);
+    ASSERT_EQ(1, stats.misses);
+}
+
+/* Whether or not the kernel takes over, the connection must keep working */
+TEST_F(SSLTest, testKernelTls)
+{
+    loop->settings->ssl_ktls = 1;
+    for (int ii = 0; ii < 2; ii++) {
+        ESocket sock;
+        loop->connect(&sock);
+        ASSERT_FALSE(sock.sock == NULL);
+        exchangeMessages(loop, sock);
+        if (ii == 0) {
+            int ktls = lcbio_ssl_ktls(sock.sock);
+            fprintf(stderr, "kTLS send: %s, recv: %s\n", (ktls & LCBIO_KTLS_SEND) ? "yes" : "no",
+                    (ktls & LCBIO_KTLS_RECV) ? "yes" : "no");
+        } else {
+            // also with a resumed session
+            ASSERT_TRUE(sessionReused(sock));
+        }
+        sock.close();
+    }
+    loop->settings->ssl_ktls = 0;
+}
+
+static bool hasInfoCallback(ESocket &sock)
+{
+    lcbio_XSSL *xs = (lcbio_XSSL *)IOTSSL_FROM_IOPS(sock.sock->io->p);
+    return SSL_get_info_callback(xs->ssl) != NULL;
+}
+
+static bool connectWithInfoCallback(Loop *loop)
+{
+    ESocket sock;
+    loop->connect(&sock);
+    EXPECT_FALSE(sock.sock == NULL);
+    if (sock.sock == NULL) {
+        return false;
+    }
+    bool ret = hasInfoCallback(sock);
+    sock.close();
+    return ret;
+}
+
+static void discard_log(const lcb_LOGGER *, uint64_t, const char *, lcb_LOG_SEVERITY, const char *, int, const char *,
+                        va_list)
+{
+}
+
+/* The handshake logging callback is only installed when it would log */
+TEST_F(SSLTest, testInfoCallbackFollowsLogLevel)
+{
+    struct lcb_CONSOLELOGGER *console = (struct lcb_CONSOLELOGGER *)lcb_console_logger;
+    const lcb_LOGGER *oldlogger = loop->settings->logger;
+    int oldlevel = console->minlevel;
+    FILE *oldfp = console->fp;
+#ifdef LCB_NO_SSL_DEBUG
+    const bool compiled = false;
+#else
+    const bool compiled = true;
+#endif
+
+    loop->settings->ssl_log_handshake = 0;
+    loop->settings->logger = NULL;
+    EXPECT_FALSE(connectWithInfoCallback(loop));
+
+    loop->settings->logger = lcb_console_logger;
+    console->minlevel = LCB_LOG_INFO;
+    EXPECT_FALSE(connectWithInfoCallback(loop));
+
+    console->fp = tmpfile();
+    console->minlevel = LCB_LOG_DEBUG;
+    EXPECT_EQ(compiled, connectWithInfoCallback(loop));
+    console->minlevel = LCB_LOG_TRACE;
+    EXPECT_EQ(compiled, connectWithInfoCallback(loop));
+
+    /* Custom loggers don't report their level, so this is only done on request */
+    lcb_LOGGER *custom = NULL;
+    lcb_logger_create(&custom, NULL);
+    lcb_logger_callback(custom, discard_log);
+    loop->settings->logger = custom;
+    EXPECT_FALSE(connectWithInfoCallback(loop));
+
+    loop->settings->ssl_log_handshake = 1;
+    EXPECT_EQ(compiled, connectWithInfoCallback(loop));
+    loop->settings->ssl_log_handshake = 0;
+
+    lcb_logger_destroy(custom);
+    fclose(console->fp);
+    console->fp = oldfp;
+    console->minlevel = oldlevel;
+    loop->settings->logger = oldlogger;
+}
+
+/**
+ * Flushes many small buffers in batches of IOVs, like the pipeline does for
+ * small packets
+ */
+class SmallWrites : public IOActions
+{
+  public:
+    SmallWrites(size_t nitems, size_t itemsize) : scheduled(0), flushed(0)
+    {
+        for (size_t ii = 0; ii < nitems; ii++) {
+            items.push_back(string(itemsize, 'a' + ii % 26));
+        }
+        total = nitems * itemsize;
+    }
+
+    void onFlushReady(ESocket *s)
+    {
+        int ready;
+        do {
+            lcb_IOV iov[32];
+            size_t niov = 0, nbytes = 0;
+            size_t itemsize = items[0].size();
+            size_t ix = scheduled / itemsize, off = scheduled % itemsize;
+            for (; ix < items.size() && niov < 32; ix++, niov++, off = 0) {
+                iov[niov].iov_base = &items[ix][off];
+                iov[niov].iov_len = itemsize - off;
+                nbytes += iov[niov].iov_len;
+            }
+            if (!nbytes) {
+                break;
+            }
+            /* flush_done may be invoked from within put_ex() */
+            scheduled += nbytes;
+            ready = lcbio_ctx_put_ex(s->ctx, iov, niov, nbytes);
+        } while (ready);
+
+        if (scheduled < total) {
+            lcbio_ctx_wwant(s->ctx);
+            s->schedule();
+        }
+    }
+
+    void onFlushDone(ESocket *, size_t expected, size_t nr)
+    {
+        flushed += nr;
+        if (nr != expected) {
+            scheduled = flushed;
+        }
+    }
+
+    vector< string > items;
+    size_t total;
+    size_t scheduled;
+    size_t flushed;
+};
+
+extern "C" {
+static void count_records(int write_p, int, int content_type, const void *, size_t, SSL *, void *arg)
+{
+    if (write_p && content_type == SSL3_RT_HEADER) {
+        (*(size_t *)arg)++;
+    }
+}
+}
+
+/* Small buffers of the same flush should share TLS records */
+TEST_F(SSLTest, testSmallWritesCoalesced)
+{
+    const size_t nops = 10000, opsize = 24;
+    ESocket sock;
+    SmallWrites actions(nops, opsize);
+    size_t nrecords = 0;
+
+    sock.setActions(&actions);
+    loop->connect(&sock);
+    ASSERT_FALSE(sock.sock == NULL);
+
+    lcbio_XSSL *xs = (lcbio_XSSL *)IOTSSL_FROM_IOPS(sock.sock->io->p);
+    SSL_set_msg_callback(xs->ssl, count_records);
+    SSL_set_msg_callback_arg(xs->ssl, &nrecords);
+
+    RecvFuture rf(actions.total);
+    FutureBreakCondition wbc(&rf);
+    sock.conn->setRecv(&rf);
+
+    std::clock_t begin = std::clock();
+    lcbio_ctx_wwant(sock.ctx);
+    sock.schedule();
+    loop->setBreakCondition(&wbc);
+    loop->start();
+    rf.wait();
+    std::clock_t end = std::clock();
+    ASSERT_TRUE(rf.isOk());
+    ASSERT_EQ(actions.total, actions.flushed);
+
+    fprintf(stderr, "%lu ops of %lu bytes: %lu TLS records, %.1f ms CPU\n", (unsigned long)nops,
+            (unsigned long)opsize, (unsigned long)nrecords, (double)(end - begin) * 1000 / CLOCKS_PER_SEC);
+    /* one record per IOV would be one per op */
+    EXPECT_LT(nrecords, nops / 10);
+    SSL_set_msg_callback(xs->ssl, NULL);
+    sock.close();
+}
+
 #else
 class SSLTest : public ::testing::Test
 {
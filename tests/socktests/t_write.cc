@@ -97,3 +97,165 @@ TEST_F(SockWriteTest, testBrokenMultiWrites)
         cf.wait();
     }
 }
+
+extern "C" {
+static void count_release(void *arg)
+{
+    (*reinterpret_cast< int * >(arg))++;
+}
+}
+
+/**
+ * Referenced buffers are written in order with the copied ones, and released
+ * once they have been flushed
+ */
+TEST_F(SockWriteTest, testPutIov)
+{
+    ESocket sock;
+    loop->connect(&sock);
+
+    string world("World"), bang("!");
+    string expected("Hello World! Bye");
+    RecvFuture rf(expected.size());
+    sock.conn->setRecv(&rf);
+
+    int nreleased = 0;
+    lcb_IOV iov[2];
+    iov[0].iov_base = &world[0];
+    iov[0].iov_len = world.size();
+    iov[1].iov_base = &bang[0];
+    iov[1].iov_len = bang.size();
+
+    sock.put("Hello ");
+    lcbio_ctx_put_iov(sock.ctx, iov, 2, count_release, &nreleased);
+    sock.put(" Bye");
+    sock.schedule();
+
+    FutureBreakCondition wbc(&rf);
+    loop->setBreakCondition(&wbc);
+    loop->start();
+    rf.wait();
+    ASSERT_TRUE(rf.isOk());
+    ASSERT_EQ(expected, rf.getString());
+
+    FlushedBreakCondition fbc(&sock);
+    loop->setBreakCondition(&fbc);
+    loop->start();
+    ASSERT_EQ(1, nreleased);
+}
+
+/**
+ * Interleave many large referenced buffers with copied data, so that the
+ * output spans more IOVs than a single write allows and is written partially
+ */
+TEST_F(SockWriteTest, testPutIovBig)
+{
+    ESocket sock;
+    loop->connect(&sock);
+
+    vector< string > bufs;
+    string expected;
+    for (int ii = 0; ii < 40; ii++) {
+        char hdr[16];
+        sprintf(hdr, "<%d>", ii);
+        bufs.push_back(string(64 * 1024, 'a' + (ii % 26)));
+        expected += hdr;
+        expected += bufs.back();
+    }
+
+    RecvFuture rf(expected.size());
+    sock.conn->setRecv(&rf);
+
+    int nreleased = 0;
+    for (int ii = 0; ii < 40; ii++) {
+        char hdr[16];
+        sprintf(hdr, "<%d>", ii);
+        sock.put(hdr);
+        lcb_IOV iov;
+        iov.iov_base = &bufs[ii][0];
+        iov.iov_len = bufs[ii].size();
+        lcbio_ctx_put_iov(sock.ctx, &iov, 1, count_release, &nreleased);
+    }
+    sock.schedule();
+
+    FutureBreakCondition wbc(&rf);
+    loop->setBreakCondition(&wbc);
+    loop->start();
+    rf.wait();
+    ASSERT_TRUE(rf.isOk());
+    ASSERT_EQ(expected, rf.getString());
+
+    FlushedBreakCondition fbc(&sock);
+    loop->setBreakCondition(&fbc);
+    loop->start();
+    ASSERT_EQ(40, nreleased);
+}
+
+/**
+ * Buffers which were never written are released when the context is closed,
+ * and empty buffers are released immediately
+ */
+TEST_F(SockWriteTest, testPutIovRelease)
+{
+    ESocket sock;
+    loop->connect(&sock);
+
+    string data("never sent");
+    int nreleased = 0;
+    lcb_IOV iov;
+    iov.iov_base = &data[0];
+    iov.iov_len = 0;
+    lcbio_ctx_put_iov(sock.ctx, &iov, 1, count_release, &nreleased);
+    ASSERT_EQ(1, nreleased);
+
+    iov.iov_len = data.size();
+    lcbio_ctx_put_iov(sock.ctx, &iov, 1, count_release, &nreleased);
+    ASSERT_EQ(1, nreleased);
+    sock.close();
+    ASSERT_EQ(2, nreleased);
+}
+
+/**
+ * Output buffers handed to completed writes are reused rather than
+ * allocated again for each batch
+ */
+TEST_F(SockWriteTest, testOutputReuse)
+{
+    ESocket sock;
+    loop->connect(&sock);
+
+    unsigned nalloc = 0;
+    for (int round = 0; round < 2; round++) {
+        string expected;
+        for (int ii = 0; ii < 4; ii++) {
+            expected += "Hello";
+        }
+        RecvFuture rf(expected.size());
+        sock.conn->setRecv(&rf);
+        for (int ii = 0; ii < 4; ii++) {
+            sock.put("Hello");
+            sock.schedule();
+        }
+
+        FutureBreakCondition wbc(&rf);
+        loop->setBreakCondition(&wbc);
+        loop->start();
+        rf.wait();
+        ASSERT_TRUE(rf.isOk());
+        ASSERT_EQ(expected, rf.getString());
+
+        FlushedBreakCondition fbc(&sock);
+        loop->setBreakCondition(&fbc);
+        loop->start();
+
+        if (round == 0) {
+            nalloc = sock.ctx->nout_alloc;
+            ASSERT_NE(0, nalloc);
+        }
+    }
+    ASSERT_EQ(nalloc, sock.ctx->nout_alloc);
+    ASSERT_EQ(nalloc - 1, sock.ctx->noutfree);
+    if (nalloc > 1) {
+        ASSERT_NE(0, sock.ctx->nout_reuse);
+    }
+}
@@ -154,6 +154,92 @@ TEST_F(ConfigTest, testGeneration)
     free(js);
 }
 
+TEST_F(ConfigTest, testBinarySnapshot)
+{
+    string testData = getConfigFile("terse_30.json");
+    lcbvb_CONFIG *orig = lcbvb_create();
+    ASSERT_EQ(0, lcbvb_load_json(orig, testData.c_str()));
+    lcbvb_genffmap(orig);
+
+    size_t nbin = 0;
+    char *bin = lcbvb_save_binary(orig, &nbin);
+    ASSERT_TRUE(bin != NULL);
+    ASSERT_TRUE(lcbvb_is_binary(bin, nbin));
+    ASSERT_FALSE(lcbvb_is_binary(testData.c_str(), testData.size()));
+
+    lcbvb_CONFIG *cfg = lcbvb_create();
+    ASSERT_EQ(0, lcbvb_load_binary(cfg, bin, nbin)) << lcbvb_get_error(cfg);
+    ASSERT_EQ(orig->dtype, cfg->dtype);
+    ASSERT_EQ(orig->revid, cfg->revid);
+    ASSERT_EQ(orig->caps, cfg->caps);
+    ASSERT_EQ(orig->nsrv, cfg->nsrv);
+    ASSERT_EQ(orig->ndatasrv, cfg->ndatasrv);
+    ASSERT_EQ(orig->nrepl, cfg->nrepl);
+    ASSERT_EQ(orig->nvb, cfg->nvb);
+    ASSERT_STREQ(orig->bname, cfg->bname);
+    ASSERT_STREQ(orig->buuid, cfg->buuid);
+    for (unsigned ii = 0; ii < orig->nsrv; ii++) {
+        ASSERT_STREQ(orig->servers[ii].authority, cfg->servers[ii].authority);
+        ASSERT_EQ(orig->servers[ii].svc_ssl.data, cfg->servers[ii].svc_ssl.data);
+        ASSERT_STREQ(lcbvb_get_resturl(orig, ii, LCBVB_SVCTYPE_VIEWS, LCBVB_SVCMODE_PLAIN),
+                     lcbvb_get_resturl(cfg, ii, LCBVB_SVCTYPE_VIEWS, LCBVB_SVCMODE_PLAIN));
+    }
+    ASSERT_EQ(0, memcmp(orig->vbuckets, cfg->vbuckets, sizeof(*cfg->vbuckets) * cfg->nvb));
+    ASSERT_TRUE(cfg->ffvbuckets != NULL);
+    ASSERT_EQ(0, memcmp(orig->ffvbuckets, cfg->ffvbuckets, sizeof(*cfg->ffvbuckets) * cfg->nvb));
+    lcbvb_destroy(cfg);
+
+    // Corrupted payload must be rejected by the checksum
+    bin[nbin - 1] ^= 0xff;
+    cfg = lcbvb_create();
+    ASSERT_NE(0, lcbvb_load_binary(cfg, bin, nbin));
+    ASSERT_TRUE(lcbvb_get_error(cfg) != NULL);
+    lcbvb_destroy(cfg);
+
+    // Truncated snapshot must be rejected
+    cfg = lcbvb_create();
+    ASSERT_NE(0, lcbvb_load_binary(cfg, bin, nbin / 2));
+    lcbvb_destroy(cfg);
+
+    free(bin);
+    lcbvb_destroy(orig);
+}
+
+TEST_F(ConfigTest, testBinarySnapshotBadIndex)
+{
+    string testData = getConfigFile("terse_30.json");
+    lcbvb_CONFIG *orig = lcbvb_create();
+    ASSERT_EQ(0, lcbvb_load_json(orig, testData.c_str()));
+
+    // A well-formed snapshot whose vBucket map points at no valid server
+    int badixs[] = {-2, -100, (int)orig->nsrv};
+    for (size_t ii = 0; ii < sizeof(badixs) / sizeof(badixs[0]); ii++) {
+        int saved = orig->vbuckets[0].servers[0];
+        orig->vbuckets[0].servers[0] = badixs[ii];
+        size_t nbin = 0;
+        char *bin = lcbvb_save_binary(orig, &nbin);
+        orig->vbuckets[0].servers[0] = saved;
+        ASSERT_TRUE(bin != NULL);
+
+        lcbvb_CONFIG *cfg = lcbvb_create();
+        ASSERT_NE(0, lcbvb_load_binary(cfg, bin, nbin)) << badixs[ii];
+        ASSERT_TRUE(lcbvb_get_error(cfg) != NULL);
+        lcbvb_destroy(cfg);
+        free(bin);
+    }
+
+    // -1 (no server) remains valid
+    orig->vbuckets[0].servers[1] = -1;
+    size_t nbin = 0;
+    char *bin = lcbvb_save_binary(orig, &nbin);
+    lcbvb_CONFIG *cfg = lcbvb_create();
+    ASSERT_EQ(0, lcbvb_load_binary(cfg, bin, nbin)) << lcbvb_get_error(cfg);
+    ASSERT_EQ(-1, cfg->vbuckets[0].servers[1]);
+    lcbvb_destroy(cfg);
+    free(bin);
+    lcbvb_destroy(orig);
+}
+
 TEST_F(ConfigTest, testAltMap)
 {
     lcbvb_CONFIG *cfg = lcbvb_create();
@@ -225,6 +311,44 @@ TEST_F(ConfigTest, testBadInput)
     lcbvb_destroy(cfg);
 }
 
+TEST_F(ConfigTest, testPeekRevision)
+{
+    int64_t epoch, rev;
+    string testData = getConfigFile("terse_30.json");
+    lcbvb_CONFIG *cfg = lcbvb_create();
+    ASSERT_EQ(0, lcbvb_load_json(cfg, testData.c_str()));
+    ASSERT_NE(0, lcbvb_peek_revision(testData.c_str(), testData.size(), &epoch, &rev));
+    ASSERT_EQ(cfg->revid, rev);
+    ASSERT_EQ(0, epoch);
+    lcbvb_destroy(cfg);
+
+    // Nested keys and string values are not mistaken for the top-level fields
+    const char *js = "{\"name\":\"rev\",\"nodes\":[{\"rev\":1}],\"x\":{\"revEpoch\":3},\"s\":\"\\\"rev\\\":2\","
+                     "\"revEpoch\" : 7, \"rev\": 1234}";
+    ASSERT_NE(0, lcbvb_peek_revision(js, strlen(js), &epoch, &rev));
+    ASSERT_EQ(1234, rev);
+    ASSERT_EQ(7, epoch);
+
+    ASSERT_EQ(0, lcbvb_peek_revision(js, 20, &epoch, &rev));
+    ASSERT_EQ(-1, rev);
+    js = "{\"rev\":1.5}";
+    ASSERT_EQ(0, lcbvb_peek_revision(js, strlen(js), &epoch, &rev));
+}
+
+TEST_F(ConfigTest, testEscapedStrings)
+{
+    const char *js = "{\"rev\":5,\"name\":\"b\\u0061\\\"d\",\"nodeLocator\":\"ketama\","
+                     "\"nodes\":[{\"hostname\":\"10.0.0.1:8091\",\"ports\":{\"direct\":11210},\"ddocs\":{\"x\":[1]}}]}"
+                     " trailing data is ignored";
+    lcbvb_CONFIG *cfg = lcbvb_create();
+    ASSERT_EQ(0, lcbvb_load_json(cfg, js));
+    ASSERT_STREQ("ba\"d", cfg->bname);
+    ASSERT_EQ(LCBVB_DIST_KETAMA, cfg->dtype);
+    ASSERT_EQ(1, cfg->nsrv);
+    ASSERT_STREQ("10.0.0.1:11210", cfg->servers[0].authority);
+    lcbvb_destroy(cfg);
+}
+
 TEST_F(ConfigTest, testEmptyMap)
 {
     string emptyTxt = getConfigFile("bad.json");
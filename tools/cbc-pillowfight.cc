@@ -1224,14 +1224,18 @@ static void diag_callback(lcb_INSTANCE *instance, int, const lcb_RESPDIAG *resp)
                     (unsigned long)cookie->stats.eexist, (unsigned long)cookie->stats.etimeout,
                     (unsigned long)cookie->stats.retried, (unsigned long)metrics->packets_retried);
             for (ii = 0; ii < metrics->nservers; ii++) {
-                fprintf(stderr, "  [srv-%d] snt: %lu, rcv: %lu, q: %lu, err: %lu, tmo: %lu, nmv: %lu, orph: %lu\n",
+                fprintf(stderr, "  [srv-%d] snt: %lu, rcv: %lu, q: %lu, err: %lu, tmo: %lu, nmv: %lu, orph: %lu, "
+                        "cmp: %lu/%lu/%lu\n",
                         (int)ii, (unsigned long)metrics->servers[ii]->packets_sent,
                         (unsigned long)metrics->servers[ii]->packets_read,
                         (unsigned long)metrics->servers[ii]->packets_queued,
                         (unsigned long)metrics->servers[ii]->packets_errored,
                         (unsigned long)metrics->servers[ii]->packets_timeout,
                         (unsigned long)metrics->servers[ii]->packets_nmv,
-                        (unsigned long)metrics->servers[ii]->packets_ownerless);
+                        (unsigned long)metrics->servers[ii]->packets_ownerless,
+                        (unsigned long)metrics->servers[ii]->compress_succeeded,
+                        (unsigned long)metrics->servers[ii]->compress_attempted,
+                        (unsigned long)metrics->servers[ii]->compress_skipped);
             }
         }
     }
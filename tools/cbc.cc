@@ -1080,6 +1080,10 @@ static const char *iops_to_string(lcb_io_ops_type_t type)
             return "libuv";
         case LCB_IO_OPS_SELECT:
             return "select";
+        case LCB_IO_OPS_EPOLL:
+            return "epoll";
+        case LCB_IO_OPS_URING:
+            return "uring";
         case LCB_IO_OPS_WINIOCP:
             return "iocp";
         case LCB_IO_OPS_INVALID:
@@ -1116,7 +1120,7 @@ void VersionHandler::run()
         size_t ii;
         char buf[256] = {0}, *p = buf;
         lcb_io_ops_type_t known_io[] = {LCB_IO_OPS_WINIOCP, LCB_IO_OPS_LIBEVENT, LCB_IO_OPS_LIBUV, LCB_IO_OPS_LIBEV,
-                                        LCB_IO_OPS_SELECT};
+                                        LCB_IO_OPS_SELECT, LCB_IO_OPS_EPOLL, LCB_IO_OPS_URING};
 
         for (ii = 0; ii < sizeof(known_io) / sizeof(known_io[0]); ii++) {
             struct lcb_create_io_ops_st cio = {0};